@@ -0,0 +1,209 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir2csv.c
+ *  @brief   Convert a binary CIR capture of dw1000_rx_cir back to CSV
+ *
+ *           Whole accumulator records give one line "sec,nsec,real,img,..." per frame. Windowed records give
+ *           "sec,nsec,<dwt_rxdiag_t fields>,first tap,tap count,real,img,..." per frame. Taps are printed as unsigned 16-bit
+ *           values, as the CSV writer of dw1000_rx_cir used to do.
+ *
+ *           With -s, sec,nsec are the time of the frame on the clock of the time sync beacon sender (sync_ns) instead
+ *           of the host clock, so the captures of several receivers line up. Records taken before the first beacon are
+ *           skipped. Version 1 files, which have no sync time, are read too.
+ *
+ *           Feature files (<capture>.feat, see cir_features.h) give "sec,nsec,seq,flags,first_path,fp_power,rx_power,
+ *           cir_power,peak_to_fp,rms_delay,mean_delay,bg_diff,peak,std_noise,bg_score" per frame, bg_score 0 in version 1
+ *           files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cir_record.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn writeCSVLine()
+ *
+ * @brief Print one record in the CSV layout matching its flags.
+ *
+ * @param  out - output stream
+ * @param  rec - the record
+ * @param  sync - print the sync time instead of the host time
+ *
+ * @return  none
+ */
+static void writeCSVLine(FILE *out, const cir_record_t *rec, int sync)
+{
+    int i;
+
+    if (sync)
+    {
+        fprintf(out, "%lld,%lld", (long long) (rec->sync_ns / 1000000000), (long long) (rec->sync_ns % 1000000000));
+    }
+    else
+    {
+        fprintf(out, "%ld,%lu", (long) rec->rx_sec, (unsigned long) rec->rx_nsec);
+    }
+    if (rec->flags & CIR_RECORD_WINDOW)
+    {
+        fprintf(out, ",%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
+                rec->first_path, rec->max_noise, rec->std_noise, rec->first_path_amp1, rec->first_path_amp2,
+                rec->first_path_amp3, rec->max_growth_cir, rec->rx_pream_count, rec->tap_first, rec->tap_count);
+    }
+    for (i = 0; i < rec->tap_count; i++)
+    {
+        fprintf(out, ",%d,%d", (uint16_t) rec->taps[i][0], (uint16_t) rec->taps[i][1]);
+    }
+    fprintf(out, "\n");
+}
+
+/* Convert a feature file, returns the number of records converted and counts the unsynced ones skipped. */
+static unsigned long convertFeatures(FILE *in, FILE *out, int sync, unsigned long *unsynced)
+{
+    cir_feature_record_t rec;
+    unsigned long n = 0;
+
+    while (fread(&rec, sizeof(rec), 1, in) == 1)
+    {
+        if (rec.magic != CIR_FEATURE_MAGIC || rec.version < 1 || rec.version > CIR_FEATURE_VERSION
+            || rec.size != sizeof(rec))
+        {
+            fprintf(stderr, "record %lu: not a version 1 to %d feature record\n", n, CIR_FEATURE_VERSION);
+            break;
+        }
+        n++;
+        if (sync && !(rec.flags & CIR_FEATURE_SYNC))
+        {
+            (*unsynced)++;
+            continue;
+        }
+        if (sync)
+        {
+            fprintf(out, "%lld,%lld", (long long) (rec.sync_ns / 1000000000), (long long) (rec.sync_ns % 1000000000));
+        }
+        else
+        {
+            fprintf(out, "%ld,%lu", (long) rec.rx_sec, (unsigned long) rec.rx_nsec);
+        }
+        fprintf(out, ",%llu,%u,%.3f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.4f,%u,%u,%.3f\n", (unsigned long long) rec.seq,
+                rec.flags, rec.first_path, rec.fp_power, rec.rx_power, rec.cir_power, rec.peak_to_fp, rec.rms_delay,
+                rec.mean_delay, rec.bg_diff, rec.peak, rec.std_noise, rec.bg_score);
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in;
+    FILE *out = stdout;
+    cir_record_t hdr;
+    cir_record_t *rec = NULL;
+    uint32_t size = 0;
+    uint32_t hdr_len;
+    unsigned long n = 0;
+    unsigned long unsynced = 0;
+    uint32_t magic = 0;
+    int sync = 0;
+
+    if (argc > 1 && strcmp(argv[1], "-s") == 0)
+    {
+        sync = 1;
+        argc--;
+        argv++;
+    }
+    if (argc < 2 || argc > 3)
+    {
+        printf("Usage: cir2csv [-s] <input_file> [output_file]\n");
+        return 1;
+    }
+
+    in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    if (argc == 3)
+    {
+        out = fopen(argv[2], "w");
+        if (!out)
+        {
+            perror(argv[2]);
+            fclose(in);
+            return 1;
+        }
+    }
+
+    if (fread(&magic, sizeof(magic), 1, in) == 1 && magic == CIR_FEATURE_MAGIC)
+    {
+        rewind(in);
+        n = convertFeatures(in, out, sync, &unsynced);
+    }
+    rewind(in);
+
+    /* The version 1 header is a prefix of the current one. */
+    while (magic != CIR_FEATURE_MAGIC && fread(&hdr, CIR_RECORD_HEADER_LEN_V1, 1, in) == 1)
+    {
+        hdr_len = hdr.version == 1 ? CIR_RECORD_HEADER_LEN_V1 : CIR_RECORD_HEADER_LEN;
+        if (hdr.magic != CIR_RECORD_MAGIC || hdr.version < 1 || hdr.version > CIR_RECORD_VERSION || hdr.size < hdr_len)
+        {
+            fprintf(stderr, "record %lu: not a version 1 to %d CIR record\n", n, CIR_RECORD_VERSION);
+            break;
+        }
+        if (hdr.size - hdr_len + CIR_RECORD_HEADER_LEN != size)
+        {
+            free(rec);
+            size = hdr.size - hdr_len + CIR_RECORD_HEADER_LEN;
+            rec = (cir_record_t *) malloc(size);
+            if (!rec)
+            {
+                fprintf(stderr, "Could not allocate memory\n");
+                break;
+            }
+        }
+        memcpy(rec, &hdr, CIR_RECORD_HEADER_LEN_V1);
+        if (hdr.version == 1)
+        {
+            rec->rx_stamp = 0;
+            rec->sync_ns = 0;
+            rec->flags &= ~CIR_RECORD_SYNC;
+        }
+        else if (fread((uint8_t *) rec + CIR_RECORD_HEADER_LEN_V1, CIR_RECORD_HEADER_LEN - CIR_RECORD_HEADER_LEN_V1, 1, in) != 1)
+        {
+            fprintf(stderr, "record %lu: truncated\n", n);
+            break;
+        }
+        rec->size = size;
+        if (fread(rec->taps, size - CIR_RECORD_HEADER_LEN, 1, in) != 1 && size > CIR_RECORD_HEADER_LEN)
+        {
+            fprintf(stderr, "record %lu: truncated\n", n);
+            break;
+        }
+        if (rec->tap_count > CIR_RECORD_CAPACITY(rec))
+        {
+            fprintf(stderr, "record %lu: %u taps do not fit in the record\n", n, rec->tap_count);
+            break;
+        }
+        n++;
+        if (sync && !(rec->flags & CIR_RECORD_SYNC))
+        {
+            unsynced++;
+            continue;
+        }
+        writeCSVLine(out, rec, sync);
+    }
+
+    if (unsynced)
+    {
+        fprintf(stderr, "%lu records without sync time skipped\n", unsynced);
+    }
+    fprintf(stderr, "%lu records converted\n", n - unsynced);
+
+    free(rec);
+    fclose(in);
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
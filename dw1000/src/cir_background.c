@@ -0,0 +1,95 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_background.c
+ *  @brief   Running background model of the CIR of one link, see cir_background.h
+ *
+ *           With d = x - mean taken before the update, mean += a d and var = (1 - a) (var + a |d|^2) is the exponentially
+ *           weighted mean and variance for a constant weight a, and the plain mean and population variance for
+ *           a = 1 / (n + 1) after n frames, which is how the warmup average is taken.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "cir_background.h"
+
+void cir_background_init(cir_background_t *b, uint16_t taps)
+{
+    memset(b, 0, sizeof(*b));
+    b->taps = taps > CIR_BACKGROUND_TAPS_MAX ? CIR_BACKGROUND_TAPS_MAX : taps;
+}
+
+void cir_background_align(const int16_t *iq, uint16_t taps, uint16_t ref, float (*x)[2])
+{
+    float re = iq[2 * ref];
+    float im = iq[2 * ref + 1];
+    float m = sqrtf(re * re + im * im);
+    float c = 1.0f, s = 0.0f;
+    uint16_t k;
+
+    /* Multiply by conj(h[ref]) / |h[ref]|, a zero reference tap leaves the frame as it is */
+    if (m > 0.0f)
+    {
+        c = re / m;
+        s = -im / m;
+    }
+    for (k = 0; k < taps; k++)
+    {
+        float a = iq[2 * k];
+        float b = iq[2 * k + 1];
+
+        x[k][0] = a * c - b * s;
+        x[k][1] = a * s + b * c;
+    }
+}
+
+void cir_background_update(cir_background_t *b, const cir_background_config_t *cfg, const float (*x)[2], float noise2,
+                           cir_background_score_t *out)
+{
+    float e[CIR_BACKGROUND_TAPS_MAX];
+    float score = 0.0f, change = 0.0f, energy = 0.0f;
+    float a;
+    uint16_t k;
+
+    memset(out, 0, sizeof(*out));
+    if (b->frames == 0)
+    {
+        /* First frame: the mean, with no spread yet */
+        memcpy(b->mean, x, (size_t) b->taps * sizeof(x[0]));
+        memset(b->var, 0, sizeof(b->var));
+        b->frames = 1;
+        out->learnt = 1;
+        return;
+    }
+
+    for (k = 0; k < b->taps; k++)
+    {
+        float dr = x[k][0] - b->mean[k][0];
+        float di = x[k][1] - b->mean[k][1];
+
+        e[k] = dr * dr + di * di;
+        score += e[k] / (b->var[k] > noise2 ? b->var[k] : (noise2 > 0.0f ? noise2 : 1.0f));
+        change += e[k];
+        energy += b->mean[k][0] * b->mean[k][0] + b->mean[k][1] * b->mean[k][1];
+    }
+    out->score = score / b->taps;
+    out->diff = energy > 0.0f ? change / energy : 0.0f;
+    out->valid = b->frames >= cfg->warmup;
+
+    if (out->valid && cfg->gate > 0.0f && out->score > cfg->gate)
+    {
+        b->gated++;
+        return;
+    }
+    a = out->valid ? cfg->alpha : 1.0f / (float) (b->frames + 1);
+    for (k = 0; k < b->taps; k++)
+    {
+        b->mean[k][0] += a * (x[k][0] - b->mean[k][0]);
+        b->mean[k][1] += a * (x[k][1] - b->mean[k][1]);
+        b->var[k] = (1.0f - a) * (b->var[k] + a * e[k]);
+    }
+    if (b->frames < UINT32_MAX)
+    {
+        b->frames++;
+    }
+    out->learnt = 1;
+}
@@ -0,0 +1,92 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_background.h
+ *  @brief   Running background model of the CIR of one link
+ *
+ *           The model keeps, for every tap of a window aligned on the first path, the exponential moving average of the
+ *           complex tap and the exponential moving variance around it, so it follows slow changes of an empty room in
+ *           fixed memory and compares every frame with it as it arrives. The CIR of each frame has its own carrier phase:
+ *           taps are rotated so that the first path has phase 0 before they are compared or averaged.
+ *
+ *           The first <warmup> frames are averaged with equal weights, the model is then valid and follows the EMA. Frames
+ *           that deviate by more than <gate> are scored but not learnt, so a person standing in the room does not become
+ *           background; a lasting change of the room is then only learnt after a restart (cir_background_init()).
+ */
+
+#ifndef _CIR_BACKGROUND_H_
+#define _CIR_BACKGROUND_H_
+
+#include <stdint.h>
+
+#define CIR_BACKGROUND_TAPS_MAX (128)   /* longest window */
+#define CIR_BACKGROUND_ALPHA    (0.01f) /* default EMA weight of a new frame, a time constant of 100 frames */
+#define CIR_BACKGROUND_GATE     (9.0f)  /* default score above which a frame is not learnt */
+
+typedef struct
+{
+    float       alpha;          /* weight of a new frame once the model is valid */
+    float       gate;           /* frames scoring above it are not learnt, 0 to learn every frame */
+    uint32_t    warmup;         /* frames averaged before the model is valid, at least 1 */
+} cir_background_config_t;
+
+typedef struct
+{
+    uint16_t        taps;       /* window length */
+    uint32_t        frames;     /* frames learnt */
+    unsigned long   gated;      /* frames not learnt, above the gate */
+    float           mean[CIR_BACKGROUND_TAPS_MAX][2];   /* real, imaginary */
+    float           var[CIR_BACKGROUND_TAPS_MAX];       /* E|h - mean|^2 */
+} cir_background_t;
+
+/* Comparison of a frame with the model */
+typedef struct
+{
+    float       score;          /* mean over the taps of |h - mean|^2 / var, about 1 for a frame of the background */
+    float       diff;           /* sum |h - mean|^2 / sum |mean|^2, the relative energy of the change */
+    int         valid;          /* the model had finished its warmup before the frame */
+    int         learnt;         /* the frame was added to the model */
+} cir_background_score_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_background_init()
+ *
+ * @brief Empty the model.
+ *
+ * @param  b - model
+ * @param  taps - window length, at most CIR_BACKGROUND_TAPS_MAX
+ *
+ * @return  none
+ */
+void cir_background_init(cir_background_t *b, uint16_t taps);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_background_align()
+ *
+ * @brief Window of a frame as the model takes it: the taps as float, rotated so that a reference tap, normally the
+ *        first path, has phase 0.
+ *
+ * @param  iq - taps interleaved real/imaginary, the window of the model already aligned on the first path
+ * @param  taps - window length
+ * @param  ref - index of the reference tap in the window
+ * @param  x - receives the rotated taps
+ *
+ * @return  none
+ */
+void cir_background_align(const int16_t *iq, uint16_t taps, uint16_t ref, float (*x)[2]);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_background_update()
+ *
+ * @brief Score an aligned frame against the model, then learn it unless it is gated out.
+ *
+ * @param  b - model
+ * @param  cfg - learning parameters
+ * @param  x - frame aligned by cir_background_align()
+ * @param  noise2 - noise power of a tap, E|n|^2, the smallest variance a tap is scored against
+ * @param  out - receives the score
+ *
+ * @return  none
+ */
+void cir_background_update(cir_background_t *b, const cir_background_config_t *cfg, const float (*x)[2], float noise2,
+                           cir_background_score_t *out);
+
+#endif /* _CIR_BACKGROUND_H_ */
@@ -0,0 +1,110 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_capture.c
+ *  @brief   Accumulator (CIR) reads shared by the receiving applications, see cir_capture.h
+ *
+ *           Accumulator values are complex numbers: one 16-bit integer for real part and one 16-bit value for imaginary
+ *           part, for each sample. The first byte read when accessing the accumulator memory is always garbage, it is
+ *           dropped by dwt_readaccdatabulk().
+ */
+
+#include <string.h>
+
+#include "deca_regs.h"
+#include "cir_capture.h"
+
+void copyCIRToBuffer(uint8 *buffer, uint16 len)
+{
+    /* Read the whole accumulator with the ACC clocks forced on once, the dummy byte is dropped by the driver. */
+    dwt_readaccdatabulk(buffer, len, 0);
+}
+
+/* Read the taps within <half> taps of the first path, given as a 10.6 bits fixed point index. */
+static uint16 copyCIRWindow(uint8 *buffer, uint16 half, uint16 first_path, uint16 *first)
+{
+    int fp_index;
+    int start;
+    int end;
+    
+    /* First path index is a 10.6 bits fixed point value, keep its integer part. */
+    fp_index = first_path >> 6;
+    start = fp_index - half;
+    end = fp_index + half;
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (end > CIR_SAMPLES)
+    {
+        end = CIR_SAMPLES;
+    }
+    if (end < start)
+    {
+        end = start;
+    }
+    
+    *first = (uint16) start;
+    if (end > start)
+    {
+        dwt_readaccdatabulk(buffer, (uint16) (4*(end - start)), (uint16) (4*start));
+    }
+    return (uint16) (end - start);
+}
+
+uint16 copyCIRWindowToBuffer(uint8 *buffer, uint16 half, dwt_rxdiag_t *diag, uint16 *first)
+{
+    dwt_readdiagnostics(diag);
+    return copyCIRWindow(buffer, half, diag->firstPath, first);
+}
+
+void copyCIRToRecord(cir_record_t *rec, uint16 window, const dwt_rxinfo_t *info)
+{
+    dwt_rxdiag_t diag;
+    
+    rec->flags = 0;
+    rec->rx_stamp = 0;
+    if (info)
+    {
+        dwt_rxinfodiagnostics(info, &diag);
+        rec->rx_stamp = rxInfoTimestamp(info);
+    }
+    
+    if (window)
+    {
+        rec->flags = CIR_RECORD_WINDOW;
+        if (info)
+        {
+            rec->tap_count = copyCIRWindow((uint8 *) rec->taps, window, diag.firstPath, &rec->tap_first);
+        }
+        else
+        {
+            rec->tap_count = copyCIRWindowToBuffer((uint8 *) rec->taps, window, &diag, &rec->tap_first);
+        }
+        memset((void *) rec->taps[rec->tap_count], 0, 4*(2*window - rec->tap_count));
+    }
+    else
+    {
+        copyCIRToBuffer((uint8 *) rec->taps, 4*CIR_SAMPLES);
+        rec->tap_first = 0;
+        rec->tap_count = CIR_SAMPLES;
+    }
+    
+    if (info || window)
+    {
+        rec->flags |= CIR_RECORD_DIAG;
+        rec->first_path = diag.firstPath;
+        rec->max_noise = diag.maxNoise;
+        rec->std_noise = diag.stdNoise;
+        rec->first_path_amp1 = diag.firstPathAmp1;
+        rec->first_path_amp2 = diag.firstPathAmp2;
+        rec->first_path_amp3 = diag.firstPathAmp3;
+        rec->max_growth_cir = diag.maxGrowthCIR;
+        rec->rx_pream_count = diag.rxPreamCount;
+    }
+}
+
+uint64_t rxInfoTimestamp(const dwt_rxinfo_t *info)
+{
+    const uint8 *ts = &info->rxtime[RX_TIME_RX_STAMP_OFFSET];
+    
+    return ((uint64_t) ts[4] << 32) | ((uint64_t) ts[3] << 24) | ((uint64_t) ts[2] << 16) | ((uint64_t) ts[1] << 8) | ts[0];
+}
@@ -0,0 +1,70 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_capture.h
+ *  @brief   Accumulator (CIR) reads shared by the receiving applications
+ */
+
+#ifndef _CIR_CAPTURE_H_
+#define _CIR_CAPTURE_H_
+
+#include "deca_device_api.h"
+#include "cir_record.h"
+
+#define CIR_SAMPLES 1016 //1016
+// 992 samples for 16MHz PRF - 3968 bytes
+// 1016 samples for 64MHz PRF - 4064 bytes
+
+#define CIR_WINDOW_MAX (CIR_SAMPLES/2)   // largest half window, in taps, around the first path
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn copyCIRToBuffer()
+ *
+ * @brief Read the first <len> bytes of the accumulator.
+ *
+ * @param  buffer - receives the taps, at least len bytes
+ * @param  len - number of bytes to read, 4 per tap
+ *
+ * @return  none
+ */
+void copyCIRToBuffer(uint8 *buffer, uint16 len);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn copyCIRWindowToBuffer()
+ *
+ * @brief Read the diagnostics and only the accumulator taps within <half> taps of the first path.
+ *
+ * @param  buffer - receives the taps of the window, at least 4*(2*half) bytes
+ * @param  half - half width of the window in taps
+ * @param  diag - receives the RX diagnostics
+ * @param  first - receives the index of the first tap of the window
+ *
+ * @return  number of taps read
+ */
+uint16 copyCIRWindowToBuffer(uint8 *buffer, uint16 half, dwt_rxdiag_t *diag, uint16 *first);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn copyCIRToRecord()
+ *
+ * @brief Fill the flags, taps, RX timestamp and diagnostics of a record from the last reception. Must run before the
+ *        receiver is re-enabled, the accumulator is overwritten by the next reception.
+ *
+ * @param  rec - the record, with room for 2*window taps, or CIR_SAMPLES if window is 0
+ * @param  window - half window in taps around the first path, 0 for the whole accumulator
+ * @param  info - registers of the reception read with dwt_batchreadrxinfo(), then only the taps are read here. NULL to
+ *                read the diagnostics here, for a window only, and leave rx_stamp at 0.
+ *
+ * @return  none
+ */
+void copyCIRToRecord(cir_record_t *rec, uint16 window, const dwt_rxinfo_t *info);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn rxInfoTimestamp()
+ *
+ * @brief RX timestamp (RX_STAMP, antenna delay corrected) read by dwt_batchreadrxinfo().
+ *
+ * @param  info - registers of the reception
+ *
+ * @return  the 40-bit timestamp
+ */
+uint64_t rxInfoTimestamp(const dwt_rxinfo_t *info);
+
+#endif /* _CIR_CAPTURE_H_ */
@@ -0,0 +1,388 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_codec.c
+ *  @brief   Lossless codec of CIR records, see cir_codec.h
+ *
+ *           Bits are packed from the least significant bit of little-endian words. A block starts with its prediction
+ *           (MODE_BITS) and its Rice parameter k (K_BITS), then each residual z gives q = z >> k as q zeros and a one,
+ *           followed by the k low bits of z. A quotient of ESCAPE or more is sent as ESCAPE then z in RAW_BITS bits,
+ *           which bounds the cost of a value, and of a block, whatever the data. The encoder tries the three
+ *           predictions on the sum of the absolute residuals and k next to log2 of their mean on the exact cost, a few
+ *           operations per value.
+ */
+
+#include <string.h>
+
+#include "cir_codec.h"
+
+#define MODE_RAW            (0)         /* no prediction */
+#define MODE_TAP            (1)         /* same component of the previous tap */
+#define MODE_FRAME          (2)         /* same value of the previous record */
+#define MODE_BITS           (2)
+#define K_BITS              (5)
+#define K_MAX               (16)
+#define ESCAPE              (24)
+#define RAW_BITS            (17)        /* zigzag mapped differences of int16 values are below 2^17 */
+#define BLOCK_VALUES        (2 * CIR_CODEC_BLOCK)
+
+typedef struct
+{
+    uint8_t    *buf;
+    size_t      pos;            /* bytes written */
+    uint64_t    acc;            /* bits not written yet */
+    unsigned    n;              /* number of bits in acc, below 32 between calls */
+} bitWriter;
+
+typedef struct
+{
+    const uint8_t *buf;
+    size_t      len;
+    size_t      pos;            /* bytes loaded into acc, may run past len: bytes past len read as zeros */
+    uint64_t    acc;            /* bits not consumed yet, bits above n already hold the next bytes or zeros */
+    unsigned    n;              /* number of bits in acc */
+} bitReader;
+
+static inline void putBits(bitWriter *w, uint32_t v, unsigned len)
+{
+    w->acc |= (uint64_t) v << w->n;
+    w->n += len;
+    if (w->n >= 32)
+    {
+        w->buf[w->pos] = (uint8_t) w->acc;
+        w->buf[w->pos + 1] = (uint8_t) (w->acc >> 8);
+        w->buf[w->pos + 2] = (uint8_t) (w->acc >> 16);
+        w->buf[w->pos + 3] = (uint8_t) (w->acc >> 24);
+        w->pos += 4;
+        w->acc >>= 32;
+        w->n -= 32;
+    }
+}
+
+/* Write out the last bits, padded to a whole word */
+static void flushBits(bitWriter *w)
+{
+    if (w->n > 0)
+    {
+        putBits(w, 0, 32 - w->n);
+    }
+}
+
+static inline void putRice(bitWriter *w, uint32_t z, unsigned k)
+{
+    uint32_t q = z >> k;
+
+    if (q >= ESCAPE)
+    {
+        putBits(w, 1u << ESCAPE, ESCAPE + 1);
+        putBits(w, z, RAW_BITS);
+    }
+    else if (q + 1 + k <= 32)
+    {
+        putBits(w, (1u << q) | ((z & ((1u << k) - 1)) << (q + 1)), q + 1 + k);
+    }
+    else
+    {
+        putBits(w, 1u << q, q + 1);
+        putBits(w, z & ((1u << k) - 1), k);
+    }
+}
+
+/* At least 57 bits in acc afterwards. The records themselves are little-endian, so is the host. */
+static inline void refill(bitReader *r)
+{
+    if (r->pos + 8 <= r->len)
+    {
+        uint64_t v;
+
+        memcpy(&v, &r->buf[r->pos], sizeof(v));
+        r->acc |= v << r->n;
+        r->pos += (63 - r->n) >> 3;
+        r->n |= 56;
+    }
+    else
+    {
+        while (r->n <= 56)
+        {
+            r->acc |= (uint64_t) (r->pos < r->len ? r->buf[r->pos] : 0) << r->n;
+            r->pos++;
+            r->n += 8;
+        }
+    }
+}
+
+static inline uint32_t getBits(bitReader *r, unsigned len)
+{
+    uint32_t v = (uint32_t) (r->acc & ((1ull << len) - 1));
+
+    r->acc >>= len;
+    r->n -= len;
+    return v;
+}
+
+/* Decode a residual after a refill(), at most ESCAPE + 1 + RAW_BITS bits. Returns -1 for a damaged stream. */
+static inline int64_t getRice(bitReader *r, unsigned k)
+{
+    uint32_t low = (uint32_t) r->acc & ((1u << (ESCAPE + 1)) - 1);
+    unsigned q;
+
+    if (low == 0)
+    {
+        return -1;
+    }
+    q = (unsigned) __builtin_ctz(low);
+    getBits(r, q + 1);
+    if (q == ESCAPE)
+    {
+        return getBits(r, RAW_BITS);
+    }
+    return ((int64_t) q << k) | getBits(r, k);
+}
+
+static inline uint32_t zigzag(int32_t r)
+{
+    return ((uint32_t) r << 1) ^ (uint32_t) -(r < 0);
+}
+
+static inline int32_t unzigzag(uint32_t z)
+{
+    return (int32_t) (z >> 1) ^ -(int32_t) (z & 1);
+}
+
+static inline uint32_t absDiff(int32_t a, int32_t b)
+{
+    return a > b ? (uint32_t) (a - b) : (uint32_t) (b - a);
+}
+
+/* Bits of n residuals Rice coded with parameter k */
+static uint32_t riceCost(const uint32_t *z, unsigned n, unsigned k)
+{
+    uint32_t bits = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+    {
+        uint32_t q = z[i] >> k;
+
+        bits += q >= ESCAPE ? ESCAPE + 1 + RAW_BITS : q + 1 + k;
+    }
+    return bits;
+}
+
+/* Header length of a CIR record, 0 if it is not one */
+static uint32_t headerLen(const cir_record_t *rec)
+{
+    if (rec->magic != CIR_RECORD_MAGIC || rec->version < 1 || rec->version > CIR_RECORD_VERSION)
+    {
+        return 0;
+    }
+    return rec->version == 1 ? CIR_RECORD_HEADER_LEN_V1 : CIR_RECORD_HEADER_LEN;
+}
+
+void cir_codec_init(cir_codec_t *c, uint32_t key_interval)
+{
+    memset(c, 0, sizeof(*c));
+    c->key_interval = key_interval ? key_interval : 1;
+}
+
+size_t cir_codec_encode(cir_codec_t *c, const cir_record_t *rec, uint8_t *out, size_t cap)
+{
+    cir_coded_header_t hdr;
+    bitWriter w;
+    const int16_t *x;
+    uint32_t hdr_len = headerLen(rec);
+    uint32_t tap_len, values, b;
+    int key, inter;
+
+    if (hdr_len == 0 || rec->size < hdr_len || (rec->size - hdr_len) % 4 != 0
+        || rec->size - hdr_len > sizeof(c->ref) || cap < CIR_CODED_BOUND(rec->size))
+    {
+        return 0;
+    }
+    tap_len = rec->size - hdr_len;
+    values = tap_len / 2;
+    x = (const int16_t *) ((const uint8_t *) rec + hdr_len);
+    key = c->since_key == 0 || c->ref_len != tap_len;
+    inter = !key;
+
+    hdr.magic = CIR_CODED_MAGIC;
+    hdr.version = CIR_CODED_VERSION;
+    hdr.flags = key ? CIR_CODED_KEY : 0;
+    hdr.raw_size = rec->size;
+    memcpy(&out[CIR_CODED_HEADER_LEN], rec, hdr_len);
+
+    w.buf = &out[CIR_CODED_HEADER_LEN + hdr_len];
+    w.pos = 0;
+    w.acc = 0;
+    w.n = 0;
+    for (b = 0; b < values; b += BLOCK_VALUES)
+    {
+        uint32_t z[BLOCK_VALUES];
+        uint32_t sum[3] = { 0, 0, 0 };
+        uint32_t total = 0, best, cost;
+        unsigned n = values - b < BLOCK_VALUES ? values - b : BLOCK_VALUES;
+        unsigned i, mode, k, k0, kk;
+
+        for (i = 0; i < n; i++)
+        {
+            int32_t v = x[b + i];
+
+            sum[MODE_RAW] += absDiff(v, 0);
+            sum[MODE_TAP] += absDiff(v, b + i >= 2 ? x[b + i - 2] : 0);
+            sum[MODE_FRAME] += inter ? absDiff(v, c->ref[b + i]) : 0;
+        }
+        mode = MODE_RAW;
+        mode = sum[MODE_TAP] < sum[mode] ? MODE_TAP : mode;
+        mode = inter && sum[MODE_FRAME] < sum[mode] ? MODE_FRAME : mode;
+        for (i = 0; i < n; i++)
+        {
+            int32_t v = x[b + i];
+            int32_t p = mode == MODE_RAW ? 0 : mode == MODE_TAP ? (b + i >= 2 ? x[b + i - 2] : 0) : c->ref[b + i];
+
+            z[i] = zigzag(v - p);
+            total += z[i];
+        }
+
+        /* k0 ~ log2 of the mean residual, then the cheapest of k0 - 1 to k0 + 1 */
+        k0 = 0;
+        while (k0 < K_MAX && ((uint32_t) n << (k0 + 1)) <= total)
+        {
+            k0++;
+        }
+        k = k0;
+        best = riceCost(z, n, k0);
+        for (kk = k0 > 0 ? k0 - 1 : k0 + 1; kk <= k0 + 1 && kk <= K_MAX; kk += 2)
+        {
+            cost = riceCost(z, n, kk);
+            if (cost < best)
+            {
+                best = cost;
+                k = kk;
+            }
+        }
+
+        /* Give up as soon as the coded taps would not be smaller than the taps as they are */
+        if (w.pos * 8 + w.n + MODE_BITS + K_BITS + best > (size_t) tap_len * 8)
+        {
+            break;
+        }
+        putBits(&w, mode | (k << MODE_BITS), MODE_BITS + K_BITS);
+        for (i = 0; i < n; i++)
+        {
+            putRice(&w, z[i], k);
+        }
+    }
+    flushBits(&w);
+
+    if (b < values || w.pos >= tap_len)
+    {
+        hdr.flags |= CIR_CODED_STORED;
+        memcpy(w.buf, x, tap_len);
+        w.pos = tap_len;
+    }
+    hdr.size = (uint32_t) (CIR_CODED_HEADER_LEN + hdr_len + w.pos);
+    memcpy(out, &hdr, sizeof(hdr));
+
+    memcpy(c->ref, x, tap_len);
+    c->ref_len = tap_len;
+    c->since_key = key ? 1 : c->since_key + 1;
+    if (c->since_key >= c->key_interval)
+    {
+        c->since_key = 0;
+    }
+    c->records++;
+    c->raw_bytes += rec->size;
+    c->coded_bytes += hdr.size;
+    return hdr.size;
+}
+
+size_t cir_codec_decode(cir_codec_t *c, const uint8_t *in, size_t len, cir_record_t *rec, size_t cap)
+{
+    cir_coded_header_t hdr;
+    bitReader r;
+    int16_t *x;
+    uint32_t hdr_len, tap_len, values, b;
+    int inter;
+
+    if (len < CIR_CODED_HEADER_LEN + CIR_RECORD_HEADER_LEN_V1 || cap < CIR_RECORD_HEADER_LEN_V1)
+    {
+        return 0;
+    }
+    memcpy(&hdr, in, sizeof(hdr));
+    if (hdr.magic != CIR_CODED_MAGIC || hdr.version != CIR_CODED_VERSION || hdr.size > len
+        || hdr.size < CIR_CODED_HEADER_LEN + CIR_RECORD_HEADER_LEN_V1 || hdr.raw_size > cap)
+    {
+        return 0;
+    }
+    memcpy(rec, &in[CIR_CODED_HEADER_LEN], CIR_RECORD_HEADER_LEN_V1);
+    hdr_len = headerLen(rec);
+    if (hdr_len == 0 || rec->size != hdr.raw_size || hdr.raw_size < hdr_len || (hdr.raw_size - hdr_len) % 4 != 0
+        || hdr.raw_size - hdr_len > sizeof(c->ref) || hdr.size < CIR_CODED_HEADER_LEN + hdr_len)
+    {
+        return 0;
+    }
+    memcpy(rec, &in[CIR_CODED_HEADER_LEN], hdr_len);
+    tap_len = hdr.raw_size - hdr_len;
+    values = tap_len / 2;
+    x = (int16_t *) ((uint8_t *) rec + hdr_len);
+    inter = !(hdr.flags & CIR_CODED_KEY) && c->ref_len == tap_len;
+
+    r.buf = &in[CIR_CODED_HEADER_LEN + hdr_len];
+    r.len = hdr.size - CIR_CODED_HEADER_LEN - hdr_len;
+    if (hdr.flags & CIR_CODED_STORED)
+    {
+        if (r.len < tap_len)
+        {
+            return 0;
+        }
+        memcpy(x, r.buf, tap_len);
+    }
+    else
+    {
+        r.pos = 0;
+        r.acc = 0;
+        r.n = 0;
+        for (b = 0; b < values; b += BLOCK_VALUES)
+        {
+            unsigned n = values - b < BLOCK_VALUES ? values - b : BLOCK_VALUES;
+            unsigned i, mode, k;
+
+            refill(&r);
+            mode = getBits(&r, MODE_BITS);
+            k = getBits(&r, K_BITS);
+            if (mode > MODE_FRAME || k > K_MAX || (mode == MODE_FRAME && !inter))
+            {
+                return 0;
+            }
+            for (i = 0; i < n; i++)
+            {
+                int64_t z;
+                int32_t p, v;
+
+                refill(&r);
+                z = getRice(&r, k);
+                if (z < 0)
+                {
+                    return 0;
+                }
+                p = mode == MODE_RAW ? 0 : mode == MODE_TAP ? (b + i >= 2 ? x[b + i - 2] : 0) : c->ref[b + i];
+                v = unzigzag((uint32_t) z) + p;
+                if (v < INT16_MIN || v > INT16_MAX)
+                {
+                    return 0;
+                }
+                x[b + i] = (int16_t) v;
+            }
+        }
+        /* Bits read past the end of the coded record were zeros, not data */
+        if (r.pos * 8 - r.n > r.len * 8)
+        {
+            return 0;
+        }
+    }
+
+    memcpy(c->ref, x, tap_len);
+    c->ref_len = tap_len;
+    c->records++;
+    c->raw_bytes += hdr.raw_size;
+    c->coded_bytes += hdr.size;
+    return hdr.raw_size;
+}
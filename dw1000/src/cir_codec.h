@@ -0,0 +1,103 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_codec.h
+ *  @brief   Lossless codec of CIR records
+ *
+ *           A coded capture is a sequence of coded records, each a cir_coded_header_t, the cir_record_t header of the
+ *           record as it is and its taps coded. Decoding gives back the original capture byte for byte.
+ *
+ *           The taps are coded in blocks of CIR_CODEC_BLOCK taps. Each block picks the prediction of its values that
+ *           costs the fewest bits: none, the same component of the previous tap, or the same value of the previous
+ *           record (same size records, taps at the same index: the same accumulator index for whole accumulator
+ *           records, the same delay after the first path for windowed ones). The residuals are zigzag mapped to
+ *           unsigned values and Rice coded with the parameter that suits the block best, so the noise taps before the
+ *           first path and in the tail cost a few bits each. A record that would not get smaller is stored as it is.
+ *
+ *           One record in <key_interval> (a key record) does not refer to the previous one, so a damaged or missing
+ *           coded record only spoils the records up to the next key record.
+ */
+
+#ifndef _CIR_CODEC_H_
+#define _CIR_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cir_record.h"
+
+#define CIR_CODED_MAGIC         (0x5A494355UL)  /* "UCIZ" */
+#define CIR_CODED_VERSION       (1)
+
+/* Coded record flags */
+#define CIR_CODED_KEY           (0x0001)        /* no block refers to the previous record */
+#define CIR_CODED_STORED        (0x0002)        /* the taps are stored as they are */
+
+#define CIR_CODEC_BLOCK         (16)            /* taps per block */
+#define CIR_CODEC_KEY_INTERVAL  (64)            /* default records between key records */
+
+typedef struct
+{
+    uint32_t    magic;          /* CIR_CODED_MAGIC */
+    uint16_t    version;        /* CIR_CODED_VERSION */
+    uint16_t    flags;          /* CIR_CODED_* flags */
+    uint32_t    size;           /* coded record size in bytes, this header included, a multiple of 4 */
+    uint32_t    raw_size;       /* size of the decoded record, its cir_record_t size field */
+} cir_coded_header_t;
+
+#define CIR_CODED_HEADER_LEN    (sizeof(cir_coded_header_t))
+#define CIR_CODED_BOUND(size)   (CIR_CODED_HEADER_LEN + (size))     /* largest coded record of a <size> bytes record */
+
+typedef struct
+{
+    uint32_t    key_interval;   /* records between key records, 1 for key records only */
+    uint32_t    since_key;      /* records since the last key record */
+    uint32_t    ref_len;        /* bytes of taps in ref, 0 if there is no previous record */
+    int16_t     ref[2 * CIR_RECORD_TAPS_MAX];   /* taps of the previous record */
+    uint64_t    records;        /* records coded or decoded */
+    uint64_t    raw_bytes;      /* their size */
+    uint64_t    coded_bytes;    /* their coded size */
+} cir_codec_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_codec_init()
+ *
+ * @brief Start coding or decoding a capture: no previous record, counters cleared. An encoder and a decoder each need
+ *        their own state.
+ *
+ * @param  c - codec state
+ * @param  key_interval - records between key records, CIR_CODEC_KEY_INTERVAL; 0 gives 1. Only used to encode.
+ *
+ * @return  none
+ */
+void cir_codec_init(cir_codec_t *c, uint32_t key_interval);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_codec_encode()
+ *
+ * @brief Code the next record of a capture.
+ *
+ * @param  c - codec state
+ * @param  rec - record, version 1 or 2, whose size holds a whole number of taps
+ * @param  out - receives the coded record, CIR_CODED_BOUND(rec->size) bytes at most
+ * @param  cap - size of out
+ *
+ * @return  size of the coded record, 0 if rec is not a CIR record or out is too small
+ */
+size_t cir_codec_encode(cir_codec_t *c, const cir_record_t *rec, uint8_t *out, size_t cap);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_codec_decode()
+ *
+ * @brief Decode the next coded record of a capture. Records are decoded in the order they were coded, from the first
+ *        one or from a key record.
+ *
+ * @param  c - codec state
+ * @param  in - coded record, its header size bytes long
+ * @param  len - bytes available at in
+ * @param  rec - receives the record
+ * @param  cap - size of rec
+ *
+ * @return  size of the record, 0 if the coded record is damaged, refers to a record not decoded, or rec is too small
+ */
+size_t cir_codec_decode(cir_codec_t *c, const uint8_t *in, size_t len, cir_record_t *rec, size_t cap);
+
+#endif /* _CIR_CODEC_H_ */
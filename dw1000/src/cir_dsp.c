@@ -0,0 +1,383 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_dsp.c
+ *  @brief   CIR post-processing kernels, see cir_dsp.h
+ *
+ *           The scalar kernels, which are also the reference the SIMD ones are checked against by cir_dsp_bench, and
+ *           the dispatch: the first call picks the widest table the build and the CPU support. The parts of the first
+ *           path search and of the delay spread that are not per tap arithmetic are common to all tables.
+ *
+ *           The NEON check is made here rather than in cir_dsp_neon.c, which is built for ARMv7 and may not run on the
+ *           ARMv6 boards it rules out.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(CIR_DSP_NEON) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+#include "cir_dsp.h"
+#include "cir_dsp_ops.h"
+
+#if defined(CIR_DSP_NEON) && !defined(__aarch64__) && !defined(HWCAP_NEON)
+#define HWCAP_NEON          (1 << 12)   /* asm/hwcap.h of 32-bit ARM */
+#endif
+
+#define FP_SINC_HALF_WIDTH  (8)     /* taps on each side of an interpolated point */
+#define FP_UPSAMPLE_MAX     (64)
+#define FP_NOISE_MIN        (16)    /* fewest taps the noise estimate is taken from */
+
+/* Power of a tap as the DW1000 accumulator allows it: re^2 + im^2 reaches 2^31 for (-32768, -32768), so the sum is
+ * unsigned. Every table converts this same value to float. */
+static inline uint32_t tapPower(const int16_t *iq)
+{
+    return (uint32_t) (iq[0] * iq[0]) + (uint32_t) (iq[1] * iq[1]);
+}
+
+static inline float atanPoly(float a)
+{
+    float s = a * a;
+
+    return a * (CIR_ATAN_C0 + s * (CIR_ATAN_C1 + s * (CIR_ATAN_C2 + s * (CIR_ATAN_C3 + s * (CIR_ATAN_C4
+        + s * CIR_ATAN_C5)))));
+}
+
+static void scalarMagnitude(const int16_t *iq, float *mag, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k < n; k++)
+    {
+        mag[k] = sqrtf((float) tapPower(&iq[2 * k]));
+    }
+}
+
+static void scalarPhase(const int16_t *iq, float *phase, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k < n; k++)
+    {
+        float x = iq[2 * k];
+        float y = iq[2 * k + 1];
+        float ax = fabsf(x);
+        float ay = fabsf(y);
+        float mx = ax > ay ? ax : ay;
+        float mn = ax > ay ? ay : ax;
+        float r = atanPoly(mx > 0.0f ? mn / mx : 0.0f);
+
+        if (ay > ax)
+        {
+            r = CIR_PI_2 - r;
+        }
+        if (x < 0.0f)
+        {
+            r = CIR_PI - r;
+        }
+        phase[k] = y < 0.0f ? -r : r;
+    }
+}
+
+static void scalarPdpAccumulate(const int16_t *iq, float *pdp, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k < n; k++)
+    {
+        pdp[k] += (float) tapPower(&iq[2 * k]);
+    }
+}
+
+static void scalarMoments(const float *p, size_t n, float origin, float sum[3])
+{
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f;
+    size_t k;
+
+    for (k = 0; k < n; k++)
+    {
+        float d = (float) k - origin;
+
+        s0 += p[k];
+        s1 += d * p[k];
+        s2 += d * d * p[k];
+    }
+    sum[0] = s0;
+    sum[1] = s1;
+    sum[2] = s2;
+}
+
+static void scalarSums(const float *x, size_t n, float sum[2])
+{
+    float s = 0.0f, s2 = 0.0f;
+    size_t k;
+
+    for (k = 0; k < n; k++)
+    {
+        s += x[k];
+        s2 += x[k] * x[k];
+    }
+    sum[0] = s;
+    sum[1] = s2;
+}
+
+static void scalarDot2(const float *re, const float *im, const float *c, size_t n, float out[2])
+{
+    float r = 0.0f, i = 0.0f;
+    size_t k;
+
+    for (k = 0; k < n; k++)
+    {
+        r += re[k] * c[k];
+        i += im[k] * c[k];
+    }
+    out[0] = r;
+    out[1] = i;
+}
+
+const cir_dsp_ops_t cir_dsp_scalar =
+{
+    "scalar", scalarMagnitude, scalarPhase, scalarPdpAccumulate, scalarMoments, scalarSums, scalarDot2
+};
+
+#ifdef CIR_DSP_NEON
+/* AArch64 always has NEON, 32-bit ARM reports it in the hardware capabilities */
+static int armHasNeon(void)
+{
+#ifdef __aarch64__
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+#endif
+
+static const cir_dsp_ops_t *ops = &cir_dsp_scalar;
+static pthread_once_t ops_once = PTHREAD_ONCE_INIT;
+
+/* Tables of this build the CPU can run, narrowest first */
+static size_t availableOps(const cir_dsp_ops_t **list)
+{
+    size_t count = 0;
+
+    list[count++] = &cir_dsp_scalar;
+#ifdef CIR_DSP_X86
+    list[count++] = &cir_dsp_sse2;
+    if (cir_dsp_x86_has_avx2())
+    {
+        list[count++] = &cir_dsp_avx2;
+    }
+#endif
+#ifdef CIR_DSP_NEON
+    if (armHasNeon())
+    {
+        list[count++] = &cir_dsp_neon;
+    }
+#endif
+    return count;
+}
+
+static void selectBest(void)
+{
+    const cir_dsp_ops_t *list[4];
+
+    ops = list[availableOps(list) - 1];
+}
+
+static inline const cir_dsp_ops_t *dspOps(void)
+{
+    pthread_once(&ops_once, selectBest);
+    return ops;
+}
+
+void cir_magnitude(const int16_t *iq, float *mag, size_t n)
+{
+    dspOps()->magnitude(iq, mag, n);
+}
+
+void cir_phase(const int16_t *iq, float *phase, size_t n)
+{
+    dspOps()->phase(iq, phase, n);
+}
+
+void cir_pdp_accumulate(const int16_t *iq, float *pdp, size_t n)
+{
+    dspOps()->pdp_accumulate(iq, pdp, n);
+}
+
+float cir_rms_delay_spread(const float *pdp, size_t n, float *mean_delay)
+{
+    const cir_dsp_ops_t *o = dspOps();
+    float sum[3];
+    float mean;
+    float var;
+
+    /* Two passes: the second moment is taken about the mean, in single precision the raw sum of k^2 p[k] would cancel
+     * the few significant digits of a spread much shorter than the CIR. */
+    o->moments(pdp, n, 0.0f, sum);
+    if (!(sum[0] > 0.0f))
+    {
+        if (mean_delay)
+        {
+            *mean_delay = 0.0f;
+        }
+        return 0.0f;
+    }
+    mean = sum[1] / sum[0];
+    o->moments(pdp, n, mean, sum);
+    var = sum[2] / sum[0] - (sum[1] / sum[0]) * (sum[1] / sum[0]);
+    if (mean_delay)
+    {
+        *mean_delay = mean;
+    }
+    return var > 0.0f ? sqrtf(var) : 0.0f;
+}
+
+/* Hann windowed sinc weights of the 2 * FP_SINC_HALF_WIDTH taps around a point frac taps after tap
+ * FP_SINC_HALF_WIDTH - 1 of the window. */
+static void sincWeights(float frac, float *c)
+{
+    /* sin(pi d) only changes sign from one tap to the next, and the window angle pi d / H steps by -pi / H: three
+     * sines and cosines per point instead of two per tap. */
+    const float step_cos = cosf(CIR_PI / FP_SINC_HALF_WIDTH);
+    const float step_sin = sinf(CIR_PI / FP_SINC_HALF_WIDTH);
+    float s = sinf(CIR_PI * frac);
+    float wc = cosf(CIR_PI * (frac + FP_SINC_HALF_WIDTH - 1) / FP_SINC_HALF_WIDTH);
+    float ws = sinf(CIR_PI * (frac + FP_SINC_HALF_WIDTH - 1) / FP_SINC_HALF_WIDTH);
+    int i;
+
+    if ((FP_SINC_HALF_WIDTH - 1) % 2)
+    {
+        s = -s;
+    }
+    for (i = 0; i < 2 * FP_SINC_HALF_WIDTH; i++)
+    {
+        float d = frac + (float) (FP_SINC_HALF_WIDTH - 1 - i);
+        float t;
+
+        c[i] = (0.5f + 0.5f * wc) * (fabsf(d) < 1e-6f ? 1.0f : s / (CIR_PI * d));
+        s = -s;
+        t = wc * step_cos + ws * step_sin;
+        ws = ws * step_cos - wc * step_sin;
+        wc = t;
+    }
+}
+
+float cir_first_path(const int16_t *iq, size_t n, const cir_fp_config_t *cfg)
+{
+    static const cir_fp_config_t default_cfg = CIR_FP_CONFIG_DEFAULT;
+    const cir_dsp_ops_t *o = dspOps();
+    float mag[CIR_DSP_TAPS_MAX];
+    float re[2 * FP_SINC_HALF_WIDTH];
+    float im[2 * FP_SINC_HALF_WIDTH];
+    float c[2 * FP_SINC_HALF_WIDTH];
+    float sum[2];
+    float mean, var, thr, prev;
+    size_t peak, start, k;
+    unsigned upsample, j;
+    int i;
+
+    if (cfg == NULL)
+    {
+        cfg = &default_cfg;
+    }
+    if (n > CIR_DSP_TAPS_MAX)
+    {
+        n = CIR_DSP_TAPS_MAX;
+    }
+    if (n == 0)
+    {
+        return -1.0f;
+    }
+
+    o->magnitude(iq, mag, n);
+    for (peak = 0, k = 1; k < n; k++)
+    {
+        if (mag[k] > mag[peak])
+        {
+            peak = k;
+        }
+    }
+
+    /* Noise statistics from the taps before the search window and its guard */
+    start = peak > cfg->search_back ? peak - cfg->search_back : 0;
+    if (start < (size_t) cfg->noise_guard + FP_NOISE_MIN)
+    {
+        return -1.0f;
+    }
+    o->sums(mag, start - cfg->noise_guard, sum);
+    mean = sum[0] / (float) (start - cfg->noise_guard);
+    var = sum[1] / (float) (start - cfg->noise_guard) - mean * mean;
+    thr = mean + cfg->noise_factor * (var > 0.0f ? sqrtf(var) : 0.0f);
+
+    for (k = start; k <= peak && !(mag[k] > thr); k++)
+    {
+    }
+    if (k > peak)
+    {
+        return -1.0f;
+    }
+
+    /* The leading edge is between taps k - 1 and k. Interpolate the complex CIR at upsample - 1 points in between, the
+     * magnitude of the taps alone can miss a crossing where the phase turns. */
+    upsample = cfg->upsample < 1 ? 1 : (cfg->upsample > FP_UPSAMPLE_MAX ? FP_UPSAMPLE_MAX : cfg->upsample);
+    for (i = 0; i < 2 * FP_SINC_HALF_WIDTH; i++)
+    {
+        long m = (long) k - FP_SINC_HALF_WIDTH + i;
+
+        re[i] = (m >= 0 && (size_t) m < n) ? iq[2 * m] : 0.0f;
+        im[i] = (m >= 0 && (size_t) m < n) ? iq[2 * m + 1] : 0.0f;
+    }
+    prev = mag[k - 1];
+    for (j = 1; j <= upsample; j++)
+    {
+        float frac = (float) j / (float) upsample;
+        float h[2];
+        float cur;
+
+        if (j == upsample)
+        {
+            cur = mag[k];
+        }
+        else
+        {
+            sincWeights(frac, c);
+            o->dot2(re, im, c, 2 * FP_SINC_HALF_WIDTH, h);
+            cur = sqrtf(h[0] * h[0] + h[1] * h[1]);
+        }
+        if (cur > thr)
+        {
+            /* Linear between the last point below the threshold and this one. Tap k - 1 is only above it when the
+             * edge is at the start of the search window, the crossing is then taken at tap k - 1. */
+            float t = prev < thr ? (thr - prev) / (cur - prev) : 0.0f;
+
+            return (float) (k - 1) + ((float) (j - 1) + t) / (float) upsample;
+        }
+        prev = cur;
+    }
+    return (float) k;
+}
+
+const char *cir_dsp_isa(void)
+{
+    return dspOps()->name;
+}
+
+int cir_dsp_select(const char *isa)
+{
+    const cir_dsp_ops_t *list[4];
+    size_t count;
+    size_t i;
+
+    pthread_once(&ops_once, selectBest);
+    count = availableOps(list);
+    for (i = 0; i < count; i++)
+    {
+        if (strcmp(list[i]->name, isa) == 0)
+        {
+            ops = list[i];
+            return 0;
+        }
+    }
+    return -1;
+}
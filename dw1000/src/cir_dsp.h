@@ -0,0 +1,122 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_dsp.h
+ *  @brief   CIR post-processing kernels
+ *
+ *           The kernels work on accumulator taps as copyCIRToBuffer() and cir_record_t store them: n interleaved
+ *           real/imaginary int16 pairs, pass &rec->taps[0][0]. Each kernel has a scalar version and SIMD versions (SSE2
+ *           and AVX2 on x86, NEON on ARMv7 and AArch64), the fastest one the CPU supports is picked on the first call.
+ *           All versions compute the same arithmetic in single precision, see cir_dsp_bench for their throughput.
+ */
+
+#ifndef _CIR_DSP_H_
+#define _CIR_DSP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CIR_DSP_TAPS_MAX        (1016)      /* longest CIR cir_first_path() searches, the accumulator at 64 MHz PRF */
+#define CIR_DSP_NS_PER_TAP      (1.0016)    /* accumulator sample period, 1/(2*499.2 MHz) */
+
+/* Leading edge search of cir_first_path() */
+typedef struct
+{
+    uint16_t    upsample;       /* interpolation factor of the fractional search, 1 for none */
+    uint16_t    search_back;    /* taps before the strongest path searched for the leading edge */
+    uint16_t    noise_guard;    /* taps before the search window left out of the noise estimate */
+    float       noise_factor;   /* threshold in noise standard deviations above the mean noise magnitude */
+} cir_fp_config_t;
+
+#define CIR_FP_CONFIG_DEFAULT   { 8, 64, 16, 6.0f }
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_magnitude()
+ *
+ * @brief |h| of every tap.
+ *
+ * @param  iq - n interleaved real/imaginary taps
+ * @param  mag - receives n magnitudes
+ * @param  n - number of taps
+ *
+ * @return  none
+ */
+void cir_magnitude(const int16_t *iq, float *mag, size_t n);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_phase()
+ *
+ * @brief Phase of every tap in radians, in [-pi, pi]. A polynomial atan2, within 1e-5 rad of atan2f().
+ *
+ * @param  iq - n interleaved real/imaginary taps
+ * @param  phase - receives n phases
+ * @param  n - number of taps
+ *
+ * @return  none
+ */
+void cir_phase(const int16_t *iq, float *phase, size_t n);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_pdp_accumulate()
+ *
+ * @brief Add the power |h|^2 of every tap to a power-delay profile. Starting from zeros, one call gives the power of a
+ *        single CIR; calls over the CIRs of a capture, first path aligned, give its average PDP once divided by their
+ *        number.
+ *
+ * @param  iq - n interleaved real/imaginary taps
+ * @param  pdp - n powers, updated
+ * @param  n - number of taps
+ *
+ * @return  none
+ */
+void cir_pdp_accumulate(const int16_t *iq, float *pdp, size_t n);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_rms_delay_spread()
+ *
+ * @brief RMS delay spread of a power-delay profile: the standard deviation of the tap index weighted by power.
+ *
+ * @param  pdp - n powers
+ * @param  n - number of taps
+ * @param  mean_delay - receives the power weighted mean tap index, or NULL
+ *
+ * @return  the spread in taps (CIR_DSP_NS_PER_TAP ns each), 0 for a profile without power
+ */
+float cir_rms_delay_spread(const float *pdp, size_t n, float *mean_delay);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_first_path()
+ *
+ * @brief Leading edge of the CIR: the first point, before the strongest tap, where |h| rises above the noise threshold.
+ *        The noise is taken from the taps before the search window. The crossing is then refined between taps on
+ *        the CIR upsampled by band limited (windowed sinc) interpolation of the complex taps.
+ *
+ * @param  iq - n interleaved real/imaginary taps
+ * @param  n - number of taps, at most CIR_DSP_TAPS_MAX
+ * @param  cfg - search parameters, NULL for CIR_FP_CONFIG_DEFAULT
+ *
+ * @return  the first path in taps, fractional, or -1 if no tap rises above the noise or there is too little noise
+ *          before the search window to estimate it
+ */
+float cir_first_path(const int16_t *iq, size_t n, const cir_fp_config_t *cfg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_dsp_isa()
+ *
+ * @brief Instruction set of the kernels in use.
+ *
+ * @return  "scalar", "sse2", "avx2" or "neon"
+ */
+const char *cir_dsp_isa(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_dsp_select()
+ *
+ * @brief Use the kernels of another instruction set, for benchmarks and comparisons. Not thread safe: call it before
+ *        the kernels are used from several threads.
+ *
+ * @param  isa - "scalar", "sse2", "avx2" or "neon"
+ *
+ * @return  0 on success, -1 if this build or CPU does not have it
+ */
+int cir_dsp_select(const char *isa);
+
+#endif /* _CIR_DSP_H_ */
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Python bindings of the CIR kernels (cir_dsp.h), on the taps of cir_reader.py.
+
+Every function takes the "taps" field of one or more records, int16 of shape
+(..., taps, 2), and runs the SIMD kernels on it without converting to complex
+first. Build the library first with "make libcir_dsp.so".
+
+    from cir_reader import CIRFile
+    import cir_dsp
+    with CIRFile("../../data/test.cir") as f:
+        mag = cir_dsp.magnitude(f.records["taps"])      # frames x taps, float32
+        pdp = cir_dsp.pdp(f.records["taps"]) / len(f)   # average power-delay profile
+        rms = cir_dsp.rms_delay_spread(pdp)             # taps
+        fp = cir_dsp.first_path(f.records["taps"])      # fractional tap per frame, -1 if none
+
+Indices are relative to taps[0], add the record's tap_first for the
+accumulator index. Records shorter than their capacity (tap_count) are zero
+padded, which only the magnitude, phase and PDP tolerate.
+"""
+
+import ctypes, os
+import numpy as np
+
+NS_PER_TAP = 1.0016
+
+
+class FirstPathConfig(ctypes.Structure):
+    _fields_ = [("upsample", ctypes.c_uint16), ("search_back", ctypes.c_uint16), ("noise_guard", ctypes.c_uint16),
+                ("noise_factor", ctypes.c_float)]
+
+
+DEFAULT_FP_CONFIG = FirstPathConfig(8, 64, 16, 6.0)
+
+_i16p = np.ctypeslib.ndpointer(dtype=np.int16, flags="C_CONTIGUOUS")
+_f32p = np.ctypeslib.ndpointer(dtype=np.float32, flags="C_CONTIGUOUS")
+
+
+def _load(path=None):
+    lib = ctypes.CDLL(path or os.path.join(os.path.dirname(os.path.abspath(__file__)), "libcir_dsp.so"))
+    for name in ("cir_magnitude", "cir_phase", "cir_pdp_accumulate"):
+        getattr(lib, name).restype = None
+        getattr(lib, name).argtypes = [_i16p, _f32p, ctypes.c_size_t]
+    lib.cir_rms_delay_spread.restype = ctypes.c_float
+    lib.cir_rms_delay_spread.argtypes = [_f32p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_float)]
+    lib.cir_first_path.restype = ctypes.c_float
+    lib.cir_first_path.argtypes = [_i16p, ctypes.c_size_t, ctypes.POINTER(FirstPathConfig)]
+    lib.cir_dsp_isa.restype = ctypes.c_char_p
+    lib.cir_dsp_isa.argtypes = []
+    lib.cir_dsp_select.restype = ctypes.c_int
+    lib.cir_dsp_select.argtypes = [ctypes.c_char_p]
+    return lib
+
+
+_lib = _load()
+
+
+def _taps(taps):
+    taps = np.ascontiguousarray(taps, dtype=np.int16)
+    if taps.ndim < 2 or taps.shape[-1] != 2:
+        raise ValueError("taps must be (..., taps, 2) int16")
+    return taps
+
+
+def _per_tap(fn, taps):
+    taps = _taps(taps)
+    out = np.empty(taps.shape[:-1], dtype=np.float32)
+    fn(taps, out, out.size)     # frames are contiguous, one call covers them all
+    return out
+
+
+def isa():
+    """Instruction set of the kernels in use."""
+    return _lib.cir_dsp_isa().decode()
+
+
+def select(name):
+    """Use the kernels of another instruction set ("scalar", "sse2", "avx2", "neon")."""
+    if _lib.cir_dsp_select(name.encode()) != 0:
+        raise ValueError("%s kernels not available" % name)
+
+
+def magnitude(taps):
+    return _per_tap(_lib.cir_magnitude, taps)
+
+
+def phase(taps):
+    return _per_tap(_lib.cir_phase, taps)
+
+
+def pdp(taps):
+    """Power-delay profile summed over all frames, float32 of shape (taps,)."""
+    taps = _taps(taps)
+    n = taps.shape[-2]
+    out = np.zeros(n, dtype=np.float32)
+    for frame in taps.reshape(-1, n, 2):
+        _lib.cir_pdp_accumulate(frame, out, n)
+    return out
+
+
+def rms_delay_spread(power, mean_delay=False):
+    """RMS delay spread of one power-delay profile, in taps. With mean_delay, (spread, mean delay)."""
+    power = np.ascontiguousarray(power, dtype=np.float32)
+    mean = ctypes.c_float()
+    spread = _lib.cir_rms_delay_spread(power, power.size, ctypes.byref(mean))
+    return (spread, mean.value) if mean_delay else spread
+
+
+def first_path(taps, config=None):
+    """Leading edge of every frame in fractional taps, -1 where none is found."""
+    taps = _taps(taps)
+    n = taps.shape[-2]
+    frames = taps.reshape(-1, n, 2)
+    cfg = ctypes.byref(config or DEFAULT_FP_CONFIG)
+    out = np.array([_lib.cir_first_path(frame, n, cfg) for frame in frames], dtype=np.float32)
+    return out.reshape(taps.shape[:-2])
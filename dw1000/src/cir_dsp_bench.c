@@ -0,0 +1,313 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_dsp_bench.c
+ *  @brief   CIR kernel benchmark
+ *
+ *           Runs every kernel of cir_dsp.h on synthetic CIRs with each instruction set the build and the CPU support, and
+ *           reports the throughput in taps per second and the largest deviation from the scalar kernels. Build with
+ *           "make cir_dsp_bench", it needs neither the DW1000 nor the emulator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "cir_dsp.h"
+
+#define DEFAULT_FRAMES  2000
+#define TAPS            CIR_DSP_TAPS_MAX
+#define FIRST_PATH      (745.0)     /* as the emulator, see DW1000_EMU_FIRST_PATH */
+#define AMPLITUDE       (4000.0)
+#define NOISE           (60.0)
+#define MIN_SECONDS     (0.2)       /* shortest timed run of a kernel */
+
+static const char *const isas[] = { "scalar", "sse2", "avx2", "neon" };
+
+typedef struct {
+    float mag;          /* relative */
+    float phase;        /* rad */
+    float pdp;          /* relative */
+    float rms;          /* taps */
+    float fp;           /* taps */
+} deviation_t;
+
+static uint64_t rng_state = 1;
+
+static double rng_uniform(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (double) ((rng_state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+static double rng_gauss(void)
+{
+    double u = rng_uniform();
+
+    return sqrt(-2.0 * log(u > 0.0 ? u : 1e-300)) * cos(2.0 * M_PI * rng_uniform());
+}
+
+/* Band limited pulse, about 2 taps wide */
+static double pulse(double t)
+{
+    return fabs(t) < 4.0 ? exp(-t * t / 0.8) : 0.0;
+}
+
+/* Noise, a direct path at a fractional tap and three weaker reflections, like the emulator's CIRs. The last frames hold
+ * the extremes of the accumulator range. */
+static void make_cir(int16_t *iq, double *path, size_t frame, size_t frames)
+{
+    double re[TAPS], im[TAPS];
+    double amp = AMPLITUDE * (0.5 + rng_uniform());
+    double at = FIRST_PATH + 8.0 * (rng_uniform() - 0.5);
+    int p, i;
+
+    if (frame + 2 >= frames)
+    {
+        for (i = 0; i < TAPS; i++)
+        {
+            iq[2 * i] = (frame + 2 == frames) ? -32768 : (int16_t) ((i % 3 - 1) * 32767);
+            iq[2 * i + 1] = (frame + 2 == frames) ? -32768 : (int16_t) ((i % 5 - 2) * 16384);
+        }
+        *path = -1.0;
+        return;
+    }
+
+    *path = at;
+    for (i = 0; i < TAPS; i++)
+    {
+        re[i] = NOISE * rng_gauss();
+        im[i] = NOISE * rng_gauss();
+    }
+    for (p = 0; p < 4; p++)
+    {
+        double phase = 2.0 * M_PI * rng_uniform();
+
+        for (i = (int) at - 4; i <= (int) at + 5 && i < TAPS; i++)
+        {
+            re[i] += amp * pulse(i - at) * cos(phase);
+            im[i] += amp * pulse(i - at) * sin(phase);
+        }
+        at += 4.0 + 36.0 * rng_uniform();
+        amp *= 0.3 + 0.3 * rng_uniform();
+    }
+    for (i = 0; i < TAPS; i++)
+    {
+        iq[2 * i] = (int16_t) fmax(-32768.0, fmin(32767.0, round(re[i])));
+        iq[2 * i + 1] = (int16_t) fmax(-32768.0, fmin(32767.0, round(im[i])));
+    }
+}
+
+static double elapsed_s(const struct timespec *a, const struct timespec *b)
+{
+    return (double) (b->tv_sec - a->tv_sec) + (double) (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+static volatile float sink;
+
+/* Taps per second of one kernel over all frames, repeated for at least MIN_SECONDS */
+static double bench_kernel(int kernel, const int16_t *cirs, size_t frames, float *out)
+{
+    static const cir_fp_config_t fp_cfg = CIR_FP_CONFIG_DEFAULT;
+    struct timespec t0, t1;
+    unsigned long reps = 0;
+    double s;
+    size_t f;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do
+    {
+        for (f = 0; f < frames; f++)
+        {
+            const int16_t *iq = &cirs[f * 2 * TAPS];
+
+            switch (kernel)
+            {
+            case 0:
+                cir_magnitude(iq, out, TAPS);
+                break;
+            case 1:
+                cir_phase(iq, out, TAPS);
+                break;
+            case 2:
+                cir_pdp_accumulate(iq, out, TAPS);
+                break;
+            case 3:
+                sink = cir_rms_delay_spread(out, TAPS, NULL);
+                break;
+            default:
+                sink = cir_first_path(iq, TAPS, &fp_cfg);
+                break;
+            }
+        }
+        reps++;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        s = elapsed_s(&t0, &t1);
+    } while (s < MIN_SECONDS);
+    return (double) reps * frames * TAPS / s;
+}
+
+/* Largest deviation of the current kernels from the scalar results */
+static void compare(const int16_t *cirs, size_t frames, const float *ref, deviation_t *dev)
+{
+    float out[TAPS];
+    float pdp[TAPS];
+    size_t f, k;
+
+    memset(dev, 0, sizeof(*dev));
+    for (f = 0; f < frames; f++)
+    {
+        const int16_t *iq = &cirs[f * 2 * TAPS];
+        const float *r = &ref[f * (3 * TAPS + 2)];
+        float v;
+
+        cir_magnitude(iq, out, TAPS);
+        for (k = 0; k < TAPS; k++)
+        {
+            v = fabsf(out[k] - r[k]) / (r[k] > 1.0f ? r[k] : 1.0f);
+            dev->mag = v > dev->mag ? v : dev->mag;
+        }
+        cir_phase(iq, out, TAPS);
+        for (k = 0; k < TAPS; k++)
+        {
+            /* -pi and pi are the same phase */
+            v = fabsf(out[k] - r[TAPS + k]);
+            v = v > (float) M_PI ? 2.0f * (float) M_PI - v : v;
+            dev->phase = v > dev->phase ? v : dev->phase;
+        }
+        memset(pdp, 0, sizeof(pdp));
+        cir_pdp_accumulate(iq, pdp, TAPS);
+        for (k = 0; k < TAPS; k++)
+        {
+            v = fabsf(pdp[k] - r[2 * TAPS + k]) / (r[2 * TAPS + k] > 1.0f ? r[2 * TAPS + k] : 1.0f);
+            dev->pdp = v > dev->pdp ? v : dev->pdp;
+        }
+        v = fabsf(cir_rms_delay_spread(pdp, TAPS, NULL) - r[3 * TAPS]);
+        dev->rms = v > dev->rms ? v : dev->rms;
+        v = fabsf(cir_first_path(iq, TAPS, NULL) - r[3 * TAPS + 1]);
+        dev->fp = v > dev->fp ? v : dev->fp;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const kernels[] = { "magnitude", "phase", "pdp", "rms spread", "first path" };
+    size_t frames = DEFAULT_FRAMES;
+    int16_t *cirs;
+    double *paths;
+    float *ref;
+    float out[TAPS];
+    double fp_sum = 0.0, fp_sum2 = 0.0, atan_err = 0.0;
+    size_t fp_count = 0;
+    size_t f, k;
+    unsigned int i, j;
+
+    if (argc > 1)
+    {
+        frames = strtoul(argv[1], NULL, 10);
+    }
+    if (frames < 3)
+    {
+        printf("Usage: cir_dsp_bench [frames]\n");
+        return 1;
+    }
+
+    cirs = (int16_t *) malloc(frames * 2 * TAPS * sizeof(int16_t));
+    paths = (double *) malloc(frames * sizeof(double));
+    ref = (float *) malloc(frames * (3 * TAPS + 2) * sizeof(float));
+    if (cirs == NULL || paths == NULL || ref == NULL)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+    for (f = 0; f < frames; f++)
+    {
+        make_cir(&cirs[f * 2 * TAPS], &paths[f], f, frames);
+    }
+
+    /* Scalar reference, and the accuracy of the scalar kernels themselves */
+    printf("Kernels: %s, %lu frames of %d taps\n", cir_dsp_isa(), (unsigned long) frames, TAPS);
+    cir_dsp_select("scalar");
+    for (f = 0; f < frames; f++)
+    {
+        const int16_t *iq = &cirs[f * 2 * TAPS];
+        float *r = &ref[f * (3 * TAPS + 2)];
+
+        cir_magnitude(iq, r, TAPS);
+        cir_phase(iq, &r[TAPS], TAPS);
+        memset(&r[2 * TAPS], 0, TAPS * sizeof(float));
+        cir_pdp_accumulate(iq, &r[2 * TAPS], TAPS);
+        r[3 * TAPS] = cir_rms_delay_spread(&r[2 * TAPS], TAPS, NULL);
+        r[3 * TAPS + 1] = cir_first_path(iq, TAPS, NULL);
+        for (k = 0; k < TAPS; k++)
+        {
+            double e = fabs(r[TAPS + k] - atan2((double) iq[2 * k + 1], (double) iq[2 * k]));
+
+            e = e > M_PI ? 2.0 * M_PI - e : e;
+            atan_err = e > atan_err ? e : atan_err;
+        }
+        if (paths[f] >= 0.0 && r[3 * TAPS + 1] >= 0.0)
+        {
+            fp_sum += r[3 * TAPS + 1] - paths[f];
+            fp_sum2 += (r[3 * TAPS + 1] - paths[f]) * (r[3 * TAPS + 1] - paths[f]);
+            fp_count++;
+        }
+    }
+    printf("Phase error against atan2: %.2e rad\n", atan_err);
+    if (fp_count > 0)
+    {
+        double mean = fp_sum / fp_count;
+
+        printf("First path found in %lu of %lu CIRs, %.3f taps from the direct path (std %.3f)\n",
+            (unsigned long) fp_count, (unsigned long) frames - 2, mean, sqrt(fp_sum2 / fp_count - mean * mean));
+    }
+
+    printf("\n%-8s", "Mtaps/s");
+    for (j = 0; j < sizeof(kernels) / sizeof(kernels[0]); j++)
+    {
+        printf("%12s", kernels[j]);
+    }
+    printf("\n");
+    for (i = 0; i < sizeof(isas) / sizeof(isas[0]); i++)
+    {
+        if (cir_dsp_select(isas[i]) != 0)
+        {
+            continue;
+        }
+        printf("%-8s", isas[i]);
+        memset(out, 0, sizeof(out));
+        for (j = 0; j < sizeof(kernels) / sizeof(kernels[0]); j++)
+        {
+            printf("%12.1f", bench_kernel(j, cirs, frames, out) / 1e6);
+            fflush(stdout);
+            if (j == 2)
+            {
+                /* A profile of one CIR for the delay spread */
+                memset(out, 0, sizeof(out));
+                cir_pdp_accumulate(cirs, out, TAPS);
+            }
+        }
+        printf("\n");
+    }
+
+    printf("\nLargest deviation from scalar: magnitude and pdp relative, phase in rad, rms spread and first path in taps\n");
+    printf("%-8s%12s%12s%12s%12s%12s\n", "", "magnitude", "phase", "pdp", "rms spread", "first path");
+    for (i = 1; i < sizeof(isas) / sizeof(isas[0]); i++)
+    {
+        deviation_t dev;
+
+        if (cir_dsp_select(isas[i]) != 0)
+        {
+            continue;
+        }
+        compare(cirs, frames, ref, &dev);
+        printf("%-8s%12.2e%12.2e%12.2e%12.2e%12.2e\n", isas[i], dev.mag, dev.phase, dev.pdp, dev.rms, dev.fp);
+    }
+
+    free(cirs);
+    free(paths);
+    free(ref);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_dsp_neon.c
+ *  @brief   NEON CIR kernels, see cir_dsp_ops.h
+ *
+ *           Built on ARMv7 (Raspberry Pi 2 and later running a 32-bit system, with -march=armv7-a -mfpu=neon for this
+ *           file only) and AArch64. A 32-bit build also runs on an ARMv6 Pi Zero or Pi 1, which have no NEON: nothing
+ *           of this file is called unless cir_dsp.c, built for the baseline, finds NEON in the hardware capabilities.
+ *
+ *           vld2q_s16 loads 8 taps de-interleaved into real and imaginary parts. ARMv7 NEON has neither a vector square
+ *           root nor a divide, they are taken from the reciprocal estimates refined by two Newton-Raphson steps (about
+ *           1 ulp), AArch64 has both.
+ */
+
+#include <arm_neon.h>
+
+#include "cir_dsp_ops.h"
+
+static inline float32x4_t sqrtNeon(float32x4_t x)
+{
+#ifdef __aarch64__
+    return vsqrtq_f32(x);
+#else
+    float32x4_t e = vrsqrteq_f32(x);
+
+    e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+    e = vmulq_f32(e, vrsqrtsq_f32(vmulq_f32(x, e), e));
+    /* x * 1/sqrt(x) is NaN for x = 0 */
+    return vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(x, vdupq_n_f32(0.0f)), vreinterpretq_u32_f32(vmulq_f32(x, e))));
+#endif
+}
+
+/* a / b, b > 0 or a = b = 0 (0) */
+static inline float32x4_t divNeon(float32x4_t a, float32x4_t b)
+{
+#ifdef __aarch64__
+    return vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(b, vdupq_n_f32(0.0f)), vreinterpretq_u32_f32(vdivq_f32(a, b))));
+#else
+    float32x4_t r = vrecpeq_f32(b);
+
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    r = vmulq_f32(r, vrecpsq_f32(b, r));
+    return vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(b, vdupq_n_f32(0.0f)), vreinterpretq_u32_f32(vmulq_f32(a, r))));
+#endif
+}
+
+static inline float hsumNeon(float32x4_t v)
+{
+    float32x2_t h = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+
+    return vget_lane_f32(vpadd_f32(h, h), 0);
+}
+
+/* re^2 + im^2 of 4 taps, unsigned since it reaches 2^31 */
+static inline float32x4_t powerNeon(int16x4_t re, int16x4_t im)
+{
+    uint32x4_t p = vaddq_u32(vreinterpretq_u32_s32(vmull_s16(re, re)), vreinterpretq_u32_s32(vmull_s16(im, im)));
+
+    return vcvtq_f32_u32(p);
+}
+
+static void neonMagnitude(const int16_t *iq, float *mag, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        int16x8x2_t v = vld2q_s16(&iq[2 * k]);
+
+        vst1q_f32(&mag[k], sqrtNeon(powerNeon(vget_low_s16(v.val[0]), vget_low_s16(v.val[1]))));
+        vst1q_f32(&mag[k + 4], sqrtNeon(powerNeon(vget_high_s16(v.val[0]), vget_high_s16(v.val[1]))));
+    }
+    cir_dsp_scalar.magnitude(&iq[2 * k], &mag[k], n - k);
+}
+
+static inline float32x4_t phaseNeon(int16x4_t re, int16x4_t im)
+{
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    float32x4_t x = vcvtq_f32_s32(vmovl_s16(re));
+    float32x4_t y = vcvtq_f32_s32(vmovl_s16(im));
+    float32x4_t ax = vabsq_f32(x);
+    float32x4_t ay = vabsq_f32(y);
+    float32x4_t a = divNeon(vminq_f32(ax, ay), vmaxq_f32(ax, ay));
+    float32x4_t s = vmulq_f32(a, a);
+    float32x4_t r = vdupq_n_f32(CIR_ATAN_C5);
+
+    r = vmlaq_f32(vdupq_n_f32(CIR_ATAN_C4), r, s);
+    r = vmlaq_f32(vdupq_n_f32(CIR_ATAN_C3), r, s);
+    r = vmlaq_f32(vdupq_n_f32(CIR_ATAN_C2), r, s);
+    r = vmlaq_f32(vdupq_n_f32(CIR_ATAN_C1), r, s);
+    r = vmlaq_f32(vdupq_n_f32(CIR_ATAN_C0), r, s);
+    r = vmulq_f32(r, a);
+
+    r = vbslq_f32(vcgtq_f32(ay, ax), vsubq_f32(vdupq_n_f32(CIR_PI_2), r), r);
+    r = vbslq_f32(vcltq_f32(x, zero), vsubq_f32(vdupq_n_f32(CIR_PI), r), r);
+    return vbslq_f32(vcltq_f32(y, zero), vnegq_f32(r), r);
+}
+
+static void neonPhase(const int16_t *iq, float *phase, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        int16x8x2_t v = vld2q_s16(&iq[2 * k]);
+
+        vst1q_f32(&phase[k], phaseNeon(vget_low_s16(v.val[0]), vget_low_s16(v.val[1])));
+        vst1q_f32(&phase[k + 4], phaseNeon(vget_high_s16(v.val[0]), vget_high_s16(v.val[1])));
+    }
+    cir_dsp_scalar.phase(&iq[2 * k], &phase[k], n - k);
+}
+
+static void neonPdpAccumulate(const int16_t *iq, float *pdp, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        int16x8x2_t v = vld2q_s16(&iq[2 * k]);
+
+        vst1q_f32(&pdp[k], vaddq_f32(vld1q_f32(&pdp[k]), powerNeon(vget_low_s16(v.val[0]), vget_low_s16(v.val[1]))));
+        vst1q_f32(&pdp[k + 4], vaddq_f32(vld1q_f32(&pdp[k + 4]),
+            powerNeon(vget_high_s16(v.val[0]), vget_high_s16(v.val[1]))));
+    }
+    cir_dsp_scalar.pdp_accumulate(&iq[2 * k], &pdp[k], n - k);
+}
+
+static void neonMoments(const float *p, size_t n, float origin, float sum[3])
+{
+    static const float ramp[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+    float32x4_t d = vsubq_f32(vld1q_f32(ramp), vdupq_n_f32(origin));
+    float32x4_t s0 = vdupq_n_f32(0.0f), s1 = s0, s2 = s0;
+    float tail[3];
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        float32x4_t v = vld1q_f32(&p[k]);
+        float32x4_t dv = vmulq_f32(d, v);
+
+        s0 = vaddq_f32(s0, v);
+        s1 = vaddq_f32(s1, dv);
+        s2 = vmlaq_f32(s2, d, dv);
+        d = vaddq_f32(d, vdupq_n_f32(4.0f));
+    }
+    cir_dsp_scalar.moments(&p[k], n - k, origin - (float) k, tail);
+    sum[0] = hsumNeon(s0) + tail[0];
+    sum[1] = hsumNeon(s1) + tail[1];
+    sum[2] = hsumNeon(s2) + tail[2];
+}
+
+static void neonSums(const float *x, size_t n, float sum[2])
+{
+    float32x4_t s = vdupq_n_f32(0.0f), s2 = s;
+    float tail[2];
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        float32x4_t v = vld1q_f32(&x[k]);
+
+        s = vaddq_f32(s, v);
+        s2 = vmlaq_f32(s2, v, v);
+    }
+    cir_dsp_scalar.sums(&x[k], n - k, tail);
+    sum[0] = hsumNeon(s) + tail[0];
+    sum[1] = hsumNeon(s2) + tail[1];
+}
+
+static void neonDot2(const float *re, const float *im, const float *c, size_t n, float out[2])
+{
+    float32x4_t r = vdupq_n_f32(0.0f), i = r;
+    float tail[2];
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        float32x4_t cv = vld1q_f32(&c[k]);
+
+        r = vmlaq_f32(r, vld1q_f32(&re[k]), cv);
+        i = vmlaq_f32(i, vld1q_f32(&im[k]), cv);
+    }
+    cir_dsp_scalar.dot2(&re[k], &im[k], &c[k], n - k, tail);
+    out[0] = hsumNeon(r) + tail[0];
+    out[1] = hsumNeon(i) + tail[1];
+}
+
+const cir_dsp_ops_t cir_dsp_neon =
+{
+    "neon", neonMagnitude, neonPhase, neonPdpAccumulate, neonMoments, neonSums, neonDot2
+};
@@ -0,0 +1,55 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_dsp_ops.h
+ *  @brief   Per instruction set kernel tables behind cir_dsp.h
+ *
+ *           cir_dsp.c holds the scalar table and picks the table cir_dsp.h calls through. Each SIMD source file
+ *           (cir_dsp_x86.c, cir_dsp_neon.c) defines its tables and is only built on its architecture, see the Makefile.
+ */
+
+#ifndef _CIR_DSP_OPS_H_
+#define _CIR_DSP_OPS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* atan(a) for a in [0, 1]: a * (C0 + C1 a^2 + ... + C5 a^10), max error 1e-5 rad. Every table uses the same one. */
+#define CIR_ATAN_C0     (0.99997726f)
+#define CIR_ATAN_C1     (-0.33262347f)
+#define CIR_ATAN_C2     (0.19354346f)
+#define CIR_ATAN_C3     (-0.11643287f)
+#define CIR_ATAN_C4     (0.05265332f)
+#define CIR_ATAN_C5     (-0.01172120f)
+
+#define CIR_PI          (3.14159265f)
+#define CIR_PI_2        (1.57079633f)
+
+typedef struct
+{
+    const char *name;
+    /* mag[k] = |h[k]| */
+    void (*magnitude)(const int16_t *iq, float *mag, size_t n);
+    /* phase[k] = arg h[k] */
+    void (*phase)(const int16_t *iq, float *phase, size_t n);
+    /* pdp[k] += |h[k]|^2 */
+    void (*pdp_accumulate)(const int16_t *iq, float *pdp, size_t n);
+    /* sum[0] = sum p[k], sum[1] = sum (k - origin) p[k], sum[2] = sum (k - origin)^2 p[k] */
+    void (*moments)(const float *p, size_t n, float origin, float sum[3]);
+    /* sum[0] = sum x[k], sum[1] = sum x[k]^2 */
+    void (*sums)(const float *x, size_t n, float sum[2]);
+    /* out[0] = sum re[k] c[k], out[1] = sum im[k] c[k] */
+    void (*dot2)(const float *re, const float *im, const float *c, size_t n, float out[2]);
+} cir_dsp_ops_t;
+
+extern const cir_dsp_ops_t cir_dsp_scalar;
+
+#ifdef CIR_DSP_X86
+extern const cir_dsp_ops_t cir_dsp_sse2;
+extern const cir_dsp_ops_t cir_dsp_avx2;
+int cir_dsp_x86_has_avx2(void);
+#endif
+
+#ifdef CIR_DSP_NEON
+extern const cir_dsp_ops_t cir_dsp_neon;
+#endif
+
+#endif /* _CIR_DSP_OPS_H_ */
@@ -0,0 +1,324 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_dsp_x86.c
+ *  @brief   SSE2 and AVX2 CIR kernels, see cir_dsp_ops.h
+ *
+ *           Built on x86 only. The file is compiled without -m options, every function is compiled for its instruction
+ *           set with a target attribute, so one binary runs the AVX2 kernels where the CPU has them and the SSE2 ones
+ *           elsewhere.
+ *
+ *           A tap is one 32-bit lane: _mm_madd_epi16 of the interleaved taps with themselves is re^2 + im^2, and the
+ *           real and imaginary parts are the low and high halves of the lane.
+ */
+
+#include <immintrin.h>
+
+#include "cir_dsp_ops.h"
+
+#define SSE2    __attribute__((target("sse2")))
+#define AVX2    __attribute__((target("avx2,fma")))
+
+int cir_dsp_x86_has_avx2(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+/* ------------------------------------------------------------------------------------------------------------------
+ * SSE2, 4 taps per vector
+ */
+
+/* re^2 + im^2 as float. The sum only exceeds INT32_MAX for (-32768, -32768), where it wraps to -2^31. */
+static inline SSE2 __m128 powerSse2(__m128i v)
+{
+    __m128 p = _mm_cvtepi32_ps(_mm_madd_epi16(v, v));
+
+    return _mm_add_ps(p, _mm_and_ps(_mm_cmplt_ps(p, _mm_setzero_ps()), _mm_set1_ps(4294967296.0f)));
+}
+
+static SSE2 void sse2Magnitude(const int16_t *iq, float *mag, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        _mm_storeu_ps(&mag[k], _mm_sqrt_ps(powerSse2(_mm_loadu_si128((const __m128i *) &iq[2 * k]))));
+    }
+    cir_dsp_scalar.magnitude(&iq[2 * k], &mag[k], n - k);
+}
+
+static inline SSE2 __m128 atanSse2(__m128 a)
+{
+    __m128 s = _mm_mul_ps(a, a);
+    __m128 r = _mm_set1_ps(CIR_ATAN_C5);
+
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(CIR_ATAN_C4));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(CIR_ATAN_C3));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(CIR_ATAN_C2));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(CIR_ATAN_C1));
+    r = _mm_add_ps(_mm_mul_ps(r, s), _mm_set1_ps(CIR_ATAN_C0));
+    return _mm_mul_ps(r, a);
+}
+
+static inline SSE2 __m128 selectSse2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static SSE2 void sse2Phase(const int16_t *iq, float *phase, size_t n)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) &iq[2 * k]);
+        __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+        __m128 y = _mm_cvtepi32_ps(_mm_srai_epi32(v, 16));
+        __m128 ax = _mm_andnot_ps(sign, x);
+        __m128 ay = _mm_andnot_ps(sign, y);
+        __m128 mx = _mm_max_ps(ax, ay);
+        __m128 mn = _mm_min_ps(ax, ay);
+        /* 0 / 0 is NaN, a tap of zero has phase 0 */
+        __m128 a = _mm_and_ps(_mm_cmpgt_ps(mx, zero), _mm_div_ps(mn, mx));
+        __m128 r = atanSse2(a);
+
+        r = selectSse2(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(CIR_PI_2), r), r);
+        r = selectSse2(_mm_cmplt_ps(x, zero), _mm_sub_ps(_mm_set1_ps(CIR_PI), r), r);
+        r = _mm_or_ps(r, _mm_and_ps(_mm_cmplt_ps(y, zero), sign));
+        _mm_storeu_ps(&phase[k], r);
+    }
+    cir_dsp_scalar.phase(&iq[2 * k], &phase[k], n - k);
+}
+
+static SSE2 void sse2PdpAccumulate(const int16_t *iq, float *pdp, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        __m128 p = powerSse2(_mm_loadu_si128((const __m128i *) &iq[2 * k]));
+
+        _mm_storeu_ps(&pdp[k], _mm_add_ps(_mm_loadu_ps(&pdp[k]), p));
+    }
+    cir_dsp_scalar.pdp_accumulate(&iq[2 * k], &pdp[k], n - k);
+}
+
+static inline SSE2 float hsumSse2(__m128 v)
+{
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static SSE2 void sse2Moments(const float *p, size_t n, float origin, float sum[3])
+{
+    __m128 d = _mm_sub_ps(_mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f), _mm_set1_ps(origin));
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+    float tail[3];
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        __m128 v = _mm_loadu_ps(&p[k]);
+        __m128 dv = _mm_mul_ps(d, v);
+
+        s0 = _mm_add_ps(s0, v);
+        s1 = _mm_add_ps(s1, dv);
+        s2 = _mm_add_ps(s2, _mm_mul_ps(d, dv));
+        d = _mm_add_ps(d, _mm_set1_ps(4.0f));
+    }
+    cir_dsp_scalar.moments(&p[k], n - k, origin - (float) k, tail);
+    sum[0] = hsumSse2(s0) + tail[0];
+    sum[1] = hsumSse2(s1) + tail[1];
+    sum[2] = hsumSse2(s2) + tail[2];
+}
+
+static SSE2 void sse2Sums(const float *x, size_t n, float sum[2])
+{
+    __m128 s = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+    float tail[2];
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        __m128 v = _mm_loadu_ps(&x[k]);
+
+        s = _mm_add_ps(s, v);
+        s2 = _mm_add_ps(s2, _mm_mul_ps(v, v));
+    }
+    cir_dsp_scalar.sums(&x[k], n - k, tail);
+    sum[0] = hsumSse2(s) + tail[0];
+    sum[1] = hsumSse2(s2) + tail[1];
+}
+
+static SSE2 void sse2Dot2(const float *re, const float *im, const float *c, size_t n, float out[2])
+{
+    __m128 r = _mm_setzero_ps(), i = _mm_setzero_ps();
+    float tail[2];
+    size_t k;
+
+    for (k = 0; k + 4 <= n; k += 4)
+    {
+        __m128 cv = _mm_loadu_ps(&c[k]);
+
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(&re[k]), cv));
+        i = _mm_add_ps(i, _mm_mul_ps(_mm_loadu_ps(&im[k]), cv));
+    }
+    cir_dsp_scalar.dot2(&re[k], &im[k], &c[k], n - k, tail);
+    out[0] = hsumSse2(r) + tail[0];
+    out[1] = hsumSse2(i) + tail[1];
+}
+
+const cir_dsp_ops_t cir_dsp_sse2 =
+{
+    "sse2", sse2Magnitude, sse2Phase, sse2PdpAccumulate, sse2Moments, sse2Sums, sse2Dot2
+};
+
+/* ------------------------------------------------------------------------------------------------------------------
+ * AVX2, 8 taps per vector
+ */
+
+static inline AVX2 __m256 powerAvx2(__m256i v)
+{
+    __m256 p = _mm256_cvtepi32_ps(_mm256_madd_epi16(v, v));
+
+    return _mm256_add_ps(p, _mm256_and_ps(_mm256_cmp_ps(p, _mm256_setzero_ps(), _CMP_LT_OQ),
+        _mm256_set1_ps(4294967296.0f)));
+}
+
+static AVX2 void avx2Magnitude(const int16_t *iq, float *mag, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        _mm256_storeu_ps(&mag[k], _mm256_sqrt_ps(powerAvx2(_mm256_loadu_si256((const __m256i *) &iq[2 * k]))));
+    }
+    sse2Magnitude(&iq[2 * k], &mag[k], n - k);
+}
+
+static inline AVX2 __m256 atanAvx2(__m256 a)
+{
+    __m256 s = _mm256_mul_ps(a, a);
+    __m256 r = _mm256_set1_ps(CIR_ATAN_C5);
+
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(CIR_ATAN_C4));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(CIR_ATAN_C3));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(CIR_ATAN_C2));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(CIR_ATAN_C1));
+    r = _mm256_fmadd_ps(r, s, _mm256_set1_ps(CIR_ATAN_C0));
+    return _mm256_mul_ps(r, a);
+}
+
+static AVX2 void avx2Phase(const int16_t *iq, float *phase, size_t n)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) &iq[2 * k]);
+        __m256 x = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16));
+        __m256 y = _mm256_cvtepi32_ps(_mm256_srai_epi32(v, 16));
+        __m256 ax = _mm256_andnot_ps(sign, x);
+        __m256 ay = _mm256_andnot_ps(sign, y);
+        __m256 mx = _mm256_max_ps(ax, ay);
+        __m256 mn = _mm256_min_ps(ax, ay);
+        __m256 a = _mm256_and_ps(_mm256_cmp_ps(mx, zero, _CMP_GT_OQ), _mm256_div_ps(mn, mx));
+        __m256 r = atanAvx2(a);
+
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(CIR_PI_2), r), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+        r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(CIR_PI), r), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+        r = _mm256_or_ps(r, _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_LT_OQ), sign));
+        _mm256_storeu_ps(&phase[k], r);
+    }
+    sse2Phase(&iq[2 * k], &phase[k], n - k);
+}
+
+static AVX2 void avx2PdpAccumulate(const int16_t *iq, float *pdp, size_t n)
+{
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        __m256 p = powerAvx2(_mm256_loadu_si256((const __m256i *) &iq[2 * k]));
+
+        _mm256_storeu_ps(&pdp[k], _mm256_add_ps(_mm256_loadu_ps(&pdp[k]), p));
+    }
+    sse2PdpAccumulate(&iq[2 * k], &pdp[k], n - k);
+}
+
+static inline AVX2 float hsumAvx2(__m256 v)
+{
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+
+    h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_add_ss(h, _mm_shuffle_ps(h, h, 1));
+    return _mm_cvtss_f32(h);
+}
+
+static AVX2 void avx2Moments(const float *p, size_t n, float origin, float sum[3])
+{
+    __m256 d = _mm256_sub_ps(_mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f), _mm256_set1_ps(origin));
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps();
+    float tail[3];
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        __m256 v = _mm256_loadu_ps(&p[k]);
+        __m256 dv = _mm256_mul_ps(d, v);
+
+        s0 = _mm256_add_ps(s0, v);
+        s1 = _mm256_add_ps(s1, dv);
+        s2 = _mm256_fmadd_ps(d, dv, s2);
+        d = _mm256_add_ps(d, _mm256_set1_ps(8.0f));
+    }
+    sse2Moments(&p[k], n - k, origin - (float) k, tail);
+    sum[0] = hsumAvx2(s0) + tail[0];
+    sum[1] = hsumAvx2(s1) + tail[1];
+    sum[2] = hsumAvx2(s2) + tail[2];
+}
+
+static AVX2 void avx2Sums(const float *x, size_t n, float sum[2])
+{
+    __m256 s = _mm256_setzero_ps(), s2 = _mm256_setzero_ps();
+    float tail[2];
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        __m256 v = _mm256_loadu_ps(&x[k]);
+
+        s = _mm256_add_ps(s, v);
+        s2 = _mm256_fmadd_ps(v, v, s2);
+    }
+    sse2Sums(&x[k], n - k, tail);
+    sum[0] = hsumAvx2(s) + tail[0];
+    sum[1] = hsumAvx2(s2) + tail[1];
+}
+
+static AVX2 void avx2Dot2(const float *re, const float *im, const float *c, size_t n, float out[2])
+{
+    __m256 r = _mm256_setzero_ps(), i = _mm256_setzero_ps();
+    float tail[2];
+    size_t k;
+
+    for (k = 0; k + 8 <= n; k += 8)
+    {
+        __m256 cv = _mm256_loadu_ps(&c[k]);
+
+        r = _mm256_fmadd_ps(_mm256_loadu_ps(&re[k]), cv, r);
+        i = _mm256_fmadd_ps(_mm256_loadu_ps(&im[k]), cv, i);
+    }
+    sse2Dot2(&re[k], &im[k], &c[k], n - k, tail);
+    out[0] = hsumAvx2(r) + tail[0];
+    out[1] = hsumAvx2(i) + tail[1];
+}
+
+const cir_dsp_ops_t cir_dsp_avx2 =
+{
+    "avx2", avx2Magnitude, avx2Phase, avx2PdpAccumulate, avx2Moments, avx2Sums, avx2Dot2
+};
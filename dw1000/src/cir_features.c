@@ -0,0 +1,170 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_features.c
+ *  @brief   Streaming CIR feature extraction in the receivers, see cir_features.h
+ *
+ *           The per tap work runs on the kernels of cir_dsp.h. Only the leading edge search reads the taps outside the
+ *           feature window, it needs the noise before the first path and is only run on whole accumulator records.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "deca_device_api.h"
+#include "cir_dsp.h"
+#include "cir_features.h"
+
+/* Power estimates of the DW1000 User Manual, 4.7.1 and 4.7.2: 10 log10(x / N^2) - A */
+#define POWER_A_PRF16       (113.77f)
+#define POWER_A_PRF64       (121.74f)
+#define POWER_FLOOR         (1e-20f)    /* power of an empty window or CIR, keeps the logarithms finite */
+
+static float powerDbm(const cir_features_t *f, float x, uint16_t pream_count)
+{
+    float n2 = (float) pream_count * (float) pream_count;
+
+    return 10.0f * log10f((x > POWER_FLOOR ? x : POWER_FLOOR) / (n2 > 1.0f ? n2 : 1.0f))
+        - (f->cfg.prf == DWT_PRF_16M ? POWER_A_PRF16 : POWER_A_PRF64);
+}
+
+static float powerDb(float x)
+{
+    return 10.0f * log10f(x > POWER_FLOOR ? x : POWER_FLOOR);
+}
+
+void cir_features_init(cir_features_t *f, const cir_features_config_t *cfg)
+{
+    int i;
+
+    memset(f, 0, sizeof(*f));
+    f->cfg = *cfg;
+    for (i = 0; i < CIR_FEATURES_LINKS; i++)
+    {
+        cir_background_init(&f->background[i], CIR_FEATURES_WINDOW);
+    }
+}
+
+void cir_features_keep(cir_features_t *f, uint32_t frames)
+{
+    f->keep_pending = frames;
+}
+
+int cir_features_keepnext(cir_features_t *f)
+{
+    int keep = 0;
+
+    if (f->keep_pending > 0)
+    {
+        f->keep_pending--;
+        keep = 1;
+    }
+    else if (f->cfg.every && f->frames % f->cfg.every == 0)
+    {
+        keep = 1;
+    }
+    f->kept += keep;
+    return keep;
+}
+
+void cir_features_extract(cir_features_t *f, const cir_record_t *rec, unsigned link, cir_feature_record_t *out)
+{
+    const int16_t *taps = &rec->taps[0][0];
+    int16_t win[CIR_FEATURES_WINDOW][2];
+    float pdp[CIR_FEATURES_WINDOW];
+    float x[CIR_FEATURES_WINDOW][2];
+    float first_path = rec->first_path / 64.0f;
+    float amp2, noise2, power, peak_power, fp_power, mean, spread;
+    int start, first, last, i;
+    int fp_tap, fp_ref, peak;
+
+    out->flags = rec->flags & (CIR_RECORD_OVERLAP | CIR_RECORD_SYNC);
+    out->seq = rec->seq;
+    out->rx_sec = rec->rx_sec;
+    out->rx_nsec = rec->rx_nsec;
+    out->sync_ns = rec->sync_ns;
+    out->std_noise = rec->std_noise;
+    f->frames++;
+
+    /* The leading edge of the taps, when the noise before it was read too */
+    if (!(rec->flags & CIR_RECORD_WINDOW))
+    {
+        float edge = cir_first_path(taps, rec->tap_count, NULL);
+
+        if (edge >= 0.0f)
+        {
+            first_path = rec->tap_first + edge;
+            out->flags |= CIR_FEATURE_EDGE;
+        }
+    }
+    out->first_path = first_path;
+
+    amp2 = (float) rec->first_path_amp1 * rec->first_path_amp1 + (float) rec->first_path_amp2 * rec->first_path_amp2
+        + (float) rec->first_path_amp3 * rec->first_path_amp3;
+    out->fp_power = powerDbm(f, amp2, rec->rx_pream_count);
+    out->rx_power = powerDbm(f, (float) rec->max_growth_cir * 131072.0f, rec->rx_pream_count);
+
+    /* Feature window, taps of the record first to last - 1; window taps the record does not hold are zero. */
+    start = (int) first_path - rec->tap_first - CIR_FEATURES_PRE;
+    first = start < 0 ? 0 : start;
+    last = start + CIR_FEATURES_WINDOW > rec->tap_count ? rec->tap_count : start + CIR_FEATURES_WINDOW;
+    memset(win, 0, sizeof(win));
+    memset(pdp, 0, sizeof(pdp));
+    if (last > first)
+    {
+        memcpy(win[first - start], &taps[2 * first], (size_t) (last - first) * sizeof(win[0]));
+    }
+    cir_pdp_accumulate(&win[0][0], pdp, CIR_FEATURES_WINDOW);
+
+    power = 0.0f;
+    peak = 0;
+    for (i = 0; i < CIR_FEATURES_WINDOW; i++)
+    {
+        power += pdp[i];
+        peak = pdp[i] > pdp[peak] ? i : peak;
+    }
+    peak_power = pdp[peak];
+    fp_power = 0.0f;
+    fp_tap = CIR_FEATURES_PRE + (int) (first_path - (int) first_path + 0.5f);
+    fp_ref = fp_tap;
+    for (i = fp_tap - 1; i <= fp_tap + 2; i++)
+    {
+        fp_ref = pdp[i] > fp_power ? i : fp_ref;
+        fp_power = pdp[i] > fp_power ? pdp[i] : fp_power;
+    }
+    out->cir_power = powerDb(power);
+    out->peak_to_fp = powerDb(peak_power) - powerDb(fp_power);
+    out->peak = (uint16_t) (rec->tap_first + start + peak);
+
+    /* Background of the link, the window phase aligned on the strongest first path tap */
+    out->bg_diff = 0.0f;
+    out->bg_score = 0.0f;
+    if (f->cfg.background_frames && link < CIR_FEATURES_LINKS)
+    {
+        cir_background_config_t bcfg;
+        cir_background_score_t score;
+
+        bcfg.alpha = f->cfg.background_alpha;
+        bcfg.gate = f->cfg.background_gate;
+        bcfg.warmup = f->cfg.background_frames;
+        cir_background_align(&win[0][0], CIR_FEATURES_WINDOW, (uint16_t) fp_ref, x);
+        cir_background_update(&f->background[link], &bcfg, (const float (*)[2]) x,
+                              (float) rec->std_noise * rec->std_noise, &score);
+        if (score.valid)
+        {
+            out->bg_diff = score.diff;
+            out->bg_score = score.score;
+            out->flags |= CIR_FEATURE_BACKGROUND;
+        }
+    }
+
+    /* Delay spread of the taps above the noise, about the first path */
+    noise2 = (float) CIR_FEATURES_NOISE_K * CIR_FEATURES_NOISE_K * rec->std_noise * rec->std_noise;
+    power = 0.0f;
+    for (i = 0; i < CIR_FEATURES_WINDOW; i++)
+    {
+        pdp[i] = pdp[i] > noise2 ? pdp[i] : 0.0f;
+        power += pdp[i];
+    }
+    spread = cir_rms_delay_spread(pdp, CIR_FEATURES_WINDOW, &mean);
+    out->rms_delay = spread * CIR_DSP_NS_PER_TAP;
+    out->mean_delay = power > 0.0f ? (float) ((rec->tap_first + start + mean - first_path) * CIR_DSP_NS_PER_TAP) : 0.0f;
+}
@@ -0,0 +1,100 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_features.h
+ *  @brief   Streaming CIR feature extraction in the receivers
+ *
+ *           Reduces the CIR record of every frame to a cir_feature_record_t (80 bytes instead of 4136 for a whole
+ *           accumulator): first path and receive power from the diagnostics, and from the taps around the first path
+ *           their power, the peak to first path ratio, the RMS delay spread and the deviation from the running background
+ *           model of the link of the frame (cir_background.h). The whole record of a frame is only kept one frame in
+ *           every <every>, or on demand, see cir_features_keep().
+ *
+ *           The feature window starts CIR_FEATURES_PRE taps before the first path and is CIR_FEATURES_WINDOW taps long,
+ *           whether the record holds the whole accumulator or a window around the first path. Windowed captures should
+ *           keep at least CIR_FEATURES_SPAN taps after it.
+ */
+
+#ifndef _CIR_FEATURES_H_
+#define _CIR_FEATURES_H_
+
+#include <stdint.h>
+
+#include "cir_record.h"
+#include "cir_background.h"
+
+#define CIR_FEATURES_PRE        (8)     /* taps of the feature window before the first path */
+#define CIR_FEATURES_SPAN       (64)    /* taps of the feature window from the first path, ~19 m of excess path */
+#define CIR_FEATURES_WINDOW     (CIR_FEATURES_PRE + CIR_FEATURES_SPAN)
+#define CIR_FEATURES_NOISE_K    (3)     /* taps under NOISE_K noise standard deviations are left out of the delay spread */
+#define CIR_FEATURES_LINKS      (8)     /* background models, one per sender: a TDMA round of at most 8 slots */
+
+typedef struct
+{
+    uint32_t    every;              /* keep the whole record of one frame in every <every>, 0 for none */
+    uint32_t    background_frames;  /* warmup of the background models, 0 for no background */
+    uint8_t     prf;                /* DWT_PRF_16M or DWT_PRF_64M, for the power estimates */
+    float       background_alpha;   /* EMA weight of a new frame in the background, CIR_BACKGROUND_ALPHA */
+    float       background_gate;    /* score above which a frame is not learnt, CIR_BACKGROUND_GATE, 0 for none */
+} cir_features_config_t;
+
+typedef struct
+{
+    cir_features_config_t cfg;
+    unsigned long   frames;         /* frames reduced */
+    unsigned long   kept;           /* frames whose whole record was to be kept */
+    uint32_t        keep_pending;   /* frames still to keep on demand */
+    cir_background_t background[CIR_FEATURES_LINKS];
+} cir_features_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_features_init()
+ *
+ * @brief Start a feature stream: no frame seen, the background models empty.
+ *
+ * @param  f - feature state
+ * @param  cfg - sampling, background and radio configuration
+ *
+ * @return  none
+ */
+void cir_features_init(cir_features_t *f, const cir_features_config_t *cfg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_features_keep()
+ *
+ * @brief Keep the whole records of the next frames, on top of the sampled ones. Same thread as the other calls.
+ *
+ * @param  f - feature state
+ * @param  frames - number of frames, replaces a request still pending
+ *
+ * @return  none
+ */
+void cir_features_keep(cir_features_t *f, uint32_t frames);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_features_keepnext()
+ *
+ * @brief Whether the whole record of the next frame is to be kept, so that its CIR can be read straight into a slot
+ *        of the CIR writer. Call once per frame, before cir_features_extract().
+ *
+ * @param  f - feature state
+ *
+ * @return  1 to keep it, 0 otherwise
+ */
+int cir_features_keepnext(cir_features_t *f);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_features_extract()
+ *
+ * @brief Reduce a record to its features, scoring it against the background model of its link and learning it.
+ *
+ * @param  f - feature state
+ * @param  rec - record filled by copyCIRToRecord() with the diagnostics (CIR_RECORD_DIAG) and stamped
+ * @param  link - sender of the frame, 0 to CIR_FEATURES_LINKS - 1, always 0 with a single sender. A frame of another
+ *                link is not scored against a background.
+ * @param  out - feature record, its header set by the writer; seq, times and flags are copied from rec. The caller adds
+ *               CIR_FEATURE_FULL if it saves rec.
+ *
+ * @return  none
+ */
+void cir_features_extract(cir_features_t *f, const cir_record_t *rec, unsigned link, cir_feature_record_t *out);
+
+#endif /* _CIR_FEATURES_H_ */
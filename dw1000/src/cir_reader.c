@@ -0,0 +1,342 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_reader.c
+ *  @brief   Memory mapped reader of binary CIR captures, see cir_reader.h
+ *
+ *           The sequence number index is a table of positions indexed by seq - seq_min when the sequence numbers span
+ *           at most a few times the number of records, which is the case of a capture of dw1000_tx frames with some
+ *           frames missed, and a sorted array of (seq, position) pairs searched by bisection otherwise (sequence numbers
+ *           of several senders, see dw1000_twr and the emulator). The time index holds the first position of every
+ *           second of the capture, it is only built if the host reception times never go backwards.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cir_reader.h"
+
+#define SEQ_TABLE_SPAN(n)   (4 * (uint64_t) (n) + 4096)     /* largest direct table, in entries */
+#define TIME_TABLE_SPAN     (1 << 24)                       /* largest time index, in seconds (~194 days) */
+#define NO_RECORD           (UINT32_MAX)
+
+typedef struct
+{
+    uint64_t seq;
+    uint32_t pos;
+} seq_entry_t;
+
+struct cir_reader
+{
+    const uint8_t *map;
+    size_t map_len;
+    size_t count;
+    uint32_t record_len;
+    /* Sequence number index: table[seq - seq_min] if table, else sorted[] */
+    uint64_t seq_min;
+    uint64_t seq_span;
+    uint32_t *seq_table;
+    seq_entry_t *seq_sorted;
+    /* Time index: time_table[sec - sec_min], first position received at or after that second */
+    int64_t sec_min;
+    int64_t sec_span;
+    uint32_t *time_table;
+};
+
+#define RECORD(r, i) ((const cir_record_t *) ((r)->map + (size_t) (i) * (r)->record_len))
+
+static int seqCompare(const void *a, const void *b)
+{
+    const seq_entry_t *x = (const seq_entry_t *) a;
+    const seq_entry_t *y = (const seq_entry_t *) b;
+
+    if (x->seq != y->seq)
+    {
+        return x->seq < y->seq ? -1 : 1;
+    }
+    return x->pos < y->pos ? -1 : x->pos > y->pos;
+}
+
+/* Host reception time of a record compared to (sec, nsec). */
+static int timeCompare(const cir_record_t *rec, int64_t sec, uint32_t nsec)
+{
+    if (rec->rx_sec != sec)
+    {
+        return rec->rx_sec < sec ? -1 : 1;
+    }
+    return rec->rx_nsec < nsec ? -1 : rec->rx_nsec > nsec;
+}
+
+static int buildSeqIndex(cir_reader_t *r)
+{
+    uint64_t seq_max = 0;
+    size_t i;
+
+    r->seq_min = UINT64_MAX;
+    for (i = 0; i < r->count; i++)
+    {
+        uint64_t seq = RECORD(r, i)->seq;
+
+        if (seq < r->seq_min)
+        {
+            r->seq_min = seq;
+        }
+        if (seq > seq_max)
+        {
+            seq_max = seq;
+        }
+    }
+    if (r->count == 0)
+    {
+        return 0;
+    }
+
+    r->seq_span = seq_max - r->seq_min + 1;
+    if (r->seq_span != 0 && r->seq_span <= SEQ_TABLE_SPAN(r->count))
+    {
+        r->seq_table = (uint32_t *) malloc(r->seq_span * sizeof(uint32_t));
+        if (r->seq_table == NULL)
+        {
+            return -1;
+        }
+        memset(r->seq_table, 0xff, r->seq_span * sizeof(uint32_t));
+        for (i = r->count; i-- > 0; )
+        {
+            /* Walked backwards so that the first of duplicate sequence numbers wins. */
+            r->seq_table[RECORD(r, i)->seq - r->seq_min] = (uint32_t) i;
+        }
+        return 0;
+    }
+
+    r->seq_sorted = (seq_entry_t *) malloc(r->count * sizeof(seq_entry_t));
+    if (r->seq_sorted == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < r->count; i++)
+    {
+        r->seq_sorted[i].seq = RECORD(r, i)->seq;
+        r->seq_sorted[i].pos = (uint32_t) i;
+    }
+    qsort(r->seq_sorted, r->count, sizeof(seq_entry_t), seqCompare);
+    return 0;
+}
+
+static int buildTimeIndex(cir_reader_t *r)
+{
+    int64_t sec;
+    size_t i;
+
+    if (r->count == 0)
+    {
+        return 0;
+    }
+    for (i = 1; i < r->count; i++)
+    {
+        const cir_record_t *prev = RECORD(r, i - 1);
+
+        if (timeCompare(RECORD(r, i), prev->rx_sec, prev->rx_nsec) < 0)
+        {
+            return 0;   /* not in time order, lookups scan the file */
+        }
+    }
+
+    r->sec_min = RECORD(r, 0)->rx_sec;
+    r->sec_span = RECORD(r, r->count - 1)->rx_sec - r->sec_min + 1;
+    if (r->sec_span > TIME_TABLE_SPAN)
+    {
+        return 0;
+    }
+    r->time_table = (uint32_t *) malloc((size_t) r->sec_span * sizeof(uint32_t));
+    if (r->time_table == NULL)
+    {
+        return -1;
+    }
+    for (i = 0, sec = 0; sec < r->sec_span; sec++)
+    {
+        while (i < r->count && RECORD(r, i)->rx_sec < r->sec_min + sec)
+        {
+            i++;
+        }
+        r->time_table[sec] = (uint32_t) i;
+    }
+    return 0;
+}
+
+cir_reader_t *cir_reader_open(const char *path)
+{
+    cir_reader_t *r;
+    const cir_record_t *first;
+    struct stat st;
+    size_t i;
+    int fd;
+    int err;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0)
+    {
+        err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if ((size_t) st.st_size < CIR_RECORD_HEADER_LEN)
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    r = (cir_reader_t *) calloc(1, sizeof(cir_reader_t));
+    if (r == NULL)
+    {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    r->map_len = (size_t) st.st_size;
+    r->map = (const uint8_t *) mmap(NULL, r->map_len, PROT_READ, MAP_SHARED, fd, 0);
+    err = errno;
+    close(fd);
+    if (r->map == (const uint8_t *) MAP_FAILED)
+    {
+        free(r);
+        errno = err;
+        return NULL;
+    }
+
+    first = (const cir_record_t *) r->map;
+    if (first->magic != CIR_RECORD_MAGIC || first->version != CIR_RECORD_VERSION || first->size < CIR_RECORD_HEADER_LEN
+        || first->size % 8 != 0)
+    {
+        err = EINVAL;
+        goto fail;
+    }
+    r->record_len = first->size;
+    r->count = r->map_len / r->record_len;
+    if (r->count >= NO_RECORD)
+    {
+        err = EFBIG;
+        goto fail;
+    }
+    for (i = 0; i < r->count; i++)
+    {
+        const cir_record_t *rec = RECORD(r, i);
+
+        if (rec->magic != CIR_RECORD_MAGIC || rec->size != r->record_len || rec->tap_count > CIR_RECORD_CAPACITY(rec))
+        {
+            err = EINVAL;
+            goto fail;
+        }
+    }
+
+    if (buildSeqIndex(r) != 0 || buildTimeIndex(r) != 0)
+    {
+        err = ENOMEM;
+        goto fail;
+    }
+    return r;
+
+fail:
+    cir_reader_close(r);
+    errno = err;
+    return NULL;
+}
+
+void cir_reader_close(cir_reader_t *r)
+{
+    if (r == NULL)
+    {
+        return;
+    }
+    munmap((void *) r->map, r->map_len);
+    free(r->seq_table);
+    free(r->seq_sorted);
+    free(r->time_table);
+    free(r);
+}
+
+size_t cir_reader_count(const cir_reader_t *r)
+{
+    return r->count;
+}
+
+uint32_t cir_reader_record_len(const cir_reader_t *r)
+{
+    return r->record_len;
+}
+
+const cir_record_t *cir_reader_get(const cir_reader_t *r, size_t i)
+{
+    return i < r->count ? RECORD(r, i) : NULL;
+}
+
+int64_t cir_reader_find_seq(const cir_reader_t *r, uint64_t seq)
+{
+    size_t lo = 0;
+    size_t hi = r->count;
+
+    if (r->count == 0 || seq < r->seq_min)
+    {
+        return -1;
+    }
+    if (r->seq_table)
+    {
+        if (seq - r->seq_min >= r->seq_span || r->seq_table[seq - r->seq_min] == NO_RECORD)
+        {
+            return -1;
+        }
+        return r->seq_table[seq - r->seq_min];
+    }
+
+    /* First entry not below seq */
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (r->seq_sorted[mid].seq < seq)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (lo < r->count && r->seq_sorted[lo].seq == seq) ? (int64_t) r->seq_sorted[lo].pos : -1;
+}
+
+int64_t cir_reader_find_time(const cir_reader_t *r, int64_t sec, uint32_t nsec)
+{
+    size_t i = 0;
+
+    if (r->time_table)
+    {
+        if (sec < r->sec_min)
+        {
+            return 0;
+        }
+        if (sec - r->sec_min >= r->sec_span)
+        {
+            return (int64_t) r->count;
+        }
+        i = r->time_table[sec - r->sec_min];
+    }
+    while (i < r->count && timeCompare(RECORD(r, i), sec, nsec) < 0)
+    {
+        i++;
+    }
+    return (int64_t) i;
+}
+
+const void *cir_reader_data(const cir_reader_t *r)
+{
+    return r->map;
+}
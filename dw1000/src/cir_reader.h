@@ -0,0 +1,118 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_reader.h
+ *  @brief   Memory mapped reader of binary CIR captures
+ *
+ *           A capture (see cir_record.h) has a fixed stride, so record i starts at i * size. The reader maps the whole
+ *           file read only and, while opening it, indexes the sequence numbers and the host reception times, so a frame
+ *           is found by sequence number or time without parsing and its record is returned in place. Also built as
+ *           libcir_reader.so for the Python bindings in cir_reader.py.
+ */
+
+#ifndef _CIR_READER_H_
+#define _CIR_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cir_record.h"
+
+typedef struct cir_reader cir_reader_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_open()
+ *
+ * @brief Map a capture and build its indexes. Only captures of the current CIR_RECORD_VERSION are mapped, older ones
+ *        can be read with cir2csv. Bytes after the last whole record, from a capture that was cut short, are ignored.
+ *
+ * @param  path - capture file
+ *
+ * @return  the reader, or NULL with errno set
+ */
+cir_reader_t *cir_reader_open(const char *path);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_close()
+ *
+ * @brief Unmap the capture and free the reader. Records returned by the reader are invalid afterwards. NULL is ignored.
+ *
+ * @param  r - reader
+ *
+ * @return  none
+ */
+void cir_reader_close(cir_reader_t *r);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_count()
+ *
+ * @brief Number of records in the capture.
+ *
+ * @param  r - reader
+ *
+ * @return  the number of whole records
+ */
+size_t cir_reader_count(const cir_reader_t *r);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_record_len()
+ *
+ * @brief Record size in bytes, header included: the stride of the capture.
+ *
+ * @param  r - reader
+ *
+ * @return  the record size
+ */
+uint32_t cir_reader_record_len(const cir_reader_t *r);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_get()
+ *
+ * @brief Record at a position of the capture, in place in the mapping.
+ *
+ * @param  r - reader
+ * @param  i - position, from 0
+ *
+ * @return  the record, or NULL if i is out of range
+ */
+const cir_record_t *cir_reader_get(const cir_reader_t *r, size_t i);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_find_seq()
+ *
+ * @brief Position of the record of a sequence number, the first one if it was saved more than once. O(1) when the
+ *        sequence numbers of the capture are dense, O(log n) otherwise.
+ *
+ * @param  r - reader
+ * @param  seq - sequence number carried by the frame
+ *
+ * @return  the position, or -1 if no record has this sequence number
+ */
+int64_t cir_reader_find_seq(const cir_reader_t *r, uint64_t seq);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_find_time()
+ *
+ * @brief Position of the first record, in file order, received at or after a host time (rx_sec, rx_nsec). O(1) plus
+ *        the records of one second when the capture is in time order, a scan of the file otherwise. The records of
+ *        [t0, t1) are the positions from find_time(t0) to find_time(t1).
+ *
+ * @param  r - reader
+ * @param  sec - CLOCK_REALTIME seconds
+ * @param  nsec - CLOCK_REALTIME nanoseconds
+ *
+ * @return  the position, or the number of records if none is that late
+ */
+int64_t cir_reader_find_time(const cir_reader_t *r, int64_t sec, uint32_t nsec);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_reader_data()
+ *
+ * @brief Start of the mapping, for bindings that view the whole capture as an array of count records of record_len
+ *        bytes.
+ *
+ * @param  r - reader
+ *
+ * @return  the first record
+ */
+const void *cir_reader_data(const cir_reader_t *r);
+
+#endif /* _CIR_READER_H_ */
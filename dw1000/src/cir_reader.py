@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Python bindings of the memory mapped CIR capture reader (cir_reader.h).
+
+The capture is viewed in place as a numpy structured array, one element per
+record, so fields and taps of any set of frames are read without parsing or
+copying. Build the library first with "make libcir_reader.so".
+
+    from cir_reader import CIRFile
+    with CIRFile("../../data/test.cir") as f:
+        rec = f.by_seq(1234)                 # one record, or None
+        first = f.time_range(t0, t1)         # records received in [t0, t1), host time in seconds
+        cir = f.complex_taps(f.records)      # every CIR as complex128, frames x taps
+        for rec in f:                        # records in file order
+            print(rec["seq"], rec["first_path"] / 64.0)
+
+The arrays are views of the mapping: they hold it while they exist, but are
+invalid after an explicit close().
+
+Feature files (<capture>.feat) are small and read whole with read_features().
+"""
+
+import ctypes, os
+import numpy as np
+
+CIR_RECORD_HEADER_LEN = 72
+
+# cir_record_t, little-endian
+HEADER_FIELDS = [
+    ("magic", "<u4"), ("version", "<u2"), ("flags", "<u2"), ("size", "<u4"), ("rx_nsec", "<u4"),
+    ("seq", "<u8"), ("rx_sec", "<i8"), ("tap_first", "<u2"), ("tap_count", "<u2"),
+    ("first_path", "<u2"), ("max_noise", "<u2"), ("std_noise", "<u2"), ("first_path_amp1", "<u2"),
+    ("first_path_amp2", "<u2"), ("first_path_amp3", "<u2"), ("max_growth_cir", "<u2"), ("rx_pream_count", "<u2"),
+    ("reserved", "<u4"), ("rx_stamp", "<u8"), ("sync_ns", "<i8"),
+]
+
+# cir_feature_record_t, little-endian; bg_score reads as 0 in version 1 files
+FEATURE_DTYPE = np.dtype([
+    ("magic", "<u4"), ("version", "<u2"), ("flags", "<u2"), ("size", "<u4"), ("rx_nsec", "<u4"),
+    ("seq", "<u8"), ("rx_sec", "<i8"), ("sync_ns", "<i8"),
+    ("first_path", "<f4"), ("fp_power", "<f4"), ("rx_power", "<f4"), ("cir_power", "<f4"), ("peak_to_fp", "<f4"),
+    ("rms_delay", "<f4"), ("mean_delay", "<f4"), ("bg_diff", "<f4"), ("peak", "<u2"), ("std_noise", "<u2"),
+    ("bg_score", "<f4"),
+])
+CIR_FEATURE_MAGIC = 0x54464355
+
+# Feature record flags
+CIR_FEATURE_EDGE = 0x0001
+CIR_FEATURE_BACKGROUND = 0x0002
+CIR_FEATURE_OVERLAP = 0x0004
+CIR_FEATURE_SYNC = 0x0008
+CIR_FEATURE_FULL = 0x0010
+
+# Record flags
+CIR_RECORD_DIAG = 0x0001
+CIR_RECORD_WINDOW = 0x0002
+CIR_RECORD_OVERLAP = 0x0004
+CIR_RECORD_SYNC = 0x0008
+
+
+def _load(path=None):
+    lib = ctypes.CDLL(path or os.path.join(os.path.dirname(os.path.abspath(__file__)), "libcir_reader.so"), use_errno=True)
+    lib.cir_reader_open.restype = ctypes.c_void_p
+    lib.cir_reader_open.argtypes = [ctypes.c_char_p]
+    lib.cir_reader_close.restype = None
+    lib.cir_reader_close.argtypes = [ctypes.c_void_p]
+    lib.cir_reader_count.restype = ctypes.c_size_t
+    lib.cir_reader_count.argtypes = [ctypes.c_void_p]
+    lib.cir_reader_record_len.restype = ctypes.c_uint32
+    lib.cir_reader_record_len.argtypes = [ctypes.c_void_p]
+    lib.cir_reader_find_seq.restype = ctypes.c_int64
+    lib.cir_reader_find_seq.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+    lib.cir_reader_find_time.restype = ctypes.c_int64
+    lib.cir_reader_find_time.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_uint32]
+    lib.cir_reader_data.restype = ctypes.c_void_p
+    lib.cir_reader_data.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+_lib = None
+
+
+def record_dtype(record_len):
+    """numpy dtype of a record of record_len bytes: the header fields, then taps as (capacity, 2) int16."""
+    capacity = (record_len - CIR_RECORD_HEADER_LEN) // 4
+    return np.dtype(HEADER_FIELDS + [("taps", "<i2", (capacity, 2))])
+
+
+class CIRFile(object):
+    def __init__(self, path, library=None):
+        global _lib
+        if _lib is None or library:
+            _lib = _load(library)
+        self._lib = _lib
+        self._r = self._lib.cir_reader_open(path.encode())
+        if not self._r:
+            err = ctypes.get_errno()
+            raise OSError(err, os.strerror(err), path)
+        self.count = self._lib.cir_reader_count(self._r)
+        self.record_len = self._lib.cir_reader_record_len(self._r)
+        self.dtype = record_dtype(self.record_len)
+        if self.count:
+            buf = (ctypes.c_char * (self.count * self.record_len)).from_address(self._lib.cir_reader_data(self._r))
+            buf._owner = self   # views of the records keep the mapping alive until close()
+            self.records = np.frombuffer(buf, dtype=self.dtype)
+        else:
+            self.records = np.zeros(0, dtype=self.dtype)
+
+    def close(self):
+        if self._r:
+            self.records = None
+            self._lib.cir_reader_close(self._r)
+            self._r = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def __len__(self):
+        return self.count
+
+    def __getitem__(self, i):
+        return self.records[i]
+
+    def __iter__(self):
+        return iter(self.records)
+
+    def find_seq(self, seq):
+        """Position of the record of sequence number seq, -1 if none."""
+        return self._lib.cir_reader_find_seq(self._r, seq)
+
+    def by_seq(self, seq):
+        i = self.find_seq(seq)
+        return self.records[i] if i >= 0 else None
+
+    def find_time(self, t):
+        """Position of the first record received at or after host time t (seconds, float or (sec, nsec))."""
+        if isinstance(t, tuple):
+            sec, nsec = t
+        else:
+            sec = int(np.floor(t))
+            nsec = int(round((t - sec) * 1e9))
+            if nsec >= 1000000000:
+                sec, nsec = sec + 1, nsec - 1000000000
+        return self._lib.cir_reader_find_time(self._r, sec, nsec)
+
+    def time_range(self, t0, t1):
+        """Records received in [t0, t1), as a view."""
+        return self.records[self.find_time(t0):self.find_time(t1)]
+
+    @staticmethod
+    def complex_taps(records):
+        """Taps of one or more records as complex128, padding taps past tap_count included."""
+        taps = records["taps"].astype(np.float64)
+        return taps[..., 0] + 1j * taps[..., 1]
+
+
+def read_features(path):
+    """Feature records of a <capture>.feat file as a numpy structured array, a trailing partial record ignored."""
+    with open(path, "rb") as f:
+        data = f.read()
+    records = np.frombuffer(data[:len(data) - len(data) % FEATURE_DTYPE.itemsize], dtype=FEATURE_DTYPE)
+    if len(records) and ((records["magic"] != CIR_FEATURE_MAGIC).any() or (records["size"] != FEATURE_DTYPE.itemsize).any()):
+        raise ValueError("%s: not a feature file" % path)
+    return records
@@ -0,0 +1,95 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_record.h
+ *  @brief   Binary CIR and feature record formats written by dw1000_rx_cir and dw1000d
+ *
+ *           A capture file is a sequence of records of identical size. Each record is a fixed cir_record_t header followed
+ *           by tap_capacity interleaved real/imaginary int16 accumulator taps, where tap_capacity = (size - header) / 4.
+ *           All fields are little-endian. Records are written with a single write() each. Coded captures (dw1000_rx_cir
+ *           -z) hold the same records losslessly coded, see cir_codec.h.
+ */
+
+#ifndef _CIR_RECORD_H_
+#define _CIR_RECORD_H_
+
+#include <stdint.h>
+
+#define CIR_RECORD_MAGIC        (0x52494355UL)  /* "UCIR" */
+#define CIR_RECORD_VERSION      (2)             /* 2 added rx_stamp and sync_ns */
+
+#define CIR_RECORD_TAPS_MAX     (1016)          /* accumulator length for 64 MHz PRF */
+
+/* Record flags */
+#define CIR_RECORD_DIAG         (0x0001)        /* diagnostics are valid */
+#define CIR_RECORD_WINDOW       (0x0002)        /* taps are a window around the first path rather than the whole accumulator */
+#define CIR_RECORD_OVERLAP      (0x0004)        /* a later preamble was detected before the taps were read, they may be overwritten */
+#define CIR_RECORD_SYNC         (0x0008)        /* sync_ns is valid, see time_sync.h */
+
+typedef struct
+{
+    uint32_t    magic;          /* CIR_RECORD_MAGIC */
+    uint16_t    version;        /* CIR_RECORD_VERSION */
+    uint16_t    flags;          /* CIR_RECORD_* flags */
+    uint32_t    size;           /* record size in bytes, header included, identical for all records of a file */
+    uint32_t    rx_nsec;        /* host CLOCK_REALTIME at reception, nanoseconds */
+    uint64_t    seq;            /* sequence number carried by the frame */
+    int64_t     rx_sec;         /* host CLOCK_REALTIME at reception, seconds */
+    uint16_t    tap_first;      /* accumulator index of taps[0] */
+    uint16_t    tap_count;      /* number of valid taps */
+    /* dwt_rxdiag_t */
+    uint16_t    first_path;     /* first path index, 10.6 bits fixed point */
+    uint16_t    max_noise;
+    uint16_t    std_noise;
+    uint16_t    first_path_amp1;
+    uint16_t    first_path_amp2;
+    uint16_t    first_path_amp3;
+    uint16_t    max_growth_cir;
+    uint16_t    rx_pream_count;
+    uint32_t    reserved;       /* zero */
+    uint64_t    rx_stamp;       /* DW1000 RX timestamp, 40 bits */
+    int64_t     sync_ns;        /* rx_stamp on the clock of the time sync beacon sender, nanoseconds */
+    int16_t     taps[][2];      /* real, imaginary */
+} cir_record_t;
+
+#define CIR_RECORD_HEADER_LEN   (sizeof(cir_record_t))
+#define CIR_RECORD_HEADER_LEN_V1 (56)           /* version 1 headers end after reserved */
+#define CIR_RECORD_LEN(taps)    (CIR_RECORD_HEADER_LEN + 4 * (taps))
+#define CIR_RECORD_CAPACITY(r)  (((r)->size - CIR_RECORD_HEADER_LEN) / 4)
+
+/* Feature records, written instead of whole CIRs by the feature stage of the receivers (see cir_features.h) to a file
+ * of their own, <capture>.feat. Fixed size, little-endian like the CIR records. */
+#define CIR_FEATURE_MAGIC       (0x54464355UL)  /* "UCFT" */
+#define CIR_FEATURE_VERSION     (2)           /* version 1 records have no bg_score, read as 0 */
+
+/* Feature record flags */
+#define CIR_FEATURE_EDGE        (0x0001)        /* first_path is the upsampled leading edge of the taps, not the LDE's */
+#define CIR_FEATURE_BACKGROUND  (0x0002)        /* bg_diff and bg_score are valid */
+#define CIR_FEATURE_OVERLAP     (0x0004)        /* as CIR_RECORD_OVERLAP */
+#define CIR_FEATURE_SYNC        (0x0008)        /* sync_ns is valid */
+#define CIR_FEATURE_FULL        (0x0010)        /* the whole record of this frame was also saved to the CIR capture */
+
+typedef struct
+{
+    uint32_t    magic;          /* CIR_FEATURE_MAGIC */
+    uint16_t    version;        /* CIR_FEATURE_VERSION */
+    uint16_t    flags;          /* CIR_FEATURE_* flags */
+    uint32_t    size;           /* record size in bytes */
+    uint32_t    rx_nsec;        /* host CLOCK_REALTIME at reception, nanoseconds */
+    uint64_t    seq;            /* sequence number carried by the frame */
+    int64_t     rx_sec;         /* host CLOCK_REALTIME at reception, seconds */
+    int64_t     sync_ns;        /* as in cir_record_t */
+    float       first_path;     /* first path, fractional accumulator index */
+    float       fp_power;       /* first path power, dBm, from the diagnostics */
+    float       rx_power;       /* estimated receive power, dBm, from the diagnostics */
+    float       cir_power;      /* power of the taps of the feature window, dB of accumulator units */
+    float       peak_to_fp;     /* strongest tap over strongest first path tap, dB */
+    float       rms_delay;      /* RMS delay spread, ns */
+    float       mean_delay;     /* mean excess delay after the first path, ns */
+    float       bg_diff;        /* energy of the difference from the background over the background energy */
+    uint16_t    peak;           /* accumulator index of the strongest tap */
+    uint16_t    std_noise;      /* from the diagnostics */
+    float       bg_score;       /* deviation from the background, mean of |h - mean|^2 / var over the taps, see cir_background.h */
+} cir_feature_record_t;
+
+#define CIR_FEATURE_LEN         (sizeof(cir_feature_record_t))
+
+#endif /* _CIR_RECORD_H_ */
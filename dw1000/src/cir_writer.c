@@ -0,0 +1,349 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_writer.c
+ *  @brief   Asynchronous CIR record writer, see cir_writer.h
+ *
+ *           head is only written by the producer and tail only by the consumer. Both are free running counters, the
+ *           slot of a counter is counter & mask. The producer publishes a record by storing head with release semantics
+ *           after filling it, the consumer frees slots by storing tail with release semantics after writing them. The
+ *           semaphore only wakes the storage thread up, it does not protect the ring. Each writer has its own ring and
+ *           storage thread, so several receive loops can record in parallel. The byte count of the file is 64 bits,
+ *           which 32-bit ARM cannot update atomically without libatomic: it has a lock of its own, taken once per
+ *           write.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "cir_codec.h"
+#include "cir_writer.h"
+
+#define CODED_BATCH 16          /* coded records gathered into one write() */
+
+struct cir_writer
+{
+    uint8_t *ring;
+    uint32_t record_len;
+    uint32_t mask;
+    uint32_t head;              /* next slot to fill, producer */
+    uint32_t tail;              /* next slot to write, consumer */
+    int stop;
+    int output_fd;
+    sem_t wakeup;
+    pthread_t thread;
+    cir_writer_stats_t stats;
+    pthread_mutex_t bytes_lock; /* file_bytes */
+    cir_codec_t *codec;         /* coded capture, used by the storage thread only */
+    uint8_t *coded;             /* CODED_BATCH coded records at most */
+};
+
+#define SLOT(w, n) ((cir_record_t *) &(w)->ring[(size_t) ((n) & (w)->mask) * (w)->record_len])
+
+/* Write len bytes, retrying on short writes and signals. Returns 0 on success. */
+static int write_all(int fd, const uint8_t *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+/* Write a batch of records, or the coded records gathered, and count them. */
+static void writeBatch(cir_writer_t *w, const uint8_t *buf, size_t len, uint32_t count)
+{
+    if (write_all(w->output_fd, buf, len) == 0)
+    {
+        __atomic_add_fetch(&w->stats.written, count, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&w->bytes_lock);
+        w->stats.file_bytes += len;
+        pthread_mutex_unlock(&w->bytes_lock);
+    }
+    else
+    {
+        perror("unable to write");
+        __atomic_add_fetch(&w->stats.errors, count, __ATOMIC_RELAXED);
+    }
+    __atomic_add_fetch(&w->stats.writes, 1, __ATOMIC_RELAXED);
+}
+
+/* Code the records of a batch, writing them CODED_BATCH at a time. */
+static void writeCoded(cir_writer_t *w, uint32_t t, uint32_t count)
+{
+    size_t len = 0;
+    uint32_t pending = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        size_t n = cir_codec_encode(w->codec, SLOT(w, t + i), &w->coded[len], CIR_CODED_BOUND(w->record_len));
+
+        if (n == 0)
+        {
+            fprintf(stderr, "cir_writer: record %lu is not a CIR record\n", (unsigned long) SLOT(w, t + i)->seq);
+            __atomic_add_fetch(&w->stats.errors, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        len += n;
+        pending++;
+        if (pending == CODED_BATCH)
+        {
+            writeBatch(w, w->coded, len, pending);
+            len = 0;
+            pending = 0;
+        }
+    }
+    if (pending > 0)
+    {
+        writeBatch(w, w->coded, len, pending);
+    }
+}
+
+static void *writer_thread(void *arg)
+{
+    cir_writer_t *w = (cir_writer_t *) arg;
+    uint32_t t = w->tail;
+
+    while (1)
+    {
+        uint32_t h = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+
+        if (h == t)
+        {
+            if (__atomic_load_n(&w->stop, __ATOMIC_ACQUIRE) && h == __atomic_load_n(&w->head, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+            sem_wait(&w->wakeup);
+            continue;
+        }
+
+        /* Write all records up to the end of the ring in one call. */
+        uint32_t count = h - t;
+        uint32_t contiguous = w->mask + 1 - (t & w->mask);
+        if (count > contiguous)
+        {
+            count = contiguous;
+        }
+
+        if (w->codec != NULL)
+        {
+            writeCoded(w, t, count);
+        }
+        else
+        {
+            writeBatch(w, (const uint8_t *) SLOT(w, t), (size_t) count * w->record_len, count);
+        }
+
+        t += count;
+        __atomic_store_n(&w->tail, t, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+/* Allocate a writer with its ring of zeroed records, the caller sets the record headers before starting it. */
+static cir_writer_t *writerAlloc(uint32_t slots, uint32_t record_len)
+{
+    cir_writer_t *w;
+
+    if (slots == 0 || (slots & (slots - 1)) != 0)
+    {
+        fprintf(stderr, "cir_writer: %u slots is not a power of 2\n", slots);
+        return NULL;
+    }
+
+    w = (cir_writer_t *) calloc(1, sizeof(*w));
+    if (w == NULL)
+    {
+        fprintf(stderr, "cir_writer: out of memory\n");
+        return NULL;
+    }
+    w->record_len = record_len;
+    w->mask = slots - 1;
+    w->ring = (uint8_t *) calloc(slots, w->record_len);
+    if (w->ring == NULL)
+    {
+        fprintf(stderr, "cir_writer: could not allocate %u records\n", slots);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+static void writerFree(cir_writer_t *w)
+{
+    free(w->coded);
+    free(w->codec);
+    free(w->ring);
+    free(w);
+}
+
+/* Start the storage thread of an allocated writer, which is freed on error. */
+static cir_writer_t *writerRun(cir_writer_t *w, int fd)
+{
+    w->output_fd = fd;
+
+    if (sem_init(&w->wakeup, 0, 0) != 0)
+    {
+        perror("cir_writer");
+        writerFree(w);
+        return NULL;
+    }
+    pthread_mutex_init(&w->bytes_lock, NULL);
+    if (pthread_create(&w->thread, NULL, writer_thread, w) != 0)
+    {
+        fprintf(stderr, "cir_writer: could not start the storage thread\n");
+        pthread_mutex_destroy(&w->bytes_lock);
+        sem_destroy(&w->wakeup);
+        writerFree(w);
+        return NULL;
+    }
+    return w;
+}
+
+/* Allocate a writer of CIR records, their headers set. */
+static cir_writer_t *recordWriterAlloc(uint32_t slots, uint16_t taps)
+{
+    cir_writer_t *w;
+    uint32_t i;
+
+    w = writerAlloc(slots, CIR_RECORD_LEN(taps));
+    if (w == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i < slots; i++)
+    {
+        SLOT(w, i)->magic = CIR_RECORD_MAGIC;
+        SLOT(w, i)->version = CIR_RECORD_VERSION;
+        SLOT(w, i)->size = w->record_len;
+    }
+    return w;
+}
+
+cir_writer_t *cir_writer_start(int fd, uint32_t slots, uint16_t taps)
+{
+    cir_writer_t *w = recordWriterAlloc(slots, taps);
+
+    return w != NULL ? writerRun(w, fd) : NULL;
+}
+
+cir_writer_t *cir_writer_start_coded(int fd, uint32_t slots, uint16_t taps)
+{
+    cir_writer_t *w = recordWriterAlloc(slots, taps);
+
+    if (w == NULL)
+    {
+        return NULL;
+    }
+    w->codec = (cir_codec_t *) malloc(sizeof(*w->codec));
+    w->coded = (uint8_t *) malloc(CODED_BATCH * CIR_CODED_BOUND(w->record_len));
+    if (w->codec == NULL || w->coded == NULL)
+    {
+        fprintf(stderr, "cir_writer: out of memory\n");
+        writerFree(w);
+        return NULL;
+    }
+    cir_codec_init(w->codec, CIR_CODEC_KEY_INTERVAL);
+    return writerRun(w, fd);
+}
+
+cir_writer_t *cir_writer_start_features(int fd, uint32_t slots)
+{
+    cir_writer_t *w;
+    uint32_t i;
+
+    w = writerAlloc(slots, CIR_FEATURE_LEN);
+    if (w == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i < slots; i++)
+    {
+        cir_feature_record_t *rec = (cir_feature_record_t *) SLOT(w, i);
+
+        rec->magic = CIR_FEATURE_MAGIC;
+        rec->version = CIR_FEATURE_VERSION;
+        rec->size = w->record_len;
+    }
+    return writerRun(w, fd);
+}
+
+cir_record_t *cir_writer_acquire(cir_writer_t *w)
+{
+    uint32_t t = __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+
+    if (w->head - t > w->mask)
+    {
+        __atomic_add_fetch(&w->stats.dropped, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    return SLOT(w, w->head);
+}
+
+cir_feature_record_t *cir_writer_acquire_feature(cir_writer_t *w)
+{
+    return (cir_feature_record_t *) cir_writer_acquire(w);
+}
+
+void cir_writer_commit(cir_writer_t *w)
+{
+    uint32_t fill = w->head + 1 - __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+
+    __atomic_store_n(&w->head, w->head + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&w->stats.committed, 1, __ATOMIC_RELAXED);
+    if (fill > __atomic_load_n(&w->stats.max_fill, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&w->stats.max_fill, fill, __ATOMIC_RELAXED);
+    }
+    sem_post(&w->wakeup);
+}
+
+void cir_writer_stop(cir_writer_t *w, cir_writer_stats_t *stats)
+{
+    if (w == NULL)
+    {
+        return;
+    }
+
+    __atomic_store_n(&w->stop, 1, __ATOMIC_RELEASE);
+    sem_post(&w->wakeup);
+    pthread_join(w->thread, NULL);
+    if (stats != NULL)
+    {
+        cir_writer_getstats(w, stats);
+    }
+
+    pthread_mutex_destroy(&w->bytes_lock);
+    sem_destroy(&w->wakeup);
+    writerFree(w);
+}
+
+void cir_writer_getstats(cir_writer_t *w, cir_writer_stats_t *out)
+{
+    out->committed = __atomic_load_n(&w->stats.committed, __ATOMIC_RELAXED);
+    out->written = __atomic_load_n(&w->stats.written, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&w->stats.dropped, __ATOMIC_RELAXED);
+    out->errors = __atomic_load_n(&w->stats.errors, __ATOMIC_RELAXED);
+    out->writes = __atomic_load_n(&w->stats.writes, __ATOMIC_RELAXED);
+    out->max_fill = __atomic_load_n(&w->stats.max_fill, __ATOMIC_RELAXED);
+    out->raw_bytes = (uint64_t) out->written * w->record_len;
+    pthread_mutex_lock(&w->bytes_lock);
+    out->file_bytes = w->stats.file_bytes;
+    pthread_mutex_unlock(&w->bytes_lock);
+}
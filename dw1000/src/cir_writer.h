@@ -0,0 +1,134 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cir_writer.h
+ *  @brief   Asynchronous CIR record writer
+ *
+ *           The receive loop (producer) fills preallocated records in a single-producer/single-consumer ring and a
+ *           storage thread (consumer) appends them to the output file. The producer never blocks: when the ring is full
+ *           the record is dropped and counted, so re-enabling the receiver never waits on the disk. A writer started
+ *           with cir_writer_start_coded() codes the records in the storage thread (see cir_codec.h) before writing
+ *           them.
+ */
+
+#ifndef _CIR_WRITER_H_
+#define _CIR_WRITER_H_
+
+#include <stdint.h>
+
+#include "cir_record.h"
+
+#define CIR_WRITER_SLOTS        (256)           /* default ring size in records, must be a power of 2 */
+
+typedef struct
+{
+    unsigned long   committed;      /* records queued by the producer */
+    unsigned long   written;        /* records written to the file */
+    unsigned long   dropped;        /* records not queued because the ring was full */
+    unsigned long   errors;         /* records lost to write errors */
+    unsigned long   writes;         /* write() calls, contiguous records are written together */
+    uint32_t        max_fill;       /* highest number of records waiting in the ring */
+    uint64_t        raw_bytes;      /* size of the records written */
+    uint64_t        file_bytes;     /* bytes written to the file, less than raw_bytes for a coded capture */
+} cir_writer_stats_t;
+
+typedef struct cir_writer cir_writer_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_start()
+ *
+ * @brief Allocate a writer with its ring and start its storage thread. The magic, version and size of every slot are
+ *        set here.
+ *
+ * @param  fd - output file descriptor
+ * @param  slots - ring size in records, a power of 2
+ * @param  taps - tap capacity of each record
+ *
+ * @return  the writer, or NULL on error
+ */
+cir_writer_t *cir_writer_start(int fd, uint32_t slots, uint16_t taps);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_start_coded()
+ *
+ * @brief Same as cir_writer_start() for a coded capture: the storage thread writes the records coded by cir_codec.c,
+ *        with a key record every CIR_CODEC_KEY_INTERVAL records.
+ *
+ * @param  fd - output file descriptor
+ * @param  slots - ring size in records, a power of 2
+ * @param  taps - tap capacity of each record
+ *
+ * @return  the writer, or NULL on error
+ */
+cir_writer_t *cir_writer_start_coded(int fd, uint32_t slots, uint16_t taps);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_start_features()
+ *
+ * @brief Same as cir_writer_start() for a writer of feature records (see cir_record.h), whose records are taken with
+ *        cir_writer_acquire_feature().
+ *
+ * @param  fd - output file descriptor
+ * @param  slots - ring size in records, a power of 2
+ *
+ * @return  the writer, or NULL on error
+ */
+cir_writer_t *cir_writer_start_features(int fd, uint32_t slots);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_acquire()
+ *
+ * @brief Producer side: get the next free record. Never blocks.
+ *
+ * @param  w - writer
+ *
+ * @return  the record to fill, or NULL if the ring is full (counted as dropped)
+ */
+cir_record_t *cir_writer_acquire(cir_writer_t *w);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_acquire_feature()
+ *
+ * @brief Producer side of a feature record writer: get the next free record. Never blocks.
+ *
+ * @param  w - writer started with cir_writer_start_features()
+ *
+ * @return  the record to fill, or NULL if the ring is full (counted as dropped)
+ */
+cir_feature_record_t *cir_writer_acquire_feature(cir_writer_t *w);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_commit()
+ *
+ * @brief Producer side: hand the record returned by the last cir_writer_acquire() or cir_writer_acquire_feature() to
+ *        the storage thread.
+ *
+ * @param  w - writer
+ *
+ * @return  none
+ */
+void cir_writer_commit(cir_writer_t *w);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_stop()
+ *
+ * @brief Write out the records still in the ring, stop the storage thread and free the writer. NULL is ignored.
+ *
+ * @param  w - writer
+ * @param  stats - final counters, taken after the last write, or NULL
+ *
+ * @return  none
+ */
+void cir_writer_stop(cir_writer_t *w, cir_writer_stats_t *stats);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn cir_writer_getstats()
+ *
+ * @brief Read the writer counters. Can be called from any thread.
+ *
+ * @param  w - writer
+ * @param  stats - output counters
+ *
+ * @return  none
+ */
+void cir_writer_getstats(cir_writer_t *w, cir_writer_stats_t *stats);
+
+#endif /* _CIR_WRITER_H_ */
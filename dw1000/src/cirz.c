@@ -0,0 +1,248 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    cirz.c
+ *  @brief   Code and decode CIR captures with the lossless codec of cir_codec.h
+ *
+ *           cirz [-k n] <capture> <coded>   code a capture of dw1000_rx_cir or dw1000d, a key record every n records
+ *           cirz -d <coded> <capture>       decode a coded capture, as written by dw1000_rx_cir -z or cirz
+ *           cirz -t [-k n] <capture>        code and decode every record of a capture in memory, check that each comes
+ *                                           back byte for byte and print the ratio and the speed of both directions
+ *
+ *           Captures of version 1 and 2 records are read, records of one capture may be of any size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cir_codec.h"
+
+#define RECORD_MAX  (CIR_RECORD_HEADER_LEN + 4 * CIR_RECORD_TAPS_MAX)
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Read the next record of a capture into rec, RECORD_MAX bytes. Returns its size, 0 at the end, -1 on error. */
+static long readRecord(FILE *in, cir_record_t *rec, unsigned long n)
+{
+    uint32_t hdr_len;
+
+    if (fread(rec, CIR_RECORD_HEADER_LEN_V1, 1, in) != 1)
+    {
+        return 0;
+    }
+    hdr_len = rec->version == 1 ? CIR_RECORD_HEADER_LEN_V1 : CIR_RECORD_HEADER_LEN;
+    if (rec->magic != CIR_RECORD_MAGIC || rec->version < 1 || rec->version > CIR_RECORD_VERSION
+        || rec->size < hdr_len || rec->size > RECORD_MAX || (rec->size - hdr_len) % 4 != 0)
+    {
+        fprintf(stderr, "record %lu: not a version 1 to %d CIR record\n", n, CIR_RECORD_VERSION);
+        return -1;
+    }
+    if (fread((uint8_t *) rec + CIR_RECORD_HEADER_LEN_V1, rec->size - CIR_RECORD_HEADER_LEN_V1, 1, in) != 1)
+    {
+        fprintf(stderr, "record %lu: truncated\n", n);
+        return -1;
+    }
+    return rec->size;
+}
+
+/* Read the next coded record into buf. Returns its size, 0 at the end, -1 on error. */
+static long readCoded(FILE *in, uint8_t *buf, unsigned long n)
+{
+    cir_coded_header_t hdr;
+
+    if (fread(buf, CIR_CODED_HEADER_LEN, 1, in) != 1)
+    {
+        return 0;
+    }
+    memcpy(&hdr, buf, sizeof(hdr));
+    if (hdr.magic != CIR_CODED_MAGIC || hdr.version != CIR_CODED_VERSION || hdr.size <= CIR_CODED_HEADER_LEN
+        || hdr.size > CIR_CODED_BOUND(RECORD_MAX))
+    {
+        fprintf(stderr, "record %lu: not a version %d coded CIR record\n", n, CIR_CODED_VERSION);
+        return -1;
+    }
+    if (fread(&buf[CIR_CODED_HEADER_LEN], hdr.size - CIR_CODED_HEADER_LEN, 1, in) != 1)
+    {
+        fprintf(stderr, "record %lu: truncated\n", n);
+        return -1;
+    }
+    return hdr.size;
+}
+
+static void printUsage(void)
+{
+    printf("Usage: cirz [-k n] <capture> <coded>\n");
+    printf("       cirz -d <coded> <capture>\n");
+    printf("       cirz -t [-k n] <capture>\n");
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in;
+    FILE *out = NULL;
+    cir_codec_t *enc, *dec;
+    cir_record_t *rec, *back;
+    uint8_t *coded;
+    double t_enc = 0.0, t_dec = 0.0, t;
+    unsigned long n = 0, stored = 0;
+    uint32_t key_interval = CIR_CODEC_KEY_INTERVAL;
+    int decode = 0, test = 0, failed = 0;
+    long len;
+    size_t size;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "dtk:")) != -1)
+    {
+        if (opt == 'd')
+        {
+            decode = 1;
+        }
+        else if (opt == 't')
+        {
+            test = 1;
+        }
+        else if (opt == 'k')
+        {
+            key_interval = (uint32_t) atoi(optarg);
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+    if (argc - optind != (test ? 1 : 2) || (decode && test))
+    {
+        printUsage();
+        return 1;
+    }
+
+    enc = (cir_codec_t *) malloc(sizeof(*enc));
+    dec = (cir_codec_t *) malloc(sizeof(*dec));
+    rec = (cir_record_t *) malloc(RECORD_MAX);
+    back = (cir_record_t *) malloc(RECORD_MAX);
+    coded = (uint8_t *) malloc(CIR_CODED_BOUND(RECORD_MAX));
+    if (!enc || !dec || !rec || !back || !coded)
+    {
+        fprintf(stderr, "Could not allocate memory\n");
+        return 1;
+    }
+    cir_codec_init(enc, key_interval);
+    cir_codec_init(dec, 0);
+
+    in = fopen(argv[optind], "rb");
+    if (!in)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (!test)
+    {
+        out = fopen(argv[optind + 1], "wb");
+        if (!out)
+        {
+            perror(argv[optind + 1]);
+            fclose(in);
+            return 1;
+        }
+    }
+
+    while ((len = decode ? readCoded(in, coded, n) : readRecord(in, rec, n)) > 0)
+    {
+        if (decode)
+        {
+            t = now();
+            size = cir_codec_decode(dec, coded, (size_t) len, rec, RECORD_MAX);
+            t_dec += now() - t;
+            if (size == 0)
+            {
+                fprintf(stderr, "record %lu: damaged or refers to a missing record\n", n);
+                failed = 1;
+                break;
+            }
+            if (fwrite(rec, size, 1, out) != 1)
+            {
+                perror(argv[optind + 1]);
+                failed = 1;
+                break;
+            }
+            n++;
+            continue;
+        }
+
+        t = now();
+        size = cir_codec_encode(enc, rec, coded, CIR_CODED_BOUND(RECORD_MAX));
+        t_enc += now() - t;
+        if (size == 0)
+        {
+            fprintf(stderr, "record %lu: could not be coded\n", n);
+            failed = 1;
+            break;
+        }
+        stored += (((const cir_coded_header_t *) coded)->flags & CIR_CODED_STORED) != 0;
+        if (test)
+        {
+            t = now();
+            size = cir_codec_decode(dec, coded, size, back, RECORD_MAX);
+            t_dec += now() - t;
+            if (size != (size_t) len || memcmp(rec, back, size) != 0)
+            {
+                fprintf(stderr, "record %lu (seq %llu): does not decode to the original\n", n,
+                        (unsigned long long) rec->seq);
+                failed = 1;
+                break;
+            }
+        }
+        else if (fwrite(coded, size, 1, out) != 1)
+        {
+            perror(argv[optind + 1]);
+            failed = 1;
+            break;
+        }
+        n++;
+    }
+    if (len < 0)
+    {
+        failed = 1;
+    }
+
+    if (decode)
+    {
+        fprintf(stderr, "%lu records decoded, %llu bytes from %llu, %.1f MB/s\n", n,
+                (unsigned long long) dec->raw_bytes, (unsigned long long) dec->coded_bytes,
+                t_dec > 0.0 ? dec->raw_bytes / t_dec * 1e-6 : 0.0);
+    }
+    else
+    {
+        fprintf(stderr, "%lu records coded, %lu stored, %llu bytes into %llu, ratio %.3f, %.1f MB/s, %.0f records/s\n",
+                n, stored, (unsigned long long) enc->raw_bytes, (unsigned long long) enc->coded_bytes,
+                enc->coded_bytes ? (double) enc->raw_bytes / enc->coded_bytes : 0.0,
+                t_enc > 0.0 ? enc->raw_bytes / t_enc * 1e-6 : 0.0, t_enc > 0.0 ? n / t_enc : 0.0);
+    }
+    if (test)
+    {
+        fprintf(stderr, "%s: %lu records decoded back byte for byte, %.1f MB/s, %.0f records/s\n",
+                failed ? "FAILED" : "OK", n,
+                t_dec > 0.0 ? dec->raw_bytes / t_dec * 1e-6 : 0.0, t_dec > 0.0 ? dec->records / t_dec : 0.0);
+    }
+
+    fclose(in);
+    if (out && fclose(out) != 0)
+    {
+        perror(argv[optind + 1]);
+        failed = 1;
+    }
+    free(enc);
+    free(dec);
+    free(rec);
+    free(back);
+    free(coded);
+    return failed;
+}
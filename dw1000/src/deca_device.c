@@ -34,6 +34,25 @@
 // Frame control maximum length in bytes.
 #define FCTRL_LEN_MAX 2
 
+// Host-owned registers with a write-through shadow copy in dwt_local_data_t, see _dwt_shadowread32()
+#define SHADOW_SYS_CFG    0
+#define SHADOW_SYS_MASK   1
+#define SHADOW_GPIO_MODE  2
+#define SHADOW_PMSC_CTRL0 3
+#define SHADOW_PMSC_CTRL1 4
+#define SHADOW_NUM        5
+
+static const uint8 shadowRegs[SHADOW_NUM][2] = // Register file ID and offset of each 32-bit shadowed register
+{
+    { SYS_CFG_ID,   0 },
+    { SYS_MASK_ID,  0 },
+    { GPIO_CTRL_ID, GPIO_MODE_OFFSET },
+    { PMSC_ID,      PMSC_CTRL0_OFFSET },
+    { PMSC_ID,      PMSC_CTRL1_OFFSET },
+};
+
+// #define DWT_SHADOW_VERIFY       // define so every shadow read is checked against the device, see dwt_shadowmismatches()
+
 // #define DWT_API_ERROR_CHECK     // define so API checks config input parameters
 
 // -------------------------------------------------------------------------------------------------------------------
@@ -49,11 +68,19 @@ void _dwt_configlde(int prf);
 // Load ucode from OTP/ROM
 void _dwt_loaducodefromrom(void);
 // Read non-volatile memory
-uint32 _dwt_otpread(uint32 address);
+uint32 _dwt_otpreadword(uint32 address);
 // Program the non-volatile memory
 uint32 _dwt_otpprogword32(uint32 data, uint16 address);
 // Upload the device configuration into always on memory
 void _dwt_aonarrayupload(void);
+// Compute the PMSC_CTRL0 value for the specified clocks
+static void _dwt_clocksetting(int clocks, uint8 *reg);
+// Queue an Accumulator read in a batch, dropping the dummy octet
+static int _dwt_batchreadacc(dwt_batch_t *batch, uint8 *buffer, uint16 len, uint16 accOffset);
+// Read a host-owned register through its shadow copy
+static uint32 _dwt_shadowread32(int reg);
+// Keep the shadow copies in step with a register write
+static void _dwt_shadowupdate(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer);
 // -------------------------------------------------------------------------------------------------------------------
 
 /*!
@@ -61,8 +88,8 @@ void _dwt_aonarrayupload(void);
  */
 
 // -------------------------------------------------------------------------------------------------------------------
-// Structure to hold device data
-typedef struct
+// Structure to hold device data, the dwt_ctx_t of the context API
+typedef struct dwt_ctx
 {
     uint32      partID ;            // IC Part ID - read during initialisation
     uint32      lotID ;             // IC Lot ID - read during initialisation
@@ -79,10 +106,13 @@ typedef struct
     dwt_cb_t    cbRxOk;             // Callback for RX good frame event
     dwt_cb_t    cbRxTo;             // Callback for RX timeout events
     dwt_cb_t    cbRxErr;            // Callback for RX error events
+    uint32      shadow[SHADOW_NUM]; // Write-through copies of host-owned registers
+    uint8       shadowValid;        // Bit n set when shadow[n] holds the device value
+    uint32      shadowMismatch;     // Stale shadow copies found with DWT_SHADOW_VERIFY
 } dwt_local_data_t ;
 
 static dwt_local_data_t dw1000local[DWT_NUM_DW_DEV] ; // Static local device data, can be an array to support multiple DW1000 testing applications/platforms
-static dwt_local_data_t *pdw1000local = dw1000local ; // Static local data structure pointer
+static __thread dwt_local_data_t *pdw1000local = dw1000local ; // Local data structure pointer, per thread so that each thread can drive its own device
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_setlocaldataptr()
@@ -99,7 +129,7 @@ static dwt_local_data_t *pdw1000local = dw1000local ; // Static local data struc
 int dwt_setlocaldataptr(unsigned int index)
 {
     // Check the index is within the array bounds
-    if (DWT_NUM_DW_DEV > index) // return error if index outside the array bounds
+    if (index >= DWT_NUM_DW_DEV) // return error if index outside the array bounds
     {
         return DWT_ERROR ;
     }
@@ -139,7 +169,7 @@ int dwt_setlocaldataptr(unsigned int index)
 #define VTEMP_ADDRESS  (0x09)
 #define XTRIM_ADDRESS  (0x1E)
 
-int dwt_initialise(uint16 config)
+static int _dwt_initialise(uint16 config)
 {
     uint16 otp_addr = 0;
     uint32 ldo_tune = 0;
@@ -147,6 +177,8 @@ int dwt_initialise(uint16 config)
     pdw1000local->dblbuffon = 0; // Double buffer mode off by default
     pdw1000local->wait4resp = 0;
     pdw1000local->sleep_mode = 0;
+    pdw1000local->shadowValid = 0; // Nothing is known about the device registers yet
+    pdw1000local->shadowMismatch = 0;
 
     pdw1000local->cbTxDone = NULL;
     pdw1000local->cbRxOk = NULL;
@@ -162,17 +194,17 @@ int dwt_initialise(uint16 config)
     // Make sure the device is completely reset before starting initialisation
     dwt_softreset();
 
-    _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: set system clock to XTI - this is necessary to make sure the values read by _dwt_otpread are reliable
+    _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: set system clock to XTI - this is necessary to make sure the values read by _dwt_otpreadword are reliable
 
     // Configure the CPLL lock detect
     dwt_write8bitoffsetreg(EXT_SYNC_ID, EC_CTRL_OFFSET, EC_CTRL_PLLLCK);
 
     // Read OTP revision number
-    otp_addr = _dwt_otpread(XTRIM_ADDRESS) & 0xffff;        // Read 32 bit value, XTAL trim val is in low octet-0 (5 bits)
+    otp_addr = _dwt_otpreadword(XTRIM_ADDRESS) & 0xffff;        // Read 32 bit value, XTAL trim val is in low octet-0 (5 bits)
     pdw1000local->otprev = (otp_addr >> 8) & 0xff;            // OTP revision is next byte
 
     // Load LDO tune from OTP and kick it if there is a value actually programmed.
-    ldo_tune = _dwt_otpread(LDOTUNE_ADDRESS);
+    ldo_tune = _dwt_otpreadword(LDOTUNE_ADDRESS);
     if((ldo_tune & 0xFF) != 0)
     {
         // Kick LDO tune
@@ -181,8 +213,8 @@ int dwt_initialise(uint16 config)
     }
 
     // Load Part and Lot ID from OTP
-    pdw1000local->partID = _dwt_otpread(PARTID_ADDRESS);
-    pdw1000local->lotID = _dwt_otpread(LOTID_ADDRESS);
+    pdw1000local->partID = _dwt_otpreadword(PARTID_ADDRESS);
+    pdw1000local->lotID = _dwt_otpreadword(LOTID_ADDRESS);
 
     // XTAL trim value is set in OTP for DW1000 module and EVK/TREK boards but that might not be the case in a custom design
     pdw1000local->init_xtrim = otp_addr & 0x1F;
@@ -201,7 +233,7 @@ int dwt_initialise(uint16 config)
     }
     else // Should disable the LDERUN enable bit in 0x36, 0x4
     {
-        uint16 rega = dwt_read16bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET+1) ;
+        uint16 rega = (uint16)(_dwt_shadowread32(SHADOW_PMSC_CTRL1) >> 8) ;
         rega &= 0xFDFF ; // Clear LDERUN bit
         dwt_write16bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET+1, rega) ;
     }
@@ -212,7 +244,7 @@ int dwt_initialise(uint16 config)
     dwt_write8bitoffsetreg(AON_ID, AON_CFG1_OFFSET, 0x00);
 
     // Read system register / store local copy
-    pdw1000local->sysCFGreg = dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
+    pdw1000local->sysCFGreg = _dwt_shadowread32(SHADOW_SYS_CFG) ; // Read sysconfig register
 
     return DWT_SUCCESS ;
 
@@ -231,7 +263,7 @@ int dwt_initialise(uint16 config)
  *
  * returns the read OTP revision value
  */
-uint8 dwt_otprevision(void)
+static uint8 _dwt_otprevision(void)
 {
     return pdw1000local->otprev ;
 }
@@ -248,7 +280,7 @@ uint8 dwt_otprevision(void)
  *
  * no return value
  */
-void dwt_setfinegraintxseq(int enable)
+static void _dwt_setfinegraintxseq(int enable)
 {
     if (enable)
     {
@@ -277,9 +309,9 @@ void dwt_setfinegraintxseq(int enable)
  *
  * no return value
  */
-void dwt_setlnapamode(int lna, int pa)
+static void _dwt_setlnapamode(int lna, int pa)
 {
-    uint32 gpio_mode = dwt_read32bitoffsetreg(GPIO_CTRL_ID, GPIO_MODE_OFFSET);
+    uint32 gpio_mode = _dwt_shadowread32(SHADOW_GPIO_MODE);
     gpio_mode &= ~(GPIO_MSGP4_MASK | GPIO_MSGP5_MASK | GPIO_MSGP6_MASK);
     if (lna)
     {
@@ -305,7 +337,7 @@ void dwt_setlnapamode(int lna, int pa)
  *
  * no return value
  */
-void dwt_setgpiodirection(uint32 gpioNum, uint32 direction)
+static void _dwt_setgpiodirection(uint32 gpioNum, uint32 direction)
 {
     uint8 buf[GPIO_DIR_LEN];
     uint32 command = direction | gpioNum;
@@ -330,7 +362,7 @@ void dwt_setgpiodirection(uint32 gpioNum, uint32 direction)
  *
  * no return value
  */
-void dwt_setgpiovalue(uint32 gpioNum, uint32 value)
+static void _dwt_setgpiovalue(uint32 gpioNum, uint32 value)
 {
     uint8 buf[GPIO_DOUT_LEN];
     uint32 command = value | gpioNum;
@@ -355,7 +387,7 @@ void dwt_setgpiovalue(uint32 gpioNum, uint32 value)
  *
  * returns the 32 bit part ID value as programmed in the factory
  */
-uint32 dwt_getpartid(void)
+static uint32 _dwt_getpartid(void)
 {
     return pdw1000local->partID;
 }
@@ -373,7 +405,7 @@ uint32 dwt_getpartid(void)
  *
  * returns the 32 bit lot ID value as programmed in the factory
  */
-uint32 dwt_getlotid(void)
+static uint32 _dwt_getlotid(void)
 {
     return pdw1000local->lotID;
 }
@@ -389,7 +421,7 @@ uint32 dwt_getlotid(void)
  *
  * returns the read value which for DW1000 is 0xDECA0130
  */
-uint32 dwt_readdevid(void)
+static uint32 _dwt_readdevid(void)
 {
     return dwt_read32bitoffsetreg(DEV_ID_ID,0);
 }
@@ -408,7 +440,7 @@ uint32 dwt_readdevid(void)
  *
  * no return value
  */
-void dwt_configuretxrf(dwt_txconfig_t *config)
+static void _dwt_configuretxrf(dwt_txconfig_t *config)
 {
 
     // Configure RF TX PG_DELAY
@@ -434,7 +466,7 @@ void dwt_configuretxrf(dwt_txconfig_t *config)
  *
  * no return value
  */
-void dwt_configure(dwt_config_t *config)
+static void _dwt_configure(dwt_config_t *config)
 {
     uint8 nsSfd_result  = 0;
     uint8 useDWnsSFD = 0;
@@ -573,7 +605,7 @@ void dwt_configure(dwt_config_t *config)
  *
  * no return value
  */
-void dwt_setrxantennadelay(uint16 rxDelay)
+static void _dwt_setrxantennadelay(uint16 rxDelay)
 {
     // Set the RX antenna delay for auto TX timestamp adjustment
     dwt_write16bitoffsetreg(LDE_IF_ID, LDE_RXANTD_OFFSET, rxDelay);
@@ -592,7 +624,7 @@ void dwt_setrxantennadelay(uint16 rxDelay)
  *
  * no return value
  */
-void dwt_settxantennadelay(uint16 txDelay)
+static void _dwt_settxantennadelay(uint16 txDelay)
 {
     // Set the TX antenna delay for auto TX timestamp adjustment
     dwt_write16bitoffsetreg(TX_ANTD_ID, TX_ANTD_OFFSET, txDelay);
@@ -618,7 +650,7 @@ void dwt_settxantennadelay(uint16 txDelay)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error
  */
-int dwt_writetxdata(uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOffset)
+static int _dwt_writetxdata(uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOffset)
 {
 #ifdef DWT_API_ERROR_CHECK
     assert(txFrameLength >= 2);
@@ -655,7 +687,7 @@ int dwt_writetxdata(uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOf
  *
  * no return value
  */
-void dwt_writetxfctrl(uint16 txFrameLength, uint16 txBufferOffset, int ranging)
+static void _dwt_writetxfctrl(uint16 txFrameLength, uint16 txBufferOffset, int ranging)
 {
 
 #ifdef DWT_API_ERROR_CHECK
@@ -683,7 +715,7 @@ void dwt_writetxfctrl(uint16 txFrameLength, uint16 txBufferOffset, int ranging)
  *
  * no return value
  */
-void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+static void _dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
 {
     dwt_readfromdevice(RX_BUFFER_ID,rxBufferOffset,length,buffer) ;
 }
@@ -705,7 +737,7 @@ void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
  *
  * no return value
  */
-void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
+static void _dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
 {
     // Force on the ACC clocks if we are sequenced
     _dwt_enableclocks(READ_ACC_ON);
@@ -715,6 +747,80 @@ void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
     _dwt_enableclocks(READ_ACC_OFF); // Revert clocks back
 }
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readaccdatabulk()
+ *
+ * @brief This is used to read a whole window of the Accumulator buffer with the ACC clocks forced on only once.
+ *        The window is read in as few chunks as the platform's maximum SPI access length allows and all chunks are
+ *        submitted together with the clock switching as a batch, see dwt_batchsubmit().
+ *
+ * NOTE: Unlike dwt_readaccdata(), the dummy octet of each chunk is clocked in as part of the SPI header and dropped, so
+ *       'buffer' receives exactly 'len' accumulator bytes.
+ *
+ * input parameters
+ * @param buffer - the buffer into which the data will be read, at least 'len' bytes
+ * @param len - the length of data to read (in bytes)
+ * @param accOffset - the offset in the acc buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+static int _dwt_readaccdatabulk(uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    dwt_batch_t batch;
+    uint32 pmsc = _dwt_shadowread32(SHADOW_PMSC_CTRL0);
+    uint8 accon[2];
+    uint8 accoff[2];
+    uint32 chunk = spimaxlength() - 4; // 3 header bytes and the dummy octet
+    int status = DWT_SUCCESS;
+
+    // Compute both PMSC_CTRL0 settings from the shadow copy
+    accon[0] = (uint8) pmsc;
+    accon[1] = (uint8) (pmsc >> 8);
+    _dwt_clocksetting(READ_ACC_ON, accon);
+    accoff[0] = accon[0];
+    accoff[1] = accon[1];
+    _dwt_clocksetting(READ_ACC_OFF, accoff);
+
+    dwt_batchinit(&batch);
+
+    // Force on the ACC clocks, lower byte first
+    dwt_batchwritetodevice(&batch, PMSC_ID, PMSC_CTRL0_OFFSET, 1, &accon[0]);
+    dwt_batchwritetodevice(&batch, PMSC_ID, 0x1, 1, &accon[1]);
+
+    while (len > 0)
+    {
+        uint16 toRead = (len > chunk) ? (uint16) chunk : len;
+
+        // Keep room for the two accesses reverting the clocks
+        if (batch.count >= DWT_BATCH_MAX_ACCESSES - 2)
+        {
+            if (dwt_batchsubmit(&batch) != DWT_SUCCESS)
+            {
+                status = DWT_ERROR;
+            }
+        }
+
+        _dwt_batchreadacc(&batch, buffer, toRead, accOffset);
+
+        buffer += toRead;
+        accOffset += toRead;
+        len -= toRead;
+    }
+
+    // Revert clocks back
+    dwt_batchwritetodevice(&batch, PMSC_ID, PMSC_CTRL0_OFFSET, 1, &accoff[0]);
+    dwt_batchwritetodevice(&batch, PMSC_ID, 0x1, 1, &accoff[1]);
+
+    if (dwt_batchsubmit(&batch) != DWT_SUCCESS)
+    {
+        status = DWT_ERROR;
+    }
+
+    return status;
+} // end dwt_readaccdatabulk()
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readcarrierintegrator()
  *
@@ -730,9 +836,9 @@ void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
  */
 
 #define B20_SIGN_EXTEND_TEST (0x00100000UL)
-#define B20_SIGN_EXTEND_MASK (0xFFF00000UL)
+#define B20_SIGN_EXTEND_MASK (~0x000FFFFFUL) // all the upper bits of regval, which is 64 bits wide on 64-bit hosts
 
-int32 dwt_readcarrierintegrator(void)
+static int32 _dwt_readcarrierintegrator(void)
 {
     uint32  regval = 0 ;
     int     j ;
@@ -765,7 +871,7 @@ int32 dwt_readcarrierintegrator(void)
  *
  * no return value
  */
-void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
+static void _dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
 {
     // Read the HW FP index
     diagnostics->firstPath = dwt_read16bitoffsetreg(RX_TIME_ID, RX_TIME_FP_INDEX_OFFSET);
@@ -793,7 +899,7 @@ void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
  *
  * no return value
  */
-void dwt_readtxtimestamp(uint8 * timestamp)
+static void _dwt_readtxtimestamp(uint8 * timestamp)
 {
     dwt_readfromdevice(TX_TIME_ID, TX_TIME_TX_STAMP_OFFSET, TX_TIME_TX_STAMP_LEN, timestamp) ; // Read bytes directly into buffer
 }
@@ -809,7 +915,7 @@ void dwt_readtxtimestamp(uint8 * timestamp)
  *
  * returns high 32-bits of TX timestamp
  */
-uint32 dwt_readtxtimestamphi32(void)
+static uint32 _dwt_readtxtimestamphi32(void)
 {
     return dwt_read32bitoffsetreg(TX_TIME_ID, 1); // Offset is 1 to get the 4 upper bytes out of 5
 }
@@ -825,7 +931,7 @@ uint32 dwt_readtxtimestamphi32(void)
  *
  * returns low 32-bits of TX timestamp
  */
-uint32 dwt_readtxtimestamplo32(void)
+static uint32 _dwt_readtxtimestamplo32(void)
 {
     return dwt_read32bitreg(TX_TIME_ID); // Read TX TIME as a 32-bit register to get the 4 lower bytes out of 5
 }
@@ -842,7 +948,7 @@ uint32 dwt_readtxtimestamplo32(void)
  *
  * no return value
  */
-void dwt_readrxtimestamp(uint8 * timestamp)
+static void _dwt_readrxtimestamp(uint8 * timestamp)
 {
     dwt_readfromdevice(RX_TIME_ID, RX_TIME_RX_STAMP_OFFSET, RX_TIME_RX_STAMP_LEN, timestamp) ; // Get the adjusted time of arrival
 }
@@ -858,7 +964,7 @@ void dwt_readrxtimestamp(uint8 * timestamp)
  *
  * returns high 32-bits of RX timestamp
  */
-uint32 dwt_readrxtimestamphi32(void)
+static uint32 _dwt_readrxtimestamphi32(void)
 {
     return dwt_read32bitoffsetreg(RX_TIME_ID, 1); // Offset is 1 to get the 4 upper bytes out of 5
 }
@@ -874,7 +980,7 @@ uint32 dwt_readrxtimestamphi32(void)
  *
  * returns low 32-bits of RX timestamp
  */
-uint32 dwt_readrxtimestamplo32(void)
+static uint32 _dwt_readrxtimestamplo32(void)
 {
     return dwt_read32bitreg(RX_TIME_ID); // Read RX TIME as a 32-bit register to get the 4 lower bytes out of 5
 }
@@ -890,7 +996,7 @@ uint32 dwt_readrxtimestamplo32(void)
  *
  * returns high 32-bits of system time timestamp
  */
-uint32 dwt_readsystimestamphi32(void)
+static uint32 _dwt_readsystimestamphi32(void)
 {
     return dwt_read32bitoffsetreg(SYS_TIME_ID, 1); // Offset is 1 to get the 4 upper bytes out of 5
 }
@@ -908,63 +1014,51 @@ uint32 dwt_readsystimestamphi32(void)
  *
  * no return value
  */
-void dwt_readsystime(uint8 * timestamp)
+static void _dwt_readsystime(uint8 * timestamp)
 {
     dwt_readfromdevice(SYS_TIME_ID, SYS_TIME_OFFSET, SYS_TIME_LEN, timestamp) ;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_writetodevice()
+ * @fn _dwt_composeheader()
  *
- * @brief  this function is used to write to the DW1000 device registers
- * Notes:
- *        1. Firstly we create a header (the first byte is a header byte)
+ * @brief  this function composes the one to three byte SPI header used by dwt_writetodevice() and dwt_readfromdevice()
  *        a. check if sub index is used, if subindexing is used - set bit-6 to 1 to signify that the sub-index address follows the register index byte
  *        b. set bit-7 (or with 0x80) for write operation
  *        c. if extended sub address index is used (i.e. if index > 127) set bit-7 of the first sub-index byte following the first header byte
  *
- *        2. Write the header followed by the data bytes to the DW1000 device
- *
- *
  * input parameters:
+ * @param header        - buffer of at least 3 bytes receiving the header
+ * @param operation     - 0x80 for a WRITE operation, 0x00 for a READ operation
  * @param recordNumber  - ID of register file or buffer being accessed
  * @param index         - byte index into register file or buffer being accessed
- * @param length        - number of bytes being written
- * @param buffer        - pointer to buffer containing the 'length' bytes to be written
+ * @param length        - number of bytes being accessed
  *
  * output parameters
  *
- * no return value
+ * returns the length of the header
  */
-void dwt_writetodevice
-(
-    uint16      recordNumber,
-    uint16      index,
-    uint32      length,
-    const uint8 *buffer
-)
+static int _dwt_composeheader(uint8 *header, uint8 operation, uint16 recordNumber, uint16 index, uint32 length)
 {
-    uint8 header[3] ; // Buffer to compose header in
-    int   cnt = 0; // Counter for length of header
+    int cnt = 0; // Counter for length of header
 #ifdef DWT_API_ERROR_CHECK
     assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
 #endif
 
-    // Write message header selecting WRITE operation and addresses as appropriate (this is one to three bytes long)
     if (index == 0) // For index of 0, no sub-index is required
     {
-        header[cnt++] = 0x80 | recordNumber ; // Bit-7 is WRITE operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
+        header[cnt++] = (uint8)(operation | recordNumber) ; // Bit-7 is operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
     }
     else
     {
 #ifdef DWT_API_ERROR_CHECK
         assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
 #endif
-        header[cnt++] = 0xC0 | recordNumber ; // Bit-7 is WRITE operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
+        header[cnt++] = (uint8)(operation | 0x40 | recordNumber) ; // Bit-7 is operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
 
         if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
         {
-            header[cnt++] = (uint8)index ; // Bit-7 zero means no extension, bits 6-0 is index.
+            header[cnt++] = (uint8) index ; // Bit-7 zero means no extension, bits 6-0 is index.
         }
         else
         {
@@ -973,6 +1067,47 @@ void dwt_writetodevice
         }
     }
 
+    (void) length;
+    return cnt;
+} // end _dwt_composeheader()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_writetodevice()
+ *
+ * @brief  this function is used to write to the DW1000 device registers
+ * Notes:
+ *        1. Firstly we create a header (the first byte is a header byte)
+ *        a. check if sub index is used, if subindexing is used - set bit-6 to 1 to signify that the sub-index address follows the register index byte
+ *        b. set bit-7 (or with 0x80) for write operation
+ *        c. if extended sub address index is used (i.e. if index > 127) set bit-7 of the first sub-index byte following the first header byte
+ *
+ *        2. Write the header followed by the data bytes to the DW1000 device
+ *
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being written
+ * @param buffer        - pointer to buffer containing the 'length' bytes to be written
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_writetodevice(
+    uint16      recordNumber,
+    uint16      index,
+    uint32      length,
+    const uint8 *buffer
+)
+{
+    uint8 header[3] ; // Buffer to compose header in
+    int   cnt ; // Length of header
+
+    cnt = _dwt_composeheader(header, 0x80, recordNumber, index, length) ; // Bit-7 is WRITE operation
+
+    _dwt_shadowupdate(recordNumber, index, length, buffer);
+
     // Write it to the SPI
     writetospi(cnt,header,length,buffer);
 } // end dwt_writetodevice()
@@ -1000,8 +1135,7 @@ void dwt_writetodevice
  *
  * no return value
  */
-void dwt_readfromdevice
-(
+static void _dwt_readfromdevice(
     uint16  recordNumber,
     uint16  index,
     uint32  length,
@@ -1009,37 +1143,131 @@ void dwt_readfromdevice
 )
 {
     uint8 header[3] ; // Buffer to compose header in
-    int   cnt = 0; // Counter for length of header
-#ifdef DWT_API_ERROR_CHECK
-    assert(recordNumber <= 0x3F); // Record number is limited to 6-bits.
-#endif
+    int   cnt ; // Length of header
 
-    // Write message header selecting READ operation and addresses as appropriate (this is one to three bytes long)
-    if (index == 0) // For index of 0, no sub-index is required
-    {
-        header[cnt++] = (uint8) recordNumber ; // Bit-7 zero is READ operation, bit-6 zero=NO sub-addressing, bits 5-0 is reg file id
-    }
-    else
+    cnt = _dwt_composeheader(header, 0x00, recordNumber, index, length) ; // Bit-7 zero is READ operation
+
+    // Do the read from the SPI
+    readfromspi(cnt, header, length, buffer);  // result is stored in the buffer
+} // end dwt_readfromdevice()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_shadowupdate()
+ *
+ * @brief  this function is called for every register write, it patches the shadow copies the write overlaps and marks
+ *         a shadow copy valid once a write has covered all four of its bytes
+ *
+ * input parameters:
+ * @param recordNumber  - ID of register file or buffer being written
+ * @param index         - byte index into register file or buffer being written
+ * @param length        - number of bytes being written
+ * @param buffer        - the data being written
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_shadowupdate(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    int reg;
+    int j;
+
+    for (reg = 0 ; reg < SHADOW_NUM ; reg++)
     {
-#ifdef DWT_API_ERROR_CHECK
-        assert((index <= 0x7FFF) && ((index + length) <= 0x7FFF)); // Index and sub-addressable area are limited to 15-bits.
-#endif
-        header[cnt++] = (uint8)(0x40 | recordNumber) ; // Bit-7 zero is READ operation, bit-6 one=sub-address follows, bits 5-0 is reg file id
+        uint32 first = shadowRegs[reg][1];
 
-        if (index <= 127) // For non-zero index < 127, just a single sub-index byte is required
+        if ((shadowRegs[reg][0] != recordNumber) || (index >= first + 4) || (index + length <= first))
         {
-            header[cnt++] = (uint8) index ; // Bit-7 zero means no extension, bits 6-0 is index.
+            continue;
         }
-        else
+
+        if ((index <= first) && (index + length >= first + 4))
         {
-            header[cnt++] = 0x80 | (uint8)(index) ; // Bit-7 one means extended index, bits 6-0 is low seven bits of index.
-            header[cnt++] =  (uint8) (index >> 7) ; // 8-bit value = high eight bits of index.
+            pdw1000local->shadowValid |= (uint8)(1 << reg);
+        }
+        else if ((pdw1000local->shadowValid & (1 << reg)) == 0)
+        {
+            continue; // A partial write to an unknown register leaves it unknown
+        }
+
+        for (j = 0 ; j < 4 ; j++)
+        {
+            if ((first + j >= index) && (first + j < index + length))
+            {
+                pdw1000local->shadow[reg] &= ~((uint32) 0xff << (8 * j));
+                pdw1000local->shadow[reg] |= (uint32) buffer[first + j - index] << (8 * j);
+            }
         }
     }
+} // end _dwt_shadowupdate()
 
-    // Do the read from the SPI
-    readfromspi(cnt, header, length, buffer);  // result is stored in the buffer
-} // end dwt_readfromdevice()
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_shadowread32()
+ *
+ * @brief  this function returns the value of a host-owned register for a read-modify-write sequence. The DW1000 never
+ *         changes these registers on its own, so the last value written is returned without an SPI read. The device is
+ *         read when the shadow copy is unknown (after a reset or sleep) or while the auto-sleep bits are set, as the
+ *         device may have slept and woken without the host knowing. With DWT_SHADOW_VERIFY defined every read goes to
+ *         the device and disagreements are counted, see dwt_shadowmismatches().
+ *
+ * input parameters:
+ * @param reg - one of the SHADOW_xxx indices
+ *
+ * output parameters
+ *
+ * returns the 32-bit register value
+ */
+static uint32 _dwt_shadowread32(int reg)
+{
+    uint32 regval;
+
+    if ((pdw1000local->shadowValid & (1 << SHADOW_PMSC_CTRL1)) == 0)
+    {
+        pdw1000local->shadow[SHADOW_PMSC_CTRL1] = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
+        pdw1000local->shadowValid |= (uint8)(1 << SHADOW_PMSC_CTRL1);
+        if (reg == SHADOW_PMSC_CTRL1)
+        {
+            return pdw1000local->shadow[reg];
+        }
+    }
+
+    if (((pdw1000local->shadowValid & (1 << reg)) == 0) ||
+        ((pdw1000local->shadow[SHADOW_PMSC_CTRL1] & (PMSC_CTRL1_ATXSLP | PMSC_CTRL1_ARXSLP)) != 0))
+    {
+        pdw1000local->shadow[reg] = dwt_read32bitoffsetreg(shadowRegs[reg][0], shadowRegs[reg][1]);
+        pdw1000local->shadowValid |= (uint8)(1 << reg);
+        return pdw1000local->shadow[reg];
+    }
+
+#ifdef DWT_SHADOW_VERIFY
+    regval = dwt_read32bitoffsetreg(shadowRegs[reg][0], shadowRegs[reg][1]);
+    if (regval != pdw1000local->shadow[reg])
+    {
+        pdw1000local->shadowMismatch++;
+        pdw1000local->shadow[reg] = regval;
+    }
+#endif
+
+    regval = pdw1000local->shadow[reg];
+    return regval;
+} // end _dwt_shadowread32()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_shadowmismatches()
+ *
+ * @brief  this function returns the number of times a shadowed register was found to differ from the device. Only
+ *         counted when the driver is built with DWT_SHADOW_VERIFY, otherwise always 0.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns the number of stale shadow copies found since dwt_initialise()
+ */
+static uint32 _dwt_shadowmismatches(void)
+{
+    return pdw1000local->shadowMismatch;
+}
 
 
 
@@ -1056,7 +1284,7 @@ void dwt_readfromdevice
  *
  * returns 32 bit register value
  */
-uint32 dwt_read32bitoffsetreg(int regFileID,int regOffset)
+static uint32 _dwt_read32bitoffsetreg(int regFileID,int regOffset)
 {
     uint32  regval = 0 ;
     int     j ;
@@ -1085,7 +1313,7 @@ uint32 dwt_read32bitoffsetreg(int regFileID,int regOffset)
  *
  * returns 16 bit register value
  */
-uint16 dwt_read16bitoffsetreg(int regFileID,int regOffset)
+static uint16 _dwt_read16bitoffsetreg(int regFileID,int regOffset)
 {
     uint16  regval = 0 ;
     uint8   buffer[2] ;
@@ -1110,7 +1338,7 @@ uint16 dwt_read16bitoffsetreg(int regFileID,int regOffset)
  *
  * returns 8-bit register value
  */
-uint8 dwt_read8bitoffsetreg(int regFileID, int regOffset)
+static uint8 _dwt_read8bitoffsetreg(int regFileID, int regOffset)
 {
     uint8 regval;
 
@@ -1133,7 +1361,7 @@ uint8 dwt_read8bitoffsetreg(int regFileID, int regOffset)
  *
  * no return value
  */
-void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval)
+static void _dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval)
 {
     dwt_writetodevice(regFileID, regOffset, 1, &regval);
 }
@@ -1152,7 +1380,7 @@ void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval)
  *
  * no return value
  */
-void dwt_write16bitoffsetreg(int regFileID,int regOffset,uint16 regval)
+static void _dwt_write16bitoffsetreg(int regFileID,int regOffset,uint16 regval)
 {
     uint8   buffer[2] ;
 
@@ -1176,7 +1404,7 @@ void dwt_write16bitoffsetreg(int regFileID,int regOffset,uint16 regval)
  *
  * no return value
  */
-void dwt_write32bitoffsetreg(int regFileID,int regOffset,uint32 regval)
+static void _dwt_write32bitoffsetreg(int regFileID,int regOffset,uint32 regval)
 {
     int     j ;
     uint8   buffer[4] ;
@@ -1191,75 +1419,364 @@ void dwt_write32bitoffsetreg(int regFileID,int regOffset,uint32 regval)
 } // end dwt_write32bitoffsetreg()
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_enableframefilter()
+ * @fn dwt_batchinit()
  *
- * @brief This is used to enable the frame filtering - (the default option is to
- * accept any data and ACK frames with correct destination address
+ * @brief  this function empties a batch so that register accesses can be queued into it
  *
- * input parameters
- * @param - bitmask - enables/disables the frame filtering options according to
- *      DWT_FF_NOTYPE_EN        0x000   no frame types allowed
- *      DWT_FF_COORD_EN         0x002   behave as coordinator (can receive frames with no destination address (PAN ID has to match))
- *      DWT_FF_BEACON_EN        0x004   beacon frames allowed
- *      DWT_FF_DATA_EN          0x008   data frames allowed
- *      DWT_FF_ACK_EN           0x010   ack frames allowed
- *      DWT_FF_MAC_EN           0x020   mac control frames allowed
- *      DWT_FF_RSVD_EN          0x040   reserved frame types allowed
+ * input parameters:
+ * @param batch - the batch to initialise
  *
  * output parameters
  *
  * no return value
  */
-void dwt_enableframefilter(uint16 enable)
+void dwt_batchinit(dwt_batch_t *batch)
 {
-    uint32 sysconfig = SYS_CFG_MASK & dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
+    batch->count = 0;
+    batch->overflow = 0;
+}
 
-    if(enable)
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_batchqueue()
+ *
+ * @brief  this function appends one access to a batch
+ *
+ * input parameters:
+ * @param batch         - the batch to queue the access in
+ * @param operation     - 0x80 for a WRITE operation, 0x00 for a READ operation
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being accessed
+ * @param buffer        - data to write, or buffer receiving the read data
+ *
+ * output parameters
+ *
+ * returns the slot of the access in the batch, or -1 if the batch is full
+ */
+static int _dwt_batchqueue(dwt_batch_t *batch, uint8 operation, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    dwt_spiaccess_t *access;
+    int slot = batch->count;
+
+    if (slot >= DWT_BATCH_MAX_ACCESSES)
     {
-        // Enable frame filtering and configure frame types
-        sysconfig &= ~(SYS_CFG_FF_ALL_EN); // Clear all
-        sysconfig |= (enable & SYS_CFG_FF_ALL_EN) | SYS_CFG_FFE;
+        batch->overflow = 1;
+        return -1;
     }
-    else
+
+    if ((operation != 0) && (buffer != NULL))
     {
-        sysconfig &= ~(SYS_CFG_FFE);
+        _dwt_shadowupdate(recordNumber, index, length, buffer);
     }
 
-    pdw1000local->sysCFGreg = sysconfig ;
-    dwt_write32bitreg(SYS_CFG_ID,sysconfig) ;
+    access = &batch->access[slot];
+    access->headerLength = _dwt_composeheader(access->header, operation, recordNumber, index, length);
+    access->write = (operation != 0);
+    access->length = length;
+    access->buffer = buffer;
+    batch->result[slot] = NULL;
+    batch->count++;
+
+    return slot;
+}
+
+static int _dwt_batchwritetodevice(dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    return (_dwt_batchqueue(batch, 0x80, recordNumber, index, length, (uint8 *) buffer) < 0) ? DWT_ERROR : DWT_SUCCESS;
+}
+
+static int _dwt_batchreadfromdevice(dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    return (_dwt_batchqueue(batch, 0x00, recordNumber, index, length, buffer) < 0) ? DWT_ERROR : DWT_SUCCESS;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_setpanid()
+ * @fn _dwt_batchreadreg()
  *
- * @brief This is used to set the PAN ID
+ * @brief  this function queues a 1, 2 or 4 byte register read whose value is unpacked into 'regval' on submission
  *
- * input parameters
- * @param panID - this is the PAN ID
+ * input parameters:
+ * @param batch     - the batch to queue the access in
+ * @param regFileID - ID of register file or buffer being accessed
+ * @param regOffset - the index into register file or buffer being accessed
+ * @param width     - register width in bytes
+ * @param regval    - pointer to a uint8, uint16 or uint32 matching 'width'
  *
  * output parameters
  *
- * no return value
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
  */
-void dwt_setpanid(uint16 panID)
+static int _dwt_batchreadreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 width, void *regval)
 {
-    // PAN ID is high 16 bits of register
-    dwt_write16bitoffsetreg(PANADR_ID, PANADR_PAN_ID_OFFSET, panID);
+    int slot = _dwt_batchqueue(batch, 0x00, regFileID, regOffset, width, NULL);
+
+    if (slot < 0)
+    {
+        return DWT_ERROR;
+    }
+
+    batch->access[slot].buffer = batch->regval[slot];
+    batch->result[slot] = regval;
+    batch->resultWidth[slot] = width;
+
+    return DWT_SUCCESS;
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn dwt_setaddress16()
+ * @fn _dwt_batchwritereg()
  *
- * @brief This is used to set 16-bit (short) address
+ * @brief  this function queues a 1, 2 or 4 byte register write, the value is copied into the batch
  *
- * input parameters
- * @param shortAddress - this sets the 16 bit short address
+ * input parameters:
+ * @param batch     - the batch to queue the access in
+ * @param regFileID - ID of register file or buffer being accessed
+ * @param regOffset - the index into register file or buffer being accessed
+ * @param width     - register width in bytes
+ * @param regval    - the value to write
  *
  * output parameters
  *
- * no return value
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
  */
-void dwt_setaddress16(uint16 shortAddress)
+static int _dwt_batchwritereg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 width, uint32 regval)
+{
+    int slot = _dwt_batchqueue(batch, 0x80, regFileID, regOffset, width, NULL);
+    int j;
+
+    if (slot < 0)
+    {
+        return DWT_ERROR;
+    }
+
+    for ( j = 0 ; j < width ; j++ )
+    {
+        batch->regval[slot][j] = regval & 0xff ;
+        regval >>= 8 ;
+    }
+    batch->access[slot].buffer = batch->regval[slot];
+    _dwt_shadowupdate(regFileID, regOffset, width, batch->regval[slot]);
+
+    return DWT_SUCCESS;
+}
+
+static int _dwt_batchread32bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint32 *regval)
+{
+    return _dwt_batchreadreg(batch, regFileID, regOffset, 4, regval);
+}
+
+static int _dwt_batchread16bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint16 *regval)
+{
+    return _dwt_batchreadreg(batch, regFileID, regOffset, 2, regval);
+}
+
+static int _dwt_batchread8bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 *regval)
+{
+    return _dwt_batchreadreg(batch, regFileID, regOffset, 1, regval);
+}
+
+static int _dwt_batchwrite32bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint32 regval)
+{
+    return _dwt_batchwritereg(batch, regFileID, regOffset, 4, regval);
+}
+
+static int _dwt_batchwrite16bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint16 regval)
+{
+    return _dwt_batchwritereg(batch, regFileID, regOffset, 2, regval);
+}
+
+static int _dwt_batchwrite8bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 regval)
+{
+    return _dwt_batchwritereg(batch, regFileID, regOffset, 1, regval);
+}
+
+static int _dwt_batchreadrxdata(dwt_batch_t *batch, uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+{
+    return dwt_batchreadfromdevice(batch, RX_BUFFER_ID, rxBufferOffset, length, buffer);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_batchreadacc()
+ *
+ * @brief  this function queues an Accumulator read. A zero byte is appended to the header so the dummy octet output by
+ *         the DW1000 is clocked in with the header and never reaches 'buffer'. ACC clocks must be forced on by the caller.
+ *
+ * input parameters:
+ * @param batch     - the batch to queue the access in
+ * @param buffer    - the buffer into which the data will be read
+ * @param len       - the length of data to read (in bytes)
+ * @param accOffset - the offset in the acc buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+static int _dwt_batchreadacc(dwt_batch_t *batch, uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    int slot = _dwt_batchqueue(batch, 0x00, ACC_MEM_ID, accOffset, len, buffer);
+
+    if (slot < 0)
+    {
+        return DWT_ERROR;
+    }
+
+    batch->access[slot].header[batch->access[slot].headerLength++] = 0; // Dummy octet
+
+    return DWT_SUCCESS;
+}
+
+static int _dwt_batchreadrxinfo(dwt_batch_t *batch, dwt_rxinfo_t *info)
+{
+    // Same registers as dwt_readdiagnostics() plus the RX timestamps, RX_TIME is read whole
+    dwt_batchread32bitreg(batch, RX_FINFO_ID, &info->finfo);
+    dwt_batchreadfromdevice(batch, RX_TIME_ID, 0, RX_TIME_LLEN, info->rxtime);
+    dwt_batchreadfromdevice(batch, RX_FQUAL_ID, 0, RX_FQUAL_LEN, info->fqual);
+    dwt_batchread16bitoffsetreg(batch, LDE_IF_ID, LDE_THRESH_OFFSET, &info->maxNoise);
+
+    return batch->overflow ? DWT_ERROR : DWT_SUCCESS;
+}
+
+void dwt_rxinfodiagnostics(const dwt_rxinfo_t *info, dwt_rxdiag_t *diagnostics)
+{
+    diagnostics->firstPath = (uint16) (info->rxtime[RX_TIME_FP_INDEX_OFFSET] | (info->rxtime[RX_TIME_FP_INDEX_OFFSET + 1] << 8));
+    diagnostics->maxNoise = info->maxNoise;
+    diagnostics->stdNoise = (uint16) (info->fqual[0] | (info->fqual[1] << 8));
+    diagnostics->firstPathAmp2 = (uint16) (info->fqual[2] | (info->fqual[3] << 8));
+    diagnostics->firstPathAmp3 = (uint16) (info->fqual[4] | (info->fqual[5] << 8));
+    diagnostics->maxGrowthCIR = (uint16) (info->fqual[6] | (info->fqual[7] << 8));
+    diagnostics->firstPathAmp1 = (uint16) (info->rxtime[RX_TIME_FP_AMPL1_OFFSET] | (info->rxtime[RX_TIME_FP_AMPL1_OFFSET + 1] << 8));
+    diagnostics->rxPreamCount = (uint16) ((info->finfo & RX_FINFO_RXPACC_MASK) >> RX_FINFO_RXPACC_SHIFT);
+}
+
+static int _dwt_batchrxreset(dwt_batch_t *batch)
+{
+    // Set RX reset
+    dwt_batchwrite8bitoffsetreg(batch, PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_RX);
+
+    // Clear RX reset
+    return dwt_batchwrite8bitoffsetreg(batch, PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_CLEAR);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchsubmit()
+ *
+ * @brief  this function performs all queued accesses in order, unpacks the register values read and empties the batch
+ *
+ * input parameters:
+ * @param batch - the batch to submit
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch overflowed or the SPI transfer failed
+ */
+static int _dwt_batchsubmit(dwt_batch_t *batch)
+{
+    int status = DWT_ERROR;
+    int i, j;
+
+    if (!batch->overflow && (batch->count == 0 || transferspi(batch->count, batch->access) == DWT_SUCCESS))
+    {
+        for (i = 0 ; i < batch->count ; i++)
+        {
+            uint32 regval = 0;
+
+            if (batch->result[i] == NULL)
+            {
+                continue;
+            }
+
+            for (j = batch->resultWidth[i] - 1 ; j >= 0 ; j --)
+            {
+                regval = (regval << 8) + batch->regval[i][j] ;
+            }
+
+            switch (batch->resultWidth[i])
+            {
+                case 1: *(uint8 *) batch->result[i] = (uint8) regval; break;
+                case 2: *(uint16 *) batch->result[i] = (uint16) regval; break;
+                default: *(uint32 *) batch->result[i] = regval; break;
+            }
+        }
+        status = DWT_SUCCESS;
+    }
+    else if (batch->count > 0)
+    {
+        pdw1000local->shadowValid = 0; // Queued writes may not have reached the device
+    }
+
+    dwt_batchinit(batch);
+    return status;
+} // end dwt_batchsubmit()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_enableframefilter()
+ *
+ * @brief This is used to enable the frame filtering - (the default option is to
+ * accept any data and ACK frames with correct destination address
+ *
+ * input parameters
+ * @param - bitmask - enables/disables the frame filtering options according to
+ *      DWT_FF_NOTYPE_EN        0x000   no frame types allowed
+ *      DWT_FF_COORD_EN         0x002   behave as coordinator (can receive frames with no destination address (PAN ID has to match))
+ *      DWT_FF_BEACON_EN        0x004   beacon frames allowed
+ *      DWT_FF_DATA_EN          0x008   data frames allowed
+ *      DWT_FF_ACK_EN           0x010   ack frames allowed
+ *      DWT_FF_MAC_EN           0x020   mac control frames allowed
+ *      DWT_FF_RSVD_EN          0x040   reserved frame types allowed
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_enableframefilter(uint16 enable)
+{
+    uint32 sysconfig = SYS_CFG_MASK & _dwt_shadowread32(SHADOW_SYS_CFG) ; // Read sysconfig register
+
+    if(enable)
+    {
+        // Enable frame filtering and configure frame types
+        sysconfig &= ~(SYS_CFG_FF_ALL_EN); // Clear all
+        sysconfig |= (enable & SYS_CFG_FF_ALL_EN) | SYS_CFG_FFE;
+    }
+    else
+    {
+        sysconfig &= ~(SYS_CFG_FFE);
+    }
+
+    pdw1000local->sysCFGreg = sysconfig ;
+    dwt_write32bitreg(SYS_CFG_ID,sysconfig) ;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_setpanid()
+ *
+ * @brief This is used to set the PAN ID
+ *
+ * input parameters
+ * @param panID - this is the PAN ID
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_setpanid(uint16 panID)
+{
+    // PAN ID is high 16 bits of register
+    dwt_write16bitoffsetreg(PANADR_ID, PANADR_PAN_ID_OFFSET, panID);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_setaddress16()
+ *
+ * @brief This is used to set 16-bit (short) address
+ *
+ * input parameters
+ * @param shortAddress - this sets the 16 bit short address
+ *
+ * output parameters
+ *
+ * no return value
+ */
+static void _dwt_setaddress16(uint16 shortAddress)
 {
     // Short address into low 16 bits
     dwt_write16bitoffsetreg(PANADR_ID, PANADR_SHORT_ADDR_OFFSET, shortAddress);
@@ -1277,7 +1794,7 @@ void dwt_setaddress16(uint16 shortAddress)
  *
  * no return value
  */
-void dwt_seteui(uint8 *eui64)
+static void _dwt_seteui(uint8 *eui64)
 {
     dwt_writetodevice(EUI_64_ID, EUI_64_OFFSET, EUI_64_LEN, eui64);
 }
@@ -1294,7 +1811,7 @@ void dwt_seteui(uint8 *eui64)
  *
  * no return value
  */
-void dwt_geteui(uint8 *eui64)
+static void _dwt_geteui(uint8 *eui64)
 {
     dwt_readfromdevice(EUI_64_ID, EUI_64_OFFSET, EUI_64_LEN, eui64);
 }
@@ -1313,15 +1830,15 @@ void dwt_geteui(uint8 *eui64)
  *
  * no return value
  */
-void dwt_otpread(uint32 address, uint32 *array, uint8 length)
+static void _dwt_otpread(uint32 address, uint32 *array, uint8 length)
 {
     int i;
 
-    _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: Set system clock to XTAL - this is necessary to make sure the values read by _dwt_otpread are reliable
+    _dwt_enableclocks(FORCE_SYS_XTI); // NOTE: Set system clock to XTAL - this is necessary to make sure the values read by _dwt_otpreadword are reliable
 
     for(i=0; i<length; i++)
     {
-        array[i] = _dwt_otpread(address + i) ;
+        array[i] = _dwt_otpreadword(address + i) ;
     }
 
     _dwt_enableclocks(ENABLE_ALL_SEQ); // Restore system clock to PLL
@@ -1330,7 +1847,7 @@ void dwt_otpread(uint32 address, uint32 *array, uint8 length)
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn _dwt_otpread()
+ * @fn _dwt_otpreadword()
  *
  * @brief function to read the OTP memory. Ensure that MR,MRa,MRb are reset to 0.
  *
@@ -1341,7 +1858,7 @@ void dwt_otpread(uint32 address, uint32 *array, uint8 length)
  *
  * returns the 32bit of read data
  */
-uint32 _dwt_otpread(uint32 address)
+uint32 _dwt_otpreadword(uint32 address)
 {
     uint32 ret_data;
 
@@ -1606,7 +2123,7 @@ uint32 _dwt_otpprogword32(uint32 data, uint16 address)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error
  */
-int dwt_otpwriteandverify(uint32 value, uint16 address)
+static int _dwt_otpwriteandverify(uint32 value, uint16 address)
 {
     int prog_ok = DWT_SUCCESS;
     int retry = 0;
@@ -1625,7 +2142,7 @@ int dwt_otpwriteandverify(uint32 value, uint16 address)
     {
         _dwt_otpprogword32(value, address);
 
-        if(_dwt_otpread(address) == value)
+        if(_dwt_otpreadword(address) == value)
         {
             break;
         }
@@ -1640,7 +2157,7 @@ int dwt_otpwriteandverify(uint32 value, uint16 address)
 
     _dwt_otpsetmrregs(4); // Set mode for reading
 
-    if(_dwt_otpread(address) != value) // If this does not pass please check voltage supply on VDDIO
+    if(_dwt_otpreadword(address) != value) // If this does not pass please check voltage supply on VDDIO
     {
         prog_ok = DWT_ERROR;
     }
@@ -1697,10 +2214,12 @@ void _dwt_aonarrayupload(void)
  *
  * no return value
  */
-void dwt_entersleep(void)
+static void _dwt_entersleep(void)
 {
     // Copy config to AON - upload the new configuration
     _dwt_aonarrayupload();
+
+    pdw1000local->shadowValid = 0; // Registers not saved in AON come back with their reset values
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -1717,7 +2236,7 @@ void dwt_entersleep(void)
  *
  * no return value
  */
-void dwt_configuresleepcnt(uint16 sleepcnt)
+static void _dwt_configuresleepcnt(uint16 sleepcnt)
 {
     // Force system clock to crystal
     _dwt_enableclocks(FORCE_SYS_XTI);
@@ -1755,7 +2274,7 @@ void dwt_configuresleepcnt(uint16 sleepcnt)
  *
  * returns the number of XTAL/2 cycles per low-power oscillator cycle. LP OSC frequency = 19.2 MHz/return value
  */
-uint16 dwt_calibratesleepcnt(void)
+static uint16 _dwt_calibratesleepcnt(void)
 {
     uint16 result;
 
@@ -1842,7 +2361,7 @@ uint16 dwt_calibratesleepcnt(void)
  *
  * no return value
  */
-void dwt_configuresleep(uint16 mode, uint8 wake)
+static void _dwt_configuresleep(uint16 mode, uint8 wake)
 {
     // Add predefined sleep settings before writing the mode
     mode |= pdw1000local->sleep_mode;
@@ -1867,9 +2386,9 @@ void dwt_configuresleep(uint16 mode, uint8 wake)
  *
  * no return value
  */
-void dwt_entersleepaftertx(int enable)
+static void _dwt_entersleepaftertx(int enable)
 {
-    uint32 reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
+    uint32 reg = _dwt_shadowread32(SHADOW_PMSC_CTRL1);
     // Set the auto TX -> sleep bit
     if(enable)
     {
@@ -1906,7 +2425,7 @@ void dwt_entersleepaftertx(int enable)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error
  */
-int dwt_spicswakeup(uint8 *buff, uint16 length)
+static int _dwt_spicswakeup(uint8 *buff, uint16 length)
 {
     if(dwt_readdevid() != DWT_DEVICE_ID) // Device was in deep sleep (the first read fails)
     {
@@ -1997,7 +2516,7 @@ void _dwt_loaducodefromrom(void)
  *
  * no return value
  */
-void dwt_loadopsettabfromotp(uint8 ops_sel)
+static void _dwt_loadopsettabfromotp(uint8 ops_sel)
 {
     uint16 reg = ((ops_sel << OTP_SF_OPS_SEL_SHFT) & OTP_SF_OPS_SEL_MASK) | OTP_SF_OPS_KICK; // Select defined OPS table and trigger its loading
 
@@ -2023,10 +2542,10 @@ void dwt_loadopsettabfromotp(uint8 ops_sel)
  *
  * no return value
  */
-void dwt_setsmarttxpower(int enable)
+static void _dwt_setsmarttxpower(int enable)
 {
     // Config system register
-    pdw1000local->sysCFGreg = dwt_read32bitreg(SYS_CFG_ID) ; // Read sysconfig register
+    pdw1000local->sysCFGreg = _dwt_shadowread32(SHADOW_SYS_CFG) ; // Read sysconfig register
 
     // Disable smart power configuration
     if(enable)
@@ -2056,7 +2575,7 @@ void dwt_setsmarttxpower(int enable)
  *
  * no return value
  */
-void dwt_enableautoack(uint8 responseDelayTime)
+static void _dwt_enableautoack(uint8 responseDelayTime)
 {
     // Set auto ACK reply delay
     dwt_write8bitoffsetreg(ACK_RESP_T_ID, ACK_RESP_T_ACK_TIM_OFFSET, responseDelayTime); // In symbols
@@ -2077,7 +2596,7 @@ void dwt_enableautoack(uint8 responseDelayTime)
  *
  * no return value
  */
-void dwt_setdblrxbuffmode(int enable)
+static void _dwt_setdblrxbuffmode(int enable)
 {
     if(enable)
     {
@@ -2107,7 +2626,7 @@ void dwt_setdblrxbuffmode(int enable)
  *
  * no return value
  */
-void dwt_setrxaftertxdelay(uint32 rxDelayTime)
+static void _dwt_setrxaftertxdelay(uint32 rxDelayTime)
 {
     uint32 val = dwt_read32bitreg(ACK_RESP_T_ID) ; // Read ACK_RESP_T_ID register
 
@@ -2136,7 +2655,7 @@ void dwt_setrxaftertxdelay(uint32 rxDelayTime)
  *
  * no return value
  */
-void dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_cb_t cbRxErr)
+static void _dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_cb_t cbRxErr)
 {
     pdw1000local->cbTxDone = cbTxDone;
     pdw1000local->cbRxOk = cbRxOk;
@@ -2155,7 +2674,7 @@ void dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_c
  *
  * return value is 1 if the IRQS bit is set and 0 otherwise
  */
-uint8 dwt_checkirq(void)
+static uint8 _dwt_checkirq(void)
 {
     return (dwt_read8bitoffsetreg(SYS_STATUS_ID, SYS_STATUS_OFFSET) & SYS_STATUS_IRQS); // Reading the lower byte only is enough for this operation
 }
@@ -2184,7 +2703,7 @@ uint8 dwt_checkirq(void)
  *
  * no return value
  */
-void dwt_isr(void)
+static void _dwt_isr(void)
 {
     uint32 status = pdw1000local->cbData.status = dwt_read32bitreg(SYS_STATUS_ID); // Read status register low 32bits
 
@@ -2321,7 +2840,7 @@ void dwt_isr(void)
  *
  * no return value
  */
-void dwt_lowpowerlistenisr(void)
+static void _dwt_lowpowerlistenisr(void)
 {
     uint32 status = pdw1000local->cbData.status = dwt_read32bitreg(SYS_STATUS_ID); // Read status register low 32bits
     uint16 finfo16;
@@ -2391,20 +2910,20 @@ void dwt_lowpowerlistenisr(void)
  *
  * no return value
  */
-void dwt_setleds(uint8 mode)
+static void _dwt_setleds(uint8 mode)
 {
     uint32 reg;
 
     if (mode & DWT_LEDS_ENABLE)
     {
         // Set up MFIO for LED output.
-        reg = dwt_read32bitoffsetreg(GPIO_CTRL_ID, GPIO_MODE_OFFSET);
+        reg = _dwt_shadowread32(SHADOW_GPIO_MODE);
         reg &= ~(GPIO_MSGP2_MASK | GPIO_MSGP3_MASK);
         reg |= (GPIO_PIN2_RXLED | GPIO_PIN3_TXLED);
         dwt_write32bitoffsetreg(GPIO_CTRL_ID, GPIO_MODE_OFFSET, reg);
 
         // Enable LP Oscillator to run from counter and turn on de-bounce clock.
-        reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET);
+        reg = _dwt_shadowread32(SHADOW_PMSC_CTRL0);
         reg |= (PMSC_CTRL0_GPDCE | PMSC_CTRL0_KHZCLEN);
         dwt_write32bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET, reg);
 
@@ -2426,29 +2945,27 @@ void dwt_setleds(uint8 mode)
     else
     {
         // Clear the GPIO bits that are used for LED control.
-        reg = dwt_read32bitoffsetreg(GPIO_CTRL_ID, GPIO_MODE_OFFSET);
+        reg = _dwt_shadowread32(SHADOW_GPIO_MODE);
         reg &= ~(GPIO_MSGP2_MASK | GPIO_MSGP3_MASK);
         dwt_write32bitoffsetreg(GPIO_CTRL_ID, GPIO_MODE_OFFSET, reg);
     }
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
- * @fn _dwt_enableclocks()
+ * @fn _dwt_clocksetting()
  *
- * @brief function to enable/disable clocks to particular digital blocks/system
+ * @brief function to compute the PMSC_CTRL0 value enabling/disabling clocks to particular digital blocks/system
  *
  * input parameters
  * @param clocks - set of clocks to enable/disable
+ * @param reg - the two low bytes of PMSC_CTRL0, updated in place
  *
  * output parameters none
  *
  * no return value
  */
-void _dwt_enableclocks(int clocks)
+static void _dwt_clocksetting(int clocks, uint8 *reg)
 {
-    uint8 reg[2];
-
-    dwt_readfromdevice(PMSC_ID, PMSC_CTRL0_OFFSET, 2, reg);
     switch(clocks)
     {
         case ENABLE_ALL_SEQ:
@@ -2505,7 +3022,28 @@ void _dwt_enableclocks(int clocks)
         default:
         break;
     }
+} // end _dwt_clocksetting()
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn _dwt_enableclocks()
+ *
+ * @brief function to enable/disable clocks to particular digital blocks/system
+ *
+ * input parameters
+ * @param clocks - set of clocks to enable/disable
+ *
+ * output parameters none
+ *
+ * no return value
+ */
+void _dwt_enableclocks(int clocks)
+{
+    uint32 pmsc = _dwt_shadowread32(SHADOW_PMSC_CTRL0);
+    uint8 reg[2];
 
+    reg[0] = (uint8) pmsc;
+    reg[1] = (uint8) (pmsc >> 8);
+    _dwt_clocksetting(clocks, reg);
 
     // Need to write lower byte separately before setting the higher byte(s)
     dwt_writetodevice(PMSC_ID, PMSC_CTRL0_OFFSET, 1, &reg[0]);
@@ -2544,7 +3082,7 @@ void _dwt_disablesequencing(void) // Disable sequencing and go to state "INIT"
  *
  * no return value
  */
-void dwt_setdelayedtrxtime(uint32 starttime)
+static void _dwt_setdelayedtrxtime(uint32 starttime)
 {
     dwt_write32bitoffsetreg(DX_TIME_ID, 1, starttime); // Write at offset 1 as the lower 9 bits of this register are ignored
 
@@ -2565,7 +3103,7 @@ void dwt_setdelayedtrxtime(uint32 starttime)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error (e.g. a delayed transmission will fail if the delayed time has passed)
  */
-int dwt_starttx(uint8 mode)
+static int _dwt_starttx(uint8 mode)
 {
     int retval = DWT_SUCCESS ;
     uint8 temp  = 0x00;
@@ -2622,12 +3160,12 @@ int dwt_starttx(uint8 mode)
  *
  * no return value
  */
-void dwt_forcetrxoff(void)
+static void _dwt_forcetrxoff(void)
 {
     decaIrqStatus_t stat ;
     uint32 mask;
 
-    mask = dwt_read32bitreg(SYS_MASK_ID) ; // Read set interrupt mask
+    mask = _dwt_shadowread32(SHADOW_SYS_MASK) ; // Read set interrupt mask
 
     // Need to beware of interrupts occurring in the middle of following read modify write cycle
     // We can disable the radio, but before the status is cleared an interrupt can be set (e.g. the
@@ -2664,7 +3202,7 @@ void dwt_forcetrxoff(void)
  *
  * no return value
  */
-void dwt_syncrxbufptrs(void)
+static void _dwt_syncrxbufptrs(void)
 {
     uint8  buff ;
     // Need to make sure that the host/IC buffer pointers are aligned before starting RX
@@ -2696,7 +3234,7 @@ void dwt_syncrxbufptrs(void)
  *
  * no return value
  */
-void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
+static void _dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
 {
     uint32 pmsc_reg;
     if (enable)
@@ -2704,7 +3242,7 @@ void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
         /* Configure ON/OFF times and enable PLL2 on/off sequencing by SNIFF mode. */
         uint16 sniff_reg = ((timeOff << 8) | timeOn) & RX_SNIFF_MASK;
         dwt_write16bitoffsetreg(RX_SNIFF_ID, RX_SNIFF_OFFSET, sniff_reg);
-        pmsc_reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET);
+        pmsc_reg = _dwt_shadowread32(SHADOW_PMSC_CTRL0);
         pmsc_reg |= PMSC_CTRL0_PLL2_SEQ_EN;
         dwt_write32bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET, pmsc_reg);
     }
@@ -2712,7 +3250,7 @@ void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
     {
         /* Clear ON/OFF times and disable PLL2 on/off sequencing by SNIFF mode. */
         dwt_write16bitoffsetreg(RX_SNIFF_ID, RX_SNIFF_OFFSET, 0x0000);
-        pmsc_reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET);
+        pmsc_reg = _dwt_shadowread32(SHADOW_PMSC_CTRL0);
         pmsc_reg &= ~PMSC_CTRL0_PLL2_SEQ_EN;
         dwt_write32bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET, pmsc_reg);
     }
@@ -2748,9 +3286,9 @@ void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
  *
  * no return value
  */
-void dwt_setlowpowerlistening(int enable)
+static void _dwt_setlowpowerlistening(int enable)
 {
-    uint32 pmsc_reg = dwt_read32bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
+    uint32 pmsc_reg = _dwt_shadowread32(SHADOW_PMSC_CTRL1);
     if (enable)
     {
         /* Configure RX to sleep and snooze features. */
@@ -2778,7 +3316,7 @@ void dwt_setlowpowerlistening(int enable)
  *
  * no return value
  */
-void dwt_setsnoozetime(uint8 snooze_time)
+static void _dwt_setsnoozetime(uint8 snooze_time)
 {
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_SNOZT_OFFSET, snooze_time);
 }
@@ -2802,7 +3340,7 @@ void dwt_setsnoozetime(uint8 snooze_time)
  *
  * returns DWT_SUCCESS for success, or DWT_ERROR for error (e.g. a delayed receive enable will be too far in the future if delayed time has passed)
  */
-int dwt_rxenable(int mode)
+static int _dwt_rxenable(int mode)
 {
     uint16 temp ;
     uint8 temp1 ;
@@ -2853,11 +3391,11 @@ int dwt_rxenable(int mode)
  *
  * no return value
  */
-void dwt_setrxtimeout(uint16 time)
+static void _dwt_setrxtimeout(uint16 time)
 {
     uint8 temp ;
 
-    temp = dwt_read8bitoffsetreg(SYS_CFG_ID, 3); // Read at offset 3 to get the upper byte only
+    temp = (uint8)(_dwt_shadowread32(SHADOW_SYS_CFG) >> 24); // Upper byte only
 
     if(time > 0)
     {
@@ -2894,7 +3432,7 @@ void dwt_setrxtimeout(uint16 time)
  *
  * no return value
  */
-void dwt_setpreambledetecttimeout(uint16 timeout)
+static void _dwt_setpreambledetecttimeout(uint16 timeout)
 {
     dwt_write16bitoffsetreg(DRX_CONF_ID, DRX_PRETOC_OFFSET, timeout);
 }
@@ -2923,7 +3461,7 @@ void dwt_setpreambledetecttimeout(uint16 timeout)
  *
  * no return value
  */
-void dwt_setinterrupt(uint32 bitmask, uint8 enable)
+static void _dwt_setinterrupt(uint32 bitmask, uint8 enable)
 {
     decaIrqStatus_t stat ;
     uint32 mask ;
@@ -2931,7 +3469,7 @@ void dwt_setinterrupt(uint32 bitmask, uint8 enable)
     // Need to beware of interrupts occurring in the middle of following read modify write cycle
     stat = decamutexon() ;
 
-    mask = dwt_read32bitreg(SYS_MASK_ID) ; // Read register
+    mask = _dwt_shadowread32(SHADOW_SYS_MASK) ; // Read register
 
     if(enable)
     {
@@ -2957,7 +3495,7 @@ void dwt_setinterrupt(uint32 bitmask, uint8 enable)
  *
  * no return value
  */
-void dwt_configeventcounters(int enable)
+static void _dwt_configeventcounters(int enable)
 {
     // Need to clear and disable, can't just clear
     dwt_write8bitoffsetreg(DIG_DIAG_ID, EVC_CTRL_OFFSET, (uint8)(EVC_CLR));
@@ -2980,7 +3518,7 @@ void dwt_configeventcounters(int enable)
  *
  * no return value
  */
-void dwt_readeventcounters(dwt_deviceentcnts_t *counters)
+static void _dwt_readeventcounters(dwt_deviceentcnts_t *counters)
 {
     uint32 temp;
 
@@ -3021,7 +3559,7 @@ void dwt_readeventcounters(dwt_deviceentcnts_t *counters)
  *
  * no return value
  */
-void dwt_rxreset(void)
+static void _dwt_rxreset(void)
 {
     // Set RX reset
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_RX);
@@ -3041,7 +3579,7 @@ void dwt_rxreset(void)
  *
  * no return value
  */
-void dwt_softreset(void)
+static void _dwt_softreset(void)
 {
     _dwt_disablesequencing();
 
@@ -3063,6 +3601,7 @@ void dwt_softreset(void)
     dwt_write8bitoffsetreg(PMSC_ID, PMSC_CTRL0_SOFTRESET_OFFSET, PMSC_CTRL0_RESET_CLEAR);
 
     pdw1000local->wait4resp = 0;
+    pdw1000local->shadowValid = 0; // All registers are back to their reset values
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
@@ -3077,7 +3616,7 @@ void dwt_softreset(void)
  *
  * no return value
  */
-void dwt_setxtaltrim(uint8 value)
+static void _dwt_setxtaltrim(uint8 value)
 {
     // The 3 MSb in this 8-bit register must be kept to 0b011 to avoid any malfunction.
     uint8 reg_val = (3 << 5) | (value & FS_XTALT_MASK);
@@ -3098,7 +3637,7 @@ void dwt_setxtaltrim(uint8 value)
  *
  * returns the XTAL trim value set upon initialisation
  */
-uint8 dwt_getinitxtaltrim(void)
+static uint8 _dwt_getinitxtaltrim(void)
 {
     return pdw1000local->init_xtrim;
 }
@@ -3115,7 +3654,7 @@ uint8 dwt_getinitxtaltrim(void)
  *
  * no return value
  */
-void dwt_configcwmode(uint8 chan)
+static void _dwt_configcwmode(uint8 chan)
 {
 #ifdef DWT_API_ERROR_CHECK
     assert((chan >= 1) && (chan <= 7) && (chan != 6));
@@ -3167,7 +3706,7 @@ void dwt_configcwmode(uint8 chan)
  *
  * no return value
  */
-void dwt_configcontinuousframemode(uint32 framerepetitionrate)
+static void _dwt_configcontinuousframemode(uint32 framerepetitionrate)
 {
     //
     // Disable TX/RX RF block sequencing (needed for continuous frame mode)
@@ -3220,7 +3759,7 @@ void dwt_configcontinuousframemode(uint32 framerepetitionrate)
  *
  * returns  (temp_raw<<8)|(vbat_raw)
  */
-uint16 dwt_readtempvbat(uint8 fastSPI)
+static uint16 _dwt_readtempvbat(uint8 fastSPI)
 {
     uint8 wr_buf[2];
     uint8 vbat_raw;
@@ -3279,7 +3818,7 @@ uint16 dwt_readtempvbat(uint8 fastSPI)
  *
  * returns: 8-bit raw temperature sensor value
  */
-uint8 dwt_readwakeuptemp(void)
+static uint8 _dwt_readwakeuptemp(void)
 {
     return dwt_read8bitoffsetreg(TX_CAL_ID, TC_SARL_SAR_LTEMP_OFFSET);
 }
@@ -3297,7 +3836,7 @@ uint8 dwt_readwakeuptemp(void)
  *
  * returns: 8-bit raw battery voltage sensor value
  */
-uint8 dwt_readwakeupvbat(void)
+static uint8 _dwt_readwakeupvbat(void)
 {
     return dwt_read8bitoffsetreg(TX_CAL_ID, TC_SARL_SAR_LVBAT_OFFSET);
 }
@@ -3315,7 +3854,7 @@ uint8 dwt_readwakeupvbat(void)
  *
  * returns: (uint32) The setting to be programmed into the PG_DELAY value
  */
-uint32 dwt_calcbandwidthtempadj(uint16 target_count)
+static uint32 _dwt_calcbandwidthtempadj(uint16 target_count)
 {
     int i;
     uint32 bit_field, curr_bw;
@@ -3330,8 +3869,8 @@ uint32 dwt_calcbandwidthtempadj(uint16 target_count)
     uint32 old_rf_conf_txpow_mask;
 
     // Record the current values of these registers, to restore later
-    old_pmsc_ctrl0 = dwt_read8bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET);
-    old_pmsc_ctrl1 = dwt_read16bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
+    old_pmsc_ctrl0 = (uint8) _dwt_shadowread32(SHADOW_PMSC_CTRL0);
+    old_pmsc_ctrl1 = (uint16) _dwt_shadowread32(SHADOW_PMSC_CTRL1);
     old_rf_conf_txpow_mask = dwt_read32bitreg(RF_CONF_ID);
 
     //  Set clock to XTAL
@@ -3507,7 +4046,7 @@ uint32 _dwt_computetxpowersetting(uint32 ref_powerreg, int32 power_adj)
  * returns: (uint16) PGC_STATUS count value calculated from the provided PG_DELAY value - used as reference for later
  * bandwidth adjustments
  */
-uint16 dwt_calcpgcount(uint8 pgdly)
+static uint16 _dwt_calcpgcount(uint8 pgdly)
 {
     // Perform PG count read ten times and take an average to smooth out any noise
     const int NUM_SAMPLES = 10;
@@ -3521,8 +4060,8 @@ uint16 dwt_calcpgcount(uint8 pgdly)
     uint32 old_rf_conf_txpow_mask;
 
     // Record the current values of these registers, to restore later
-    old_pmsc_ctrl0 = dwt_read8bitoffsetreg(PMSC_ID, PMSC_CTRL0_OFFSET);
-    old_pmsc_ctrl1 = dwt_read16bitoffsetreg(PMSC_ID, PMSC_CTRL1_OFFSET);
+    old_pmsc_ctrl0 = (uint8) _dwt_shadowread32(SHADOW_PMSC_CTRL0);
+    old_pmsc_ctrl1 = (uint16) _dwt_shadowread32(SHADOW_PMSC_CTRL1);
     old_rf_conf_txpow_mask = dwt_read32bitreg(RF_CONF_ID);
 
     //  Set clock to XTAL
@@ -3563,6 +4102,1091 @@ uint16 dwt_calcpgcount(uint8 pgdly)
 }
 
 
+// -------------------------------------------------------------------------------------------------------------------
+// Context API
+//
+// The functions above act on pdw1000local without locking. Each public entry point below runs one of them on a given
+// device with that device locked by the platform (decamutexon()) and its SPI port selected (decaselectdevice()), then
+// restores the calling thread's selection. dwt_xxx(...) is dwt_ctx_xxx(pdw1000local, ...). Calls made from inside the
+// driver or from the callbacks of dwt_isr() nest on the same (recursive) device lock.
+// -------------------------------------------------------------------------------------------------------------------
+
+#define DWT_CTX_CALL(ctx, call)                                                     \
+    do                                                                              \
+    {                                                                               \
+        dwt_local_data_t *prevlocal = pdw1000local;                                 \
+        int prevdev = decaselectdevice((int) ((ctx) - dw1000local));                \
+        decaIrqStatus_t stat = decamutexon();                                       \
+        pdw1000local = (ctx);                                                       \
+        call;                                                                       \
+        pdw1000local = prevlocal;                                                   \
+        decamutexoff(stat);                                                         \
+        decaselectdevice(prevdev);                                                  \
+    } while (0)
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getctx()
+ *
+ * @brief This function returns the context of the device in local data slot index, for the dwt_ctx_ functions.
+ *
+ * input parameters
+ * @param index    - local data slot, < DWT_NUM_DW_DEV
+ *
+ * output parameters
+ *
+ * returns the context, or NULL if index is outside the array bounds
+ */
+dwt_ctx_t *dwt_getctx(unsigned int index)
+{
+    if (index >= DWT_NUM_DW_DEV)
+    {
+        return NULL ;
+    }
+    return &dw1000local[index] ;
+}
+
+int dwt_ctx_initialise(dwt_ctx_t *ctx, uint16 config)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_initialise(config));
+    return r;
+}
+
+int dwt_initialise(uint16 config)
+{
+    return dwt_ctx_initialise(pdw1000local, config);
+}
+
+uint8 dwt_ctx_otprevision(dwt_ctx_t *ctx)
+{
+    uint8 r;
+    DWT_CTX_CALL(ctx, r = _dwt_otprevision());
+    return r;
+}
+
+uint8 dwt_otprevision(void)
+{
+    return dwt_ctx_otprevision(pdw1000local);
+}
+
+void dwt_ctx_setfinegraintxseq(dwt_ctx_t *ctx, int enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_setfinegraintxseq(enable));
+}
+
+void dwt_setfinegraintxseq(int enable)
+{
+    dwt_ctx_setfinegraintxseq(pdw1000local, enable);
+}
+
+void dwt_ctx_setlnapamode(dwt_ctx_t *ctx, int lna, int pa)
+{
+    DWT_CTX_CALL(ctx, _dwt_setlnapamode(lna, pa));
+}
+
+void dwt_setlnapamode(int lna, int pa)
+{
+    dwt_ctx_setlnapamode(pdw1000local, lna, pa);
+}
+
+void dwt_ctx_setgpiodirection(dwt_ctx_t *ctx, uint32 gpioNum, uint32 direction)
+{
+    DWT_CTX_CALL(ctx, _dwt_setgpiodirection(gpioNum, direction));
+}
+
+void dwt_setgpiodirection(uint32 gpioNum, uint32 direction)
+{
+    dwt_ctx_setgpiodirection(pdw1000local, gpioNum, direction);
+}
+
+void dwt_ctx_setgpiovalue(dwt_ctx_t *ctx, uint32 gpioNum, uint32 value)
+{
+    DWT_CTX_CALL(ctx, _dwt_setgpiovalue(gpioNum, value));
+}
+
+void dwt_setgpiovalue(uint32 gpioNum, uint32 value)
+{
+    dwt_ctx_setgpiovalue(pdw1000local, gpioNum, value);
+}
+
+uint32 dwt_ctx_getpartid(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_getpartid());
+    return r;
+}
+
+uint32 dwt_getpartid(void)
+{
+    return dwt_ctx_getpartid(pdw1000local);
+}
+
+uint32 dwt_ctx_getlotid(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_getlotid());
+    return r;
+}
+
+uint32 dwt_getlotid(void)
+{
+    return dwt_ctx_getlotid(pdw1000local);
+}
+
+uint32 dwt_ctx_readdevid(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readdevid());
+    return r;
+}
+
+uint32 dwt_readdevid(void)
+{
+    return dwt_ctx_readdevid(pdw1000local);
+}
+
+void dwt_ctx_configuretxrf(dwt_ctx_t *ctx, dwt_txconfig_t *config)
+{
+    DWT_CTX_CALL(ctx, _dwt_configuretxrf(config));
+}
+
+void dwt_configuretxrf(dwt_txconfig_t *config)
+{
+    dwt_ctx_configuretxrf(pdw1000local, config);
+}
+
+void dwt_ctx_configure(dwt_ctx_t *ctx, dwt_config_t *config)
+{
+    DWT_CTX_CALL(ctx, _dwt_configure(config));
+}
+
+void dwt_configure(dwt_config_t *config)
+{
+    dwt_ctx_configure(pdw1000local, config);
+}
+
+void dwt_ctx_setrxantennadelay(dwt_ctx_t *ctx, uint16 rxDelay)
+{
+    DWT_CTX_CALL(ctx, _dwt_setrxantennadelay(rxDelay));
+}
+
+void dwt_setrxantennadelay(uint16 rxDelay)
+{
+    dwt_ctx_setrxantennadelay(pdw1000local, rxDelay);
+}
+
+void dwt_ctx_settxantennadelay(dwt_ctx_t *ctx, uint16 txDelay)
+{
+    DWT_CTX_CALL(ctx, _dwt_settxantennadelay(txDelay));
+}
+
+void dwt_settxantennadelay(uint16 txDelay)
+{
+    dwt_ctx_settxantennadelay(pdw1000local, txDelay);
+}
+
+int dwt_ctx_writetxdata(dwt_ctx_t *ctx, uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOffset)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_writetxdata(txFrameLength, txFrameBytes, txBufferOffset));
+    return r;
+}
+
+int dwt_writetxdata(uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOffset)
+{
+    return dwt_ctx_writetxdata(pdw1000local, txFrameLength, txFrameBytes, txBufferOffset);
+}
+
+void dwt_ctx_writetxfctrl(dwt_ctx_t *ctx, uint16 txFrameLength, uint16 txBufferOffset, int ranging)
+{
+    DWT_CTX_CALL(ctx, _dwt_writetxfctrl(txFrameLength, txBufferOffset, ranging));
+}
+
+void dwt_writetxfctrl(uint16 txFrameLength, uint16 txBufferOffset, int ranging)
+{
+    dwt_ctx_writetxfctrl(pdw1000local, txFrameLength, txBufferOffset, ranging);
+}
+
+void dwt_ctx_readrxdata(dwt_ctx_t *ctx, uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+{
+    DWT_CTX_CALL(ctx, _dwt_readrxdata(buffer, length, rxBufferOffset));
+}
+
+void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+{
+    dwt_ctx_readrxdata(pdw1000local, buffer, length, rxBufferOffset);
+}
+
+void dwt_ctx_readaccdata(dwt_ctx_t *ctx, uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    DWT_CTX_CALL(ctx, _dwt_readaccdata(buffer, len, accOffset));
+}
+
+void dwt_readaccdata(uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    dwt_ctx_readaccdata(pdw1000local, buffer, len, accOffset);
+}
+
+int dwt_ctx_readaccdatabulk(dwt_ctx_t *ctx, uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_readaccdatabulk(buffer, len, accOffset));
+    return r;
+}
+
+int dwt_readaccdatabulk(uint8 *buffer, uint16 len, uint16 accOffset)
+{
+    return dwt_ctx_readaccdatabulk(pdw1000local, buffer, len, accOffset);
+}
+
+int32 dwt_ctx_readcarrierintegrator(dwt_ctx_t *ctx)
+{
+    int32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readcarrierintegrator());
+    return r;
+}
+
+int32 dwt_readcarrierintegrator(void)
+{
+    return dwt_ctx_readcarrierintegrator(pdw1000local);
+}
+
+void dwt_ctx_readdiagnostics(dwt_ctx_t *ctx, dwt_rxdiag_t *diagnostics)
+{
+    DWT_CTX_CALL(ctx, _dwt_readdiagnostics(diagnostics));
+}
+
+void dwt_readdiagnostics(dwt_rxdiag_t *diagnostics)
+{
+    dwt_ctx_readdiagnostics(pdw1000local, diagnostics);
+}
+
+void dwt_ctx_readtxtimestamp(dwt_ctx_t *ctx, uint8 *timestamp)
+{
+    DWT_CTX_CALL(ctx, _dwt_readtxtimestamp(timestamp));
+}
+
+void dwt_readtxtimestamp(uint8 *timestamp)
+{
+    dwt_ctx_readtxtimestamp(pdw1000local, timestamp);
+}
+
+uint32 dwt_ctx_readtxtimestamphi32(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readtxtimestamphi32());
+    return r;
+}
+
+uint32 dwt_readtxtimestamphi32(void)
+{
+    return dwt_ctx_readtxtimestamphi32(pdw1000local);
+}
+
+uint32 dwt_ctx_readtxtimestamplo32(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readtxtimestamplo32());
+    return r;
+}
+
+uint32 dwt_readtxtimestamplo32(void)
+{
+    return dwt_ctx_readtxtimestamplo32(pdw1000local);
+}
+
+void dwt_ctx_readrxtimestamp(dwt_ctx_t *ctx, uint8 *timestamp)
+{
+    DWT_CTX_CALL(ctx, _dwt_readrxtimestamp(timestamp));
+}
+
+void dwt_readrxtimestamp(uint8 *timestamp)
+{
+    dwt_ctx_readrxtimestamp(pdw1000local, timestamp);
+}
+
+uint32 dwt_ctx_readrxtimestamphi32(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readrxtimestamphi32());
+    return r;
+}
+
+uint32 dwt_readrxtimestamphi32(void)
+{
+    return dwt_ctx_readrxtimestamphi32(pdw1000local);
+}
+
+uint32 dwt_ctx_readrxtimestamplo32(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readrxtimestamplo32());
+    return r;
+}
+
+uint32 dwt_readrxtimestamplo32(void)
+{
+    return dwt_ctx_readrxtimestamplo32(pdw1000local);
+}
+
+uint32 dwt_ctx_readsystimestamphi32(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readsystimestamphi32());
+    return r;
+}
+
+uint32 dwt_readsystimestamphi32(void)
+{
+    return dwt_ctx_readsystimestamphi32(pdw1000local);
+}
+
+void dwt_ctx_readsystime(dwt_ctx_t *ctx, uint8 *timestamp)
+{
+    DWT_CTX_CALL(ctx, _dwt_readsystime(timestamp));
+}
+
+void dwt_readsystime(uint8 *timestamp)
+{
+    dwt_ctx_readsystime(pdw1000local, timestamp);
+}
+
+void dwt_ctx_writetodevice(dwt_ctx_t *ctx, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    DWT_CTX_CALL(ctx, _dwt_writetodevice(recordNumber, index, length, buffer));
+}
+
+void dwt_writetodevice(uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    dwt_ctx_writetodevice(pdw1000local, recordNumber, index, length, buffer);
+}
+
+void dwt_ctx_readfromdevice(dwt_ctx_t *ctx, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    DWT_CTX_CALL(ctx, _dwt_readfromdevice(recordNumber, index, length, buffer));
+}
+
+void dwt_readfromdevice(uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    dwt_ctx_readfromdevice(pdw1000local, recordNumber, index, length, buffer);
+}
+
+uint32 dwt_ctx_shadowmismatches(dwt_ctx_t *ctx)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_shadowmismatches());
+    return r;
+}
+
+uint32 dwt_shadowmismatches(void)
+{
+    return dwt_ctx_shadowmismatches(pdw1000local);
+}
+
+uint32 dwt_ctx_read32bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_read32bitoffsetreg(regFileID, regOffset));
+    return r;
+}
+
+uint32 dwt_read32bitoffsetreg(int regFileID, int regOffset)
+{
+    return dwt_ctx_read32bitoffsetreg(pdw1000local, regFileID, regOffset);
+}
+
+uint16 dwt_ctx_read16bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset)
+{
+    uint16 r;
+    DWT_CTX_CALL(ctx, r = _dwt_read16bitoffsetreg(regFileID, regOffset));
+    return r;
+}
+
+uint16 dwt_read16bitoffsetreg(int regFileID, int regOffset)
+{
+    return dwt_ctx_read16bitoffsetreg(pdw1000local, regFileID, regOffset);
+}
+
+uint8 dwt_ctx_read8bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset)
+{
+    uint8 r;
+    DWT_CTX_CALL(ctx, r = _dwt_read8bitoffsetreg(regFileID, regOffset));
+    return r;
+}
+
+uint8 dwt_read8bitoffsetreg(int regFileID, int regOffset)
+{
+    return dwt_ctx_read8bitoffsetreg(pdw1000local, regFileID, regOffset);
+}
+
+void dwt_ctx_write8bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset, uint8 regval)
+{
+    DWT_CTX_CALL(ctx, _dwt_write8bitoffsetreg(regFileID, regOffset, regval));
+}
+
+void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval)
+{
+    dwt_ctx_write8bitoffsetreg(pdw1000local, regFileID, regOffset, regval);
+}
+
+void dwt_ctx_write16bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset, uint16 regval)
+{
+    DWT_CTX_CALL(ctx, _dwt_write16bitoffsetreg(regFileID, regOffset, regval));
+}
+
+void dwt_write16bitoffsetreg(int regFileID, int regOffset, uint16 regval)
+{
+    dwt_ctx_write16bitoffsetreg(pdw1000local, regFileID, regOffset, regval);
+}
+
+void dwt_ctx_write32bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset, uint32 regval)
+{
+    DWT_CTX_CALL(ctx, _dwt_write32bitoffsetreg(regFileID, regOffset, regval));
+}
+
+void dwt_write32bitoffsetreg(int regFileID, int regOffset, uint32 regval)
+{
+    dwt_ctx_write32bitoffsetreg(pdw1000local, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchwritetodevice(dwt_ctx_t *ctx, dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchwritetodevice(batch, recordNumber, index, length, buffer));
+    return r;
+}
+
+int dwt_batchwritetodevice(dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer)
+{
+    return dwt_ctx_batchwritetodevice(pdw1000local, batch, recordNumber, index, length, buffer);
+}
+
+int dwt_ctx_batchreadfromdevice(dwt_ctx_t *ctx, dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchreadfromdevice(batch, recordNumber, index, length, buffer));
+    return r;
+}
+
+int dwt_batchreadfromdevice(dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer)
+{
+    return dwt_ctx_batchreadfromdevice(pdw1000local, batch, recordNumber, index, length, buffer);
+}
+
+int dwt_ctx_batchread32bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint32 *regval)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchread32bitoffsetreg(batch, regFileID, regOffset, regval));
+    return r;
+}
+
+int dwt_batchread32bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint32 *regval)
+{
+    return dwt_ctx_batchread32bitoffsetreg(pdw1000local, batch, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchread16bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint16 *regval)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchread16bitoffsetreg(batch, regFileID, regOffset, regval));
+    return r;
+}
+
+int dwt_batchread16bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint16 *regval)
+{
+    return dwt_ctx_batchread16bitoffsetreg(pdw1000local, batch, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchread8bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint8 *regval)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchread8bitoffsetreg(batch, regFileID, regOffset, regval));
+    return r;
+}
+
+int dwt_batchread8bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 *regval)
+{
+    return dwt_ctx_batchread8bitoffsetreg(pdw1000local, batch, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchwrite32bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint32 regval)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchwrite32bitoffsetreg(batch, regFileID, regOffset, regval));
+    return r;
+}
+
+int dwt_batchwrite32bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint32 regval)
+{
+    return dwt_ctx_batchwrite32bitoffsetreg(pdw1000local, batch, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchwrite16bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint16 regval)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchwrite16bitoffsetreg(batch, regFileID, regOffset, regval));
+    return r;
+}
+
+int dwt_batchwrite16bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint16 regval)
+{
+    return dwt_ctx_batchwrite16bitoffsetreg(pdw1000local, batch, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchwrite8bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint8 regval)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchwrite8bitoffsetreg(batch, regFileID, regOffset, regval));
+    return r;
+}
+
+int dwt_batchwrite8bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 regval)
+{
+    return dwt_ctx_batchwrite8bitoffsetreg(pdw1000local, batch, regFileID, regOffset, regval);
+}
+
+int dwt_ctx_batchreadrxdata(dwt_ctx_t *ctx, dwt_batch_t *batch, uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchreadrxdata(batch, buffer, length, rxBufferOffset));
+    return r;
+}
+
+int dwt_batchreadrxdata(dwt_batch_t *batch, uint8 *buffer, uint16 length, uint16 rxBufferOffset)
+{
+    return dwt_ctx_batchreadrxdata(pdw1000local, batch, buffer, length, rxBufferOffset);
+}
+
+int dwt_ctx_batchrxreset(dwt_ctx_t *ctx, dwt_batch_t *batch)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchrxreset(batch));
+    return r;
+}
+
+int dwt_batchrxreset(dwt_batch_t *batch)
+{
+    return dwt_ctx_batchrxreset(pdw1000local, batch);
+}
+
+int dwt_ctx_batchreadrxinfo(dwt_ctx_t *ctx, dwt_batch_t *batch, dwt_rxinfo_t *info)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchreadrxinfo(batch, info));
+    return r;
+}
+
+int dwt_batchreadrxinfo(dwt_batch_t *batch, dwt_rxinfo_t *info)
+{
+    return dwt_ctx_batchreadrxinfo(pdw1000local, batch, info);
+}
+
+int dwt_ctx_batchsubmit(dwt_ctx_t *ctx, dwt_batch_t *batch)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_batchsubmit(batch));
+    return r;
+}
+
+int dwt_batchsubmit(dwt_batch_t *batch)
+{
+    return dwt_ctx_batchsubmit(pdw1000local, batch);
+}
+
+void dwt_ctx_enableframefilter(dwt_ctx_t *ctx, uint16 enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_enableframefilter(enable));
+}
+
+void dwt_enableframefilter(uint16 enable)
+{
+    dwt_ctx_enableframefilter(pdw1000local, enable);
+}
+
+void dwt_ctx_setpanid(dwt_ctx_t *ctx, uint16 panID)
+{
+    DWT_CTX_CALL(ctx, _dwt_setpanid(panID));
+}
+
+void dwt_setpanid(uint16 panID)
+{
+    dwt_ctx_setpanid(pdw1000local, panID);
+}
+
+void dwt_ctx_setaddress16(dwt_ctx_t *ctx, uint16 shortAddress)
+{
+    DWT_CTX_CALL(ctx, _dwt_setaddress16(shortAddress));
+}
+
+void dwt_setaddress16(uint16 shortAddress)
+{
+    dwt_ctx_setaddress16(pdw1000local, shortAddress);
+}
+
+void dwt_ctx_seteui(dwt_ctx_t *ctx, uint8 *eui64)
+{
+    DWT_CTX_CALL(ctx, _dwt_seteui(eui64));
+}
+
+void dwt_seteui(uint8 *eui64)
+{
+    dwt_ctx_seteui(pdw1000local, eui64);
+}
+
+void dwt_ctx_geteui(dwt_ctx_t *ctx, uint8 *eui64)
+{
+    DWT_CTX_CALL(ctx, _dwt_geteui(eui64));
+}
+
+void dwt_geteui(uint8 *eui64)
+{
+    dwt_ctx_geteui(pdw1000local, eui64);
+}
+
+void dwt_ctx_otpread(dwt_ctx_t *ctx, uint32 address, uint32 *array, uint8 length)
+{
+    DWT_CTX_CALL(ctx, _dwt_otpread(address, array, length));
+}
+
+void dwt_otpread(uint32 address, uint32 *array, uint8 length)
+{
+    dwt_ctx_otpread(pdw1000local, address, array, length);
+}
+
+int dwt_ctx_otpwriteandverify(dwt_ctx_t *ctx, uint32 value, uint16 address)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_otpwriteandverify(value, address));
+    return r;
+}
+
+int dwt_otpwriteandverify(uint32 value, uint16 address)
+{
+    return dwt_ctx_otpwriteandverify(pdw1000local, value, address);
+}
+
+void dwt_ctx_entersleep(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_entersleep());
+}
+
+void dwt_entersleep(void)
+{
+    dwt_ctx_entersleep(pdw1000local);
+}
+
+void dwt_ctx_configuresleepcnt(dwt_ctx_t *ctx, uint16 sleepcnt)
+{
+    DWT_CTX_CALL(ctx, _dwt_configuresleepcnt(sleepcnt));
+}
+
+void dwt_configuresleepcnt(uint16 sleepcnt)
+{
+    dwt_ctx_configuresleepcnt(pdw1000local, sleepcnt);
+}
+
+uint16 dwt_ctx_calibratesleepcnt(dwt_ctx_t *ctx)
+{
+    uint16 r;
+    DWT_CTX_CALL(ctx, r = _dwt_calibratesleepcnt());
+    return r;
+}
+
+uint16 dwt_calibratesleepcnt(void)
+{
+    return dwt_ctx_calibratesleepcnt(pdw1000local);
+}
+
+void dwt_ctx_configuresleep(dwt_ctx_t *ctx, uint16 mode, uint8 wake)
+{
+    DWT_CTX_CALL(ctx, _dwt_configuresleep(mode, wake));
+}
+
+void dwt_configuresleep(uint16 mode, uint8 wake)
+{
+    dwt_ctx_configuresleep(pdw1000local, mode, wake);
+}
+
+void dwt_ctx_entersleepaftertx(dwt_ctx_t *ctx, int enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_entersleepaftertx(enable));
+}
+
+void dwt_entersleepaftertx(int enable)
+{
+    dwt_ctx_entersleepaftertx(pdw1000local, enable);
+}
+
+int dwt_ctx_spicswakeup(dwt_ctx_t *ctx, uint8 *buff, uint16 length)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_spicswakeup(buff, length));
+    return r;
+}
+
+int dwt_spicswakeup(uint8 *buff, uint16 length)
+{
+    return dwt_ctx_spicswakeup(pdw1000local, buff, length);
+}
+
+void dwt_ctx_loadopsettabfromotp(dwt_ctx_t *ctx, uint8 ops_sel)
+{
+    DWT_CTX_CALL(ctx, _dwt_loadopsettabfromotp(ops_sel));
+}
+
+void dwt_loadopsettabfromotp(uint8 ops_sel)
+{
+    dwt_ctx_loadopsettabfromotp(pdw1000local, ops_sel);
+}
+
+void dwt_ctx_setsmarttxpower(dwt_ctx_t *ctx, int enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_setsmarttxpower(enable));
+}
+
+void dwt_setsmarttxpower(int enable)
+{
+    dwt_ctx_setsmarttxpower(pdw1000local, enable);
+}
+
+void dwt_ctx_enableautoack(dwt_ctx_t *ctx, uint8 responseDelayTime)
+{
+    DWT_CTX_CALL(ctx, _dwt_enableautoack(responseDelayTime));
+}
+
+void dwt_enableautoack(uint8 responseDelayTime)
+{
+    dwt_ctx_enableautoack(pdw1000local, responseDelayTime);
+}
+
+void dwt_ctx_setdblrxbuffmode(dwt_ctx_t *ctx, int enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_setdblrxbuffmode(enable));
+}
+
+void dwt_setdblrxbuffmode(int enable)
+{
+    dwt_ctx_setdblrxbuffmode(pdw1000local, enable);
+}
+
+void dwt_ctx_setrxaftertxdelay(dwt_ctx_t *ctx, uint32 rxDelayTime)
+{
+    DWT_CTX_CALL(ctx, _dwt_setrxaftertxdelay(rxDelayTime));
+}
+
+void dwt_setrxaftertxdelay(uint32 rxDelayTime)
+{
+    dwt_ctx_setrxaftertxdelay(pdw1000local, rxDelayTime);
+}
+
+void dwt_ctx_setcallbacks(dwt_ctx_t *ctx, dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_cb_t cbRxErr)
+{
+    DWT_CTX_CALL(ctx, _dwt_setcallbacks(cbTxDone, cbRxOk, cbRxTo, cbRxErr));
+}
+
+void dwt_setcallbacks(dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_cb_t cbRxErr)
+{
+    dwt_ctx_setcallbacks(pdw1000local, cbTxDone, cbRxOk, cbRxTo, cbRxErr);
+}
+
+uint8 dwt_ctx_checkirq(dwt_ctx_t *ctx)
+{
+    uint8 r;
+    DWT_CTX_CALL(ctx, r = _dwt_checkirq());
+    return r;
+}
+
+uint8 dwt_checkirq(void)
+{
+    return dwt_ctx_checkirq(pdw1000local);
+}
+
+void dwt_ctx_isr(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_isr());
+}
+
+void dwt_isr(void)
+{
+    dwt_ctx_isr(pdw1000local);
+}
+
+void dwt_ctx_lowpowerlistenisr(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_lowpowerlistenisr());
+}
+
+void dwt_lowpowerlistenisr(void)
+{
+    dwt_ctx_lowpowerlistenisr(pdw1000local);
+}
+
+void dwt_ctx_setleds(dwt_ctx_t *ctx, uint8 mode)
+{
+    DWT_CTX_CALL(ctx, _dwt_setleds(mode));
+}
+
+void dwt_setleds(uint8 mode)
+{
+    dwt_ctx_setleds(pdw1000local, mode);
+}
+
+void dwt_ctx_setdelayedtrxtime(dwt_ctx_t *ctx, uint32 starttime)
+{
+    DWT_CTX_CALL(ctx, _dwt_setdelayedtrxtime(starttime));
+}
+
+void dwt_setdelayedtrxtime(uint32 starttime)
+{
+    dwt_ctx_setdelayedtrxtime(pdw1000local, starttime);
+}
+
+int dwt_ctx_starttx(dwt_ctx_t *ctx, uint8 mode)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_starttx(mode));
+    return r;
+}
+
+int dwt_starttx(uint8 mode)
+{
+    return dwt_ctx_starttx(pdw1000local, mode);
+}
+
+void dwt_ctx_forcetrxoff(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_forcetrxoff());
+}
+
+void dwt_forcetrxoff(void)
+{
+    dwt_ctx_forcetrxoff(pdw1000local);
+}
+
+void dwt_ctx_syncrxbufptrs(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_syncrxbufptrs());
+}
+
+void dwt_syncrxbufptrs(void)
+{
+    dwt_ctx_syncrxbufptrs(pdw1000local);
+}
+
+void dwt_ctx_setsniffmode(dwt_ctx_t *ctx, int enable, uint8 timeOn, uint8 timeOff)
+{
+    DWT_CTX_CALL(ctx, _dwt_setsniffmode(enable, timeOn, timeOff));
+}
+
+void dwt_setsniffmode(int enable, uint8 timeOn, uint8 timeOff)
+{
+    dwt_ctx_setsniffmode(pdw1000local, enable, timeOn, timeOff);
+}
+
+void dwt_ctx_setlowpowerlistening(dwt_ctx_t *ctx, int enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_setlowpowerlistening(enable));
+}
+
+void dwt_setlowpowerlistening(int enable)
+{
+    dwt_ctx_setlowpowerlistening(pdw1000local, enable);
+}
+
+void dwt_ctx_setsnoozetime(dwt_ctx_t *ctx, uint8 snooze_time)
+{
+    DWT_CTX_CALL(ctx, _dwt_setsnoozetime(snooze_time));
+}
+
+void dwt_setsnoozetime(uint8 snooze_time)
+{
+    dwt_ctx_setsnoozetime(pdw1000local, snooze_time);
+}
+
+int dwt_ctx_rxenable(dwt_ctx_t *ctx, int mode)
+{
+    int r;
+    DWT_CTX_CALL(ctx, r = _dwt_rxenable(mode));
+    return r;
+}
+
+int dwt_rxenable(int mode)
+{
+    return dwt_ctx_rxenable(pdw1000local, mode);
+}
+
+void dwt_ctx_setrxtimeout(dwt_ctx_t *ctx, uint16 time)
+{
+    DWT_CTX_CALL(ctx, _dwt_setrxtimeout(time));
+}
+
+void dwt_setrxtimeout(uint16 time)
+{
+    dwt_ctx_setrxtimeout(pdw1000local, time);
+}
+
+void dwt_ctx_setpreambledetecttimeout(dwt_ctx_t *ctx, uint16 timeout)
+{
+    DWT_CTX_CALL(ctx, _dwt_setpreambledetecttimeout(timeout));
+}
+
+void dwt_setpreambledetecttimeout(uint16 timeout)
+{
+    dwt_ctx_setpreambledetecttimeout(pdw1000local, timeout);
+}
+
+void dwt_ctx_setinterrupt(dwt_ctx_t *ctx, uint32 bitmask, uint8 enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_setinterrupt(bitmask, enable));
+}
+
+void dwt_setinterrupt(uint32 bitmask, uint8 enable)
+{
+    dwt_ctx_setinterrupt(pdw1000local, bitmask, enable);
+}
+
+void dwt_ctx_configeventcounters(dwt_ctx_t *ctx, int enable)
+{
+    DWT_CTX_CALL(ctx, _dwt_configeventcounters(enable));
+}
+
+void dwt_configeventcounters(int enable)
+{
+    dwt_ctx_configeventcounters(pdw1000local, enable);
+}
+
+void dwt_ctx_readeventcounters(dwt_ctx_t *ctx, dwt_deviceentcnts_t *counters)
+{
+    DWT_CTX_CALL(ctx, _dwt_readeventcounters(counters));
+}
+
+void dwt_readeventcounters(dwt_deviceentcnts_t *counters)
+{
+    dwt_ctx_readeventcounters(pdw1000local, counters);
+}
+
+void dwt_ctx_rxreset(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_rxreset());
+}
+
+void dwt_rxreset(void)
+{
+    dwt_ctx_rxreset(pdw1000local);
+}
+
+void dwt_ctx_softreset(dwt_ctx_t *ctx)
+{
+    DWT_CTX_CALL(ctx, _dwt_softreset());
+}
+
+void dwt_softreset(void)
+{
+    dwt_ctx_softreset(pdw1000local);
+}
+
+void dwt_ctx_setxtaltrim(dwt_ctx_t *ctx, uint8 value)
+{
+    DWT_CTX_CALL(ctx, _dwt_setxtaltrim(value));
+}
+
+void dwt_setxtaltrim(uint8 value)
+{
+    dwt_ctx_setxtaltrim(pdw1000local, value);
+}
+
+uint8 dwt_ctx_getinitxtaltrim(dwt_ctx_t *ctx)
+{
+    uint8 r;
+    DWT_CTX_CALL(ctx, r = _dwt_getinitxtaltrim());
+    return r;
+}
+
+uint8 dwt_getinitxtaltrim(void)
+{
+    return dwt_ctx_getinitxtaltrim(pdw1000local);
+}
+
+void dwt_ctx_configcwmode(dwt_ctx_t *ctx, uint8 chan)
+{
+    DWT_CTX_CALL(ctx, _dwt_configcwmode(chan));
+}
+
+void dwt_configcwmode(uint8 chan)
+{
+    dwt_ctx_configcwmode(pdw1000local, chan);
+}
+
+void dwt_ctx_configcontinuousframemode(dwt_ctx_t *ctx, uint32 framerepetitionrate)
+{
+    DWT_CTX_CALL(ctx, _dwt_configcontinuousframemode(framerepetitionrate));
+}
+
+void dwt_configcontinuousframemode(uint32 framerepetitionrate)
+{
+    dwt_ctx_configcontinuousframemode(pdw1000local, framerepetitionrate);
+}
+
+uint16 dwt_ctx_readtempvbat(dwt_ctx_t *ctx, uint8 fastSPI)
+{
+    uint16 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readtempvbat(fastSPI));
+    return r;
+}
+
+uint16 dwt_readtempvbat(uint8 fastSPI)
+{
+    return dwt_ctx_readtempvbat(pdw1000local, fastSPI);
+}
+
+uint8 dwt_ctx_readwakeuptemp(dwt_ctx_t *ctx)
+{
+    uint8 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readwakeuptemp());
+    return r;
+}
+
+uint8 dwt_readwakeuptemp(void)
+{
+    return dwt_ctx_readwakeuptemp(pdw1000local);
+}
+
+uint8 dwt_ctx_readwakeupvbat(dwt_ctx_t *ctx)
+{
+    uint8 r;
+    DWT_CTX_CALL(ctx, r = _dwt_readwakeupvbat());
+    return r;
+}
+
+uint8 dwt_readwakeupvbat(void)
+{
+    return dwt_ctx_readwakeupvbat(pdw1000local);
+}
+
+uint32 dwt_ctx_calcbandwidthtempadj(dwt_ctx_t *ctx, uint16 target_count)
+{
+    uint32 r;
+    DWT_CTX_CALL(ctx, r = _dwt_calcbandwidthtempadj(target_count));
+    return r;
+}
+
+uint32 dwt_calcbandwidthtempadj(uint16 target_count)
+{
+    return dwt_ctx_calcbandwidthtempadj(pdw1000local, target_count);
+}
+
+uint16 dwt_ctx_calcpgcount(dwt_ctx_t *ctx, uint8 pgdly)
+{
+    uint16 r;
+    DWT_CTX_CALL(ctx, r = _dwt_calcpgcount(pgdly));
+    return r;
+}
+
+uint16 dwt_calcpgcount(uint8 pgdly)
+{
+    return dwt_ctx_calcpgcount(pdw1000local, pgdly);
+}
+
 /* ===============================================================================================
    List of expected (known) device ID handled by this software
    ===============================================================================================
@@ -64,6 +64,8 @@ typedef signed long int32;
 #define DWT_NUM_DW_DEV (1)
 #endif
 
+typedef struct dwt_ctx dwt_ctx_t;   // One device of the context API, see dwt_getctx()
+
 #define DWT_SUCCESS (0)
 #define DWT_ERROR   (-1)
 
@@ -285,6 +287,7 @@ typedef struct
  * @fn dwt_setlocaldataptr()
  *
  * @brief This function sets the local data structure pointer to point to the element in the local array as given by the index.
+ *        The pointer is kept per thread: a thread that calls this keeps driving that device whatever other threads select.
  *
  * input parameters
  * @param index    - selects the array element to point to. Must be within the array bounds, i.e. < DWT_NUM_DW_DEV
@@ -295,6 +298,27 @@ typedef struct
  */
 int dwt_setlocaldataptr(unsigned int index);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_getctx()
+ *
+ * @brief This function returns the context of the device in local data slot index. A context names one device
+ * explicitly: dwt_ctx_xxx(ctx, ...) does what dwt_xxx(...) does, on device ctx and with the device locked for the whole
+ * call, so different threads can drive the same device (e.g. dwt_isr() on an IRQ thread while another thread reads the
+ * temperature or schedules a TX) without interleaving their SPI transactions. The dwt_xxx(...) functions are wrappers
+ * of dwt_ctx_xxx(...) on the device selected with dwt_setlocaldataptr() in the calling thread.
+ *
+ * Sequences of calls that must not be interleaved with other threads can be bracketed with decamutexon() and
+ * decamutexoff() after selecting the device. The lock is recursive, so the callbacks of dwt_isr() can use the API.
+ *
+ * input parameters
+ * @param index    - local data slot, < DWT_NUM_DW_DEV
+ *
+ * output parameters
+ *
+ * returns the context, or NULL if index is outside the array bounds
+ */
+dwt_ctx_t *dwt_getctx(unsigned int index);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_getpartid()
  *
@@ -1270,6 +1294,27 @@ void dwt_readrxdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset);
  */
 void dwt_readaccdata(uint8 *buffer, uint16 length, uint16 rxBufferOffset);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_readaccdatabulk()
+ *
+ * @brief This is used to read a whole window of the Accumulator buffer with the ACC clocks forced on only once.
+ *        The window is read in as few chunks as the platform's maximum SPI access length allows and all chunks are
+ *        submitted together with the clock switching as a batch, see dwt_batchsubmit().
+ *
+ * NOTE: Unlike dwt_readaccdata(), the dummy octet of each chunk is clocked in as part of the SPI header and dropped, so
+ *       'buffer' receives exactly 'len' accumulator bytes.
+ *
+ * input parameters
+ * @param buffer - the buffer into which the data will be read, at least 'len' bytes
+ * @param len - the length of data to read (in bytes)
+ * @param accOffset - the offset in the acc buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int dwt_readaccdatabulk(uint8 *buffer, uint16 len, uint16 accOffset);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_readcarrierintegrator()
  *
@@ -1354,6 +1399,21 @@ void dwt_configeventcounters(int enable);
  */
 void dwt_readeventcounters(dwt_deviceentcnts_t *counters);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_shadowmismatches()
+ *
+ * @brief This is used to check the driver's shadow copies of the host-owned registers (SYS_CFG, SYS_MASK, GPIO_MODE,
+ *        PMSC_CTRL0 and PMSC_CTRL1), which let read-modify-write sequences skip the SPI read. When the driver is built
+ *        with DWT_SHADOW_VERIFY each shadow read is compared against the device and disagreements are counted.
+ *
+ * input parameters
+ *
+ * output parameters
+ *
+ * returns the number of mismatches since dwt_initialise(), always 0 without DWT_SHADOW_VERIFY
+ */
+uint32 dwt_shadowmismatches(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn dwt_otpwriteandverify()
  *
@@ -1706,6 +1766,216 @@ uint8 dwt_read8bitoffsetreg(int regFileID, int regOffset);
  */
 void dwt_write8bitoffsetreg(int regFileID, int regOffset, uint8 regval);
 
+/****************************************************************************************************************************************************
+ *
+ * Batched register access. Accesses are queued in a dwt_batch_t and handed to the platform in one transferspi() call when the
+ * batch is submitted, each access framed by its own chip select. The batch must stay at the same address until it is submitted.
+ *
+ ****************************************************************************************************************************************************/
+
+#define DWT_BATCH_MAX_ACCESSES  (16)    // Maximum number of register accesses queued in one batch
+
+// One chip select framed register access, as passed to transferspi()
+typedef struct
+{
+    uint8       header[4] ;         // SPI header selecting direction, register file and sub-index, plus an optional dummy byte
+    uint16      headerLength ;      // Number of header bytes
+    uint8       write ;             // 1 to write 'length' bytes from buffer, 0 to read them into buffer
+    uint32      length ;            // Number of data bytes
+    uint8       *buffer ;           // Data to write, or buffer receiving the read data
+} dwt_spiaccess_t ;
+
+typedef struct
+{
+    uint16          count ;                                 // Number of queued accesses
+    uint8           overflow ;                              // Set when an access did not fit in the batch
+    dwt_spiaccess_t access[DWT_BATCH_MAX_ACCESSES] ;
+    uint8           regval[DWT_BATCH_MAX_ACCESSES][4] ;     // Register values written or read by the 8/16/32-bit accessors
+    void            *result[DWT_BATCH_MAX_ACCESSES] ;       // Where to unpack register reads, NULL for raw accesses
+    uint8           resultWidth[DWT_BATCH_MAX_ACCESSES] ;   // Width of the unpacked value in bytes (1, 2 or 4)
+} dwt_batch_t ;
+
+// Raw RX frame information, read in one batch with dwt_batchreadrxinfo()
+typedef struct
+{
+    uint32      finfo ;             // RX_FINFO
+    uint8       rxtime[14] ;        // RX_TIME: RX_STAMP (5 bytes), FP_INDEX, FP_AMPL1, RX_RAWST (5 bytes)
+    uint8       fqual[8] ;          // RX_FQUAL: STD_NOISE, FP_AMPL2, FP_AMPL3, CIR_PWR
+    uint16      maxNoise ;          // LDE_THRESH
+} dwt_rxinfo_t ;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchinit()
+ *
+ * @brief  this function empties a batch so that register accesses can be queued into it
+ *
+ * input parameters:
+ * @param batch - the batch to initialise
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_batchinit(dwt_batch_t *batch);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchwritetodevice()
+ *
+ * @brief  this function queues a write to the DW1000 device registers, see dwt_writetodevice()
+ *         The data are not copied, 'buffer' must remain valid until the batch is submitted.
+ *
+ * input parameters:
+ * @param batch         - the batch to queue the access in
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being written
+ * @param buffer        - pointer to buffer containing the 'length' bytes to be written
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchwritetodevice(dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchreadfromdevice()
+ *
+ * @brief  this function queues a read from the DW1000 device registers, see dwt_readfromdevice()
+ *         'buffer' is filled when the batch is submitted.
+ *
+ * input parameters:
+ * @param batch         - the batch to queue the access in
+ * @param recordNumber  - ID of register file or buffer being accessed
+ * @param index         - byte index into register file or buffer being accessed
+ * @param length        - number of bytes being read
+ * @param buffer        - pointer to buffer in which to return the read data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchreadfromdevice(dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchread32bitoffsetreg()
+ *
+ * @brief  batch variants of dwt_read32bitoffsetreg(), dwt_read16bitoffsetreg() and dwt_read8bitoffsetreg()
+ *         '*regval' is set when the batch is submitted.
+ *
+ * input parameters:
+ * @param batch     - the batch to queue the access in
+ * @param regFileID - ID of register file or buffer being accessed
+ * @param regOffset - the index into register file or buffer being accessed
+ * @param regval    - where to store the register value
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchread32bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint32 *regval);
+int dwt_batchread16bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint16 *regval);
+int dwt_batchread8bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 *regval);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchwrite32bitoffsetreg()
+ *
+ * @brief  batch variants of dwt_write32bitoffsetreg(), dwt_write16bitoffsetreg() and dwt_write8bitoffsetreg()
+ *         The value is copied into the batch.
+ *
+ * input parameters:
+ * @param batch     - the batch to queue the access in
+ * @param regFileID - ID of register file or buffer being accessed
+ * @param regOffset - the index into register file or buffer being accessed
+ * @param regval    - the value to write
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchwrite32bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint32 regval);
+int dwt_batchwrite16bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint16 regval);
+int dwt_batchwrite8bitoffsetreg(dwt_batch_t *batch, int regFileID, int regOffset, uint8 regval);
+
+#define dwt_batchwrite32bitreg(b,x,y)   dwt_batchwrite32bitoffsetreg(b,x,0,y)
+#define dwt_batchread32bitreg(b,x,y)    dwt_batchread32bitoffsetreg(b,x,0,y)
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchreadrxdata()
+ *
+ * @brief batch variant of dwt_readrxdata()
+ *
+ * input parameters
+ * @param batch - the batch to queue the access in
+ * @param buffer - the buffer into which the data will be read
+ * @param length - the length of data to read (in bytes)
+ * @param rxBufferOffset - the offset in the rx buffer from which to read the data
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchreadrxdata(dwt_batch_t *batch, uint8 *buffer, uint16 length, uint16 rxBufferOffset);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchrxreset()
+ *
+ * @brief batch variant of dwt_rxreset()
+ *
+ * input parameters:
+ * @param batch - the batch to queue the accesses in
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchrxreset(dwt_batch_t *batch);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchreadrxinfo()
+ *
+ * @brief  this function queues the reads of the frame information, RX timestamps and diagnostics of the last frame received,
+ *         so that they take no SPI transaction of their own. 'info' is filled when the batch is submitted, see
+ *         dwt_rxinfodiagnostics() to unpack it.
+ *
+ * input parameters:
+ * @param batch - the batch to queue the accesses in
+ * @param info - the structure receiving the registers
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch is full
+ */
+int dwt_batchreadrxinfo(dwt_batch_t *batch, dwt_rxinfo_t *info);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_rxinfodiagnostics()
+ *
+ * @brief  this function unpacks the RX signal quality diagnostic data read by dwt_batchreadrxinfo(), it performs no SPI access
+ *
+ * input parameters:
+ * @param info - the registers read
+ * @param diagnostics - diagnostic structure pointer, this will contain the same data as after dwt_readdiagnostics()
+ *
+ * output parameters
+ *
+ * no return value
+ */
+void dwt_rxinfodiagnostics(const dwt_rxinfo_t *info, dwt_rxdiag_t *diagnostics);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dwt_batchsubmit()
+ *
+ * @brief  this function performs all queued accesses in order, unpacks the register values read and empties the batch
+ *
+ * input parameters:
+ * @param batch - the batch to submit
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR if the batch overflowed or the SPI transfer failed
+ */
+int dwt_batchsubmit(dwt_batch_t *batch);
+
 
 /****************************************************************************************************************************************************
  *
@@ -1762,6 +2032,145 @@ int writetospi(uint16 headerLength, const uint8 *headerBuffer, uint32 bodylength
  */
 int readfromspi(uint16 headerLength, const uint8 *headerBuffer, uint32 readlength, uint8 *readBuffer);
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn transferspi()
+ *
+ * @brief
+ * Low level abstract function to perform several register accesses in as few bus submissions as the platform allows.
+ * Each access is framed by its own chip select and the accesses are performed in order.
+ *
+ * Note: The body of this function is platform specific
+ *
+ * input parameters:
+ * @param count   - number of accesses
+ * @param access  - the accesses to perform, see dwt_spiaccess_t
+ *
+ * output parameters
+ *
+ * returns DWT_SUCCESS for success, or DWT_ERROR for error
+ */
+int transferspi(uint16 count, const dwt_spiaccess_t *access);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spimaxlength()
+ *
+ * @brief
+ * Low level abstract function returning the maximum number of bytes, header included, of one SPI access.
+ * Longer reads and writes must be split by the caller.
+ *
+ * Note: The body of this function is platform specific
+ *
+ * input parameters:
+ *
+ * output parameters
+ *
+ * returns the maximum access length in bytes
+ */
+uint32 spimaxlength(void);
+
+// ---------------------------------------------------------------------------
+//
+// Context API: dwt_ctx_xxx(ctx, ...) is dwt_xxx(...) run on device ctx with the device locked, see dwt_getctx().
+//
+// ---------------------------------------------------------------------------
+
+int dwt_ctx_initialise(dwt_ctx_t *ctx, uint16 config);
+uint8 dwt_ctx_otprevision(dwt_ctx_t *ctx);
+void dwt_ctx_setfinegraintxseq(dwt_ctx_t *ctx, int enable);
+void dwt_ctx_setlnapamode(dwt_ctx_t *ctx, int lna, int pa);
+void dwt_ctx_setgpiodirection(dwt_ctx_t *ctx, uint32 gpioNum, uint32 direction);
+void dwt_ctx_setgpiovalue(dwt_ctx_t *ctx, uint32 gpioNum, uint32 value);
+uint32 dwt_ctx_getpartid(dwt_ctx_t *ctx);
+uint32 dwt_ctx_getlotid(dwt_ctx_t *ctx);
+uint32 dwt_ctx_readdevid(dwt_ctx_t *ctx);
+void dwt_ctx_configuretxrf(dwt_ctx_t *ctx, dwt_txconfig_t *config);
+void dwt_ctx_configure(dwt_ctx_t *ctx, dwt_config_t *config);
+void dwt_ctx_setrxantennadelay(dwt_ctx_t *ctx, uint16 rxDelay);
+void dwt_ctx_settxantennadelay(dwt_ctx_t *ctx, uint16 txDelay);
+int dwt_ctx_writetxdata(dwt_ctx_t *ctx, uint16 txFrameLength, uint8 *txFrameBytes, uint16 txBufferOffset);
+void dwt_ctx_writetxfctrl(dwt_ctx_t *ctx, uint16 txFrameLength, uint16 txBufferOffset, int ranging);
+void dwt_ctx_readrxdata(dwt_ctx_t *ctx, uint8 *buffer, uint16 length, uint16 rxBufferOffset);
+void dwt_ctx_readaccdata(dwt_ctx_t *ctx, uint8 *buffer, uint16 len, uint16 accOffset);
+int dwt_ctx_readaccdatabulk(dwt_ctx_t *ctx, uint8 *buffer, uint16 len, uint16 accOffset);
+int32 dwt_ctx_readcarrierintegrator(dwt_ctx_t *ctx);
+void dwt_ctx_readdiagnostics(dwt_ctx_t *ctx, dwt_rxdiag_t *diagnostics);
+void dwt_ctx_readtxtimestamp(dwt_ctx_t *ctx, uint8 *timestamp);
+uint32 dwt_ctx_readtxtimestamphi32(dwt_ctx_t *ctx);
+uint32 dwt_ctx_readtxtimestamplo32(dwt_ctx_t *ctx);
+void dwt_ctx_readrxtimestamp(dwt_ctx_t *ctx, uint8 *timestamp);
+uint32 dwt_ctx_readrxtimestamphi32(dwt_ctx_t *ctx);
+uint32 dwt_ctx_readrxtimestamplo32(dwt_ctx_t *ctx);
+uint32 dwt_ctx_readsystimestamphi32(dwt_ctx_t *ctx);
+void dwt_ctx_readsystime(dwt_ctx_t *ctx, uint8 *timestamp);
+void dwt_ctx_writetodevice(dwt_ctx_t *ctx, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer);
+void dwt_ctx_readfromdevice(dwt_ctx_t *ctx, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer);
+uint32 dwt_ctx_shadowmismatches(dwt_ctx_t *ctx);
+uint32 dwt_ctx_read32bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset);
+uint16 dwt_ctx_read16bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset);
+uint8 dwt_ctx_read8bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset);
+void dwt_ctx_write8bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset, uint8 regval);
+void dwt_ctx_write16bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset, uint16 regval);
+void dwt_ctx_write32bitoffsetreg(dwt_ctx_t *ctx, int regFileID, int regOffset, uint32 regval);
+int dwt_ctx_batchwritetodevice(dwt_ctx_t *ctx, dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, const uint8 *buffer);
+int dwt_ctx_batchreadfromdevice(dwt_ctx_t *ctx, dwt_batch_t *batch, uint16 recordNumber, uint16 index, uint32 length, uint8 *buffer);
+int dwt_ctx_batchread32bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint32 *regval);
+int dwt_ctx_batchread16bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint16 *regval);
+int dwt_ctx_batchread8bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint8 *regval);
+int dwt_ctx_batchwrite32bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint32 regval);
+int dwt_ctx_batchwrite16bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint16 regval);
+int dwt_ctx_batchwrite8bitoffsetreg(dwt_ctx_t *ctx, dwt_batch_t *batch, int regFileID, int regOffset, uint8 regval);
+int dwt_ctx_batchreadrxdata(dwt_ctx_t *ctx, dwt_batch_t *batch, uint8 *buffer, uint16 length, uint16 rxBufferOffset);
+int dwt_ctx_batchrxreset(dwt_ctx_t *ctx, dwt_batch_t *batch);
+int dwt_ctx_batchreadrxinfo(dwt_ctx_t *ctx, dwt_batch_t *batch, dwt_rxinfo_t *info);
+int dwt_ctx_batchsubmit(dwt_ctx_t *ctx, dwt_batch_t *batch);
+void dwt_ctx_enableframefilter(dwt_ctx_t *ctx, uint16 enable);
+void dwt_ctx_setpanid(dwt_ctx_t *ctx, uint16 panID);
+void dwt_ctx_setaddress16(dwt_ctx_t *ctx, uint16 shortAddress);
+void dwt_ctx_seteui(dwt_ctx_t *ctx, uint8 *eui64);
+void dwt_ctx_geteui(dwt_ctx_t *ctx, uint8 *eui64);
+void dwt_ctx_otpread(dwt_ctx_t *ctx, uint32 address, uint32 *array, uint8 length);
+int dwt_ctx_otpwriteandverify(dwt_ctx_t *ctx, uint32 value, uint16 address);
+void dwt_ctx_entersleep(dwt_ctx_t *ctx);
+void dwt_ctx_configuresleepcnt(dwt_ctx_t *ctx, uint16 sleepcnt);
+uint16 dwt_ctx_calibratesleepcnt(dwt_ctx_t *ctx);
+void dwt_ctx_configuresleep(dwt_ctx_t *ctx, uint16 mode, uint8 wake);
+void dwt_ctx_entersleepaftertx(dwt_ctx_t *ctx, int enable);
+int dwt_ctx_spicswakeup(dwt_ctx_t *ctx, uint8 *buff, uint16 length);
+void dwt_ctx_loadopsettabfromotp(dwt_ctx_t *ctx, uint8 ops_sel);
+void dwt_ctx_setsmarttxpower(dwt_ctx_t *ctx, int enable);
+void dwt_ctx_enableautoack(dwt_ctx_t *ctx, uint8 responseDelayTime);
+void dwt_ctx_setdblrxbuffmode(dwt_ctx_t *ctx, int enable);
+void dwt_ctx_setrxaftertxdelay(dwt_ctx_t *ctx, uint32 rxDelayTime);
+void dwt_ctx_setcallbacks(dwt_ctx_t *ctx, dwt_cb_t cbTxDone, dwt_cb_t cbRxOk, dwt_cb_t cbRxTo, dwt_cb_t cbRxErr);
+uint8 dwt_ctx_checkirq(dwt_ctx_t *ctx);
+void dwt_ctx_isr(dwt_ctx_t *ctx);
+void dwt_ctx_lowpowerlistenisr(dwt_ctx_t *ctx);
+void dwt_ctx_setleds(dwt_ctx_t *ctx, uint8 mode);
+void dwt_ctx_setdelayedtrxtime(dwt_ctx_t *ctx, uint32 starttime);
+int dwt_ctx_starttx(dwt_ctx_t *ctx, uint8 mode);
+void dwt_ctx_forcetrxoff(dwt_ctx_t *ctx);
+void dwt_ctx_syncrxbufptrs(dwt_ctx_t *ctx);
+void dwt_ctx_setsniffmode(dwt_ctx_t *ctx, int enable, uint8 timeOn, uint8 timeOff);
+void dwt_ctx_setlowpowerlistening(dwt_ctx_t *ctx, int enable);
+void dwt_ctx_setsnoozetime(dwt_ctx_t *ctx, uint8 snooze_time);
+int dwt_ctx_rxenable(dwt_ctx_t *ctx, int mode);
+void dwt_ctx_setrxtimeout(dwt_ctx_t *ctx, uint16 time);
+void dwt_ctx_setpreambledetecttimeout(dwt_ctx_t *ctx, uint16 timeout);
+void dwt_ctx_setinterrupt(dwt_ctx_t *ctx, uint32 bitmask, uint8 enable);
+void dwt_ctx_configeventcounters(dwt_ctx_t *ctx, int enable);
+void dwt_ctx_readeventcounters(dwt_ctx_t *ctx, dwt_deviceentcnts_t *counters);
+void dwt_ctx_rxreset(dwt_ctx_t *ctx);
+void dwt_ctx_softreset(dwt_ctx_t *ctx);
+void dwt_ctx_setxtaltrim(dwt_ctx_t *ctx, uint8 value);
+uint8 dwt_ctx_getinitxtaltrim(dwt_ctx_t *ctx);
+void dwt_ctx_configcwmode(dwt_ctx_t *ctx, uint8 chan);
+void dwt_ctx_configcontinuousframemode(dwt_ctx_t *ctx, uint32 framerepetitionrate);
+uint16 dwt_ctx_readtempvbat(dwt_ctx_t *ctx, uint8 fastSPI);
+uint8 dwt_ctx_readwakeuptemp(dwt_ctx_t *ctx);
+uint8 dwt_ctx_readwakeupvbat(dwt_ctx_t *ctx);
+uint32 dwt_ctx_calcbandwidthtempadj(dwt_ctx_t *ctx, uint16 target_count);
+uint16 dwt_ctx_calcpgcount(dwt_ctx_t *ctx, uint8 pgdly);
+
 // ---------------------------------------------------------------------------
 //
 // NB: The purpose of the deca_mutex.c file is to provide for microprocessor interrupt enable/disable, this is used for
@@ -1812,6 +2221,23 @@ decaIrqStatus_t decamutexon(void) ;
  */
 void decamutexoff(decaIrqStatus_t s) ;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn decaselectdevice()
+ *
+ * @brief This function routes the SPI accesses and the decamutexon() lock of the calling thread to device index. It is
+ * called by the context API around each call.
+ *
+ * Note: The body of this function is platform specific
+ *
+ * input parameters:
+ * @param index - local data slot of the device, < DWT_NUM_DW_DEV
+ *
+ * output parameters
+ *
+ * returns the previously selected device, or -1 if index is outside the array bounds (nothing is changed)
+ */
+int decaselectdevice(int index) ;
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn deca_sleep()
  *
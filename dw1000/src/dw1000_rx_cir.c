@@ -30,10 +30,19 @@
 #include <stdint.h>
 #include <string.h> // memset
 #include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <math.h>
 
 #include "deca_device_api.h"
 #include "deca_regs.h"
 #include "platform.h"
+#include "cir_record.h"
+#include "cir_writer.h"
+#include "cir_capture.h"
+#include "cir_features.h"
+#include "time_sync.h"
 
 /* Example application name and version to display on LCD screen. */
 #define APP_NAME "HEADCOUNT RX v2.0"
@@ -58,8 +67,9 @@ static dwt_config_t config = {
 
 /* Buffer to store received frame. See NOTE 1 below. */
 #define FRAME_LEN_MAX 127   // Just make sure it contains all the info
-#define RX_BUF_LEN 12   // The same length as tx_msg
+#define RX_BUF_LEN SYNC_BEACON_LEN   // The longest frame of dw1000_tx, a time sync beacon
 static uint8 rx_buffer[RX_BUF_LEN];
+static dwt_rxinfo_t rx_info;   // RX timestamps and diagnostics of the frame in rx_buffer, see NOTE 12 below
 
 typedef unsigned long long uint64;
 typedef signed long long int64;
@@ -70,17 +80,30 @@ static uint32 status_reg = 0;
 /* Hold copy of frame length of frame received (if good) so that it can be examined at a debug breakpoint. */
 static uint16 frame_len = 0;
 
-struct cir_tap_struct {
-    uint16 real;
-    uint16 img;
-}; // 4 bytes
+#define TIMEOUT 5   // timeout of the loop
 
-#define CIR_SAMPLES 1016 //1016
-// 992 samples for 16MHz PRF - 3968 bytes
-// 1016 samples for 64MHz PRF - 4064 bytes
+#define IRQ_WAIT_MS 100   // longest sleep on the IRQ line before checking for a stop request
 
-#define ACC_CHUNK 64 // bytes read at the same time
-#define TIMEOUT 5   // timeout of the loop
+/* Set by SIGINT/SIGTERM to leave the receive loop and flush the records still queued for the disk. */
+static volatile sig_atomic_t stop_requested = 0;
+
+/* Set by SIGUSR1 to keep the whole records of the next frames of a feature capture, see NOTE 13 below. */
+static volatile sig_atomic_t keep_requested = 0;
+
+#define FEATURES_BACKGROUND 100   // frames averaged before the background model of a feature capture is used
+#define FEATURES_ON_DEMAND 100    // whole records kept per SIGUSR1
+
+static void on_stop_signal(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+static void on_keep_signal(int sig)
+{
+    (void) sig;
+    keep_requested = 1;
+}
 
 static void setup_dw1000(void) {
     
@@ -99,95 +122,141 @@ static void setup_dw1000(void) {
     
     /* Configure DW1000. See NOTE 7 below. */
     dwt_configure(&config);
+    spi_stats_reset(); /* Only count the frame cycles, see spi_stats_dump(). */
     
     printf("%s\n", APP_NAME);
 }
 
-void copyCIRToBuffer(uint8 *buffer, uint16 len)
-{
-    int loc = 0;
-    uint16 toRead = 0;
-    int lastRead = 0;
-
-    // we need to create a buffer to discard the dummy byte
-    uint8 buf[ACC_CHUNK+1];
-    
-    while(1)
-    {
+/* Capture state shared by the polled and the interrupt driven receivers. */
+static cir_writer_t *writer = NULL;
+static uint16 cir_window = 0;   // half window in taps, 0 for the whole accumulator
+static int compress = 0;        // code the records with cir_codec.h, see NOTE 14 below
+static uint64 seq = 0;          // last sequence number saved
+static time_sync_t sync_state;  // clock of the beacon sender, see NOTE 11 below
 
-        memset((void *) buf, 0, ACC_CHUNK + 1);
+/* Feature capture, see NOTE 13 below */
+static int features_on = 0;
+static cir_features_config_t features_config = { 0, FEATURES_BACKGROUND, DWT_PRF_64M, CIR_BACKGROUND_ALPHA,
+                                                  CIR_BACKGROUND_GATE };
+static cir_features_t features;
+static cir_writer_t *feature_writer = NULL;
+static cir_record_t *scratch = NULL;    // record of the frames whose whole record is not kept
 
-        if(len > ACC_CHUNK)
-        {
-            // need to loop again
-            // only read the max allowable number of characters
-            toRead = ACC_CHUNK;
-        }
-        else
-        {
-            // we will cover the entire length in this iteration of the loop
-            // only read the remaining length
-            toRead = len;
-            lastRead = 1;
-        }
+/* Set by the RX callbacks once dwt_isr() has handled the event the receiver was waiting for. */
+static volatile int rx_done = 0;
 
-        // read from device
-        dwt_readaccdata(buf, toRead, loc);
+/* Telemetry thread, see NOTE 10 below. */
+static unsigned int telemetry_ms = 0;
 
-        // copy to the buffer
-        memcpy((void *) &buffer[loc], (void *) &buf[1], toRead);
+/* Continuous reception state, see NOTE 9 below. */
+static int continuous = 0;      // double buffered RX, re-enabled from the RX callbacks
+static uint16 over_count = 0;   // last value of the OVER event counter
+static unsigned long overruns = 0;
 
-        if(lastRead)
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn captureFrame()
+ *
+ * @brief Check the frame in rx_buffer and, for a new sequence number, queue its CIR to the storage thread. Must run
+ *        before the receiver is re-enabled, the accumulator is overwritten by the next reception.
+ *
+ * @return  none
+ */
+static void captureFrame(void)
+{
+    struct timespec tm_rx;
+    time_t time_rx;
+    struct tm *lctm;
+    uint64 seq_buffer = 0;
+    uint64_t rx_stamp;
+    cir_record_t *rec = NULL;
+    cir_feature_record_t *feat = NULL;
+    int keep = 1;
+    
+    /*  Check the MSG flag */
+    if (FLAG != rx_buffer[0])
+    {
+        return;
+    }
+    
+    /*  Get receive timestamps, on the host and on the DW1000 clock, and follow the clock of the beacon sender. */
+    clock_gettime(CLOCK_REALTIME, &tm_rx);
+    rx_stamp = rxInfoTimestamp(&rx_info);
+    time_sync_frame(&sync_state, rx_buffer, frame_len, rx_stamp, &config);
+    
+    /*  Get sequence number to the local buffer. */
+    memcpy((void *) &seq_buffer, (void *) &rx_buffer[FLAG_IDX], sizeof(uint64));
+    if (seq >= seq_buffer)
+    {
+        return;
+    }
+    seq = seq_buffer;
+    time( &time_rx );
+    lctm = localtime( &time_rx );
+    printf("%llu MSG Received! Time: %i.%i.%i %i:%i:%i\n", seq, lctm->tm_year+1900, lctm->tm_mon, lctm->tm_mday, lctm->tm_hour, lctm->tm_min, lctm->tm_sec);
+    
+    /* With features the whole record is only kept for some frames, the others are reduced from a scratch record. */
+    if (features_on)
+    {
+        if (keep_requested)
         {
-            break;
+            keep_requested = 0;
+            cir_features_keep(&features, FEATURES_ON_DEMAND);
         }
-
-        // decrease remaining length
-        len = len - toRead;
-
-        // increase pointer in buffer
-        loc = loc + toRead;
+        keep = cir_features_keepnext(&features);
+        feat = cir_writer_acquire_feature(feature_writer);
     }
-}
-
-void saveCIRToFile(FILE *output_file, struct timespec *tm_rx, struct cir_tap_struct *cir)
-{
-    int i;
     
-    if (output_file == NULL){
-        printf("unable to write\n");
+    /* Never wait for the disk: if the ring is full the CIR is dropped and RX re-enabled at once. */
+    if (keep)
+    {
+        rec = cir_writer_acquire(writer);
     }
-    else {
-        fprintf(output_file, "%ld,%lu", tm_rx->tv_sec, tm_rx->tv_nsec);
-        for (i = 0; i < CIR_SAMPLES; i++)
+    if (rec == NULL)
+    {
+        if (feat == NULL)
         {
-            fprintf(output_file, ",%d,%d", cir[i].real, cir[i].img);
+            return;
         }
-        fprintf(output_file, "\n");
-        fflush(output_file);
-        printf("Saved\n");
+        rec = scratch;
     }
-}
-
-void receiver(FILE *fp){
-    /** Variable Define **/
-    struct timespec tm_rx;
-    time_t time_rx;
-    struct tm *lctm;
-    uint64 seq = 0;
-    uint64 seq_buffer = 0;
+    rec->seq = seq;
+    rec->rx_sec = tm_rx.tv_sec;
+    rec->rx_nsec = tm_rx.tv_nsec;
+    
+    /*  Get CIR to our local buffer, see NOTE 6 below. */
+    copyCIRToRecord(rec, cir_window, &rx_info);
+    time_sync_stamp(&sync_state, rec);
     
-    uint8 *cir_buffer;
-    cir_buffer = (uint8 *) malloc(4*CIR_SAMPLES);
-    if(cir_buffer == NULL)
+    /* The accumulator is not double buffered: a preamble detected since RX was re-enabled may have overwritten it. */
+    if (continuous && (dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_RXPRD))
     {
-        printf("Could not allocate memory\r\n");
-        exit(1);
+        rec->flags |= CIR_RECORD_OVERLAP;
     }
-    struct cir_tap_struct *cir = (struct cir_tap_struct *) &cir_buffer[0];
+    
+    if (feat != NULL)
+    {
+        cir_features_extract(&features, rec, 0, feat);
+        if (rec != scratch)
+        {
+            feat->flags |= CIR_FEATURE_FULL;
+        }
+        cir_writer_commit(feature_writer);
+    }
+    if (rec != scratch)
+    {
+        cir_writer_commit(writer);
+    }
+}
+
+/* Polled receiver: spins on SYS_STATUS, see NOTE 5 below. */
+static void receiverPolled(void)
+{
+    dwt_batch_t batch;
+    
+    dwt_batchinit(&batch);
     
     /** CIR Receiving Loop **/
-    while(1)
+    while(!stop_requested)
     {
         /* Clear local RX buffer to avoid having leftovers from previous receptions  This is not necessary but is included here to aid reading
          * the RX buffer.
@@ -195,9 +264,6 @@ void receiver(FILE *fp){
          * and if a good receive has happened the data buffer will have the data in it, and frame_len will be set to the length of the RX frame. */
         memset((void *) rx_buffer, 0, RX_BUF_LEN);
         
-        /* clear cir_buffer before next sampling. */
-        memset((void *) cir_buffer, 0, 4*CIR_SAMPLES);
-        
         /* Set timeout.
          * The time parameter used here is in 1.0256 us (512/499.2MHz) units.
             If set to 0 the timeout is disabled.*/
@@ -209,53 +275,273 @@ void receiver(FILE *fp){
          * STATUS register is 5 bytes long but, as the event we are looking at is in the first byte of the register, we can use this simplest API.
             function to access it. */
         while (!((status_reg = dwt_read32bitreg(SYS_STATUS_ID)) & (SYS_STATUS_RXFCG | SYS_STATUS_ALL_RX_ERR)))
-        { };
+        {
+            if (stop_requested)
+            {
+                break;
+            }
+        }
         
         if (status_reg & SYS_STATUS_RXFCG)
         {
-            /* Clear good RX frame event in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG);
+            /* Clear good RX frame event in the DW1000 status register, read the frame info, timestamps and diagnostics and
+             * speculatively copy a full RX_BUF_LEN frame to our local buffer, all in one SPI submission. */
+            dwt_batchwrite32bitreg(&batch, SYS_STATUS_ID, SYS_STATUS_RXFCG);
+            dwt_batchreadrxinfo(&batch, &rx_info);
+            dwt_batchreadrxdata(&batch, rx_buffer, RX_BUF_LEN, 0);
+            dwt_batchsubmit(&batch);
             
-            /* A frame has been received, copy it to our local buffer. */
-            frame_len = dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023;
+            /* Only keep the bytes of the frame actually received. */
+            frame_len = rx_info.finfo & RX_FINFO_RXFL_MASK_1023;
             if (frame_len <= RX_BUF_LEN)
             {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
+                memset((void *) &rx_buffer[frame_len], 0, RX_BUF_LEN - frame_len);
             }
-            
-            /*  Check the MSG flag */
-           if (FLAG==rx_buffer[0])
+            else
             {
-                /*  Get receive timestamp */
-                clock_gettime(CLOCK_REALTIME, &tm_rx);
-                
-                /*  Get sequence number to the local buffer. */
-                memcpy((void *) &seq_buffer, (void *) &rx_buffer[FLAG_IDX], sizeof(uint64));
-                if (seq<seq_buffer){
-                    seq = seq_buffer;
-                    time( &time_rx );
-                    lctm = localtime( &time_rx );
-                    printf("%llu MSG Received! Time: %i.%i.%i %i:%i:%i\n", seq, lctm->tm_year+1900, lctm->tm_mon, lctm->tm_mday, lctm->tm_hour, lctm->tm_min, lctm->tm_sec);
-                    
-                    /*  Get CIR to our local buffer. */
-                    copyCIRToBuffer((uint8 *) cir_buffer, 4*CIR_SAMPLES);
-                    
-                    saveCIRToFile(fp, &tm_rx, cir);
-                }
+                memset((void *) rx_buffer, 0, RX_BUF_LEN);
             }
+            
+            captureFrame();
         }
         else
         {
             /* Clear RX error events in the DW1000 status register. */
-            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
+            dwt_batchwrite32bitreg(&batch, SYS_STATUS_ID, SYS_STATUS_ALL_RX_ERR);
             
             /* Reset RX to properly reinitialise LDE operation. */
-            dwt_rxreset();
+            dwt_batchrxreset(&batch);
+            dwt_batchsubmit(&batch);
         }
     }
+}
+
+/* RX good frame callback, called from dwt_isr() once the status is cleared and the frame length read. */
+static void rxOkCallback(const dwt_cb_data_t *cb_data)
+{
+    static dwt_batch_t batch;
+    
+    status_reg = cb_data->status;
+    frame_len = cb_data->datalength;
+    memset((void *) rx_buffer, 0, RX_BUF_LEN);
     
-    cir = NULL;
-    free(cir_buffer);
+    if (continuous)
+    {
+        /* Both buffers were full, this one is unreliable. checkOverrun() restarts the receiver. */
+        if (status_reg & SYS_STATUS_RXOVRR)
+        {
+            return;
+        }
+        /* Keep listening into the other buffer while this one is drained, dwt_isr() toggles HRBT on return. */
+        dwt_rxenable(DWT_START_RX_IMMEDIATE | DWT_NO_SYNC_PTRS);
+    }
+    
+    /* The frame, its timestamps and its diagnostics in one SPI submission. */
+    dwt_batchinit(&batch);
+    dwt_batchreadrxinfo(&batch, &rx_info);
+    if (frame_len <= RX_BUF_LEN)
+    {
+        dwt_batchreadrxdata(&batch, rx_buffer, frame_len, 0);
+    }
+    dwt_batchsubmit(&batch);
+    
+    captureFrame();
+    rx_done = 1;
+}
+
+/* RX error and timeout callback, dwt_isr() has already cleared the events and reset the receiver. */
+static void rxErrCallback(const dwt_cb_data_t *cb_data)
+{
+    status_reg = cb_data->status;
+    if (continuous)
+    {
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+    rx_done = 1;
+}
+
+/* RX events routed to the IRQ line. */
+#define RX_EVENTS (DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE | DWT_INT_RFSL | DWT_INT_RFTO | DWT_INT_RXPTO | DWT_INT_SFDT \
+                   | DWT_INT_ARFE)
+
+/* Interrupt driven receiver: sleeps on the DW1000 IRQ line and dispatches through dwt_isr(). */
+static void receiverIrq(void)
+{
+    if (irq_init() != 0)
+    {
+        exit(1);
+    }
+    dwt_setcallbacks(NULL, &rxOkCallback, &rxErrCallback, &rxErrCallback);
+    dwt_setinterrupt(RX_EVENTS, 1);
+    
+    /** CIR Receiving Loop **/
+    while(!stop_requested)
+    {
+        rx_done = 0;
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        
+        /* The timeout only bounds the reaction to SIGINT/SIGTERM, the line wakes us up for every event. */
+        while (!rx_done && !stop_requested)
+        {
+            int irq = irq_wait(IRQ_WAIT_MS);
+            if (irq < 0)
+            {
+                perror("IRQ wait");
+                return;
+            }
+            if (irq > 0)
+            {
+                dwt_isr();
+            }
+        }
+    }
+    
+    dwt_setinterrupt(SYS_MASK_MASK_32, 0);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn checkOverrun()
+ *
+ * @brief Compare the OVER event counter with its last value. If frames arrived while both RX buffers were full, count
+ *        them and restart the receiver with the IC and host buffer pointers in sync.
+ *
+ * @return  none
+ */
+static void checkOverrun(void)
+{
+    uint16 over = dwt_read16bitoffsetreg(DIG_DIAG_ID, EVC_OVR_OFFSET) & EVC_OVR_MASK;
+    
+    if (over == over_count)
+    {
+        return;
+    }
+    overruns += (uint16) (over - over_count) & EVC_OVR_MASK;
+    over_count = over;
+    printf("RX overrun! %lu so far\n", overruns);
+    
+    dwt_forcetrxoff();
+    dwt_rxreset();
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXOVRR);
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
+
+/* Continuous receiver: the radio stays enabled and only stops on RX errors or overruns, see NOTE 9 below. */
+static void receiverContinuous(int use_irq)
+{
+    int pending;
+    
+    if (use_irq && irq_init() != 0)
+    {
+        exit(1);
+    }
+    dwt_setdblrxbuffmode(1);
+    dwt_configeventcounters(1);
+    over_count = 0;
+    dwt_setcallbacks(NULL, &rxOkCallback, &rxErrCallback, &rxErrCallback);
+    dwt_setinterrupt(RX_EVENTS | DWT_INT_RXOVRR, 1);
+    
+    /* Syncs the IC and host buffer pointers before the first reception. */
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    
+    /** CIR Receiving Loop **/
+    while(!stop_requested)
+    {
+        /* Interrupt mask bits match the status bits, the same mask selects the events when polling. */
+        if (use_irq)
+        {
+            pending = irq_wait(IRQ_WAIT_MS);
+            if (pending < 0)
+            {
+                perror("IRQ wait");
+                break;
+            }
+        }
+        else
+        {
+            pending = (dwt_read32bitreg(SYS_STATUS_ID) & (RX_EVENTS | DWT_INT_RXOVRR)) != 0;
+        }
+        
+        if (pending)
+        {
+            dwt_isr();
+            checkOverrun();
+        }
+    }
+    
+    dwt_setinterrupt(SYS_MASK_MASK_32, 0);
+    dwt_forcetrxoff();
+    dwt_setdblrxbuffmode(0);
+    printf("%lu RX overruns\n", overruns);
+}
+
+/* Polls temperature, battery voltage and event counters while the receive loop runs on the main thread. */
+static void *telemetryThread(void *arg)
+{
+    dwt_ctx_t *ctx = (dwt_ctx_t *) arg;
+    dwt_deviceentcnts_t cnt;
+    uint16 tempvbat;
+    
+    while (!stop_requested)
+    {
+        usleep(telemetry_ms * 1000);
+        tempvbat = dwt_ctx_readtempvbat(ctx, 1);
+        dwt_ctx_readeventcounters(ctx, &cnt);
+        printf("telemetry: temp %u vbat %u (SAR raw), %u good, %u CRC errors, %u PHY errors, %u overruns\n",
+               tempvbat >> 8, tempvbat & 0xff, cnt.CRCG, cnt.CRCB, cnt.PHE, cnt.OVER);
+    }
+    return NULL;
+}
+
+void receiver(int fd, int feature_fd, int use_irq, cir_writer_stats_t *writer_stats, cir_writer_stats_t *feature_stats){
+    uint16 cir_capacity;
+    
+    /* The CIR is read straight into a record of the writer ring, the storage thread writes it to disk. */
+    cir_capacity = cir_window ? 2*cir_window : CIR_SAMPLES;
+    if (compress)
+    {
+        writer = cir_writer_start_coded(fd, CIR_WRITER_SLOTS, cir_capacity);
+    }
+    else
+    {
+        writer = cir_writer_start(fd, CIR_WRITER_SLOTS, cir_capacity);
+    }
+    if (writer == NULL)
+    {
+        exit(1);
+    }
+    if (features_on)
+    {
+        cir_features_init(&features, &features_config);
+        feature_writer = cir_writer_start_features(feature_fd, CIR_WRITER_SLOTS);
+        scratch = (cir_record_t *) calloc(1, CIR_RECORD_LEN(cir_capacity));
+        if (feature_writer == NULL || scratch == NULL)
+        {
+            exit(1);
+        }
+    }
+    
+    if (continuous)
+    {
+        receiverContinuous(use_irq);
+    }
+    else if (use_irq)
+    {
+        receiverIrq();
+    }
+    else
+    {
+        receiverPolled();
+    }
+    
+    cir_writer_stop(writer, writer_stats);
+    writer = NULL;
+    if (features_on)
+    {
+        cir_writer_stop(feature_writer, feature_stats);
+        feature_writer = NULL;
+        free(scratch);
+        scratch = NULL;
+    }
 }
 
 /**
@@ -264,29 +550,93 @@ void receiver(FILE *fp){
 int main(int argc, char** argv)
 {
     /** Variable Define **/
-    FILE* fp;
+    int fd = -1;
+    int feature_fd = -1;
+    int use_irq = 1;
+    int opt;
+    cir_writer_stats_t writer_stats;
+    cir_writer_stats_t feature_stats;
+    struct sigaction sa;
     
     /** Mode Configuration **/
+    pthread_t telemetry;
+    
+    while ((opt = getopt(argc, argv, "pct:f:b:z")) != -1){
+        if (opt == 'p'){
+            /* Busy-poll SYS_STATUS instead of waiting on the IRQ line. */
+            use_irq = 0;
+        }
+        else if (opt == 'c'){
+            /* Keep the receiver listening into the other RX buffer while a frame is processed. */
+            continuous = 1;
+        }
+        else if (opt == 't'){
+            /* Poll temperature, voltage and event counters from a second thread. */
+            telemetry_ms = (unsigned int) atoi(optarg);
+        }
+        else if (opt == 'f'){
+            /* Save feature records, and the whole record of one frame in every <optarg> only. */
+            features_on = 1;
+            features_config.every = (uint32_t) atoi(optarg);
+        }
+        else if (opt == 'b'){
+            /* Frames averaged before the background model of the features is used. */
+            features_config.background_frames = (uint32_t) atoi(optarg);
+        }
+        else if (opt == 'z'){
+            /* Write the records coded by the lossless CIR codec. */
+            compress = 1;
+        }
+        else {
+            return 0;
+        }
+    }
+    argc -= optind - 1;
+    argv += optind - 1;
     if (1 == argc){
         /* If you want to log the CIR for off-line processing,
          * you need to specify the name of the output file
          */
-        printf("/**************************************/\n");
-        printf("/*  Usage: dw1000_rx_cir <filename>   */\n");
-        printf("/**************************************/\n");
+        printf("/***********************************************************/\n");
+        printf("/*  Usage: dw1000_rx_cir [-p] [-c] [-t ms] [-f n [-b n]]    */\n");
+        printf("/*                      [-z] <file> [window]               */\n");
+        printf("/*  window: taps kept each side of the first path          */\n");
+        printf("/*  -p: poll SYS_STATUS instead of the IRQ line            */\n");
+        printf("/*  -c: continuous double buffered reception               */\n");
+        printf("/*  -t: print telemetry every ms milliseconds              */\n");
+        printf("/*  -f: features to <file>.feat, one CIR in n to <file>    */\n");
+        printf("/*  -b: frames of the feature background (default 100)     */\n");
+        printf("/*  -z: lossless coded records, cirz -d decodes them        */\n");
+        printf("/***********************************************************/\n");
         return 0;
     }
-    if (2 == argc){
+    if (3 == argc){
+        /* Only keep the taps around the first path, with the diagnostics. */
+        cir_window = (uint16) atoi(argv[2]);
+        if (cir_window == 0 || cir_window > CIR_WINDOW_MAX){
+            printf("window must be between 1 and %d taps\n", CIR_WINDOW_MAX);
+            return 0;
+        }
+    }
+    if (2 == argc || 3 == argc){
         char filename[48];
         snprintf(filename, 47, "../../data/%s", argv[1]);
-        fp = fopen(filename,"w");
-        if (!fp){
+        fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0){
             printf("Fail to open <output_file>, are you root?\n");
-            fclose(fp);
             return 0;
         }
+        if (features_on){
+            char feature_name[64];
+            snprintf(feature_name, sizeof(feature_name), "%s.feat", filename);
+            feature_fd = open(feature_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (feature_fd < 0){
+                printf("Fail to open <output_file>.feat, are you root?\n");
+                return 0;
+            }
+        }
     }
-    if (argc > 2){
+    if (argc > 3){
         printf(" Too many input arguments !\n");
         return 0;
     }
@@ -296,10 +646,60 @@ int main(int argc, char** argv)
     hardware_init();
     setup_dw1000();
     
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = on_keep_signal;
+    sigaction(SIGUSR1, &sa, NULL);
+    features_config.prf = config.prf;
+    
+    if (telemetry_ms)
+    {
+        dwt_configeventcounters(1);
+        if (pthread_create(&telemetry, NULL, telemetryThread, dwt_getctx(0)) != 0)
+        {
+            telemetry_ms = 0;
+        }
+    }
+    
     /** MSG Receiving Loop **/
-    receiver(fp);
+    time_sync_init(&sync_state);
+    receiver(fd, feature_fd, use_irq, &writer_stats, &feature_stats);
+    if (telemetry_ms)
+    {
+        pthread_join(telemetry, NULL);
+    }
+    
+    printf("%lu CIR saved, %lu dropped (ring full), %lu lost (write errors), ring peak %u/%d\n",
+           writer_stats.written, writer_stats.dropped, writer_stats.errors, writer_stats.max_fill, CIR_WRITER_SLOTS);
+    if (compress && writer_stats.file_bytes)
+    {
+        printf("%llu bytes of records coded into %llu, ratio %.2f\n", (unsigned long long) writer_stats.raw_bytes,
+               (unsigned long long) writer_stats.file_bytes,
+               (double) writer_stats.raw_bytes / (double) writer_stats.file_bytes);
+    }
+    if (features_on)
+    {
+        printf("%lu feature records saved, %lu dropped (ring full), %lu lost (write errors), %lu frames reduced\n",
+               feature_stats.written, feature_stats.dropped, feature_stats.errors, features.frames);
+    }
+    if (sync_state.beacons)
+    {
+        printf("%lu sync beacons, %lu resyncs, drift %.3f ppm, prediction error rms %.1f ns max %.1f ns\n",
+               sync_state.beacons, sync_state.resyncs, sync_state.drift * 1e6,
+               sync_state.residuals ? sqrt(sync_state.residual_sum2 / sync_state.residuals) : 0.0, sync_state.residual_max);
+    }
+#ifdef DWT_SHADOW_VERIFY
+    printf("%lu register shadow mismatches\n", (unsigned long) dwt_shadowmismatches());
+#endif
+    spi_stats_dump(stdout);
     
-    fclose(fp);
+    close(fd);
+    if (feature_fd >= 0)
+    {
+        close(feature_fd);
+    }
     return 0;
 }
 
@@ -315,8 +715,9 @@ int main(int argc, char** argv)
  *    not loaded and running, dwt_readdiagnostics will return all 0 values.
  * 4. Manual reception activation is performed here but DW1000 offers several features that can be used to handle more complex scenarios or to
  *    optimise system's overall performance (e.g. timeout after a given time, automatic re-enabling of reception in case of errors, etc.).
- * 5. We use polled mode of operation here to keep the example as simple as possible but RXFCG and error/timeout status events can be used to generate
- *    interrupts. Please refer to DW1000 User Manual for more details on "interrupts".
+ * 5. By default RXFCG and error/timeout status events are routed to the IRQ line and the receiver sleeps until it rises, then dispatches through
+ *    dwt_isr() and the callbacks set with dwt_setcallbacks(). With -p the receiver polls SYS_STATUS instead, which keeps a core busy and the SPI
+ *    bus loaded with status reads. Please refer to DW1000 User Manual for more details on "interrupts".
  * 6. Here we chose to read only a few values around the first path index but it is possible and can be useful to get all accumulator values, using
  *    the relevant offset and length parameters. Reading the whole accumulator will require 4064 bytes of memory. First path value gotten from
  *    dwt_readdiagnostics is a 10.6 bits fixed point value calculated by the DW1000. By dividing this value by 64, we end up with the integer part of
@@ -325,4 +726,31 @@ int main(int argc, char** argv)
  *    "enable" parameter set).
  * 8. The user is referred to DecaRanging ARM application (distributed with EVK1000 product) for additional practical example of usage, and to the
  *    DW1000 API Guide for more details on the DW1000 driver functions.
+ * 9. With -c the DW1000 double RX buffer is used: the RX good frame callback re-enables the receiver without syncing the buffer pointers, so the
+ *    next frame lands in the other buffer while this one and its CIR are read, and dwt_isr() hands the buffer back by toggling HRBT. The
+ *    accumulator itself is not double buffered, records whose CIR may have been overwritten by the next preamble are flagged
+ *    CIR_RECORD_OVERLAP. A frame arriving while both buffers are full is an overrun: it is counted by the OVER event counter, which is checked
+ *    after every event, and the receiver is then reset and re-enabled with the pointers in sync.
+ * 10. With -t a second thread reads the temperature, the battery voltage and the event counters while the main thread receives. It goes through
+ *    the dwt_ctx_ API, which locks the device for each call, so its SPI sequences (the SAR conversion takes several writes) never interleave with
+ *    the ones of dwt_isr() and the CIR reads.
+ * 11. Every record carries the RX timestamp of its frame. Once a time sync beacon of dw1000_tx -b has been received, it also carries that time
+ *    on the clock of the beacon sender in nanoseconds (CIR_RECORD_SYNC), so records of several receivers can be matched, see time_sync.h. With
+ *    -c the carrier integrator, which is not double buffered, may already belong to the next frame, but it only seeds the drift estimate.
+ * 12. The RX timestamps and the diagnostics of every frame (RX_FINFO, RX_TIME, RX_FQUAL and LDE_THRESH) are queued with dwt_batchreadrxinfo()
+ *    in the SPI submission that reads the frame, and saved in every record, whole accumulator ones included (CIR_RECORD_DIAG). The window
+ *    around the first path is then placed without reading the diagnostics again, so the CIR read is the only other SPI access of a frame.
+ * 13. With -f n every frame is reduced on the fly to a feature record (first path and receive power, power, peak to first path ratio and RMS
+ *    delay spread of the taps around the first path, deviation from the background, see cir_features.h)
+ *    saved to <file>.feat, and only one whole record in n (none for 0) goes to <file>: 80 bytes per frame instead of 4136. The CIR of the
+ *    other frames is read into a scratch record that is never queued. kill -USR1 keeps the whole records of the next FEATURES_ON_DEMAND
+ *    frames, for instance while something is being looked at.
+ *    The background is a running model of the taps around the first path (see cir_background.h): the mean of the first -b frames, then an
+ *    exponential moving average and variance of every complex tap, phase aligned on the first path. Each frame gets its deviation score
+ *    against it, about 1 for an unchanged channel, and frames scoring over CIR_BACKGROUND_GATE are not learnt, so change detection runs
+ *    live at the frame rate in a fixed 1.5 KB per link.
+ * 14. With -z the storage thread codes every record with the lossless codec of cir_codec.h before writing it, the receive loop does the same
+ *    work as without. Most taps are noise, before the first path and in the tail, and take a few bits each instead of 16: the ratio of the
+ *    record size to the bytes written is printed on exit. "cirz -d <file> <capture>" gives back the original capture byte for byte, "cirz -t"
+ *    checks it on any capture and reports the coding speed.
  ****************************************************************************************************************************************************/
@@ -0,0 +1,324 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    dw1000_rx_multi.c
+ *  @brief   Concurrent CIR capture from several DW1000s
+ *
+ *           Every radio sits on its own spidev chip select with its own reset and IRQ lines and is driven by its own
+ *           thread: the thread selects its device with dw1000_select(), then resets, configures and receives exactly
+ *           like dw1000_rx_cir in interrupt mode. The driver local data and the platform port are thread local, so the
+ *           radios need no locking between them. Each radio has its own CIR writer and output file <file>.<n>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "platform.h"
+#include "cir_record.h"
+#include "cir_writer.h"
+#include "cir_capture.h"
+#include "time_sync.h"
+
+#define APP_NAME "HEADCOUNT RX MULTI v1.0"
+
+/* Same configuration as dw1000_rx_cir. */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_1024,   /* Preamble length. Used in TX only. */
+    DWT_PAC32,       /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_110K,     /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (1025 + 64 - 32) /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+#define FLAG_IDX   2   // sequence number index
+#define FLAG 0xab   // Flag: check message
+#define RX_BUF_LEN SYNC_BEACON_LEN   // The longest frame of dw1000_tx, a time sync beacon
+
+#define IRQ_WAIT_MS 100   // longest sleep on the IRQ line before checking for a stop request
+
+/* RX events routed to the IRQ line. */
+#define RX_EVENTS (DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE | DWT_INT_RFSL | DWT_INT_RFTO | DWT_INT_RXPTO | DWT_INT_SFDT \
+                   | DWT_INT_ARFE)
+
+typedef unsigned long long uint64;
+
+/* Default radios: the first two of DW1000Radios, the two chip selects of SPI1 (dtoverlay=spi1-2cs). */
+#define DEFAULT_RADIOS 2
+
+typedef struct
+{
+    int index;                  // device slot, see dw1000_select()
+    char path[64];              // spidev
+    int rst_pin;
+    int irq_pin;
+    int fd;                     // output file
+    cir_writer_t *writer;
+    pthread_t thread;
+    int ok;                     // thread got to its receive loop
+    uint64 seq;                 // last sequence number saved
+    unsigned long rx_frames;
+    unsigned long rx_errors;
+    cir_writer_stats_t stats;   // final writer counters
+    time_sync_t sync;           // clock of the beacon sender as seen by this radio
+} radio_t;
+
+static radio_t radios[DWT_NUM_DW_DEV];
+static int nradios = 0;
+static uint16 cir_window = 0;   // half window in taps, 0 for the whole accumulator
+
+/* Radio of the calling thread, for the dwt_isr() callbacks. */
+static __thread radio_t *radio;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+/* RX good frame callback, called from dwt_isr() in the thread of the radio. */
+static void rxOkCallback(const dwt_cb_data_t *cb_data)
+{
+    uint8 rx_buffer[RX_BUF_LEN];
+    dwt_batch_t batch;
+    dwt_rxinfo_t info;
+    uint64 seq = 0;
+    struct timespec tm_rx;
+    cir_record_t *rec;
+
+    /* The frame, its timestamps and its diagnostics in one SPI submission. */
+    memset(rx_buffer, 0, sizeof(rx_buffer));
+    dwt_batchinit(&batch);
+    dwt_batchreadrxinfo(&batch, &info);
+    if (cb_data->datalength <= RX_BUF_LEN)
+    {
+        dwt_batchreadrxdata(&batch, rx_buffer, cb_data->datalength, 0);
+    }
+    dwt_batchsubmit(&batch);
+    radio->rx_frames++;
+
+    if (FLAG != rx_buffer[0])
+    {
+        return;
+    }
+    clock_gettime(CLOCK_REALTIME, &tm_rx);
+    time_sync_frame(&radio->sync, rx_buffer, cb_data->datalength, rxInfoTimestamp(&info), &config);
+    memcpy((void *) &seq, (void *) &rx_buffer[FLAG_IDX], sizeof(uint64));
+    if (radio->seq >= seq)
+    {
+        return;
+    }
+    radio->seq = seq;
+
+    /* Never wait for the disk: if the ring is full the CIR is dropped. */
+    rec = cir_writer_acquire(radio->writer);
+    if (rec == NULL)
+    {
+        return;
+    }
+    rec->seq = seq;
+    rec->rx_sec = tm_rx.tv_sec;
+    rec->rx_nsec = tm_rx.tv_nsec;
+    copyCIRToRecord(rec, cir_window, &info);
+    time_sync_stamp(&radio->sync, rec);
+    cir_writer_commit(radio->writer);
+}
+
+/* RX error and timeout callback, dwt_isr() has already cleared the events and reset the receiver. */
+static void rxErrCallback(const dwt_cb_data_t *cb_data)
+{
+    (void) cb_data;
+    radio->rx_errors++;
+}
+
+/* Thread of one radio: select it, bring it up and receive until stopped. */
+static void *radioThread(void *arg)
+{
+    radio = (radio_t *) arg;
+    time_sync_init(&radio->sync);
+
+    if (dw1000_select(radio->index) != 0)
+    {
+        fprintf(stderr, "radio %d: cannot select device\n", radio->index);
+        return NULL;
+    }
+
+    reset_DW1000();
+    spi_set_rate_low();
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        fprintf(stderr, "radio %d: INIT FAILED\n", radio->index);
+        return NULL;
+    }
+    spi_set_rate_high();
+    dwt_configure(&config);
+
+    if (irq_init() != 0)
+    {
+        return NULL;
+    }
+    dwt_setcallbacks(NULL, &rxOkCallback, &rxErrCallback, &rxErrCallback);
+    dwt_setinterrupt(RX_EVENTS, 1);
+    printf("radio %d: %s, device 0x%08lx\n", radio->index, radio->path, (unsigned long) dwt_readdevid());
+    radio->ok = 1;
+
+    /* Every callback leaves the receiver off, re-enable it after each event. */
+    while (!stop_requested)
+    {
+        int irq;
+
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        do
+        {
+            irq = irq_wait(IRQ_WAIT_MS);
+        }
+        while (irq == 0 && !stop_requested);
+        if (irq < 0)
+        {
+            perror("IRQ wait");
+            break;
+        }
+        if (irq > 0)
+        {
+            dwt_isr();
+        }
+    }
+
+    dwt_setinterrupt(SYS_MASK_MASK_32, 0);
+    dwt_forcetrxoff();
+    return NULL;
+}
+
+/**
+ * Application entry point.
+ */
+int main(int argc, char** argv)
+{
+    int opt;
+    int i;
+    struct sigaction sa;
+
+    while ((opt = getopt(argc, argv, "w:")) != -1)
+    {
+        if (opt == 'w')
+        {
+            /* Only keep the taps around the first path, with the diagnostics. */
+            cir_window = (uint16) atoi(optarg);
+            if (cir_window == 0 || cir_window > CIR_WINDOW_MAX)
+            {
+                printf("window must be between 1 and %d taps\n", CIR_WINDOW_MAX);
+                return 0;
+            }
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    if (optind >= argc)
+    {
+        printf("/**************************************************************/\n");
+        printf("/*  Usage: dw1000_rx_multi [-w window] <file> [radio ...]      */\n");
+        printf("/*  radio: <spidev>:<rst pin>:<irq pin>, wiringPi numbering    */\n");
+        printf("/*  default: %s %s */\n", DW1000Radios[0], DW1000Radios[1]);
+        printf("/*  the CIR of radio n is saved to <file>.<n>                  */\n");
+        printf("/**************************************************************/\n");
+        return 0;
+    }
+
+    /* Radios from the command line, the two SPI1 chip selects otherwise. */
+    nradios = argc - optind - 1;
+    if (nradios == 0)
+    {
+        nradios = DEFAULT_RADIOS;
+    }
+    if (nradios > DWT_NUM_DW_DEV)
+    {
+        printf("at most %d radios\n", DWT_NUM_DW_DEV);
+        return 0;
+    }
+    for (i = 0; i < nradios; i++)
+    {
+        const char *arg = argc - optind > 1 ? argv[optind + 1 + i] : DW1000Radios[i];
+        char filename[80];
+
+        radios[i].index = i;
+        if (dw1000_parse_radio(arg, radios[i].path, sizeof(radios[i].path), &radios[i].rst_pin,
+                               &radios[i].irq_pin) != 0)
+        {
+            printf("bad radio %s, expected <spidev>:<rst pin>:<irq pin>\n", arg);
+            return 0;
+        }
+        snprintf(filename, sizeof(filename), "../../data/%s.%d", argv[optind], i);
+        radios[i].fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (radios[i].fd < 0)
+        {
+            printf("Fail to open %s, are you root?\n", filename);
+            return 0;
+        }
+        radios[i].writer = cir_writer_start(radios[i].fd, CIR_WRITER_SLOTS, cir_window ? 2*cir_window : CIR_SAMPLES);
+        if (radios[i].writer == NULL)
+        {
+            return 1;
+        }
+    }
+
+    /* hardware_init() opens the first radio as device 0, the others are added to its slots. */
+    SPIPath = radios[0].path;
+    RSTPin = radios[0].rst_pin;
+    IRQPin = radios[0].irq_pin;
+    if (hardware_init() != 0)
+    {
+        return 1;
+    }
+    for (i = 1; i < nradios; i++)
+    {
+        if (dw1000_open(i, radios[i].path, radios[i].rst_pin, radios[i].irq_pin) != 0)
+        {
+            return 1;
+        }
+    }
+    printf("%s\n", APP_NAME);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for (i = 0; i < nradios; i++)
+    {
+        if (pthread_create(&radios[i].thread, NULL, radioThread, &radios[i]) != 0)
+        {
+            fprintf(stderr, "could not start the thread of radio %d\n", i);
+            stop_requested = 1;
+            nradios = i;
+            break;
+        }
+    }
+
+    for (i = 0; i < nradios; i++)
+    {
+        pthread_join(radios[i].thread, NULL);
+        cir_writer_stop(radios[i].writer, &radios[i].stats);
+        close(radios[i].fd);
+        printf("radio %d: %s%lu frames, %lu errors, %lu CIR saved, %lu dropped (ring full), %lu lost (write errors), "
+               "%lu sync beacons\n",
+               i, radios[i].ok ? "" : "FAILED, ", radios[i].rx_frames, radios[i].rx_errors, radios[i].stats.written,
+               radios[i].stats.dropped, radios[i].stats.errors, radios[i].sync.beacons);
+    }
+    spi_stats_dump(stdout);
+    return 0;
+}
@@ -0,0 +1,810 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    dw1000_twr.c
+ *  @brief   Double-sided two-way ranging between one initiator and up to three responders
+ *
+ *           A ranging round is one POLL broadcast by the initiator, one RESP from each responder in its own slot and one
+ *           FINAL from the initiator carrying its POLL TX, RESP RX and FINAL TX timestamps:
+ *
+ *             initiator  POLL ---------------------------------------------- FINAL
+ *             responder 1      RESP                                            (distance)
+ *             responder 2                 RESP                                 (distance)
+ *                        |<--- slot --->|<--- slot --->|<--- slot ---> ...
+ *
+ *           RESP and FINAL are delayed transmissions: responder k sends its RESP k slots after the POLL it received, the
+ *           initiator its FINAL n+1 slots after its POLL, so every timestamp a frame carries is known before it is sent.
+ *           Each responder then has the four intervals of DS-TWR (see NOTE 1 below) and prints the distance, together
+ *           with the clock offset of the initiator read from the carrier integrator. The initiator prints the round
+ *           latency and the clock offset of each responder.
+ *
+ *           On a board with several DW1000s (or with EMU=1, where the emulated devices share the air) "local" runs the
+ *           initiator and the responders in one process, one thread per radio.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "platform.h"
+
+#define APP_NAME "HEADCOUNT TWR v1.0"
+
+/* Ranging configuration: short preamble and 6.8 Mbps keep a frame around 170 us on air. */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_128,    /* Preamble length. Used in TX only. */
+    DWT_PAC8,        /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    0,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_6M8,      /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (129 + 8 - 8)    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+/* Default antenna delays, see NOTE 2 below. */
+#define TX_ANT_DLY 16436
+#define RX_ANT_DLY 16436
+
+/* Frames: flag, type, round number, source (0 initiator, k responder k), responders in the round, then the payload. */
+#define TWR_FLAG 0xc5
+#define MSG_POLL 0x21
+#define MSG_RESP 0x10
+#define MSG_FINAL 0x23
+#define HDR_LEN 5
+#define TS_LEN 5
+#define FCS_LEN 2
+#define FINAL_POLL_TX_IDX HDR_LEN
+#define FINAL_FINAL_TX_IDX (HDR_LEN + TS_LEN)
+#define FINAL_RESP_RX_IDX (HDR_LEN + 2*TS_LEN)   // one per responder, responder k at index k-1
+
+#define RESP_MAX (DWT_NUM_DW_DEV - 1)
+#define FRAME_MAX (FINAL_RESP_RX_IDX + RESP_MAX*TS_LEN + FCS_LEN)
+
+/* Time between the POLL and the first RESP, between two RESPs and between the last RESP and the FINAL, in UWB
+ * microseconds (1.0256 us). It must cover the IRQ, the timestamp read and the frame write on the receiving host. */
+#define DEFAULT_SLOT_US 1000
+#define DEFAULT_PERIOD_MS 5
+#define FINAL_PREP_US 300   // the FINAL is armed this long before its slot even if responses are missing
+
+#define UUS_TO_DWT_TIME 65536   // 1 UWB microsecond (1.0256 us) in device time units
+#define DWT_TIME_MASK 0xFFFFFFFFFFULL
+#define SPEED_OF_LIGHT 299702547.0
+#define REPORT_NS 1000000000LL
+#define IRQ_WAIT_MS 100   // longest sleep on the IRQ line before checking for a stop request
+
+typedef unsigned long long uint64;
+typedef signed long long int64;
+
+typedef struct
+{
+    int index;                      // device slot, see dw1000_select()
+    int id;                         // 0 initiator, k responder k
+    char path[64];
+    int rst_pin;
+    int irq_pin;
+    pthread_t thread;
+    volatile int ready;             // configured and listening
+
+    /* Responder */
+    int awaiting_final;
+    uint8 round;
+    uint64 poll_rx;
+    uint64 resp_tx;
+    unsigned long ranges;
+    unsigned long late;
+    double dist_sum, dist_sum2, ppm_sum;
+    unsigned long rep_ranges;       // since the last report
+    double rep_sum, rep_sum2, rep_ppm;
+
+    /* Initiator */
+    volatile int tx_done;
+    volatile int all_in;            // RESPs of all the responders received this round
+    uint8 responders;
+    uint64 resp_rx[RESP_MAX + 1];
+    double resp_ppm[RESP_MAX + 1];
+    uint8 got;                      // bit k: RESP of responder k received this round
+    unsigned long rounds;
+    unsigned long completed;        // rounds that got to the FINAL confirmation
+    unsigned long responses[RESP_MAX + 1];
+    unsigned long final_late;
+    double latency_sum, latency_max;
+    unsigned long rep_rounds;
+    double rep_latency_sum, rep_latency_max;
+} node_t;
+
+static node_t nodes[DWT_NUM_DW_DEV];
+static int nresponders = 1;
+static uint32 slot_us = DEFAULT_SLOT_US;
+static uint32 period_ms = DEFAULT_PERIOD_MS;
+static unsigned long max_rounds = 0;   // 0 for no limit
+
+/* Node of the calling thread, for the dwt_isr() callbacks. */
+static __thread node_t *node;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+static uint64 getTs(const uint8 *p)
+{
+    uint64 v = 0;
+    int i;
+
+    for (i = TS_LEN - 1; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+static void putTs(uint8 *p, uint64 v)
+{
+    int i;
+
+    for (i = 0; i < TS_LEN; i++, v >>= 8)
+    {
+        p[i] = (uint8) v;
+    }
+}
+
+static uint64 readTxTs(void)
+{
+    uint8 ts[TS_LEN];
+
+    dwt_readtxtimestamp(ts);
+    return getTs(ts);
+}
+
+static uint64 readRxTs(void)
+{
+    uint8 ts[TS_LEN];
+
+    dwt_readrxtimestamp(ts);
+    return getTs(ts);
+}
+
+/* Clock offset of the sender of the last frame received relative to this device, in ppm. */
+static double readClockOffsetPpm(void)
+{
+    return dwt_readcarrierintegrator() * FREQ_OFFSET_MULTIPLIER * HERTZ_TO_PPM_MULTIPLIER_CHAN_2;
+}
+
+static int64 nowNs(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64) t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* DX_TIME for a transmission about delay_uus after base, and the TX timestamp the frame will carry. See NOTE 3 below. */
+static uint32 delayedTxTime(uint64 base, uint64 delay_uus, uint64 *tx_ts)
+{
+    uint32 dx = (uint32) (((base + delay_uus * UUS_TO_DWT_TIME) & DWT_TIME_MASK) >> 8);
+
+    *tx_ts = ((((uint64) (dx & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY) & DWT_TIME_MASK;
+    return dx;
+}
+
+/* A delayed transmission was too late: HPDWARN stays set and fails every later one until it is cleared. */
+static void clearLate(void)
+{
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_HPDWARN);
+}
+
+static void writeHeader(uint8 *frame, uint8 type, uint8 round, uint8 count)
+{
+    frame[0] = TWR_FLAG;
+    frame[1] = type;
+    frame[2] = round;
+    frame[3] = (uint8) node->id;
+    frame[4] = count;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn rangeDone()
+ *
+ * @brief Responder side: the FINAL of the round has been received, compute the time of flight from the four DS-TWR
+ *        intervals. See NOTE 1 below.
+ *
+ * @param  frame - the FINAL
+ * @param  final_rx - its RX timestamp
+ *
+ * @return  none
+ */
+static void rangeDone(const uint8 *frame, uint64 final_rx)
+{
+    uint64 poll_tx = getTs(&frame[FINAL_POLL_TX_IDX]);
+    uint64 final_tx = getTs(&frame[FINAL_FINAL_TX_IDX]);
+    uint64 resp_rx = getTs(&frame[FINAL_RESP_RX_IDX + (node->id - 1)*TS_LEN]);
+    int64 ra, rb, da, db;
+    double tof, dist, ppm;
+
+    if (resp_rx == 0)
+    {
+        /* The initiator missed our RESP. */
+        return;
+    }
+    ra = (int64) ((resp_rx - poll_tx) & DWT_TIME_MASK);
+    rb = (int64) ((final_rx - node->resp_tx) & DWT_TIME_MASK);
+    da = (int64) ((final_tx - resp_rx) & DWT_TIME_MASK);
+    db = (int64) ((node->resp_tx - node->poll_rx) & DWT_TIME_MASK);
+
+    tof = (double) (ra * rb - da * db) / (double) (ra + rb + da + db);
+    dist = tof * DWT_TIME_UNITS * SPEED_OF_LIGHT;
+    ppm = readClockOffsetPpm();
+
+    node->ranges++;
+    node->dist_sum += dist;
+    node->dist_sum2 += dist * dist;
+    node->ppm_sum += ppm;
+    node->rep_ranges++;
+    node->rep_sum += dist;
+    node->rep_sum2 += dist * dist;
+    node->rep_ppm += ppm;
+}
+
+/* Responder: RX good frame callback, called from dwt_isr() in the thread of the node. */
+static void respRxOk(const dwt_cb_data_t *cb_data)
+{
+    uint8 frame[FRAME_MAX];
+    uint16 len = cb_data->datalength;
+
+    if (len > FRAME_MAX || len < HDR_LEN + FCS_LEN)
+    {
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        return;
+    }
+    dwt_readrxdata(frame, len, 0);
+    if (frame[0] != TWR_FLAG || frame[3] != 0)
+    {
+        /* Not ours, or the RESP of another responder. */
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        return;
+    }
+
+    if (frame[1] == MSG_POLL && node->id <= frame[4])
+    {
+        uint8 resp[HDR_LEN + FCS_LEN];
+        uint32 dx;
+
+        node->poll_rx = readRxTs();
+        node->round = frame[2];
+        dx = delayedTxTime(node->poll_rx, (uint64) node->id * slot_us, &node->resp_tx);
+
+        writeHeader(resp, MSG_RESP, node->round, frame[4]);
+        dwt_writetxdata(sizeof(resp), resp, 0);
+        dwt_writetxfctrl(sizeof(resp), 0, 1);
+        dwt_setdelayedtrxtime(dx);
+        /* The receiver turns on after the RESP, for the RESPs of the others and then the FINAL. */
+        if (dwt_starttx(DWT_START_TX_DELAYED | DWT_RESPONSE_EXPECTED) == DWT_SUCCESS)
+        {
+            node->awaiting_final = 1;
+            return;
+        }
+        clearLate();
+        node->late++;
+        node->awaiting_final = 0;
+    }
+    else if (frame[1] == MSG_FINAL && node->awaiting_final && frame[2] == node->round
+             && len >= FINAL_RESP_RX_IDX + frame[4]*TS_LEN + FCS_LEN && node->id <= frame[4])
+    {
+        rangeDone(frame, readRxTs());
+        node->awaiting_final = 0;
+    }
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
+
+/* Responder: RX errors and timeouts, listen again. */
+static void respRxErr(const dwt_cb_data_t *cb_data)
+{
+    (void) cb_data;
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
+
+/* Initiator: TX confirmation of the POLL or the FINAL. */
+static void initTxDone(const dwt_cb_data_t *cb_data)
+{
+    (void) cb_data;
+    node->tx_done = 1;
+}
+
+/* Initiator: a RESP, keep listening for the others. */
+static void initRxOk(const dwt_cb_data_t *cb_data)
+{
+    uint8 frame[HDR_LEN + FCS_LEN];
+    int k;
+
+    if (cb_data->datalength == sizeof(frame))
+    {
+        dwt_readrxdata(frame, sizeof(frame), 0);
+        k = frame[3];
+        if (frame[0] == TWR_FLAG && frame[1] == MSG_RESP && frame[2] == (uint8) node->rounds && k >= 1
+            && k <= node->responders)
+        {
+            node->resp_rx[k] = readRxTs();
+            node->resp_ppm[k] = readClockOffsetPpm();
+            node->got |= 1 << k;
+        }
+    }
+    if (node->got == (uint8) (((1 << node->responders) - 1) << 1))
+    {
+        node->all_in = 1;
+    }
+    else
+    {
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+}
+
+static void initRxErr(const dwt_cb_data_t *cb_data)
+{
+    (void) cb_data;
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+}
+
+/* Dispatch DW1000 events until flag is set or the host clock passes deadline (ns). Returns 0 if flag was set. */
+static int waitEvents(volatile int *flag, int64 deadline)
+{
+    while (!*flag && !stop_requested)
+    {
+        int64 left = deadline ? deadline - nowNs() : IRQ_WAIT_MS * 1000000LL;
+        int irq;
+
+        if (left <= 0)
+        {
+            return -1;
+        }
+        /* Poll the line in the last millisecond, a sleep may overshoot the deadline. */
+        irq = irq_wait(left >= 2000000 ? (int) (left / 1000000) - 1 : 0);
+        if (irq < 0)
+        {
+            perror("IRQ wait");
+            stop_requested = 1;
+        }
+        else if (irq > 0)
+        {
+            dwt_isr();
+        }
+    }
+    return *flag ? 0 : -1;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn initiatorRound()
+ *
+ * @brief Run one ranging round: POLL, the RESPs of the responders, FINAL.
+ *
+ * @return  the round latency in ns from the POLL write to the FINAL confirmation, or -1 if the round failed
+ */
+static int64 initiatorRound(void)
+{
+    uint8 poll[HDR_LEN + FCS_LEN];
+    uint8 final[FRAME_MAX];
+    uint16 final_len = FINAL_RESP_RX_IDX + node->responders*TS_LEN + FCS_LEN;
+    int64 start = nowNs();
+    int64 deadline;
+    uint64 poll_tx, final_tx;
+    uint32 dx;
+    int k;
+
+    node->got = 0;
+    node->all_in = 0;
+    memset(node->resp_rx, 0, sizeof(node->resp_rx));
+
+    /* POLL, the receiver turns on after it for the RESPs. */
+    writeHeader(poll, MSG_POLL, (uint8) node->rounds, node->responders);
+    dwt_writetxdata(sizeof(poll), poll, 0);
+    dwt_writetxfctrl(sizeof(poll), 0, 1);
+    node->tx_done = 0;
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) != DWT_SUCCESS || waitEvents(&node->tx_done, 0) != 0)
+    {
+        return -1;
+    }
+    poll_tx = readTxTs();
+    dx = delayedTxTime(poll_tx, (uint64) (node->responders + 1) * slot_us, &final_tx);
+
+    /* The RESPs, until all are in or the FINAL must be armed. */
+    deadline = start + ((int64) (node->responders + 1) * slot_us - FINAL_PREP_US) * 1000;
+    waitEvents(&node->all_in, deadline);
+    if (stop_requested)
+    {
+        return -1;
+    }
+    dwt_forcetrxoff();
+
+    /* FINAL with the timestamps of the round. */
+    writeHeader(final, MSG_FINAL, (uint8) node->rounds, node->responders);
+    putTs(&final[FINAL_POLL_TX_IDX], poll_tx);
+    putTs(&final[FINAL_FINAL_TX_IDX], final_tx);
+    for (k = 1; k <= node->responders; k++)
+    {
+        putTs(&final[FINAL_RESP_RX_IDX + (k - 1)*TS_LEN], (node->got & (1 << k)) ? node->resp_rx[k] : 0);
+        if (node->got & (1 << k))
+        {
+            node->responses[k]++;
+        }
+    }
+    dwt_writetxdata(final_len, final, 0);
+    dwt_writetxfctrl(final_len, 0, 1);
+    dwt_setdelayedtrxtime(dx);
+    node->tx_done = 0;
+    if (dwt_starttx(DWT_START_TX_DELAYED) != DWT_SUCCESS)
+    {
+        clearLate();
+        node->final_late++;
+        return -1;
+    }
+    if (waitEvents(&node->tx_done, 0) != 0)
+    {
+        return -1;
+    }
+    return nowNs() - start;
+}
+
+static void initiatorReport(int64 elapsed)
+{
+    int k;
+
+    printf("init: %.0f rounds/s, latency mean %.2f ms max %.2f ms, FINAL late %lu", node->rep_rounds * 1e9 / elapsed,
+           node->rep_rounds ? node->rep_latency_sum / node->rep_rounds / 1e6 : 0.0, node->rep_latency_max / 1e6,
+           node->final_late);
+    for (k = 1; k <= node->responders; k++)
+    {
+        printf(", resp %d %lu/%lu %+.2f ppm", k, node->responses[k], node->rounds, node->resp_ppm[k]);
+    }
+    printf("\n");
+    node->rep_rounds = 0;
+    node->rep_latency_sum = 0;
+    node->rep_latency_max = 0;
+}
+
+static void initiatorLoop(void)
+{
+    struct timespec next;
+    int64 report = nowNs();
+
+    node->responders = (uint8) nresponders;
+    dwt_setcallbacks(&initTxDone, &initRxOk, &initRxErr, &initRxErr);
+    dwt_setrxaftertxdelay(0);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    while (!stop_requested && (max_rounds == 0 || node->rounds < max_rounds))
+    {
+        int64 latency = initiatorRound();
+        int64 now;
+
+        dwt_forcetrxoff();
+        node->rounds++;
+        if (latency >= 0)
+        {
+            node->completed++;
+            node->latency_sum += latency;
+            node->rep_latency_sum += latency;
+            node->rep_rounds++;
+            if (latency > node->rep_latency_max)
+            {
+                node->rep_latency_max = latency;
+            }
+            if (latency > node->latency_max)
+            {
+                node->latency_max = latency;
+            }
+        }
+
+        now = nowNs();
+        if (now - report >= REPORT_NS)
+        {
+            initiatorReport(now - report);
+            report = now;
+        }
+
+        /* Rounds start every period_ms on the host clock. */
+        next.tv_nsec += period_ms * 1000000L;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+}
+
+static void responderReport(void)
+{
+    double mean = node->rep_ranges ? node->rep_sum / node->rep_ranges : 0.0;
+    double var = node->rep_ranges ? node->rep_sum2 / node->rep_ranges - mean * mean : 0.0;
+
+    printf("resp %d: %lu ranges, distance %.3f m (sd %.3f), initiator clock %+.2f ppm, RESP late %lu\n", node->id,
+           node->rep_ranges, mean, sqrt(var > 0.0 ? var : 0.0), node->rep_ranges ? node->rep_ppm / node->rep_ranges : 0.0,
+           node->late);
+    node->rep_ranges = 0;
+    node->rep_sum = 0;
+    node->rep_sum2 = 0;
+    node->rep_ppm = 0;
+}
+
+static void responderLoop(void)
+{
+    int64 report = nowNs();
+
+    dwt_setcallbacks(NULL, &respRxOk, &respRxErr, &respRxErr);
+    dwt_setrxaftertxdelay(0);
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    node->ready = 1;
+
+    while (!stop_requested)
+    {
+        int irq = irq_wait(IRQ_WAIT_MS);
+
+        if (irq < 0)
+        {
+            perror("IRQ wait");
+            break;
+        }
+        if (irq > 0)
+        {
+            dwt_isr();
+        }
+        if (nowNs() - report >= REPORT_NS)
+        {
+            report = nowNs();
+            if (node->rep_ranges)
+            {
+                responderReport();
+            }
+        }
+    }
+    if (node->rep_ranges)
+    {
+        responderReport();
+    }
+}
+
+/* Bring up the radio of the node in the calling thread. Returns 0 on success. */
+static int setupNode(node_t *n)
+{
+    node = n;
+    if (dw1000_select(n->index) != 0)
+    {
+        fprintf(stderr, "node %d: cannot select device %d\n", n->id, n->index);
+        return -1;
+    }
+    reset_DW1000();
+    spi_set_rate_low();
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        fprintf(stderr, "node %d: INIT FAILED\n", n->id);
+        return -1;
+    }
+    spi_set_rate_high();
+    dwt_configure(&config);
+    dwt_setrxantennadelay(RX_ANT_DLY);
+    dwt_settxantennadelay(TX_ANT_DLY);
+
+    if (irq_init() != 0)
+    {
+        return -1;
+    }
+    dwt_setinterrupt(DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE | DWT_INT_RFSL | DWT_INT_RFTO
+                     | DWT_INT_RXPTO | DWT_INT_SFDT | DWT_INT_ARFE, 1);
+    return 0;
+}
+
+static void *nodeThread(void *arg)
+{
+    node_t *n = (node_t *) arg;
+
+    if (setupNode(n) != 0)
+    {
+        stop_requested = 1;
+        return NULL;
+    }
+    if (n->id == 0)
+    {
+        int k;
+
+        /* Wait for the responders of this process to listen. */
+        for (k = 1; k < DWT_NUM_DW_DEV; k++)
+        {
+            while (nodes[k].thread && !nodes[k].ready && !stop_requested)
+            {
+                usleep(1000);
+            }
+        }
+        initiatorLoop();
+        stop_requested = 1;
+    }
+    else
+    {
+        responderLoop();
+    }
+    dwt_setinterrupt(SYS_MASK_MASK_32, 0);
+    dwt_forcetrxoff();
+    return NULL;
+}
+
+static void usage(void)
+{
+    printf("/****************************************************************/\n");
+    printf("/*  Usage: dw1000_twr [options] init                            */\n");
+    printf("/*         dw1000_twr [options] resp <id>                       */\n");
+    printf("/*         dw1000_twr [options] local                           */\n");
+    printf("/*  -n responders per round, 1 to %d (1)                         */\n", RESP_MAX);
+    printf("/*  -s slot in us between POLL, RESPs and FINAL (%d)           */\n", DEFAULT_SLOT_US);
+    printf("/*  -p round period in ms (%d)                                   */\n", DEFAULT_PERIOD_MS);
+    printf("/*  -c rounds, 0 for no limit (0)                               */\n");
+    printf("/*  local: initiator on the first radio, responder k on radio k */\n");
+    printf("/****************************************************************/\n");
+}
+
+/**
+ * Application entry point.
+ */
+int main(int argc, char** argv)
+{
+    struct sigaction sa;
+    int opt;
+    int local = 0;
+    int count;
+    int i;
+
+    while ((opt = getopt(argc, argv, "n:s:p:c:")) != -1)
+    {
+        if (opt == 'n')
+        {
+            nresponders = atoi(optarg);
+        }
+        else if (opt == 's')
+        {
+            slot_us = (uint32) atoi(optarg);
+        }
+        else if (opt == 'p')
+        {
+            period_ms = (uint32) atoi(optarg);
+        }
+        else if (opt == 'c')
+        {
+            max_rounds = strtoul(optarg, NULL, 0);
+        }
+        else
+        {
+            usage();
+            return 0;
+        }
+    }
+    if (optind >= argc || nresponders < 1 || nresponders > RESP_MAX || slot_us <= FINAL_PREP_US || period_ms == 0)
+    {
+        usage();
+        return 0;
+    }
+
+    memset(nodes, 0, sizeof(nodes));
+    if (strcmp(argv[optind], "init") == 0)
+    {
+        count = 1;
+        nodes[0].id = 0;
+    }
+    else if (strcmp(argv[optind], "resp") == 0 && optind + 1 < argc)
+    {
+        count = 1;
+        nodes[0].id = atoi(argv[optind + 1]);
+        if (nodes[0].id < 1 || nodes[0].id > RESP_MAX)
+        {
+            usage();
+            return 0;
+        }
+    }
+    else if (strcmp(argv[optind], "local") == 0)
+    {
+        local = 1;
+        count = nresponders + 1;
+        for (i = 0; i < count; i++)
+        {
+            nodes[i].id = i;
+            /* The initiator on the first radio of DW1000Radios, responder k on radio k. */
+            if (dw1000_parse_radio(DW1000Radios[i], nodes[i].path, sizeof(nodes[i].path), &nodes[i].rst_pin,
+                                   &nodes[i].irq_pin) != 0)
+            {
+                return 1;
+            }
+        }
+        SPIPath = nodes[0].path;
+        RSTPin = nodes[0].rst_pin;
+        IRQPin = nodes[0].irq_pin;
+    }
+    else
+    {
+        usage();
+        return 0;
+    }
+    for (i = 0; i < count; i++)
+    {
+        nodes[i].index = i;
+    }
+
+    if (hardware_init() != 0)
+    {
+        return 1;
+    }
+    for (i = 1; local && i < count; i++)
+    {
+        if (dw1000_open(i, nodes[i].path, nodes[i].rst_pin, nodes[i].irq_pin) != 0)
+        {
+            return 1;
+        }
+    }
+    printf("%s: %s, %d responder(s), slot %lu us, period %lu ms\n", APP_NAME, argv[optind], nresponders, (unsigned long) slot_us,
+           (unsigned long) period_ms);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* Responders first, so that the initiator of this process finds them listening. */
+    for (i = count - 1; i >= 0; i--)
+    {
+        if (pthread_create(&nodes[i].thread, NULL, nodeThread, &nodes[i]) != 0)
+        {
+            fprintf(stderr, "could not start the thread of node %d\n", i);
+            stop_requested = 1;
+            break;
+        }
+    }
+    for (i = 0; i < count; i++)
+    {
+        if (nodes[i].thread)
+        {
+            pthread_join(nodes[i].thread, NULL);
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        node_t *n = &nodes[i];
+
+        if (n->id == 0)
+        {
+            printf("init: %lu rounds, %lu completed, latency mean %.2f ms max %.2f ms, %lu FINAL late\n", n->rounds,
+                   n->completed, n->completed ? n->latency_sum / n->completed / 1e6 : 0.0, n->latency_max / 1e6,
+                   n->final_late);
+        }
+        else
+        {
+            double mean = n->ranges ? n->dist_sum / n->ranges : 0.0;
+            double var = n->ranges ? n->dist_sum2 / n->ranges - mean * mean : 0.0;
+
+            printf("resp %d: %lu ranges, distance %.3f m (sd %.3f), initiator clock %+.2f ppm, %lu RESP late\n", n->id,
+                   n->ranges, mean, sqrt(var > 0.0 ? var : 0.0), n->ranges ? n->ppm_sum / n->ranges : 0.0, n->late);
+        }
+    }
+    spi_stats_dump(stdout);
+    return 0;
+}
+
+/*****************************************************************************************************************************************************
+ * NOTES:
+ *
+ * 1. With Ra = RESP RX - POLL TX and Da = FINAL TX - RESP RX measured by the initiator, Rb = FINAL RX - RESP TX and Db = RESP TX - POLL RX
+ *    measured by the responder, the time of flight is (Ra*Rb - Da*Db) / (Ra + Rb + Da + Db). The products are taken in 64-bit integers, the
+ *    intervals are a few ms (~1e8 device time units) so they do not overflow, and the result does not depend on the clock offset between the
+ *    two devices to first order.
+ * 2. The antenna delays should be calibrated per board, the default of the Decawave examples is used here. The TX timestamps include the TX
+ *    antenna delay and the RX timestamps have the RX antenna delay removed by the DW1000, so the distance is measured between the antennas.
+ * 3. DX_TIME takes the upper 32 bits of the 40-bit device time and ignores its lowest bit, so the frame leaves at a multiple of 512 device time
+ *    units. The TX timestamp it will get, that lowered time plus the TX antenna delay, is computed in advance and written into the frame.
+ ****************************************************************************************************************************************************/
@@ -23,10 +23,13 @@
 #include <stdint.h>
 #include <string.h> // memset
 #include <time.h>
+#include <errno.h>
+#include <signal.h>
 
 #include "deca_device_api.h"
 #include "deca_regs.h"
 #include "platform.h"
+#include "time_sync.h"
 
 #define APP_NAME "HEADCOUNT TX v2.0"
 
@@ -53,9 +56,116 @@ static dwt_config_t config = {
 /* Inter-frame delay period, in milliseconds. */
 #define TX_SLOT_MS 50
 
+/* Time before its slot at which a frame is written and its delayed TX armed, in milliseconds. See NOTE 8 below. */
+#define TX_PREP_MS 5
+
+/* DW1000 system time: 40-bit counter of 1/(128*499.2 MHz) ticks (~15.65 ps), DX_TIME takes its upper 32 bits. */
+#define DWT_TICKS_PER_MS 63897600ULL
+#define DWT_HI32_PER_MS (DWT_TICKS_PER_MS >> 8)
+#define DWT_TIME_MASK 0xFFFFFFFFFFULL
+
+/* Jitter histograms: bin 0 counts zero deviations, bin k deviations in [2^(k-1), 2^k), the last bin everything above. */
+#define HIST_BINS 24
+
 typedef unsigned long long uint64;
 typedef signed long long int64;
 
+typedef struct {
+    unsigned long bin[HIST_BINS];
+    unsigned long count;
+    uint64 max;
+    double sum;
+} jitter_hist_t;
+
+/* Send time sync beacons (-b), see NOTE 9 below. */
+static int beacon = 0;
+
+/* Set by SIGINT/SIGTERM to stop sending and print the jitter report. */
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+static void hist_add(jitter_hist_t *h, uint64 value)
+{
+    int b = 0;
+    
+    while (b < HIST_BINS - 1 && value >= (1ULL << b))
+    {
+        b++;
+    }
+    h->bin[b]++;
+    h->count++;
+    h->sum += (double) value;
+    if (value > h->max)
+    {
+        h->max = value;
+    }
+}
+
+static void hist_print(const char *title, const char *unit, const jitter_hist_t *h)
+{
+    int b;
+    int last = 0;
+    
+    printf("%s: %lu samples, mean %.1f %s, max %llu %s\n", title, h->count, h->count ? h->sum / h->count : 0.0, unit, h->max, unit);
+    for (b = 0; b < HIST_BINS; b++)
+    {
+        if (h->bin[b])
+        {
+            last = b;
+        }
+    }
+    for (b = 0; b <= last; b++)
+    {
+        unsigned long lo = b ? 1UL << (b - 1) : 0;
+        unsigned long hi = b ? 1UL << b : 1;
+        int bar = h->count ? (int) (50 * h->bin[b] / h->count) : 0;
+        
+        if (b == HIST_BINS - 1)
+        {
+            printf("  [%8lu,      inf) %s %8lu ", lo, unit, h->bin[b]);
+        }
+        else
+        {
+            printf("  [%8lu, %8lu) %s %8lu ", lo, hi, unit, h->bin[b]);
+        }
+        while (bar-- > 0)
+        {
+            putchar('#');
+        }
+        putchar('\n');
+    }
+}
+
+/* Nanoseconds spanned by a number of DX_TIME units (256 ticks, ~4.006 ns). */
+static int64 hi32_to_ns(int64 units)
+{
+    return units * 1000000 / (int64) DWT_HI32_PER_MS;
+}
+
+static void timespec_add_ns(struct timespec *t, int64 ns)
+{
+    int64 total = (int64) t->tv_nsec + ns;
+    
+    t->tv_sec += total / 1000000000LL;
+    total %= 1000000000LL;
+    if (total < 0)
+    {
+        total += 1000000000LL;
+        t->tv_sec--;
+    }
+    t->tv_nsec = (long) total;
+}
+
+static int64 timespec_diff_ns(const struct timespec *a, const struct timespec *b)
+{
+    return (int64) (b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec);
+}
+
 static void setup_dw1000(void) {
     
     /* Reset and initialise DW1000.
@@ -73,6 +183,7 @@ static void setup_dw1000(void) {
     
     /* Configure DW1000. See NOTE 7 below. */
     dwt_configure(&config);
+    spi_stats_reset(); /* Only count the frame cycles, see spi_stats_dump(). */
     
     printf("%s\n", APP_NAME);
 }
@@ -80,7 +191,8 @@ static void setup_dw1000(void) {
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn initiator()
  *
- * @brief Send the MSG for given time slot and batch number.
+ * @brief Send the MSG for given time slot and batch number. Frames are sent with delayed TX on the DW1000 system clock,
+ *        TX_SLOT_MS apart, and the host sleeps between frame preparations. See NOTE 8 below.
  *
  * @param  none
  *
@@ -88,69 +200,152 @@ static void setup_dw1000(void) {
  */
 static void initiator(void){
     /******** Variable Define *********/
-    uint8 tx_msg[] = {0xab, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    uint8 tx_msg[SYNC_BEACON_LEN] = {0xab, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     /*The frame sent in this example is adjusted from an 802.15.4e standard blink. It is a 12-byte frame composed of the following fields:
      *     - byte 0: frame type (0xC5 for a blink).
      *     - byte 1: not used here
      *     - byte 2 -> 9: current time
      *     - byte 10/11: frame check-sum, automatically set by DW1000.
      size = 1+1+8+2 = 12
+     * A time sync beacon has SYNC_BEACON in byte 1 and its TX time in bytes 10 -> 17, then the check-sum: 20 bytes.
      */
-    char flag = 0;
+    const uint16 tx_len = beacon ? SYNC_BEACON_LEN : 12;
+    uint16 tx_antd = dwt_read16bitoffsetreg(TX_ANTD_ID, TX_ANTD_OFFSET);
+    uint64_t tx_clock = 0;                              // TX times of the beacons, extended past the 40-bit wrap
     /* Frequency Control */
-    double duration;
-    struct timespec tm_last;
+    const uint32 slot = TX_SLOT_MS * DWT_HI32_PER_MS;   // TX period in DX_TIME units
+    uint32 tx_time;                                     // DX_TIME of the frame being armed
+    uint32 sys_time;
+    uint8 ts[5];
+    uint64 tx_stamp;
+    uint64 last_stamp = 0;
+    int pending = 0;                                    // a frame is armed and its TXFRS not yet seen
+    unsigned long late = 0;
+    struct timespec tm_wake;
     struct timespec tm_now;
-    clock_gettime(CLOCK_REALTIME, &tm_last);
+    int64 wake_late;
+    jitter_hist_t period_hist;
+    jitter_hist_t wake_hist;
+    
+    memset(&period_hist, 0, sizeof(period_hist));
+    memset(&wake_hist, 0, sizeof(wake_hist));
+    
+    /* First slot one preparation margin from now. */
+    tx_time = dwt_readsystimestamphi32() + 2 * TX_PREP_MS * DWT_HI32_PER_MS;
     
     /******** Batch MSG sending loop *********/
-    for(uint64 seq=1; seq<=BATCH_NUM; seq++){
+    for(uint64 seq=1; seq<=BATCH_NUM && !stop_requested; seq++){
         memcpy((void *) &tx_msg[FLAG_IDX], (void *) &seq, sizeof(uint64));
-        flag = !flag;
-        /* Write frame data to DW1000 and prepare transmission. See NOTE 4 below.*/
-        dwt_writetxdata(sizeof(tx_msg), tx_msg, 0); /* Zero offset in TX buffer. */
-        dwt_writetxfctrl(sizeof(tx_msg), 0, 0); /* Zero offset in TX buffer, no ranging. */
         
-        /* Start transmission. */
-        dwt_starttx(DWT_START_TX_IMMEDIATE);
+        /* The previous frame went out about TX_SLOT_MS - TX_PREP_MS ago. See NOTE 5 below. */
+        if (pending)
+        {
+            while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS))
+            { };
+            dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
+            
+            /* Achieved period from the TX timestamps of consecutive frames. */
+            dwt_readtxtimestamp(ts);
+            tx_stamp = ((uint64) ts[4] << 32) | ((uint64) ts[3] << 24) | ((uint64) ts[2] << 16) | ((uint64) ts[1] << 8) | ts[0];
+            if (last_stamp)
+            {
+                int64 period = (int64) ((tx_stamp - last_stamp) & DWT_TIME_MASK);
+                int64 error = period - (int64) ((uint64) slot << 8);
+                hist_add(&period_hist, (uint64) (error < 0 ? -error : error) * 1000000 / DWT_TICKS_PER_MS);
+            }
+            last_stamp = tx_stamp;
+            pending = 0;
+        }
         
-        /* Poll DW1000 until TX frame sent event set. See NOTE 5 below.
-         * STATUS register is 5 bytes long but, as the event we are looking at is in the first byte of the register, we can use this simplest API
-         * function to access it.*/
-        while (!(dwt_read32bitreg(SYS_STATUS_ID) & SYS_STATUS_TXFRS))
-        { };
+        /* A beacon carries its own TX timestamp, known before it is sent: DX_TIME without its ignored low bit, plus
+         * the TX antenna delay. */
+        if (beacon)
+        {
+            uint64_t stamp = ((((uint64_t) tx_time & 0xFFFFFFFEUL) << 8) + tx_antd) & DWT_TIME_MASK;
+            uint64_t master = time_sync_extend(&tx_clock, stamp);
+            
+            tx_msg[1] = SYNC_BEACON;
+            memcpy((void *) &tx_msg[SYNC_TIME_IDX], (void *) &master, sizeof(uint64_t));
+        }
+        
+        /* Write frame data to DW1000 and prepare transmission. See NOTE 4 below.*/
+        dwt_writetxdata(tx_len, tx_msg, 0); /* Zero offset in TX buffer. */
+        dwt_writetxfctrl(tx_len, 0, 0); /* Zero offset in TX buffer, no ranging. */
         
-        /* Clear TX frame sent event. */
-        dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_TXFRS);
-        printf("%llu MSG SENT!\r\n", seq);
+        /* Start transmission at the start of the slot. */
+        dwt_setdelayedtrxtime(tx_time);
+        if (dwt_starttx(DWT_START_TX_DELAYED) == DWT_SUCCESS)
+        {
+            pending = 1;
+            printf("%llu MSG SENT!\r\n", seq);
+        }
+        else
+        {
+            /* Armed too late for the slot: it is skipped and the slot grid restarts from now. */
+            late++;
+            last_stamp = 0;
+            tx_time = dwt_readsystimestamphi32() + 2 * TX_PREP_MS * DWT_HI32_PER_MS - slot;
+            printf("%llu MSG LATE!\r\n", seq);
+        }
         
-        /* Frequency Control */
-        do {
-            clock_gettime(CLOCK_REALTIME, &tm_now);
-            duration = (double) 1000 * (tm_now.tv_sec - tm_last.tv_sec) + (tm_now.tv_nsec - tm_last.tv_nsec)/1000000;
-        } while (duration<TX_SLOT_MS);
-        memcpy((void *) &tm_last, (void *) &tm_now, sizeof(struct timespec));
-        printf("%f\r\n", duration);
+        /* Wake up TX_PREP_MS before the next slot. The wake-up time is derived from the DW1000 clock each time so
+         * that the host and DW1000 crystals cannot drift apart. */
+        sys_time = dwt_readsystimestamphi32();
+        clock_gettime(CLOCK_MONOTONIC, &tm_wake);
+        tx_time += slot;
+        timespec_add_ns(&tm_wake, hi32_to_ns((int32) (tx_time - sys_time)) - TX_PREP_MS * 1000000LL);
+        
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tm_wake, NULL) == EINTR && !stop_requested)
+        { };
+        clock_gettime(CLOCK_MONOTONIC, &tm_now);
+        wake_late = timespec_diff_ns(&tm_wake, &tm_now);
+        hist_add(&wake_hist, (uint64) (wake_late > 0 ? wake_late / 1000 : 0));
     }
+    
+    printf("%lu frames missed their slot\r\n", late);
+    hist_print("TX period error", "ns", &period_hist);
+    hist_print("Host wake-up latency", "us", &wake_hist);
+    spi_stats_dump(stdout);
 }
 
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn main()
  *
- * @brief Application entry point.
+ * @brief Application entry point. With -b the frames are time sync beacons.
  *
- * @param  none
+ * @param  argc, argv - command line
  *
  * @return none
  */
-int main(void)
+int main(int argc, char **argv)
 {
+    struct sigaction sa;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "b")) != -1)
+    {
+        if (opt == 'b')
+        {
+            beacon = 1;
+        }
+        else
+        {
+            printf("Usage: dw1000_tx [-b]\n");
+            return 0;
+        }
+    }
+    
     /** Initialization **/
     
     /* Start with board specific hardware init. */
 	hardware_init();
     setup_dw1000();
     
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
     
     /** MSG Sending Loop **/
     initiator();
@@ -174,5 +369,15 @@ int main(void)
  *    Please refer to DW1000 User Manual for more details on "interrupts".
  * 6. The user is referred to DecaRanging ARM application (distributed with EVK1000 product) for additional practical example of usage, and to the
  *    DW1000 API Guide for more details on the DW1000 driver functions.
+ * 8. Frames are sent with dwt_starttx(DWT_START_TX_DELAYED) at slot times kept on the DW1000 system clock, so the period is set by the DW1000
+ *    crystal and not by host scheduling. DX_TIME ignores the low 9 bits of the system time, slots are therefore on a ~8 ns grid and TX_SLOT_MS
+ *    must map to a multiple of it (1 ms does). The host sleeps with clock_nanosleep() until TX_PREP_MS before the next slot, then collects the
+ *    previous TXFRS and arms the next frame. A frame armed after its slot time is not sent, counted late, and the slots restart from
+ *    the current time. On exit, the deviation of the period
+ *    measured from consecutive TX timestamps and the host wake-up latency are printed as histograms.
+ * 9. With -b every frame is a time sync beacon (see time_sync.h): the receivers estimate the offset and drift of their clock against this node
+ *    from the beacons and stamp their CIR records with the time on this node's clock. The TX time written in the frame is the TX timestamp the
+ *    DW1000 will take, extended with the wraps of the 40-bit system time so that it keeps counting after ~17.2 s. A late frame is not sent, its
+ *    time is simply never seen.
  ****************************************************************************************************************************************************/
 
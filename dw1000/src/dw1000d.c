@@ -0,0 +1,1031 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    dw1000d.c
+ *  @brief   Resident DW1000 daemon
+ *
+ *           Initialises the DW1000 once and switches it between listening and speaking on commands received over a local
+ *           Unix socket, so no process is started and no radio initialisation is repeated per message. One command per
+ *           line, one reply line per command starting with "OK" or "ERR":
+ *               - RX [<file> [window]]      listen, saving CIRs as binary records (see cir_record.h) to ../../data/<file>.
+ *                                           Without a file, listening resumes into the capture already open.
+ *               - TX <seq> [count] [period] send <count> frames (default 1) carrying sequence numbers <seq>, <seq>+1...
+ *                                           <period> ms apart (default 50). The radio goes back to listening afterwards
+ *                                           if a capture is open.
+ *               - TDMA <slot> <slots> [slot_ms] [rounds]
+ *                                           take part in a round of <slots> slots of <slot_ms> ms (default 6) repeated
+ *                                           <rounds> times (default 40, 0 for no limit): send one frame per round in slot
+ *                                           <slot> and listen in the others, saving their CIRs if a capture is open. See
+ *                                           NOTE 1 below.
+ *               - FEATURES <every> [background]
+ *                                           from the next RX <file>, reduce every frame to a feature record saved to
+ *                                           <file>.feat and only save the whole record of one frame in <every> (0 for
+ *                                           none) to <file>. The background model of each sender starts from the
+ *                                           mean of <background> frames (default 100).
+ *                                           FEATURES OFF goes back to whole records. See NOTE 3 below.
+ *               - KEEP <frames>             save the whole records of the next <frames> frames of a feature capture.
+ *               - COMPRESS ON|OFF           from the next RX <file>, write the CIR records coded by the lossless codec of
+ *                                           cir_codec.h, which cirz decodes. See NOTE 4 below.
+ *               - IDLE                      turn the radio off, an open capture stays open.
+ *               - CLOSE                     turn the radio off and close the capture.
+ *               - STATUS                    role and counters.
+ *               - QUIT                      close the capture and stop the daemon.
+ *           Everything runs in one thread: the socket and the DW1000 IRQ line are waited on together with poll() and radio
+ *           events are dispatched through dwt_isr(), so a role switch only costs the few SPI accesses it needs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "platform.h"
+#include "cir_record.h"
+#include "cir_writer.h"
+#include "cir_capture.h"
+#include "cir_features.h"
+#include "time_sync.h"
+
+#define APP_NAME "HEADCOUNT DAEMON v2.0"
+
+/* Default communication configuration, identical to dw1000_tx and dw1000_rx_cir. */
+static dwt_config_t config = {
+    2,               /* Channel number. */
+    DWT_PRF_64M,     /* Pulse repetition frequency. */
+    DWT_PLEN_1024,   /* Preamble length. Used in TX only. */
+    DWT_PAC32,       /* Preamble acquisition chunk size. Used in RX only. */
+    9,               /* TX preamble code. Used in TX only. */
+    9,               /* RX preamble code. Used in RX only. */
+    1,               /* 0 to use standard SFD, 1 to use non-standard SFD. */
+    DWT_BR_110K,     /* Data rate. */
+    DWT_PHRMODE_STD, /* PHY header mode. */
+    (1025 + 64 - 32) /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+};
+
+/* Index to access to a certain frame in the tx_msg array. */
+#define FLAG_IDX   2   // sequence number index
+#define FLAG 0xab   // Flag: check message
+
+#define TX_FRAME_LEN 12   // flag, pad, sequence number, FCS
+#define RX_BUF_LEN SYNC_BEACON_LEN   // The longest frame, a time sync beacon
+
+#define SOCKET_PATH "/tmp/dw1000d.sock"
+#define DATA_DIR "../../data"
+#define MAX_CLIENTS 4
+#define CMD_LEN 128
+
+#define TX_PERIOD_MS 50   // default period of a TX burst
+#define DWT_HI32_PER_MS 249600UL   // DX_TIME units (256 system time ticks, ~4.006 ns) per millisecond
+#define DWT_HI32_PER_UUS 256   // DX_TIME units per RX_FWTO unit (512/499.2 us)
+
+#define TDMA_SLOT_MS 6   // default slot, a frame is about 2.5 ms on air
+#define TDMA_SLOT_MIN_MS 5   // air time plus the guard
+#define TDMA_PERIOD_MAX_MS 1000   // DX_TIME differences stay far from their 17.2 s wrap
+#define TDMA_ROUNDS 40
+#define FEATURES_BACKGROUND 100   // default warmup frames of the feature background models
+/* The receiver stops this long before the own slot to arm the frame: the preamble starts ~1 ms before DX_TIME and the
+ * host needs the rest to take the timeout interrupt and write the frame. */
+#define TDMA_GUARD_HI32 (2500 * DWT_HI32_PER_MS / 1000)
+
+#define POLL_MS 1000   // longest wait before checking for a stop request
+
+/* RX and TX events routed to the IRQ line. */
+#define RADIO_EVENTS (DWT_INT_TFRS | DWT_INT_RFCG | DWT_INT_RPHE | DWT_INT_RFCE | DWT_INT_RFSL | DWT_INT_RFTO | DWT_INT_RXPTO \
+                      | DWT_INT_SFDT | DWT_INT_ARFE)
+
+typedef unsigned long long uint64;
+
+typedef enum {
+    ROLE_IDLE,
+    ROLE_RX,
+    ROLE_TX,
+    ROLE_TDMA
+} role_t;
+
+typedef struct {
+    int fd;
+    int len;
+    char buf[CMD_LEN];
+} client_t;
+
+static role_t role = ROLE_IDLE;
+
+/* Capture */
+static int capture_fd = -1;
+static cir_writer_t *writer = NULL;
+static uint16 capture_window = 0;
+static unsigned long rx_frames = 0;
+static uint8 rx_buffer[RX_BUF_LEN];
+static time_sync_t sync_state;  // clock of the beacon sender, see NOTE 2 below
+
+/* Feature capture, see NOTE 3 below */
+static int features_on = 0;     // set by FEATURES, applies to the captures opened afterwards
+static cir_features_config_t features_config = { 0, FEATURES_BACKGROUND, DWT_PRF_64M, CIR_BACKGROUND_ALPHA,
+                                                  CIR_BACKGROUND_GATE };
+static int feature_fd = -1;     // open with the capture when it is a feature capture
+static cir_features_t features;
+static cir_writer_t *feature_writer = NULL;
+static cir_record_t *scratch = NULL;    // record of the frames whose whole record is not kept
+
+static int compress_on = 0;     // set by COMPRESS, applies to the captures opened afterwards, see NOTE 4 below
+
+/* TX burst */
+static uint8 tx_msg[SYNC_BEACON_LEN] = {FLAG, 0x00, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+static uint16 tx_antd = 0;     // TX antenna delay, for the TX time of the beacons
+static uint64_t tx_clock = 0;  // TX times of the beacons, extended past the 40-bit wrap
+static uint64 tx_seq = 0;
+static uint32 tx_left = 0;
+static uint32 tx_period = 0;   // DX_TIME units
+static uint32 tx_time = 0;     // DX_TIME of the next delayed frame
+static int tx_first = 0;       // next frame is the first of the burst
+static unsigned long tx_sent = 0;
+static unsigned long tx_late = 0;
+
+/* TDMA, the own frames use tx_seq and tx_time */
+static uint32 tdma_slot = 0;
+static uint32 tdma_slots = 0;
+static uint32 tdma_slot_len = 0;          // DX_TIME units
+static unsigned long tdma_rounds = 0;     // 0 for no limit
+static unsigned long tdma_round = 0;      // round of the next own frame
+static int tdma_armed = 0;                // tx_time of the next own frame is known
+static unsigned long tdma_beacons = 0;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void on_stop_signal(int sig)
+{
+    (void) sig;
+    stop_requested = 1;
+}
+
+static void setup_dw1000(void) {
+
+    /* Reset and initialise DW1000.
+     * For initialisation, DW1000 clocks must be temporarily set to crystal speed. After initialisation SPI rate can be increased for optimum performance.
+     */
+    reset_DW1000(); /* Target specific drive of RSTn line into DW1000 low for a period. */
+    spi_set_rate_low();
+
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        printf("%s\n", "INIT FAILED");
+        exit(1);
+    }
+    spi_set_rate_high();
+
+    dwt_configure(&config);
+    tx_antd = dwt_read16bitoffsetreg(TX_ANTD_ID, TX_ANTD_OFFSET);
+    spi_stats_reset(); /* Only count the frame cycles, see spi_stats_dump(). */
+
+    printf("%s\n", APP_NAME);
+}
+
+static void radioIdle(void)
+{
+    dwt_forcetrxoff();
+    if (role == ROLE_TDMA)
+    {
+        dwt_setrxtimeout(0);
+    }
+    tx_left = 0;
+    role = ROLE_IDLE;
+}
+
+static void radioListen(void)
+{
+    dwt_forcetrxoff();
+    if (role == ROLE_TDMA)
+    {
+        dwt_setrxtimeout(0);
+    }
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    role = ROLE_RX;
+}
+
+/* Back to listening after a TX burst if a capture is open. */
+static void txFinish(void)
+{
+    if (capture_fd >= 0)
+    {
+        radioListen();
+    }
+    else
+    {
+        radioIdle();
+    }
+}
+
+/* Write and start the next frame of the burst. The first goes out at once, the others on a period grid anchored on its
+ * TX timestamp. Frames armed too late for their slot are skipped. Returns 0 once no frame is left. */
+static int txArm(void)
+{
+    while (tx_left > 0)
+    {
+        tx_msg[1] = 0x00;
+        memcpy((void *) &tx_msg[FLAG_IDX], (void *) &tx_seq, sizeof(uint64));
+        dwt_writetxdata(TX_FRAME_LEN, tx_msg, 0); /* Zero offset in TX buffer. */
+        dwt_writetxfctrl(TX_FRAME_LEN, 0, 0); /* Zero offset in TX buffer, no ranging. */
+
+        if (tx_first)
+        {
+            dwt_starttx(DWT_START_TX_IMMEDIATE);
+            return 1;
+        }
+
+        dwt_setdelayedtrxtime(tx_time);
+        if (dwt_starttx(DWT_START_TX_DELAYED) == DWT_SUCCESS)
+        {
+            return 1;
+        }
+        tx_late++;
+        tx_left--;
+        tx_seq++;
+        tx_time += tx_period;
+    }
+    return 0;
+}
+
+/* Signed distance from b to a in DX_TIME units. */
+static int32_t hi32Diff(uint32 a, uint32 b)
+{
+    return (int32_t) (uint32_t) (a - b);
+}
+
+/* The own frame of the round is sent or skipped, move on to the next round. */
+static void tdmaNext(void)
+{
+    tdma_round++;
+    if (tdma_rounds && tdma_round >= tdma_rounds)
+    {
+        txFinish();
+        return;
+    }
+    if (tdma_slot == 0)
+    {
+        /* The beacon keeps its grid on the local clock. */
+        tx_time += tdma_slots * tdma_slot_len;
+    }
+    else
+    {
+        /* The others wait for the next beacon. */
+        tdma_armed = 0;
+    }
+}
+
+/* Write and start the own frame of the round. Returns 0 if it is too late for its slot and was skipped. The beacon is
+ * also a time sync beacon, carrying its TX timestamp: DX_TIME without its ignored low bit plus the TX antenna delay. */
+static int tdmaArm(void)
+{
+    uint16 len = TX_FRAME_LEN;
+
+    tx_seq = (uint64) tdma_round * tdma_slots + tdma_slot;
+    memcpy((void *) &tx_msg[FLAG_IDX], (void *) &tx_seq, sizeof(uint64));
+    tx_msg[1] = 0x00;
+    if (tdma_slot == 0)
+    {
+        uint64_t stamp = ((((uint64_t) tx_time & 0xFFFFFFFEUL) << 8) + tx_antd) & 0xFFFFFFFFFFULL;
+        uint64_t master = time_sync_extend(&tx_clock, stamp);
+
+        tx_msg[1] = SYNC_BEACON;
+        memcpy((void *) &tx_msg[SYNC_TIME_IDX], (void *) &master, sizeof(uint64_t));
+        len = SYNC_BEACON_LEN;
+    }
+    dwt_writetxdata(len, tx_msg, 0); /* Zero offset in TX buffer. */
+    dwt_writetxfctrl(len, 0, 0); /* Zero offset in TX buffer, no ranging. */
+    dwt_setdelayedtrxtime(tx_time);
+    if (dwt_starttx(DWT_START_TX_DELAYED) == DWT_SUCCESS)
+    {
+        return 1;
+    }
+    /* HPDWARN would fail every later delayed transmission. */
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_HPDWARN);
+    tx_late++;
+    tdmaNext();
+    return 0;
+}
+
+/* Listen until the own slot comes near, the frame wait timeout then hands over to tdmaArm(). */
+static void tdmaListen(void)
+{
+    while (role == ROLE_TDMA)
+    {
+        int32_t left;
+
+        if (!tdma_armed)
+        {
+            dwt_setrxtimeout(0);
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+            return;
+        }
+        left = hi32Diff(tx_time, dwt_readsystimestamphi32()) - (int32_t) TDMA_GUARD_HI32;
+        if (left >= DWT_HI32_PER_UUS)
+        {
+            left /= DWT_HI32_PER_UUS;
+            dwt_setrxtimeout((uint16) (left > RX_FWTO_MASK ? RX_FWTO_MASK : left));
+            dwt_rxenable(DWT_START_RX_IMMEDIATE);
+            return;
+        }
+        if (tdmaArm())
+        {
+            return;
+        }
+    }
+}
+
+/* A frame of slot 0 starts round seq / slots, the own slot is timed from its RX timestamp. */
+static void tdmaFrame(uint64 seq)
+{
+    unsigned long round;
+
+    if (tdma_slot == 0 || seq % tdma_slots != 0)
+    {
+        return;
+    }
+    round = (unsigned long) (seq / tdma_slots);
+    tdma_beacons++;
+    if (tdma_rounds && round >= tdma_rounds)
+    {
+        txFinish();
+        return;
+    }
+    tdma_round = round;
+    tx_time = dwt_readrxtimestamphi32() + tdma_slot * tdma_slot_len;
+    tdma_armed = 1;
+}
+
+static void txDoneCallback(const dwt_cb_data_t *cb_data)
+{
+    (void) cb_data;
+
+    if (role == ROLE_TDMA)
+    {
+        tx_sent++;
+        tdmaNext();
+        tdmaListen();
+        return;
+    }
+    if (role != ROLE_TX)
+    {
+        return;
+    }
+
+    if (tx_first)
+    {
+        tx_time = dwt_readtxtimestamphi32() + tx_period;
+        tx_first = 0;
+    }
+    else
+    {
+        tx_time += tx_period;
+    }
+    tx_sent++;
+    tx_left--;
+    tx_seq++;
+
+    if (!txArm())
+    {
+        txFinish();
+    }
+}
+
+static void rxOkCallback(const dwt_cb_data_t *cb_data)
+{
+    struct timespec tm_rx;
+    uint64 seq = 0;
+    dwt_batch_t batch;
+    dwt_rxinfo_t info;
+    cir_record_t *rec = NULL;
+    cir_feature_record_t *feat = NULL;
+    int keep = 1;
+
+    if (role != ROLE_RX && role != ROLE_TDMA)
+    {
+        return;
+    }
+
+    /* The frame, its timestamps and its diagnostics in one SPI submission. */
+    memset((void *) rx_buffer, 0, RX_BUF_LEN);
+    dwt_batchinit(&batch);
+    dwt_batchreadrxinfo(&batch, &info);
+    if (cb_data->datalength <= RX_BUF_LEN)
+    {
+        dwt_batchreadrxdata(&batch, rx_buffer, cb_data->datalength, 0);
+    }
+    dwt_batchsubmit(&batch);
+
+    if (FLAG == rx_buffer[0])
+    {
+        time_sync_frame(&sync_state, rx_buffer, cb_data->datalength, rxInfoTimestamp(&info), &config);
+    }
+
+    if (FLAG == rx_buffer[0] && capture_fd >= 0)
+    {
+        clock_gettime(CLOCK_REALTIME, &tm_rx);
+        memcpy((void *) &seq, (void *) &rx_buffer[FLAG_IDX], sizeof(uint64));
+        rx_frames++;
+
+        /* Never wait for the disk: if the ring is full the CIR is dropped. A feature capture only keeps some whole
+         * records, the other frames are reduced from the scratch record. */
+        if (feature_fd >= 0)
+        {
+            keep = cir_features_keepnext(&features);
+            feat = cir_writer_acquire_feature(feature_writer);
+        }
+        if (keep)
+        {
+            rec = cir_writer_acquire(writer);
+        }
+        if (rec == NULL && feat != NULL)
+        {
+            rec = scratch;
+        }
+        if (rec != NULL)
+        {
+            rec->seq = seq;
+            rec->rx_sec = tm_rx.tv_sec;
+            rec->rx_nsec = tm_rx.tv_nsec;
+            copyCIRToRecord(rec, capture_window, &info);
+            time_sync_stamp(&sync_state, rec);
+            if (feat != NULL)
+            {
+                cir_features_extract(&features, rec, role == ROLE_TDMA ? (unsigned) (seq % tdma_slots) : 0, feat);
+                if (rec != scratch)
+                {
+                    feat->flags |= CIR_FEATURE_FULL;
+                }
+                cir_writer_commit(feature_writer);
+            }
+            if (rec != scratch)
+            {
+                cir_writer_commit(writer);
+            }
+        }
+    }
+
+    if (role == ROLE_TDMA)
+    {
+        if (FLAG == rx_buffer[0])
+        {
+            memcpy((void *) &seq, (void *) &rx_buffer[FLAG_IDX], sizeof(uint64));
+            tdmaFrame(seq);
+        }
+        tdmaListen();
+    }
+    else if (role == ROLE_RX)
+    {
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+}
+
+/* dwt_isr() has already cleared the events and reset the receiver. In TDMA the frame wait timeout ends up here. */
+static void rxErrCallback(const dwt_cb_data_t *cb_data)
+{
+    (void) cb_data;
+
+    if (role == ROLE_RX)
+    {
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    }
+    else if (role == ROLE_TDMA)
+    {
+        tdmaListen();
+    }
+}
+
+static void captureClose(char *reply, size_t size)
+{
+    cir_writer_stats_t st;
+    cir_writer_stats_t fst;
+    char ratio[32] = "";
+
+    if (capture_fd < 0)
+    {
+        snprintf(reply, size, "OK");
+        return;
+    }
+    cir_writer_stop(writer, &st);
+    writer = NULL;
+    close(capture_fd);
+    capture_fd = -1;
+    if (st.file_bytes < st.raw_bytes)
+    {
+        snprintf(ratio, sizeof(ratio), " ratio %.2f", (double) st.raw_bytes / (double) st.file_bytes);
+    }
+    if (feature_fd < 0)
+    {
+        snprintf(reply, size, "OK saved %lu dropped %lu errors %lu%s", st.written, st.dropped, st.errors, ratio);
+        return;
+    }
+    cir_writer_stop(feature_writer, &fst);
+    feature_writer = NULL;
+    close(feature_fd);
+    feature_fd = -1;
+    free(scratch);
+    scratch = NULL;
+    snprintf(reply, size, "OK saved %lu dropped %lu errors %lu%s features %lu dropped %lu errors %lu", st.written,
+             st.dropped, st.errors, ratio, fst.written, fst.dropped, fst.errors);
+}
+
+static int captureOpen(const char *name, uint16 window, char *reply, size_t size)
+{
+    char filename[256];
+    char closed[CMD_LEN];
+    int fd;
+    int ffd = -1;
+
+    snprintf(filename, sizeof(filename), "%s/%s", DATA_DIR, name);
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        perror(filename);
+        snprintf(reply, size, "ERR cannot open capture file: %s", strerror(errno));
+        return -1;
+    }
+    if (features_on)
+    {
+        snprintf(filename, sizeof(filename), "%s/%s.feat", DATA_DIR, name);
+        ffd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (ffd < 0)
+        {
+            perror(filename);
+            snprintf(reply, size, "ERR cannot open feature file: %s", strerror(errno));
+            close(fd);
+            return -1;
+        }
+    }
+
+    captureClose(closed, sizeof(closed));
+    if (compress_on)
+    {
+        writer = cir_writer_start_coded(fd, CIR_WRITER_SLOTS, window ? 2*window : CIR_SAMPLES);
+    }
+    else
+    {
+        writer = cir_writer_start(fd, CIR_WRITER_SLOTS, window ? 2*window : CIR_SAMPLES);
+    }
+    if (writer == NULL)
+    {
+        close(fd);
+        if (ffd >= 0)
+        {
+            close(ffd);
+        }
+        snprintf(reply, size, "ERR writer");
+        return -1;
+    }
+    if (ffd >= 0)
+    {
+        features_config.prf = config.prf;
+        cir_features_init(&features, &features_config);
+        feature_writer = cir_writer_start_features(ffd, CIR_WRITER_SLOTS);
+        scratch = (cir_record_t *) calloc(1, CIR_RECORD_LEN(window ? 2*window : CIR_SAMPLES));
+        if (feature_writer == NULL || scratch == NULL)
+        {
+            cir_writer_stop(writer, NULL);
+            cir_writer_stop(feature_writer, NULL);
+            writer = NULL;
+            feature_writer = NULL;
+            free(scratch);
+            scratch = NULL;
+            close(fd);
+            close(ffd);
+            snprintf(reply, size, "ERR writer");
+            return -1;
+        }
+        feature_fd = ffd;
+    }
+    capture_fd = fd;
+    capture_window = window;
+    rx_frames = 0;
+    return 0;
+}
+
+/* Execute one command line, the reply has no line terminator. Returns 1 for QUIT. */
+static int command(char *line, char *reply, size_t size)
+{
+    char verb[16] = "";
+    char name[CMD_LEN] = "";
+    unsigned long long seq = 0;
+    unsigned long a = 0;
+    unsigned long b = 0;
+    int n;
+
+    n = sscanf(line, "%15s", verb);
+    if (n != 1)
+    {
+        snprintf(reply, size, "ERR empty command");
+        return 0;
+    }
+
+    if (strcmp(verb, "RX") == 0)
+    {
+        n = sscanf(line, "%*s %127s %lu", name, &a);
+        if (n >= 1)
+        {
+            if (a > CIR_WINDOW_MAX)
+            {
+                snprintf(reply, size, "ERR window must be between 1 and %d taps", CIR_WINDOW_MAX);
+                return 0;
+            }
+            dwt_forcetrxoff();
+            if (captureOpen(name, (uint16) a, reply, size) != 0)
+            {
+                radioIdle();
+                return 0;
+            }
+        }
+        else if (capture_fd < 0)
+        {
+            snprintf(reply, size, "ERR no capture open");
+            return 0;
+        }
+        radioListen();
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "TX") == 0)
+    {
+        n = sscanf(line, "%*s %llu %lu %lu", &seq, &a, &b);
+        if (n < 1)
+        {
+            snprintf(reply, size, "ERR usage: TX <seq> [count] [period_ms]");
+            return 0;
+        }
+        dwt_forcetrxoff();
+        role = ROLE_TX;
+        tx_seq = seq;
+        tx_left = n >= 2 ? a : 1;
+        tx_period = (n >= 3 ? b : TX_PERIOD_MS) * DWT_HI32_PER_MS;
+        tx_first = 1;
+        if (!txArm())
+        {
+            txFinish();
+        }
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "TDMA") == 0)
+    {
+        unsigned long slot_ms = TDMA_SLOT_MS;
+        unsigned long rounds = TDMA_ROUNDS;
+
+        n = sscanf(line, "%*s %lu %lu %lu %lu", &a, &b, &slot_ms, &rounds);
+        if (n < 2 || b == 0 || a >= b)
+        {
+            snprintf(reply, size, "ERR usage: TDMA <slot> <slots> [slot_ms] [rounds]");
+            return 0;
+        }
+        if (slot_ms < TDMA_SLOT_MIN_MS || b * slot_ms > TDMA_PERIOD_MAX_MS)
+        {
+            snprintf(reply, size, "ERR slots of %d ms at least, rounds of %d ms at most", TDMA_SLOT_MIN_MS,
+                     TDMA_PERIOD_MAX_MS);
+            return 0;
+        }
+        if (feature_writer != NULL && b > CIR_FEATURES_LINKS)
+        {
+            snprintf(reply, size, "ERR a feature capture has background models for %d slots at most",
+                     CIR_FEATURES_LINKS);
+            return 0;
+        }
+        dwt_forcetrxoff();
+        role = ROLE_TDMA;
+        tx_left = 0;
+        tdma_slot = (uint32) a;
+        tdma_slots = (uint32) b;
+        tdma_slot_len = (uint32) (slot_ms * DWT_HI32_PER_MS);
+        tdma_rounds = rounds;
+        tdma_round = 0;
+        tdma_beacons = 0;
+        tdma_armed = tdma_slot == 0;
+        if (tdma_armed)
+        {
+            /* The first beacon leaves after one guard of listening. */
+            tx_time = dwt_readsystimestamphi32() + 2 * TDMA_GUARD_HI32;
+        }
+        tdmaListen();
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "FEATURES") == 0)
+    {
+        unsigned long background = FEATURES_BACKGROUND;
+
+        n = sscanf(line, "%*s %127s %lu", name, &background);
+        if (n >= 1 && strcmp(name, "OFF") == 0)
+        {
+            features_on = 0;
+        }
+        else if (n >= 1 && sscanf(name, "%lu", &a) == 1)
+        {
+            features_on = 1;
+            features_config.every = (uint32_t) a;
+            features_config.background_frames = (uint32_t) background;
+        }
+        else
+        {
+            snprintf(reply, size, "ERR usage: FEATURES <every> [background] | FEATURES OFF");
+            return 0;
+        }
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "COMPRESS") == 0)
+    {
+        n = sscanf(line, "%*s %127s", name);
+        if (n == 1 && strcmp(name, "ON") == 0)
+        {
+            compress_on = 1;
+        }
+        else if (n == 1 && strcmp(name, "OFF") == 0)
+        {
+            compress_on = 0;
+        }
+        else
+        {
+            snprintf(reply, size, "ERR usage: COMPRESS ON|OFF");
+            return 0;
+        }
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "KEEP") == 0)
+    {
+        n = sscanf(line, "%*s %lu", &a);
+        if (n < 1)
+        {
+            snprintf(reply, size, "ERR usage: KEEP <frames>");
+            return 0;
+        }
+        if (feature_fd < 0)
+        {
+            snprintf(reply, size, "ERR no feature capture open");
+            return 0;
+        }
+        cir_features_keep(&features, (uint32_t) a);
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "IDLE") == 0)
+    {
+        radioIdle();
+        snprintf(reply, size, "OK");
+    }
+    else if (strcmp(verb, "CLOSE") == 0)
+    {
+        radioIdle();
+        captureClose(reply, size);
+    }
+    else if (strcmp(verb, "STATUS") == 0)
+    {
+        cir_writer_stats_t st;
+
+        memset(&st, 0, sizeof(st));
+        if (capture_fd >= 0)
+        {
+            cir_writer_getstats(writer, &st);
+        }
+        snprintf(reply, size, "OK role %s rx %lu saved %lu dropped %lu tx %lu late %lu round %lu beacons %lu sync %lu "
+                 "features %lu", role == ROLE_RX ? "RX" : role == ROLE_TX ? "TX" : role == ROLE_TDMA ? "TDMA" : "IDLE",
+                 rx_frames, st.written, st.dropped, tx_sent, tx_late, tdma_round, tdma_beacons, sync_state.beacons,
+                 feature_fd >= 0 ? features.frames : 0UL);
+    }
+    else if (strcmp(verb, "QUIT") == 0)
+    {
+        radioIdle();
+        captureClose(reply, size);
+        return 1;
+    }
+    else
+    {
+        snprintf(reply, size, "ERR unknown command %s", verb);
+    }
+    return 0;
+}
+
+static int socketOpen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, MAX_CLIENTS) < 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    /* The daemon runs as root for SPI and GPIO access, let the unprivileged MQTT client connect. */
+    chmod(path, 0666);
+    return fd;
+}
+
+/* Read from a client and execute its complete lines. Returns -1 when the client is gone, 1 for QUIT. */
+static int clientRead(client_t *c)
+{
+    char reply[CMD_LEN + 64];
+    ssize_t n;
+    char *eol;
+    int quit = 0;
+
+    n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+    if (n <= 0)
+    {
+        return -1;
+    }
+    c->len += n;
+    c->buf[c->len] = '\0';
+
+    while (!quit && (eol = strchr(c->buf, '\n')) != NULL)
+    {
+        *eol = '\0';
+        if (eol > c->buf && eol[-1] == '\r')
+        {
+            eol[-1] = '\0';
+        }
+        quit = command(c->buf, reply, sizeof(reply) - 1);
+        strcat(reply, "\n");
+        if (write(c->fd, reply, strlen(reply)) < 0)
+        {
+            return -1;
+        }
+        c->len -= (int) (eol + 1 - c->buf);
+        memmove(c->buf, eol + 1, c->len + 1);
+    }
+
+    if (c->len == (int) sizeof(c->buf) - 1)
+    {
+        /* Line too long, drop it. */
+        c->len = 0;
+    }
+    return quit;
+}
+
+int main(int argc, char **argv)
+{
+    const char *path = SOCKET_PATH;
+    struct pollfd fds[2 + MAX_CLIENTS];
+    client_t clients[MAX_CLIENTS];
+    struct sigaction sa;
+    int listen_fd;
+    int quit = 0;
+    int i;
+
+    if (argc > 2)
+    {
+        printf("Usage: dw1000d [socket_path]\n");
+        return 1;
+    }
+    if (argc == 2)
+    {
+        path = argv[1];
+    }
+
+    /** Initialization **/
+    if (hardware_init() != 0 || irq_init() != 0)
+    {
+        return 1;
+    }
+    setup_dw1000();
+    time_sync_init(&sync_state);
+    dwt_setcallbacks(&txDoneCallback, &rxOkCallback, &rxErrCallback, &rxErrCallback);
+    dwt_setinterrupt(RADIO_EVENTS, 1);
+
+    listen_fd = socketOpen(path);
+    if (listen_fd < 0)
+    {
+        return 1;
+    }
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        clients[i].fd = -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on %s\n", path);
+
+    /** Event loop **/
+    while (!quit && !stop_requested)
+    {
+        fds[0].fd = irq_fd();
+        fds[0].events = POLLIN;
+        fds[1].fd = listen_fd;
+        fds[1].events = POLLIN;
+        for (i = 0; i < MAX_CLIENTS; i++)
+        {
+            fds[2 + i].fd = clients[i].fd;
+            fds[2 + i].events = POLLIN;
+        }
+
+        if (poll(fds, 2 + MAX_CLIENTS, POLL_MS) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("poll");
+            break;
+        }
+
+        /* Radio events first, they are time critical. */
+        if (fds[0].revents & POLLIN)
+        {
+            while (irq_wait(0) > 0)
+            {
+                dwt_isr();
+            }
+        }
+
+        if (fds[1].revents & POLLIN)
+        {
+            int fd = accept(listen_fd, NULL, NULL);
+            for (i = 0; i < MAX_CLIENTS && clients[i].fd >= 0; i++)
+            { };
+            if (fd >= 0 && i < MAX_CLIENTS)
+            {
+                clients[i].fd = fd;
+                clients[i].len = 0;
+            }
+            else if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+
+        for (i = 0; i < MAX_CLIENTS && !quit; i++)
+        {
+            int r;
+
+            if (clients[i].fd < 0 || !(fds[2 + i].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+            r = clientRead(&clients[i]);
+            if (r < 0)
+            {
+                close(clients[i].fd);
+                clients[i].fd = -1;
+            }
+            quit = r > 0;
+        }
+    }
+
+    if (!quit)
+    {
+        char reply[CMD_LEN];
+
+        radioIdle();
+        captureClose(reply, sizeof(reply));
+    }
+    dwt_setinterrupt(SYS_MASK_MASK_32, 0);
+    spi_stats_dump(stdout);
+    for (i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd >= 0)
+        {
+            close(clients[i].fd);
+        }
+    }
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
+
+/*****************************************************************************************************************************************************
+ * NOTES:
+ *
+ * 1. The node of slot 0 sends the beacon: the frame of round r carries sequence number r * <slots> and goes out every <slots> * <slot_ms> ms
+ *    on a delayed transmission grid of its own clock. Every other node takes the RX timestamp of the beacon as the start of the round and
+ *    sends its frame, sequence number r * <slots> + <slot>, <slot> * <slot_ms> ms later, also as a delayed transmission. Between its own
+ *    frames a node listens with the frame wait timeout set to end TDMA_GUARD_HI32 before its slot, so the whole round needs no host timer
+ *    and no message from the controller. A node that misses the beacon skips its slot for that round. The round number and the
+ *    transmitting slot of every CIR saved follow from its sequence number.
+ * 2. The beacon of slot 0 is also a time sync beacon (see time_sync.h), and so are the frames of dw1000_tx -b. Every node listening follows the
+ *    clock of their sender and stamps the CIR records it saves with the time of the frame on that clock (CIR_RECORD_SYNC), so the captures of
+ *    all the nodes share one timebase. STATUS counts the sync beacons received.
+ * 3. After FEATURES, a capture reduces the CIR of every frame to an 80-byte feature record on the fly (see cir_features.h) and only saves
+ *    the whole records sampled by <every> or asked for by KEEP, so a node ships a few bytes per frame instead of 4 KB. The CIR of the other
+ *    frames is read into a scratch record that is never queued. STATUS counts the frames reduced in the open capture.
+ *    Each sender has its own background model (see cir_background.h), its slot in TDMA: a frame is scored against the model of the link it
+ *    came over, so the links of a TDMA round are watched for changes separately. There are CIR_FEATURES_LINKS models, so TDMA is refused
+ *    with more slots than that while a feature capture is open.
+ * 4. After COMPRESS ON, the storage thread of a capture codes every CIR record before writing it (see cir_codec.h), the receive path is
+ *    unchanged. The noise taps before the first path and in the tail take a few bits each instead of 16, and nothing is lost: "cirz -d"
+ *    turns the coded capture back into the original one, byte for byte. CLOSE reports the ratio of the record size to the bytes written.
+ ****************************************************************************************************************************************************/
@@ -27,21 +27,146 @@
 #include "deca_regs.h"
 
 #include <errno.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#ifdef SPI_STATS
+#include <time.h>
+#endif
+#ifdef DW1000_EMU
+#include "spidev_emu.h"
+#define spi_open(path)				spidev_emu_open(path)
+#define spi_close					spidev_emu_close
+#define spi_ioctl					spidev_emu_ioctl
+#define spi_wire(fd, rst, irq)		spidev_emu_setpins(fd, rst, irq)
+#else
 #include <wiringPi.h>
+#define spi_open(path)				open(path, O_RDWR)
+#define spi_close					close
+#define spi_ioctl					ioctl
+#define spi_wire(fd, rst, irq)		(0)
+#endif
 
 #define SPI_SPEED_SLOW    				( 3000000)
-#define SPI_SPEED_FAST  	  			(10000000)
+#define SPI_SPEED_FAST  	  			(10000000)	// used until spi_probe_rate() finds the board's fastest stable clock
+#define SPI_DELAY_DEFAULT				(10)		// us after each access, until a probe shows it is not needed
 #define SPI_PATH 						"/dev/spidev1.0"
+#define SPI_SETTINGS_PATH				"/etc/dw1000_spi.conf"
+#define SPI_SETTINGS_ENV				"DW1000_SPI_CONF"	// overrides SPI_SETTINGS_PATH
+#define SPI_PROBE_ROUNDS				(64)		// DEV_ID reads and TX buffer read-backs per probe step
+#define SPI_PROBE_LEN					(128)		// bytes of the TX buffer read back
+#define SPI_BUFSIZ_PATH					"/sys/module/spidev/parameters/bufsiz"
+#define SPI_BUFSIZ_DEFAULT				(4096)		// spidev limit on the bytes of one SPI_IOC_MESSAGE
+#define SPI_BATCH_SEGMENTS				(32)		// header and data segment of 16 accesses
 
 static uint32_t mode 	= 0;
 static uint8_t bits 	= 8;
-static uint32_t speed 	= SPI_SPEED_SLOW;
-static uint16_t delay_us 	= 10;
-
-static int fd;
-
+const char *SPIPath = SPI_PATH;
 int RSTPin = 2; // BCM27
 int IRQPin = 3; // BCM22
+const char *DW1000Radios[DW1000_RADIOS] = {"/dev/spidev1.0:2:3", "/dev/spidev1.1:4:5", "/dev/spidev1.2:6:7",
+										   "/dev/spidev0.0:21:22"};
+
+/* One DW1000: its spidev node, wiring and SPI settings. The slot index is also its dw1000local slot in deca_device.c. */
+typedef struct
+{
+	int opened;
+	int fd;
+	char path[64];
+	int rst_pin;
+	int irq_pin;
+	int irq_efd;						// eventfd counting the rising edges of irq_pin
+	uint32_t speed;
+	uint32_t speed_high;
+	uint16_t delay_us;
+	uint32_t bufsiz;
+	pthread_mutex_t lock;				// recursive, taken by decamutexon()
+} dw1000_port_t;
+
+static dw1000_port_t ports[DWT_NUM_DW_DEV];
+static __thread dw1000_port_t *port = &ports[0];	// device of the calling thread, see dw1000_select()
+
+#ifdef SPI_STATS
+#define SPI_STATS_FILES					(64)		// register file IDs are 6 bits
+#define SPI_STATS_BATCH					SPI_STATS_FILES	// row of the SPI_IOC_MESSAGE ioctls issued by transferspi()
+#define SPI_STATS_BINS					(24)		// bin 0 counts 0 ns, bin k [2^(k-1), 2^k) ns, the last everything above
+
+typedef struct
+{
+	unsigned long reads;
+	unsigned long writes;
+	unsigned long long bytes;
+	unsigned long samples;				// accesses timed on their own, batched accesses are timed in the batch row
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+	unsigned long bin[SPI_STATS_BINS];
+} spi_stats_t;
+
+static spi_stats_t spi_stats[SPI_STATS_FILES + 1];
+
+static const char *const spi_stats_names[SPI_STATS_FILES] = {
+	[DEV_ID_ID] = "DEV_ID",			[EUI_64_ID] = "EUI_64",			[PANADR_ID] = "PANADR",
+	[SYS_CFG_ID] = "SYS_CFG",		[SYS_TIME_ID] = "SYS_TIME",		[TX_FCTRL_ID] = "TX_FCTRL",
+	[TX_BUFFER_ID] = "TX_BUFFER",	[DX_TIME_ID] = "DX_TIME",		[RX_FWTO_ID] = "RX_FWTO",
+	[SYS_CTRL_ID] = "SYS_CTRL",		[SYS_MASK_ID] = "SYS_MASK",		[SYS_STATUS_ID] = "SYS_STATUS",
+	[RX_FINFO_ID] = "RX_FINFO",		[RX_BUFFER_ID] = "RX_BUFFER",	[RX_FQUAL_ID] = "RX_FQUAL",
+	[RX_TTCKI_ID] = "RX_TTCKI",		[RX_TTCKO_ID] = "RX_TTCKO",		[RX_TIME_ID] = "RX_TIME",
+	[TX_TIME_ID] = "TX_TIME",		[TX_ANTD_ID] = "TX_ANTD",		[SYS_STATE_ID] = "SYS_STATE",
+	[ACK_RESP_T_ID] = "ACK_RESP_T",	[RX_SNIFF_ID] = "RX_SNIFF",		[TX_POWER_ID] = "TX_POWER",
+	[CHAN_CTRL_ID] = "CHAN_CTRL",	[USR_SFD_ID] = "USR_SFD",		[AGC_CTRL_ID] = "AGC_CTRL",
+	[EXT_SYNC_ID] = "EXT_SYNC",		[ACC_MEM_ID] = "ACC_MEM",		[GPIO_CTRL_ID] = "GPIO_CTRL",
+	[DRX_CONF_ID] = "DRX_CONF",		[RF_CONF_ID] = "RF_CONF",		[TX_CAL_ID] = "TX_CAL",
+	[FS_CTRL_ID] = "FS_CTRL",		[AON_ID] = "AON",				[OTP_IF_ID] = "OTP_IF",
+	[LDE_IF_ID] = "LDE_IF",			[DIG_DIAG_ID] = "DIG_DIAG",		[PMSC_ID] = "PMSC",
+};
+
+static void spi_stats_time(spi_stats_t *st, const struct timespec *t0)
+{
+	struct timespec t1;
+	unsigned long long ns;
+	int b = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = (unsigned long long)(t1.tv_sec - t0->tv_sec) * 1000000000ULL + t1.tv_nsec - t0->tv_nsec;
+
+	while(b < SPI_STATS_BINS - 1 && (ns >> b) != 0)
+		b++;
+	st->bin[b]++;
+	st->samples++;
+	st->total_ns += ns;
+	if(ns > st->max_ns)
+		st->max_ns = ns;
+}
+
+/* The register file ID sits in the low 6 bits of the first header byte. */
+static void spi_stats_count(const uint8 *header, int write, uint32 len, const struct timespec *t0)
+{
+	spi_stats_t *st = &spi_stats[header[0] & 0x3F];
+
+	if(write)
+		st->writes++;
+	else
+		st->reads++;
+	st->bytes += len;
+	if(t0 != NULL)
+		spi_stats_time(st, t0);
+}
+
+#define SPI_STATS_DECLARE				struct timespec stats_t0;
+#define SPI_STATS_START()				clock_gettime(CLOCK_MONOTONIC, &stats_t0)
+#define SPI_STATS_ACCESS(hdr, wr, len)	spi_stats_count(hdr, wr, len, &stats_t0)
+#define SPI_STATS_BATCHED(hdr, wr, len)	spi_stats_count(hdr, wr, len, NULL)
+#define SPI_STATS_MESSAGE(len)			do { spi_stats[SPI_STATS_BATCH].writes++; \
+										spi_stats[SPI_STATS_BATCH].bytes += (len); \
+										spi_stats_time(&spi_stats[SPI_STATS_BATCH], &stats_t0); } while(0)
+#else
+#define SPI_STATS_DECLARE
+#define SPI_STATS_START()				do { } while(0)
+#define SPI_STATS_ACCESS(hdr, wr, len)	do { } while(0)
+#define SPI_STATS_BATCHED(hdr, wr, len)	do { } while(0)
+#define SPI_STATS_MESSAGE(len)			do { } while(0)
+#endif
 
 /* Wrapper function to be used by decadriver. Declared in deca_device_api.h */
 void deca_sleep(unsigned int time_ms)
@@ -54,14 +179,14 @@ void sleep_ms(unsigned int time_ms)
 	usleep(time_ms * 1000);
 }
 
-int spi_set_rate_low (void)
+static int spi_write_speed(uint32_t hz)
 {
-	speed = SPI_SPEED_SLOW;
-	if(ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed)==-1){
+	port->speed = hz;
+	if(spi_ioctl(port->fd, SPI_IOC_WR_MAX_SPEED_HZ, &port->speed)==-1){
 		perror("SPI: Can't set max speed HZ");
 		return -1;
 	}
-	if(ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed)==-1){
+	if(spi_ioctl(port->fd, SPI_IOC_RD_MAX_SPEED_HZ, &port->speed)==-1){
 		perror("SPI: Can't get max speed HZ.");
 		return -1;
 	}
@@ -69,163 +194,589 @@ int spi_set_rate_low (void)
 	return 0;
 }
 
+int spi_set_rate_low (void)
+{
+	return spi_write_speed(SPI_SPEED_SLOW);
+}
+
 int spi_set_rate_high (void)
 {
-	speed = SPI_SPEED_FAST;
-	if(ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed)==-1){
-		perror("SPI: Can't set max speed HZ");
+	return spi_write_speed(port->speed_high);
+}
+
+int spi_set_rate(uint32 hz)
+{
+	port->speed_high = hz;
+	return spi_write_speed(hz);
+}
+
+uint32 spi_get_rate(void)
+{
+	return port->speed;
+}
+
+void spi_set_delay(uint16 us)
+{
+	port->delay_us = us;
+}
+
+uint16 spi_get_delay(void)
+{
+	return port->delay_us;
+}
+
+/* The board is told apart by the SoC serial number, settings are kept per board and spidev node. */
+static void spi_board_id(char *id, size_t len)
+{
+	char line[128];
+	FILE *f;
+
+	if((f = fopen("/proc/device-tree/serial-number", "r")) != NULL){
+		if(fgets(id, (int) len, f) == NULL || id[0] == '\0')
+			snprintf(id, len, "unknown");
+		fclose(f);
+		return;
+	}
+	snprintf(id, len, "unknown");
+	if((f = fopen("/proc/cpuinfo", "r")) != NULL){
+		while(fgets(line, sizeof(line), f) != NULL)
+			if(sscanf(line, "Serial : %63s", id) == 1)
+				break;
+		fclose(f);
+	}
+}
+
+static const char *spi_settings_path(void)
+{
+	const char *path = getenv(SPI_SETTINGS_ENV);
+
+	return (path && *path) ? path : SPI_SETTINGS_PATH;
+}
+
+/* One "<board> <spidev> <speed_hz> <delay_us>" line per board and device, a missing file keeps the defaults. */
+static void spi_load_settings(dw1000_port_t *p)
+{
+	char board[64], key[64], dev[128], line[256];
+	unsigned int hz, us;
+	FILE *f;
+
+	if((f = fopen(spi_settings_path(), "r")) == NULL)
+		return;
+	spi_board_id(board, sizeof(board));
+	while(fgets(line, sizeof(line), f) != NULL){
+		if(sscanf(line, "%63s %127s %u %u", key, dev, &hz, &us) == 4 &&
+		   strcmp(key, board) == 0 && strcmp(dev, p->path) == 0 && hz > 0){
+			p->speed_high = hz;
+			p->delay_us = (uint16_t) us;
+		}
+	}
+	fclose(f);
+}
+
+int spi_save_settings(void)
+{
+	const char *path = spi_settings_path();
+	char board[64], key[64], dev[128], line[256], tmp[256];
+	FILE *in, *out;
+
+	spi_board_id(board, sizeof(board));
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if((out = fopen(tmp, "w")) == NULL){
+		fprintf(stderr, "SPI: Can't write %s: %s\n", tmp, strerror(errno));
 		return -1;
 	}
-	if(ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed)==-1){
-		perror("SPI: Can't get max speed HZ.");
+	// keep the other boards' lines
+	if((in = fopen(path, "r")) != NULL){
+		while(fgets(line, sizeof(line), in) != NULL)
+			if(sscanf(line, "%63s %127s", key, dev) != 2 || strcmp(key, board) != 0 || strcmp(dev, port->path) != 0)
+				fputs(line, out);
+		fclose(in);
+	}
+	fprintf(out, "%s %s %u %u\n", board, port->path, port->speed_high, port->delay_us);
+	if(fclose(out) != 0 || rename(tmp, path) != 0){
+		fprintf(stderr, "SPI: Can't write %s: %s\n", path, strerror(errno));
+		unlink(tmp);
 		return -1;
 	}
-
 	return 0;
 }
 
+/* DEV_ID must read back and a pattern written to the TX buffer must read back unchanged, every round. */
+static int spi_probe_check(void)
+{
+	uint8 out[SPI_PROBE_LEN], in[SPI_PROBE_LEN];
+	int round, i;
+
+	for(round = 0; round < SPI_PROBE_ROUNDS; round++){
+		if(dwt_readdevid() != DWT_DEVICE_ID)
+			return 0;
+		for(i = 0; i < SPI_PROBE_LEN; i++)
+			out[i] = (uint8)(round * 31 + i * 7 + (i >> 3));
+		dwt_writetodevice(TX_BUFFER_ID, 0, SPI_PROBE_LEN, out);
+		dwt_readfromdevice(TX_BUFFER_ID, 0, SPI_PROBE_LEN, in);
+		if(memcmp(out, in, SPI_PROBE_LEN) != 0)
+			return 0;
+	}
+	return 1;
+}
+
+int spi_probe_rate(uint32 max_hz)
+{
+	static const uint32_t steps[] = { 4000000, 5000000, 8000000, 10000000, 12500000, 16000000, 20000000, 25000000, 32000000 };
+	static const uint16_t delays[] = { 0, SPI_DELAY_DEFAULT };
+	uint32_t best = 0;
+	uint16_t best_delay = SPI_DELAY_DEFAULT;
+	uint16_t old_delay = port->delay_us;
+	unsigned int s, d;
+
+	for(s = 0; s < sizeof(steps) / sizeof(steps[0]) && steps[s] <= max_hz; s++){
+		for(d = 0; d < sizeof(delays) / sizeof(delays[0]); d++){
+			port->delay_us = delays[d];
+			if(spi_write_speed(steps[s]) == 0 && spi_probe_check())
+				break;
+		}
+		if(d == sizeof(delays) / sizeof(delays[0]))
+			break;
+		best = steps[s];
+		best_delay = delays[d];
+	}
+
+	if(best == 0){
+		port->delay_us = old_delay;
+		spi_write_speed(port->speed_high);
+		return -1;
+	}
+	port->delay_us = best_delay;
+	return spi_set_rate(best);
+}
+
+/* Header and body go out as chained segments of one message so neither is copied;
+ * the inter-transfer delay is applied once, after the last segment. */
 int writetospi(uint16 headerLength, const uint8 *headerBuffer, uint32 bodylength, const uint8 *bodyBuffer)
 {
 	int status;
-	int i;
+	struct spi_ioc_transfer transfer[2];
+	SPI_STATS_DECLARE
 
-	for (i = 0; i < 128; i++)
-	{
-		
-	}
+	SPI_STATS_START();
+	memset(transfer, 0, sizeof(transfer));
 
-	uint8_t txbuf[headerLength+bodylength];
-	uint8_t rxbuf[headerLength+bodylength];
+	transfer[0].tx_buf = (unsigned long)headerBuffer;
+	transfer[0].len = headerLength;
+	transfer[0].speed_hz = port->speed;
+	transfer[0].bits_per_word = bits;
 
-	struct spi_ioc_transfer transfer = {
-		.tx_buf = (unsigned long)txbuf,
-		.rx_buf = (unsigned long)rxbuf,
-		.len = headerLength+bodylength,
-		.delay_usecs = delay_us,
-		.speed_hz = speed,
-		.bits_per_word = bits,
-	};
+	transfer[1].tx_buf = (unsigned long)bodyBuffer;
+	transfer[1].len = bodylength;
+	transfer[1].speed_hz = port->speed;
+	transfer[1].bits_per_word = bits;
 
-	int j;
-	for(j = 0; j < headerLength; j++)
+	if (bodylength == 0)
 	{
-		txbuf[j] = headerBuffer[j];
+		transfer[0].delay_usecs = port->delay_us;
+		status = spi_ioctl(port->fd, SPI_IOC_MESSAGE(1), transfer);
 	}
-
-	for(j = 0; j < bodylength; j++)
+	else
 	{
-		txbuf[headerLength+j] = bodyBuffer[j];
+		transfer[1].delay_usecs = port->delay_us;
+		status = spi_ioctl(port->fd, SPI_IOC_MESSAGE(2), transfer);
 	}
-
-	//printf("hdr buf: %02X %02X body buf: %02X %02X tx buf: %02X %02X %02X %02X\n", headerBuffer[0], headerBuffer[1], bodyBuffer[0], bodyBuffer[1], txbuf[0], txbuf[1], txbuf[headerLength], txbuf[headerLength+1]);
-	//printf("hdr: %d body: %d tx: %d\n", headerLength, bodylength, transfer.len);
-
-	// send the SPI message (all of the above fields, inc. buffers)
-	status = ioctl(fd, SPI_IOC_MESSAGE(1), &transfer);
 	if(status < 0)
 		return DWT_ERROR;
 
+	SPI_STATS_ACCESS(headerBuffer, 1, headerLength + bodylength);
 	return DWT_SUCCESS;
 
-
 } // end writetospi()
 
+/* The header segment has no rx buffer and the data segment clocks zeros out
+ * while receiving straight into the caller's buffer. */
 int readfromspi(uint16 headerLength, const uint8 *headerBuffer, uint32 readlength, uint8 *readBuffer)
 {
 	int status;
-	uint8_t buf[readlength];
+	struct spi_ioc_transfer transfer[2];
+	SPI_STATS_DECLARE
+
+	SPI_STATS_START();
+	memset(transfer, 0, sizeof(transfer));
 
-	struct spi_ioc_transfer transfer = {
-		.tx_buf = (unsigned long)headerBuffer,
-		.rx_buf = (unsigned long)buf,
-		.len = headerLength+readlength,
-		.delay_usecs = delay_us,
-		.speed_hz = speed,
-		.bits_per_word = bits,
-	};
+	transfer[0].tx_buf = (unsigned long)headerBuffer;
+	transfer[0].len = headerLength;
+	transfer[0].speed_hz = port->speed;
+	transfer[0].bits_per_word = bits;
+
+	transfer[1].rx_buf = (unsigned long)readBuffer;
+	transfer[1].len = readlength;
+	transfer[1].delay_usecs = port->delay_us;
+	transfer[1].speed_hz = port->speed;
+	transfer[1].bits_per_word = bits;
 
 	// send the SPI message (all of the above fields, inc. buffers)
-	status = ioctl(fd, SPI_IOC_MESSAGE(1), &transfer);
+	status = spi_ioctl(port->fd, SPI_IOC_MESSAGE(2), transfer);
 	if(status < 0)
 		return DWT_ERROR;
 
-	int j;
-	for(j = 0; j < readlength; j++)
+	SPI_STATS_ACCESS(headerBuffer, 0, headerLength + readlength);
+	return DWT_SUCCESS;
+
+} // end readfromspi()
+
+/* Accesses are chained into as few SPI_IOC_MESSAGE ioctls as spidev's bufsiz allows,
+ * cs_change on the data segment of each access releases chip select before the next one. */
+int transferspi(uint16 count, const dwt_spiaccess_t *access)
+{
+	struct spi_ioc_transfer transfer[SPI_BATCH_SEGMENTS];
+	uint32_t total = 0;
+	int n = 0;
+	int i;
+	SPI_STATS_DECLARE
+
+	SPI_STATS_START();
+	for(i = 0; i < count; i++)
 	{
-		readBuffer[j] = buf[j+headerLength];
+		uint32_t len = access[i].headerLength + access[i].length;
+
+		if(len > port->bufsiz)
+			return DWT_ERROR;
+
+		if(n && (total + len > port->bufsiz || n + 2 > SPI_BATCH_SEGMENTS))
+		{
+			transfer[n-1].cs_change = 0;
+			if(spi_ioctl(port->fd, SPI_IOC_MESSAGE(n), transfer) < 0)
+				return DWT_ERROR;
+			SPI_STATS_MESSAGE(total);
+			SPI_STATS_START();
+			n = 0;
+			total = 0;
+		}
+
+		memset(&transfer[n], 0, 2 * sizeof(transfer[0]));
+
+		transfer[n].tx_buf = (unsigned long)access[i].header;
+		transfer[n].len = access[i].headerLength;
+		transfer[n].speed_hz = port->speed;
+		transfer[n].bits_per_word = bits;
+		n++;
+
+		if(access[i].write)
+			transfer[n].tx_buf = (unsigned long)access[i].buffer;
+		else
+			transfer[n].rx_buf = (unsigned long)access[i].buffer;
+		transfer[n].len = access[i].length;
+		transfer[n].delay_usecs = port->delay_us;
+		transfer[n].speed_hz = port->speed;
+		transfer[n].bits_per_word = bits;
+		transfer[n].cs_change = 1;
+		n++;
+
+		total += len;
+		SPI_STATS_BATCHED(access[i].header, access[i].write, len);
+	}
+
+	if(n)
+	{
+		transfer[n-1].cs_change = 0;
+		if(spi_ioctl(port->fd, SPI_IOC_MESSAGE(n), transfer) < 0)
+			return DWT_ERROR;
+		SPI_STATS_MESSAGE(total);
 	}
 
 	return DWT_SUCCESS;
 
-} // end readfromspi()
+} // end transferspi()
 
-int hardware_init (void)
+uint32 spimaxlength(void)
 {
-	// sets up the wiringPi library
-	if (wiringPiSetup () < 0) {
-		fprintf (stderr, "Unable to setup wiringPi: %s\n", strerror (errno));
-		return 1;
+	return port->bufsiz;
+}
+
+#ifdef SPI_STATS
+void spi_stats_reset(void)
+{
+	memset(spi_stats, 0, sizeof(spi_stats));
+}
+
+void spi_stats_dump(FILE *out)
+{
+	unsigned long long bytes = 0, total_ns = 0;
+	unsigned long accesses = 0;
+	int r, b;
+
+	fprintf(out, "%-12s %4s %9s %9s %12s %10s %10s\n", "register", "id", "reads", "writes", "bytes", "mean ns", "max ns");
+	for(r = 0; r <= SPI_STATS_FILES; r++)
+	{
+		const spi_stats_t *st = &spi_stats[r];
+		int last = 0;
+
+		if(st->reads == 0 && st->writes == 0)
+			continue;
+
+		if(r == SPI_STATS_BATCH)
+			fprintf(out, "%-12s %4s %9lu %9s %12llu", "(batches)", "", st->writes, "messages", st->bytes);
+		else
+		{
+			fprintf(out, "%-12s 0x%02X %9lu %9lu %12llu", spi_stats_names[r] ? spi_stats_names[r] : "?", r,
+					st->reads, st->writes, st->bytes);
+			accesses += st->reads + st->writes;
+			bytes += st->bytes;
+		}
+		total_ns += st->total_ns;
+
+		if(st->samples == 0)
+		{
+			fprintf(out, " %10s %10s\n", "-", "-");
+			continue;
+		}
+		fprintf(out, " %10.0f %10llu\n", (double) st->total_ns / st->samples, st->max_ns);
+
+		// one line of latency bins per register file, from the first to the last one used
+		for(b = 0; b < SPI_STATS_BINS; b++)
+			if(st->bin[b])
+				last = b;
+		fprintf(out, "%17s", "");
+		for(b = 0; b <= last; b++)
+			if(st->bin[b])
+				fprintf(out, " %s%lluns:%lu", b == SPI_STATS_BINS - 1 ? ">=" : "<",
+						b == SPI_STATS_BINS - 1 ? 1ULL << (b - 1) : 1ULL << b, st->bin[b]);
+		fprintf(out, "\n");
+	}
+	fprintf(out, "%-12s %4s %9lu accesses, %llu bytes, %.3f ms on the bus\n", "total", "", accesses, bytes,
+			(double) total_ns / 1e6);
+}
+#endif
+
+int dw1000_parse_radio(const char *spec, char *path, size_t size, int *rst_pin, int *irq_pin)
+{
+	const char *c = strchr(spec, ':');
+	size_t len;
+
+	if(c == NULL || sscanf(c + 1, "%d:%d", rst_pin, irq_pin) != 2)
+		return -1;
+	len = (size_t)(c - spec);
+	if(len == 0 || len >= size)
+		return -1;
+	memcpy(path, spec, len);
+	path[len] = '\0';
+	return 0;
+}
+
+int dw1000_open(int index, const char *path, int rst_pin, int irq_pin)
+{
+	dw1000_port_t *p;
+	pthread_mutexattr_t attr;
+	FILE *f;
+
+	if(index < 0 || index >= DWT_NUM_DW_DEV || ports[index].opened){
+		fprintf(stderr, "SPI: Can't use device slot %d for %s\n", index, path);
+		return -1;
+	}
+	p = &ports[index];
+	memset(p, 0, sizeof(*p));
+	snprintf(p->path, sizeof(p->path), "%s", path);
+	p->rst_pin = rst_pin;
+	p->irq_pin = irq_pin;
+	p->irq_efd = -1;
+	p->speed = SPI_SPEED_SLOW;
+	p->speed_high = SPI_SPEED_FAST;
+	p->delay_us = SPI_DELAY_DEFAULT;
+	p->bufsiz = SPI_BUFSIZ_DEFAULT;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	if(pthread_mutex_init(&p->lock, &attr) != 0){
+		fprintf(stderr, "SPI: Can't create the lock of %s\n", path);
+		pthread_mutexattr_destroy(&attr);
+		return -1;
 	}
+	pthread_mutexattr_destroy(&attr);
 
-	pinMode(IRQPin, INPUT);
-	pinMode(RSTPin, OUTPUT);
-	digitalWrite(RSTPin, HIGH);
+	pinMode(p->irq_pin, INPUT);
+	pinMode(p->rst_pin, OUTPUT);
+	digitalWrite(p->rst_pin, HIGH);
 
 	// The following calls set up the SPI bus properties
-	if((fd = open(SPI_PATH, O_RDWR))<0){
+	if((p->fd = spi_open(p->path))<0){
 		perror("SPI Error: Can't open device.");
-		return -1;
+		goto fail;
 	}
-	if(ioctl(fd, SPI_IOC_WR_MODE, &mode)==-1){
+	if(spi_ioctl(p->fd, SPI_IOC_WR_MODE, &mode)==-1){
 		perror("SPI: Can't set SPI mode.");
-		return -1;
+		goto fail;
 	}
-	if(ioctl(fd, SPI_IOC_RD_MODE, &mode)==-1){
+	if(spi_ioctl(p->fd, SPI_IOC_RD_MODE, &mode)==-1){
 		perror("SPI: Can't get SPI mode.");
-		return -1;
+		goto fail;
 	}
-	if(ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits)==-1){
+	if(spi_ioctl(p->fd, SPI_IOC_WR_BITS_PER_WORD, &bits)==-1){
 		perror("SPI: Can't set bits per word.");
-		return -1;
+		goto fail;
 	}
-	if(ioctl(fd, SPI_IOC_RD_BITS_PER_WORD, &bits)==-1){
+	if(spi_ioctl(p->fd, SPI_IOC_RD_BITS_PER_WORD, &bits)==-1){
 		perror("SPI: Can't get bits per word.");
-		return -1;
+		goto fail;
 	}
-	if(ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed)==-1){
+	if(spi_ioctl(p->fd, SPI_IOC_WR_MAX_SPEED_HZ, &p->speed)==-1){
 		perror("SPI: Can't set max speed HZ");
-		return -1;
+		goto fail;
 	}
-	if(ioctl(fd, SPI_IOC_RD_MAX_SPEED_HZ, &speed)==-1){
+	if(spi_ioctl(p->fd, SPI_IOC_RD_MAX_SPEED_HZ, &p->speed)==-1){
 		perror("SPI: Can't get max speed HZ.");
-		return -1;
+		goto fail;
+	}
+	if(spi_wire(p->fd, p->rst_pin, p->irq_pin) < 0){
+		perror("SPI: Can't wire the emulated device.");
+		goto fail;
 	}
+
+	// spidev rejects messages longer than its bufsiz module parameter
+	if((f = fopen(SPI_BUFSIZ_PATH, "r")) != NULL){
+		if(fscanf(f, "%u", &p->bufsiz) != 1 || p->bufsiz == 0)
+			p->bufsiz = SPI_BUFSIZ_DEFAULT;
+		fclose(f);
+	}
+
+	// fast clock and inter-access delay found by spi_probe_rate() on this board
+	spi_load_settings(p);
+	p->opened = 1;
 	return 0;
+
+fail:
+	// the slot is left as if never opened, so it can be tried again
+	if(p->fd >= 0)
+		spi_close(p->fd);
+	p->fd = -1;
+	pthread_mutex_destroy(&p->lock);
+	return -1;
+}
+
+int dw1000_select(int index)
+{
+	if(index < 0 || index >= DWT_NUM_DW_DEV || !ports[index].opened)
+		return -1;
+	if(dwt_setlocaldataptr(index) != DWT_SUCCESS)
+		return -1;
+	decaselectdevice(index);
+	return 0;
+}
+
+int decaselectdevice(int index)
+{
+	int prev = (int)(port - ports);
+
+	if(index < 0 || index >= DWT_NUM_DW_DEV)
+		return -1;
+	port = &ports[index];
+	return prev;
+}
+
+int dw1000_selected(void)
+{
+	return (int)(port - ports);
+}
+
+int hardware_init (void)
+{
+	// sets up the wiringPi library
+	if (wiringPiSetup () < 0) {
+		fprintf (stderr, "Unable to setup wiringPi: %s\n", strerror (errno));
+		return 1;
+	}
+
+	// the first DW1000, further ones are added with dw1000_open()
+	if(dw1000_open(0, SPIPath, RSTPin, IRQPin) != 0)
+		return -1;
+	return dw1000_select(0);
 }
 
 int reset_DW1000(void)
 {
-	digitalWrite(RSTPin, LOW);
+	digitalWrite(port->rst_pin, LOW);
 	usleep(2000);
-	digitalWrite(RSTPin, HIGH);
+	digitalWrite(port->rst_pin, HIGH);
     return 0;
 }
 
-decaIrqStatus_t decamutexon(void) 
+/* Runs in the wiringPi interrupt thread, only wakes irq_wait() or a poll() on irq_fd() up. */
+static void irq_edge(int index)
 {
-	decaIrqStatus_t s = 0;
+	uint64_t one = 1;
 
-	if(s) {
-		// no interrupt lines
+	if(write(ports[index].irq_efd, &one, sizeof(one)) < 0){
+		// the counter saturating is harmless, the line level is what matters
 	}
-	return s ;   // return state before disable, value is used to re-enable in decamutexoff call
 }
 
-void decamutexoff(decaIrqStatus_t s)        // put a function here that re-enables the interrupt at the end of the critical section
+// wiringPi handlers take no argument, one per device slot
+#if DWT_NUM_DW_DEV > 4
+#error "add IRQ handlers for the extra device slots"
+#endif
+static void irq_handler0(void) { irq_edge(0); }
+static void irq_handler1(void) { irq_edge(1); }
+static void irq_handler2(void) { irq_edge(2); }
+static void irq_handler3(void) { irq_edge(3); }
+static void (*const irq_handlers[4])(void) = { irq_handler0, irq_handler1, irq_handler2, irq_handler3 };
+
+int irq_init(void)
 {
-	if(s) { //need to check the port state as we can't use level sensitive interrupt on the STM ARM
-		// no interrupt lines
+	if(port->irq_efd >= 0)
+		return 0;
+	if((port->irq_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0){
+		perror("IRQ: Can't create eventfd.");
+		return -1;
+	}
+	if(wiringPiISR(port->irq_pin, INT_EDGE_RISING, irq_handlers[port - ports]) < 0){
+		fprintf(stderr, "IRQ: Can't watch pin %d: %s\n", port->irq_pin, strerror(errno));
+		close(port->irq_efd);
+		port->irq_efd = -1;
+		return -1;
 	}
+	return 0;
+}
+
+int irq_fd(void)
+{
+	return port->irq_efd;
+}
+
+int irq_wait(int timeout_ms)
+{
+	struct pollfd pfd;
+	uint64_t edges;
+
+	if(port->irq_efd < 0){
+		errno = EINVAL;
+		return -1;
+	}
+
+	// The DW1000 holds IRQ high until the events are cleared, an edge seen before this call may already be consumed
+	if(digitalRead(port->irq_pin) == HIGH)
+		return 1;
+
+	pfd.fd = port->irq_efd;
+	pfd.events = POLLIN;
+	if(poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR)
+		return -1;
+	if(read(port->irq_efd, &edges, sizeof(edges)) < 0 && errno != EAGAIN)
+		return -1;
+
+	// Edges left over from events already serviced wake us with the line low, report the level
+	return digitalRead(port->irq_pin) == HIGH;
+}
+
+// dwt_isr() runs on the thread waiting in irq_wait(), so instead of masking the IRQ line the critical sections take the
+// lock of the selected device. The status names the device locked, so that decamutexoff() releases the same one.
+decaIrqStatus_t decamutexon(void) 
+{
+	if(!port->opened)
+		return 0;
+	pthread_mutex_lock(&port->lock);
+	return (decaIrqStatus_t)(port - ports) + 1;
+}
+
+void decamutexoff(decaIrqStatus_t s)
+{
+	if(s > 0)
+		pthread_mutex_unlock(&ports[s - 1].lock);
 }
 
 void dwt_readtx_sys_count(uint8 * timestamp)
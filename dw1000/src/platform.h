@@ -20,14 +20,25 @@
 #include "deca_types.h"
 #include "deca_device_api.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <fcntl.h>
 
 #define DECA_MAX_SPI_HEADER_LENGTH      (3)                     // max number of bytes in header (for formating & sizing)
 
+/* Wiring of the first DW1000, change before hardware_init() to move it. */
+extern const char *SPIPath;     // spidev node, "/dev/spidev1.0"
+extern int RSTPin;              // wiringPi pin of RSTn
+extern int IRQPin;              // wiringPi pin of IRQ
+
+/* Default wiring of several DW1000s: the three chip selects of SPI1 (dtoverlay=spi1-3cs), then CE0 of SPI0. */
+#define DW1000_RADIOS   (4)
+extern const char *DW1000Radios[DW1000_RADIOS];     // "<spidev>:<rst pin>:<irq pin>"
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn hardware_init()
  *
- * @brief Initialise all peripherals at once.
+ * @brief Initialise all peripherals at once and select the first DW1000 (SPIPath, RSTPin, IRQPin) in the calling
+ * thread.
  *
  * @param none
  *
@@ -35,6 +46,62 @@
  */
 int hardware_init();
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw1000_open()
+ *
+ * @brief Open a further DW1000 on its own spidev chip select, with its own reset and IRQ pins, and bind it to local
+ * data slot index of the driver (see dwt_setlocaldataptr()). Call after hardware_init(). The saved spi_probe_rate()
+ * settings of the spidev are loaded.
+ *
+ * @param index - device slot, below DWT_NUM_DW_DEV
+ * @param path - spidev device, e.g. "/dev/spidev1.1"
+ * @param rst_pin - wiringPi pin of the RSTn line
+ * @param irq_pin - wiringPi pin of the IRQ line
+ *
+ * @return 0 on success, -1 on error
+ */
+int dw1000_open(int index, const char *path, int rst_pin, int irq_pin);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw1000_parse_radio()
+ *
+ * @brief Parse the wiring of a DW1000 given as "<spidev>:<rst pin>:<irq pin>", e.g. "/dev/spidev1.1:4:5", into the
+ * arguments of dw1000_open().
+ *
+ * @param spec - wiring, as on the command line of the applications or in DW1000Radios
+ * @param path - receives the spidev device
+ * @param size - size of path
+ * @param rst_pin - receives the wiringPi pin of the RSTn line
+ * @param irq_pin - receives the wiringPi pin of the IRQ line
+ *
+ * @return 0 on success, -1 if spec is malformed or its spidev does not fit in path
+ */
+int dw1000_parse_radio(const char *spec, char *path, size_t size, int *rst_pin, int *irq_pin);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw1000_select()
+ *
+ * @brief Make device index the current DW1000 of the calling thread. The selection is kept per thread, so each radio
+ * can be driven from its own thread without locking: the dwt_ API, reset_DW1000(), irq_ and spi_ functions of this
+ * file then act on the selected device. Threads start with device 0 selected.
+ *
+ * @param index - device slot opened by hardware_init() (0) or dw1000_open()
+ *
+ * @return 0 on success, -1 if the slot is not open
+ */
+int dw1000_select(int index);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw1000_selected()
+ *
+ * @brief Device slot selected in the calling thread.
+ *
+ * @param none
+ *
+ * @return the slot index
+ */
+int dw1000_selected(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn reset_DW1000()
  *
@@ -46,6 +113,43 @@ int hardware_init();
  */
 int reset_DW1000();
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn irq_init()
+ *
+ * @brief Watch the rising edge of the DW1000 IRQ line so that irq_wait() can sleep until the device raises it.
+ *
+ * @param none
+ *
+ * @return 0 on success, -1 on error
+ */
+int irq_init(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn irq_wait()
+ *
+ * @brief Sleep until the DW1000 IRQ line is active. The line is level triggered, so this returns at once while an
+ * event is still pending in SYS_STATUS. dwt_isr() should then be called from the waiting thread, not from the edge
+ * handler; it holds the device lock (see decamutexon()) while it runs, so other threads can use the dwt_ctx_ API on
+ * the same device meanwhile.
+ *
+ * @param timeout_ms - timeout in milliseconds
+ *
+ * @return 1 if the IRQ line is active, 0 on timeout or signal, -1 on error
+ */
+int irq_wait(int timeout_ms);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn irq_fd()
+ *
+ * @brief File descriptor that becomes readable on a rising edge of the DW1000 IRQ line, to wait on the line together
+ * with other descriptors in poll(). When it is readable, call irq_wait(0) to consume the edges and read the line level.
+ *
+ * @param none
+ *
+ * @return the descriptor, or -1 if irq_init() has not succeeded
+ */
+int irq_fd(void);
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn spi_set_rate_low()
  *
@@ -60,7 +164,8 @@ int spi_set_rate_low();
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn spi_set_rate_high()
  *
- * @brief Set SPI rate as close to 20 MHz as possible for optimum performances.
+ * @brief Set SPI rate as close to 20 MHz as possible for optimum performances. This is the rate saved for the board by
+ * spi_save_settings(), 10 MHz if none was saved, or the last one given to spi_set_rate().
  *
  * @param none
  *
@@ -68,6 +173,113 @@ int spi_set_rate_low();
  */
 int spi_set_rate_high();
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_set_rate()
+ *
+ * @brief Switch the SPI clock to <hz> now and use it for spi_set_rate_high() from then on. Only valid once the DW1000
+ * PLL is locked (after dwt_initialise()), the device needs less than 3 MHz before. spidev rounds the clock down to
+ * what the SPI controller can divide, see spi_get_rate().
+ *
+ * @param hz - SPI clock in Hz
+ *
+ * @return 0 on success, -1 on error
+ */
+int spi_set_rate(uint32 hz);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_get_rate()
+ *
+ * @brief SPI clock currently used, as reported back by spidev.
+ *
+ * @param none
+ *
+ * @return the clock in Hz
+ */
+uint32 spi_get_rate(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_set_delay()
+ *
+ * @brief Set the delay inserted after each register access, before chip select is released. It adds to every access,
+ * the DW1000 itself needs none.
+ *
+ * @param us - delay in microseconds
+ *
+ * @return none
+ */
+void spi_set_delay(uint16 us);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_get_delay()
+ *
+ * @brief Delay inserted after each register access.
+ *
+ * @param none
+ *
+ * @return the delay in microseconds
+ */
+uint16 spi_get_delay(void);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_probe_rate()
+ *
+ * @brief Find the fastest SPI clock this board runs reliably. The clock is raised step by step from 4 MHz up to
+ * <max_hz>, each step reading DEV_ID and writing and reading back a pattern in the TX buffer many times, first without
+ * and then with the default inter-access delay. The last step that passed is kept as with spi_set_rate() together
+ * with its delay. Call it right after dwt_initialise(): the TX buffer is overwritten and a failing step may have
+ * garbled other accesses, so reset and initialise the DW1000 again before using it.
+ *
+ * @param max_hz - highest clock to try
+ *
+ * @return 0 on success, -1 if even the first step failed (the previous clock and delay are restored)
+ */
+int spi_probe_rate(uint32 max_hz);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_save_settings()
+ *
+ * @brief Save the current fast clock and inter-access delay for this board, identified by its SoC serial number.
+ * hardware_init() loads them back. They are kept in /etc/dw1000_spi.conf, or the file named by DW1000_SPI_CONF.
+ *
+ * @param none
+ *
+ * @return 0 on success, -1 on error
+ */
+int spi_save_settings(void);
+
+#ifdef SPI_STATS
+#include <stdio.h>
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_stats_dump()
+ *
+ * @brief Print the SPI instrumentation gathered by writetospi(), readfromspi() and transferspi(): per register file
+ * the reads, writes, bytes on the bus (headers included) and a histogram of the latency measured on the monotonic
+ * clock. Accesses queued in a batch are counted per register file but timed as a whole in the "(batches)" row. Only
+ * built with SPI_STATS, otherwise this and spi_stats_reset() compile to nothing. Not thread safe, call it from the
+ * thread doing the SPI accesses.
+ *
+ * @param out - stream to print to
+ *
+ * @return none
+ */
+void spi_stats_dump(FILE *out);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spi_stats_reset()
+ *
+ * @brief Clear the SPI instrumentation counters, e.g. after initialisation so that only a frame cycle is measured.
+ *
+ * @param none
+ *
+ * @return none
+ */
+void spi_stats_reset(void);
+#else
+#define spi_stats_dump(out)				do { } while(0)
+#define spi_stats_reset()				do { } while(0)
+#endif
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn sleep_ms()
  *
@@ -106,7 +318,8 @@ void sleep_ms(unsigned int time_ms);
  * Description: This function should disable interrupts. This is called at the start of a critical section
  * It returns the irq state before disable, this value is used to re-enable in decamutexoff call
  *
- * Note: The body of this function is defined in deca_mutex.c and is platform specific
+ * Note: On this platform it takes the recursive lock of the device selected in the calling thread, which the context
+ * API also holds for each dwt_ call. It returns 0 if the device is not open (nothing locked).
  *
  * input parameters:	
  *
@@ -122,7 +335,7 @@ decaIrqStatus_t decamutexon(void);
  * Description: This function should re-enable interrupts, or at least restore their state as returned(&saved) by decamutexon 
  * This is called at the end of a critical section
  *
- * Note: The body of this function is defined in deca_mutex.c and is platform specific
+ * Note: On this platform it releases the device lock taken by the matching decamutexon()
  *
  * input parameters:	
  * @param s - the state of the DW1000 interrupt as returned by decamutexon
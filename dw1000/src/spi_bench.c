@@ -0,0 +1,255 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    spi_bench.c
+ *  @brief   SPI transport microbenchmark
+ *
+ *           Runs typical register accesses through dwt_readfromdevice()/dwt_writetodevice() against the emulated spidev
+ *           backend and reports time per access, throughput and ioctls per access. Build with "make EMU=1 spi_bench".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deca_device_api.h"
+#include "deca_regs.h"
+#include "platform.h"
+
+#ifndef DW1000_EMU
+#error "spi_bench runs against the emulated spidev backend, build it with: make EMU=1 spi_bench"
+#endif
+#include "spidev_emu.h"
+
+#define DEFAULT_ITERATIONS 100000
+
+typedef struct {
+    const char *name;
+    uint16 regFileID;
+    uint16 index;
+    uint16 len;
+    int write;
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    { "SYS_STATUS read32",   SYS_STATUS_ID, 0,    4,            0 },
+    { "SYS_STATUS write32",  SYS_STATUS_ID, 0,    4,            1 },
+    { "PMSC_CTRL0 read16",   PMSC_ID,       0,    2,            0 },
+    { "TX_BUFFER write12",   TX_BUFFER_ID,  0,    10,           1 },
+    { "RX_BUFFER read12",    RX_BUFFER_ID,  0,    12,           0 },
+    { "ACC_MEM read64",      ACC_MEM_ID,    128,  65,           0 },
+    { "ACC_MEM read4064",    ACC_MEM_ID,    0,    4064 + 1,     0 },
+};
+
+static uint8 buffer[SPIDEV_EMU_FILE_LEN];
+
+/* Per-frame register accesses of the dw1000_rx_cir receive path, one ioctl each. */
+static void rx_frame_single(void)
+{
+    uint8 rx_buffer[12];
+    uint16 frame_len;
+
+    dwt_write32bitreg(SYS_STATUS_ID, SYS_STATUS_RXFCG);
+    frame_len = dwt_read32bitreg(RX_FINFO_ID) & RX_FINFO_RXFL_MASK_1023;
+    dwt_readrxdata(rx_buffer, frame_len <= sizeof(rx_buffer) ? frame_len : sizeof(rx_buffer), 0);
+}
+
+/* The same accesses queued in one batch. */
+static void rx_frame_batch(void)
+{
+    static dwt_batch_t batch;
+    uint8 rx_buffer[12];
+    uint32 finfo;
+
+    dwt_batchinit(&batch);
+    dwt_batchwrite32bitreg(&batch, SYS_STATUS_ID, SYS_STATUS_RXFCG);
+    dwt_batchread32bitreg(&batch, RX_FINFO_ID, &finfo);
+    dwt_batchreadrxdata(&batch, rx_buffer, sizeof(rx_buffer), 0);
+    dwt_batchsubmit(&batch);
+}
+
+/* Full CIR read the way copyCIRToBuffer() used to do it: 64-byte chunks, ACC clocks toggled per chunk. */
+static void cir_chunked(void)
+{
+    uint8 buf[64 + 1];
+    uint16 loc;
+
+    for (loc = 0; loc < 4064; loc += 64)
+    {
+        dwt_readaccdata(buf, 64 + 1, loc);
+        memcpy(&buffer[loc], &buf[1], 64);
+    }
+}
+
+/* Full CIR read in bufsiz-sized chunks with the clocks forced on once. */
+static void cir_bulk(void)
+{
+    dwt_readaccdatabulk(buffer, 4064, 0);
+}
+
+/* Receiver abort as done before every RX re-enable and TX start: SYS_MASK saved, cleared and restored. */
+static void trx_off(void)
+{
+    dwt_forcetrxoff();
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} bench_seq_t;
+
+static const bench_seq_t sequences[] = {
+    { "RX frame single",     rx_frame_single },
+    { "RX frame batch",      rx_frame_batch },
+    { "CIR 64-byte chunks",  cir_chunked },
+    { "CIR bulk",            cir_bulk },
+    { "TRX off",             trx_off },
+};
+
+static double elapsed_s(const struct timespec *a, const struct timespec *b)
+{
+    return (double) (b->tv_sec - a->tv_sec) + (double) (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+/* Write a pattern through the transport and read it back at a sub-indexed and an extended-index offset. */
+static int check_loopback(void)
+{
+    uint8 out[300], in[300];
+    dwt_batch_t batch;
+    uint32 reg32 = 0;
+    uint16 reg16 = 0;
+    int i;
+
+    for (i = 0; i < (int) sizeof(out); i++)
+    {
+        out[i] = (uint8) (i * 7 + 1);
+    }
+    dwt_writetodevice(TX_BUFFER_ID, 100, sizeof(out), out);
+    memset(in, 0, sizeof(in));
+    dwt_readfromdevice(TX_BUFFER_ID, 100, sizeof(in), in);
+
+    if (memcmp(out, in, sizeof(out)) != 0)
+    {
+        return 0;
+    }
+
+    dwt_batchinit(&batch);
+    dwt_batchwrite32bitoffsetreg(&batch, DX_TIME_ID, 0, 0x12345678);
+    dwt_batchwrite16bitoffsetreg(&batch, TX_BUFFER_ID, 200, 0xBEEF);
+    dwt_batchread32bitoffsetreg(&batch, DX_TIME_ID, 0, &reg32);
+    dwt_batchread16bitoffsetreg(&batch, TX_BUFFER_ID, 200, &reg16);
+    if (dwt_batchsubmit(&batch) != DWT_SUCCESS)
+    {
+        return 0;
+    }
+
+    if (reg32 != 0x12345678 || reg16 != 0xBEEF || dwt_read16bitoffsetreg(TX_BUFFER_ID, 200) != 0xBEEF)
+    {
+        return 0;
+    }
+
+    /* Receive a synthetic frame so the accumulator holds a CIR. */
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    if (spidev_emu_inject() != 0)
+    {
+        return 0;
+    }
+
+    /* Bulk accumulator reads must match chunked dwt_readaccdata() reads with the dummy octet removed. */
+    memset(buffer, 0, 4064);
+    dwt_readaccdatabulk(buffer, 4064 - 300, 300);
+    dwt_readaccdata(in, sizeof(in), 300);
+
+    for (i = 0; i < (int) sizeof(in) - 1 && buffer[i] == 0; i++)
+    {
+    }
+    return memcmp(buffer, &in[1], sizeof(in) - 1) == 0 && i < (int) sizeof(in) - 1;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = DEFAULT_ITERATIONS;
+    spidev_emu_stats_t st;
+    spidev_emu_config_t cfg;
+    struct timespec t0, t1;
+    unsigned int c;
+    unsigned long i;
+
+    if (argc > 1)
+    {
+        iterations = strtoul(argv[1], NULL, 10);
+    }
+    if (iterations == 0)
+    {
+        printf("Usage: spi_bench [iterations]\n");
+        return 1;
+    }
+
+    if (hardware_init() != 0)
+    {
+        return 1;
+    }
+
+    /* No traffic on air, the receiver only gets the frame injected by the loopback check. */
+    spidev_emu_getconfig(&cfg);
+    cfg.rx_rate_hz = 0.0;
+    spidev_emu_configure(&cfg);
+
+    if (!check_loopback())
+    {
+        printf("Loopback check FAILED\n");
+        return 1;
+    }
+
+    printf("%-20s %8s %10s %10s %8s %8s\n", "access", "bytes", "ns/access", "MB/s", "ioctl", "segs");
+    for (c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        const bench_case_t *bc = &cases[c];
+
+        spidev_emu_getstats(&st, 1);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < iterations; i++)
+        {
+            if (bc->write)
+            {
+                dwt_writetodevice(bc->regFileID, bc->index, bc->len, buffer);
+            }
+            else
+            {
+                dwt_readfromdevice(bc->regFileID, bc->index, bc->len, buffer);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        spidev_emu_getstats(&st, 1);
+
+        double s = elapsed_s(&t0, &t1);
+        printf("%-20s %8u %10.1f %10.1f %8.2f %8.2f\n", bc->name, bc->len,
+               s * 1e9 / iterations,
+               (double) st.bytes / s / 1e6,
+               (double) st.ioctls / iterations,
+               (double) st.transfers / iterations);
+    }
+
+    printf("\n%-20s %8s %10s %10s %8s %8s\n", "sequence", "", "ns/seq", "", "ioctl", "segs");
+    for (c = 0; c < sizeof(sequences) / sizeof(sequences[0]); c++)
+    {
+        spidev_emu_getstats(&st, 1);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < iterations; i++)
+        {
+            sequences[c].run();
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        spidev_emu_getstats(&st, 1);
+
+        printf("%-20s %8s %10.1f %10s %8.2f %8.2f\n", sequences[c].name, "",
+               elapsed_s(&t0, &t1) * 1e9 / iterations, "",
+               (double) st.ioctls / iterations,
+               (double) st.transfers / iterations);
+    }
+
+#ifdef DWT_SHADOW_VERIFY
+    printf("\nshadow mismatches: %lu\n", (unsigned long) dwt_shadowmismatches());
+#endif
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    spi_probe.c
+ *  @brief   SPI clock probe
+ *
+ *           Finds the fastest SPI clock and shortest inter-access delay the DW1000 on this board runs reliably with and
+ *           saves them, so that spi_set_rate_high() uses them in every application. Run it once per board (as root, the
+ *           settings go to /etc/dw1000_spi.conf unless DW1000_SPI_CONF names another file). Takes the highest clock to
+ *           try in Hz as an optional parameter, 20 MHz by default.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "deca_device_api.h"
+#include "platform.h"
+
+#define DEFAULT_MAX_HZ 20000000
+
+static int init_dw1000(void)
+{
+    reset_DW1000();
+    spi_set_rate_low();
+    if (dwt_initialise(DWT_LOADUCODE) == DWT_ERROR)
+    {
+        printf("%s\n", "INIT FAILED");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long max_hz = DEFAULT_MAX_HZ;
+
+    if (argc > 1)
+    {
+        max_hz = strtoul(argv[1], NULL, 10);
+    }
+    if (argc > 2 || max_hz == 0)
+    {
+        printf("Usage: spi_probe [max_hz]\n");
+        return 1;
+    }
+
+    if (hardware_init() != 0 || init_dw1000() != 0)
+    {
+        return 1;
+    }
+
+    if (spi_probe_rate(max_hz) != 0)
+    {
+        printf("No stable SPI clock found up to %lu Hz, keeping %lu Hz\n", max_hz, (unsigned long) spi_get_rate());
+        return 1;
+    }
+    printf("Fastest stable SPI clock: %lu Hz, %u us delay\n", (unsigned long) spi_get_rate(), spi_get_delay());
+
+    /* The probe overwrote the TX buffer and failing steps may have garbled other registers, start over at the new rate. */
+    if (init_dw1000() != 0)
+    {
+        return 1;
+    }
+    spi_set_rate_high();
+    if (dwt_readdevid() != DWT_DEVICE_ID)
+    {
+        printf("DEV_ID check FAILED at %lu Hz, settings not saved\n", (unsigned long) spi_get_rate());
+        return 1;
+    }
+
+    if (spi_save_settings() != 0)
+    {
+        return 1;
+    }
+    printf("Saved\n");
+    return 0;
+}
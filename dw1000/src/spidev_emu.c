@@ -0,0 +1,1429 @@
+/*
+ * spidev_emu.c
+ *
+ * Emulated spidev backend. Every chip select assertion is decoded as one
+ * DW1000 register access (1 to 3 header bytes followed by data) against
+ * SPIDEV_EMU_NUM_FILES register files laid out as in deca_regs.h. Like the
+ * DW1000, accumulator reads output one dummy octet before the data.
+ *
+ * Most register files are plain memory. The ones the driver relies on for
+ * its control flow behave like the device:
+ *
+ *  - DEV_ID reads 0xDECA0130 and PMSC_CTRL0 soft resets or RSTn low restore
+ *    the reset defaults.
+ *  - SYS_TIME counts at 63.8976 GHz from CLOCK_MONOTONIC.
+ *  - SYS_STATUS bits are cleared by writing ones, IRQS, HSRBP and ICRBP are
+ *    read only. SYS_MASK & SYS_STATUS drives the IRQ line.
+ *  - SYS_CTRL starts immediate and delayed transmissions (HPDWARN when
+ *    DX_TIME is more than half a period away), enables and disables the
+ *    receiver and toggles the host side receive buffer. With SYS_CFG RXWTOE
+ *    the receiver turns off with RXRFTO after RX_FWTO.
+ *  - RX_FINFO, RX_BUFFER, RX_FQUAL and RX_TIME are read only and double
+ *    buffered unless SYS_CFG DIS_DRXB is set. A frame completing while both
+ *    buffers are full sets RXOVRR.
+ *  - OTP_CTRL reads copy the emulated OTP word at OTP_ADDR to OTP_RDAT.
+ *  - DIG_DIAG event counters count good and bad frames, overruns, frame
+ *    wait timeouts, sent frames and half period warnings.
+ *
+ * Frames are injected at a configurable rate while the receiver is enabled,
+ * with a synthetic channel impulse response in ACC_MEM and the matching
+ * diagnostics. Air time follows the preamble, data rate and PRF in TX_FCTRL.
+ * Events are processed lazily on SPI accesses and by a timer thread that
+ * calls the wiringPiISR() handler on rising edges of the IRQ line. Up to
+ * SPIDEV_EMU_MAX_DEVS devices can be opened, one per chip select. Preamble
+ * timeouts, sleep and frame filtering are not modelled.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "spidev_emu.h"
+#include "deca_regs.h"
+#include <linux/spi/spidev.h>
+#include <sys/ioctl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#define EMU_DEV_ID			(0xDECA0130UL)
+#define EMU_TIME_MASK		(0xFFFFFFFFFFULL)		// 40-bit system time
+#define EMU_TIME_HALF		(0x8000000000ULL)		// half period for delayed TX/RX
+#define EMU_TIME_RES		(0x1FFULL)				// SYS_TIME and DX_TIME ignore the low 9 bits
+#define EMU_RX_BUFFER_LEN	(1024)
+#define EMU_FRAME_LEN		(12)					// synthetic frames, FCS included
+#define EMU_BEACON_LEN		(20)					// synthetic time sync beacons, FCS included
+#define EMU_CIR_TAPS		(1016)					// taps in ACC_MEM at 64 MHz PRF
+#define EMU_OTP_WORDS		(0x20)
+#define EMU_NO_EVENT		(~0ULL)
+#define EMU_PINS			(64)
+#define EMU_AIR_QUEUE		(8)						// frames from the other devices waiting to start on air
+#define EMU_AIR_LEN			(128)					// longest frame passed between devices, FCS included
+#define EMU_TICKS_PER_NS	(63.8976)
+#define EMU_SPEED_OF_LIGHT	(299702547.0)			// in air, m/s
+
+#define EMU_DEFAULT_RATE		(20.0)				// frames per second, dw1000_tx sends every 50 ms
+#define EMU_DEFAULT_FIRST_PATH	(745)
+#define EMU_DEFAULT_AMPLITUDE	(4000)
+#define EMU_DEFAULT_NOISE		(60)
+#define EMU_DEFAULT_SPI_MAX_HZ	(20000000)			// DW1000 SPI clock limit once the PLL is locked
+#define EMU_DEFAULT_DISTANCE	(3.0)				// metres between devices n and n+1
+
+typedef struct
+{
+	uint8_t		hdr[3];			// header bytes received so far
+	int			hdrgot;			// number of header bytes received
+	int			hdrlen;			// expected header length, grows while decoding
+	uint32_t	pos;			// data bytes transferred after the header
+	uint32_t	wstart;			// first register byte written
+	uint32_t	wend;			// one past the last register byte written
+} spidev_emu_frame_t;
+
+/* One set of the double buffered receive registers */
+typedef struct
+{
+	int			full;			// holds a frame the host has not released with HRBT
+	uint8_t		finfo[RX_FINFO_LEN];
+	uint8_t		fqual[RX_FQUAL_LEN];
+	uint8_t		rxtime[RX_TIME_LLEN];
+	uint8_t		data[EMU_RX_BUFFER_LEN];
+} emu_rxbuf_t;
+
+/* A frame sent by another emulated device, as seen by this one */
+typedef struct
+{
+	uint64_t	start;			// host time the preamble reaches this device, ns
+	uint64_t	sfd;			// host time of the RMARKER at this device, ns
+	uint64_t	end;
+	double		rmarker;		// same as sfd, with the sub-nanosecond part
+	double		ppm;			// crystal offset of the sender
+	uint64_t	seq;			// frames sent by the sender, for the CIR generator
+	uint16_t	len;			// FCS included
+	uint8_t		data[EMU_AIR_LEN];
+} emu_air_t;
+
+/* One emulated DW1000 behind a chip select. Everything from t0 on is cleared by a reset. */
+typedef struct
+{
+	int			index;			// handle returned by spidev_emu_open()
+	int			opened;
+	uint32_t	max_speed_hz;	// SPI_IOC_WR_MAX_SPEED_HZ, spidev's default until set
+	int			rst_pin;		// wiringPi pins bound with spidev_emu_setpins(), -1 if none
+	int			irq_pin;
+	uint32_t	otp[EMU_OTP_WORDS];
+	uint64_t	tx_seq;			// frames sent
+	uint64_t	t0;				// host time of SYS_TIME zero, ns
+	int			rx_on;			// receiver enabled
+	uint64_t	rx_from;		// receiver listens from this host time (delayed RX)
+	uint64_t	rx_timeout;		// frame wait timeout (RX_FWTO), host time, 0 if none
+	int			wait4resp;		// enable the receiver when the pending TX is sent
+	uint64_t	rx_next;		// start of the next synthetic frame on air, ns
+	uint64_t	rx_seq;			// sequence number of that frame
+	int			air;			// 0 idle, 1 receiving preamble, 2 receiving data
+	uint64_t	air_sfd;		// SFD time of the frame being received
+	uint64_t	air_end;		// end of the frame being received
+	uint64_t	air_seq;
+	int			tx_busy;
+	uint64_t	tx_end;			// end of the frame being sent, ns
+	uint8_t		tx_time[TX_TIME_LLEN];
+	int			dblbuf;			// double buffering enabled
+	int			ic;				// IC side buffer, next one written
+	int			hs;				// host side buffer, the one mapped in the register files
+	emu_rxbuf_t	buf[2];
+	int			line;			// IRQ line level
+	int			resched;		// the timer thread must recompute its deadline
+	emu_rxbuf_t	rx_pending;		// frame whose SFD was detected, stored in a buffer at its end
+	emu_air_t	inq[EMU_AIR_QUEUE];	// frames of the other devices, in start order
+	int			ninq;
+	int			air_remote;		// the frame on air comes from inq, not from the synthetic traffic
+	emu_air_t	air_frame;
+	uint8_t		regfile[SPIDEV_EMU_NUM_FILES][SPIDEV_EMU_FILE_LEN];
+} emu_dev_t;
+
+typedef void (*emu_isr_t)(void);
+
+/* The model functions act on the device dw points to, selected with the lock held. */
+static emu_dev_t devs[SPIDEV_EMU_MAX_DEVS];
+static emu_dev_t *dw = &devs[0];
+static int ndevs = 0;						// devices opened, the timer thread runs while non-zero
+
+static int16_t cir[EMU_CIR_TAPS][2];
+static spidev_emu_stats_t stats;
+static spidev_emu_config_t config;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake;
+static pthread_t thread;
+static emu_isr_t pin_isr[EMU_PINS];			// wiringPiISR() handlers
+static uint64_t output_pins = 0;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/* 63.8976 GHz device ticks, split to avoid overflowing 64 bits */
+static uint64_t ns_to_ticks(uint64_t ns)
+{
+	return (ns / 10000) * 638976 + (ns % 10000) * 638976 / 10000;
+}
+
+static uint64_t ticks_to_ns(uint64_t ticks)
+{
+	return (ticks / 638976) * 10000 + (ticks % 638976) * 10000 / 638976;
+}
+
+static uint64_t get_le(const uint8_t *p, int len)
+{
+	uint64_t v = 0;
+
+	while (len-- > 0)
+		v = (v << 8) | p[len];
+	return v;
+}
+
+static void put_le(uint8_t *p, uint64_t v, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++, v >>= 8)
+		p[i] = (uint8_t) v;
+}
+
+/* Crystal offset of device d: its clock runs this many ppm fast */
+#define DEV_PPM(d)	(config.clock_ppm * (d)->index)
+
+/* Device ticks since reset at host time now, not wrapped, with the crystal offset of the device */
+static uint64_t dev_ticks(uint64_t now)
+{
+	uint64_t ticks = ns_to_ticks(now - dw->t0);
+
+	if (DEV_PPM(dw) != 0.0)
+		ticks += (uint64_t) (int64_t) ((double) ticks * DEV_PPM(dw) * 1e-6);
+	return ticks;
+}
+
+static uint64_t systime(uint64_t now)
+{
+	return dev_ticks(now) & EMU_TIME_MASK & ~EMU_TIME_RES;
+}
+
+/* Host time at which SYS_TIME reaches the 40-bit device time t, or EMU_NO_EVENT if t is half a period or more away */
+static uint64_t device_time_ns(uint64_t t, uint64_t now)
+{
+	uint64_t delta = (t - systime(now)) & EMU_TIME_MASK;
+	uint64_t ns;
+
+	if (delta >= EMU_TIME_HALF)
+		return EMU_NO_EVENT;
+	ns = ticks_to_ns(delta);
+	if (DEV_PPM(dw) != 0.0)
+		ns -= (uint64_t) (int64_t) ((double) ns * DEV_PPM(dw) * 1e-6);
+	return now + ns;
+}
+
+static uint64_t status_get(void)
+{
+	return get_le(dw->regfile[SYS_STATUS_ID], SYS_STATUS_LEN);
+}
+
+static void status_set(uint64_t bits)
+{
+	put_le(dw->regfile[SYS_STATUS_ID], status_get() | bits, SYS_STATUS_LEN);
+}
+
+static void status_clear(uint64_t bits)
+{
+	put_le(dw->regfile[SYS_STATUS_ID], status_get() & ~bits, SYS_STATUS_LEN);
+}
+
+static void evc_count(int offset)
+{
+	uint8_t *c = &dw->regfile[DIG_DIAG_ID][offset];
+
+	if (dw->regfile[DIG_DIAG_ID][EVC_CTRL_OFFSET] & EVC_EN)
+		put_le(c, (get_le(c, 2) + 1) & 0x0FFF, 2);
+}
+
+/* xorshift64*, seeded per frame so the same configuration always gives the same CIRs */
+static uint64_t rng_state;
+
+static uint64_t rng_next(void)
+{
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return rng_state * 2685821657736338717ULL;
+}
+
+static double rng_uniform(void)
+{
+	return (double) (rng_next() >> 11) / 9007199254740992.0;
+}
+
+static double rng_gauss(void)
+{
+	double u = rng_uniform();
+
+	return sqrt(-2.0 * log(u > 0.0 ? u : 1e-300)) * cos(2.0 * M_PI * rng_uniform());
+}
+
+// ---------------------------------------------------------------------------
+// Radio model
+// ---------------------------------------------------------------------------
+
+/* Preamble length in symbols from TXPSR and PE */
+static uint32_t preamble_len(uint32_t fctrl)
+{
+	static const uint16_t plen[16] = {
+		0, 0, 0, 0,   64, 128, 256, 512,   1024, 1536, 2048, 1024,   4096, 4096, 4096, 4096
+	};
+	uint32_t psr = (fctrl >> 18) & 0xF;
+
+	return plen[psr] ? plen[psr] : 1024;
+}
+
+/* Preamble (including SFD) and total air time of a frame of len bytes with the TX_FCTRL settings */
+static void air_time(uint32_t len, uint64_t *preamble_ns, uint64_t *total_ns)
+{
+	uint32_t fctrl = (uint32_t) get_le(dw->regfile[TX_FCTRL_ID], 4);
+	uint32_t br = (fctrl >> 13) & 0x3;
+	double symbol = (((fctrl >> 16) & 0x3) == 1) ? 993.59 : 1017.63;
+	double bit = (br == 0) ? 8205.13 : (br == 1) ? 1025.64 : 128.21;
+	double phr = 21.0 * ((br == 0) ? 8205.13 : 1025.64);
+	double sfd = (br == 0) ? 64.0 : 8.0;
+	double pre = (preamble_len(fctrl) + sfd) * symbol;
+
+	*preamble_ns = (uint64_t) pre;
+	// Reed-Solomon adds 48 parity bits per 330 data bits
+	*total_ns = (uint64_t) (pre + phr + len * 8.0 * 378.0 / 330.0 * bit);
+}
+
+/* Map the host side receive buffer into the register files and SYS_STATUS */
+static void rxbuf_map(void)
+{
+	emu_rxbuf_t *b = &dw->buf[dw->hs];
+
+	memcpy(dw->regfile[RX_FINFO_ID], b->finfo, sizeof(b->finfo));
+	memcpy(dw->regfile[RX_FQUAL_ID], b->fqual, sizeof(b->fqual));
+	memcpy(dw->regfile[RX_TIME_ID], b->rxtime, sizeof(b->rxtime));
+	memcpy(dw->regfile[RX_BUFFER_ID], b->data, sizeof(b->data));
+	if (b->full)
+		status_set(SYS_STATUS_ALL_DBLBUFF);
+	else
+		status_clear(SYS_STATUS_ALL_DBLBUFF);
+}
+
+static void rx_reset_buffers(void)
+{
+	memset(dw->buf, 0, sizeof(dw->buf));
+	dw->ic = 0;
+	dw->hs = 0;
+	rxbuf_map();
+}
+
+static void rx_off(void)
+{
+	dw->rx_on = 0;
+	dw->air = 0;
+	dw->rx_timeout = 0;
+	dw->resched = 1;
+}
+
+/* The receiver turns on at rx_from: start the frame wait timeout if SYS_CFG enables it. RX_FWTO counts in 512/499.2 us. */
+static void rx_start_timeout(void)
+{
+	uint64_t fwto = get_le(dw->regfile[RX_FWTO_ID], RX_FWTO_LEN) & RX_FWTO_MASK;
+
+	dw->rx_timeout = 0;
+	if ((get_le(dw->regfile[SYS_CFG_ID], 4) & SYS_CFG_RXWTOE) && fwto)
+		dw->rx_timeout = dw->rx_from + fwto * 512000000ULL / 499200ULL;
+}
+
+/* Synthesise the CIR of frame seq into ACC_MEM, LDE_THRESH and the first path diagnostics of b */
+static void rx_make_cir(uint64_t seq, emu_rxbuf_t *b)
+{
+	static const double pulse[4] = { 0.3, 0.9, 1.0, 0.5 };
+	double re[EMU_CIR_TAPS], im[EMU_CIR_TAPS];
+	uint32_t fp = config.first_path;
+	double noise = 0.0, max_noise = 0.0, power = 0.0;
+	double amp, phase;
+	int i, p, n = 0;
+
+	if (fp < 16)
+		fp = 16;
+	if (fp > EMU_CIR_TAPS - 48)
+		fp = EMU_CIR_TAPS - 48;
+
+	rng_state = ((config.seed + dw->index) ^ (seq * 0x9E3779B97F4A7C15ULL)) | 1;
+	for (i = 0; i < EMU_CIR_TAPS; i++)
+	{
+		re[i] = config.noise * rng_gauss();
+		im[i] = config.noise * rng_gauss();
+	}
+
+	// Direct path followed by three weaker reflections
+	amp = config.fp_amplitude * (0.8 + 0.4 * rng_uniform());
+	for (p = 0; p < 4; p++)
+	{
+		uint32_t at = fp + ((p == 0) ? 0 : 4 + (uint32_t) (rng_uniform() * 36.0));
+
+		phase = 2.0 * M_PI * rng_uniform();
+		for (i = 0; i < 4; i++)
+		{
+			re[at + i] += amp * pulse[i] * cos(phase);
+			im[at + i] += amp * pulse[i] * sin(phase);
+		}
+		amp *= 0.3 + 0.3 * rng_uniform();
+	}
+
+	for (i = 0; i < EMU_CIR_TAPS; i++)
+	{
+		double m2 = re[i] * re[i] + im[i] * im[i];
+
+		cir[i][0] = (int16_t) fmax(-32768.0, fmin(32767.0, re[i]));
+		cir[i][1] = (int16_t) fmax(-32768.0, fmin(32767.0, im[i]));
+		put_le(&dw->regfile[ACC_MEM_ID][i * 4], (uint16_t) cir[i][0], 2);
+		put_le(&dw->regfile[ACC_MEM_ID][i * 4 + 2], (uint16_t) cir[i][1], 2);
+		power += m2;
+		if (i < (int) fp - 16)
+		{
+			noise += m2;
+			n++;
+			if (sqrt(m2) > max_noise)
+				max_noise = sqrt(m2);
+		}
+	}
+
+#define MAG(i)	((uint16_t) fmin(65535.0, hypot(cir[i][0], cir[i][1])))
+	put_le(&dw->regfile[LDE_IF_ID][LDE_THRESH_OFFSET], (uint16_t) max_noise, 2);
+	put_le(&b->rxtime[RX_TIME_FP_INDEX_OFFSET], fp << 6, 2);
+	put_le(&b->rxtime[RX_TIME_FP_AMPL1_OFFSET], MAG(fp + 3), 2);
+	put_le(&b->fqual[0], (uint16_t) sqrt(noise / (2.0 * n)), 2);		// STD_NOISE
+	put_le(&b->fqual[2], MAG(fp + 2), 2);								// FP_AMPL2
+	put_le(&b->fqual[4], MAG(fp + 1), 2);								// FP_AMPL3
+	put_le(&b->fqual[6], (uint16_t) fmin(65535.0, power / 131072.0), 2);	// CIR_PWR
+#undef MAG
+}
+
+/* Carrier integrator of a frame from a sender whose crystal runs ppm fast */
+static void rx_carrier(double ppm)
+{
+	static const double carrier_mhz[8] = { 3993.6, 3494.4, 3993.6, 4492.8, 3993.6, 6489.6, 3993.6, 6489.6 };
+	uint32_t fctrl = (uint32_t) get_le(dw->regfile[TX_FCTRL_ID], 4);
+	double step = (((fctrl >> 13) & 0x3) == 0) ? 998.4e6 / 2.0 / 8192.0 / 131072.0 : 998.4e6 / 2.0 / 1024.0 / 131072.0;
+	int32_t carrier;
+
+	// A sender running fast reads as a negative frequency offset, see HERTZ_TO_PPM_MULTIPLIER_CHAN_2
+	carrier = (int32_t) lround(-(ppm - DEV_PPM(dw)) * carrier_mhz[dw->regfile[CHAN_CTRL_ID][0] & 0x7] / step);
+	put_le(&dw->regfile[DRX_CONF_ID][DRX_CARRIER_INT_OFFSET], (uint32_t) carrier & DRX_CARRIER_INT_MASK, DRX_CARRIER_INT_LEN);
+}
+
+/* SFD of frame seq detected: the accumulator now holds its CIR */
+static void rx_sfd(uint64_t seq, uint64_t at)
+{
+	uint32_t fctrl = (uint32_t) get_le(dw->regfile[TX_FCTRL_ID], 4);
+	uint64_t stamp = dev_ticks(at) & EMU_TIME_MASK;
+	uint32_t finfo;
+
+	memset(&dw->rx_pending, 0, sizeof(dw->rx_pending));
+	rx_make_cir(seq, &dw->rx_pending);
+
+	// RXBR and RXPRF sit at the same place as TXBR and TXPRF, RXPSR and RXNSPL take TXPSR and PE
+	finfo = EMU_FRAME_LEN | (fctrl & 0x00036000UL) | (((fctrl >> 18) & 0x3) << 18) | (((fctrl >> 20) & 0x3) << 11);
+	finfo |= ((preamble_len(fctrl) - 8 - (uint32_t) (rng_uniform() * 8.0)) & 0xFFF) << RX_FINFO_RXPACC_SHIFT;
+	put_le(dw->rx_pending.finfo, finfo, 4);
+
+	put_le(&dw->rx_pending.rxtime[RX_TIME_RX_STAMP_OFFSET], stamp, 5);
+	put_le(&dw->rx_pending.rxtime[RX_TIME_FP_RAWST_OFFSET], stamp & ~EMU_TIME_RES, 5);
+
+	// The frame dw1000_tx sends: flag, pad, 64-bit sequence number, FCS
+	dw->rx_pending.data[0] = 0xab;
+	put_le(&dw->rx_pending.data[2], seq, 8);
+
+	// or with -b: SYNC_BEACON, the sequence number and the time of the RMARKER on the clock of the virtual sender,
+	// counted from CLOCK_MONOTONIC zero
+	if (config.beacon)
+	{
+		finfo = (finfo & ~(uint32_t) (RX_FINFO_RXFLEN_MASK | RX_FINFO_RXFLE_MASK)) | EMU_BEACON_LEN;
+		put_le(dw->rx_pending.finfo, finfo, 4);
+		dw->rx_pending.data[1] = 0x5b;
+		put_le(&dw->rx_pending.data[10], (uint64_t) llround(at * EMU_TICKS_PER_NS * (1.0 + config.beacon_ppm * 1e-6)), 8);
+		rx_carrier(config.beacon_ppm);
+	}
+
+	status_set(SYS_STATUS_RXSFDD | SYS_STATUS_LDEDONE);
+}
+
+/* SFD of a frame from another device: its data, an RX_STAMP on this device's clock and the carrier integrator */
+static void rx_sfd_remote(void)
+{
+	emu_air_t *a = &dw->air_frame;
+	uint64_t antd = get_le(&dw->regfile[LDE_IF_ID][LDE_RXANTD_OFFSET], 2);
+	double ticks = (a->rmarker - (double) dw->t0) * EMU_TICKS_PER_NS;
+	uint64_t stamp;
+	uint32_t finfo;
+
+	// The sequence number only seeds the CIR of the frame, the data comes from the sender
+	rx_sfd(a->seq, a->sfd);
+	finfo = (uint32_t) get_le(dw->rx_pending.finfo, 4);
+	put_le(dw->rx_pending.finfo, (finfo & ~(uint32_t) (RX_FINFO_RXFLEN_MASK | RX_FINFO_RXFLE_MASK)) | a->len, 4);
+	memset(dw->rx_pending.data, 0, sizeof(dw->rx_pending.data));
+	memcpy(dw->rx_pending.data, a->data, a->len);
+
+	// The antenna delays are exactly the programmed ones: the stamp is the arrival at the antenna on this clock, the
+	// raw RMARKER is later by the RX antenna delay
+	stamp = (uint64_t) llround(ticks * (1.0 + DEV_PPM(dw) * 1e-6));
+	put_le(&dw->rx_pending.rxtime[RX_TIME_RX_STAMP_OFFSET], stamp & EMU_TIME_MASK, 5);
+	put_le(&dw->rx_pending.rxtime[RX_TIME_FP_RAWST_OFFSET], (stamp + antd) & EMU_TIME_MASK & ~EMU_TIME_RES, 5);
+
+	rx_carrier(a->ppm);
+}
+
+/* Put the frame being sent on air for every other device, delayed by the time of flight. rmarker_ticks is when the
+ * RMARKER leaves the antenna, on the sender's clock: the TX stamp, raw RMARKER plus the TX antenna delay. */
+static void air_send(uint64_t start, uint64_t pre, uint64_t total, uint64_t rmarker_ticks)
+{
+	emu_dev_t *self = dw;
+	uint32_t fctrl = (uint32_t) get_le(dw->regfile[TX_FCTRL_ID], 4);
+	uint32_t len = fctrl & (TX_FCTRL_TFLEN_MASK | TX_FCTRL_TFLE_MASK);
+	uint32_t offset = (fctrl & TX_FCTRL_TXBOFFS_MASK) >> TX_FCTRL_TXBOFFS_SHFT;
+	// Host time of the RMARKER with the sub-nanosecond part, from the sender's clock
+	double rmarker = (double) self->t0 + (double) rmarker_ticks / (EMU_TICKS_PER_NS * (1.0 + DEV_PPM(self) * 1e-6));
+	int i, j;
+
+	if (len > EMU_AIR_LEN || offset + len > SPIDEV_EMU_FILE_LEN)
+		return;
+	self->tx_seq++;
+
+	for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+	{
+		emu_dev_t *d = &devs[i];
+		double tof;
+		emu_air_t *a;
+
+		if (d == self || !d->opened)
+			continue;
+		tof = config.distance_m * abs(d->index - self->index) / EMU_SPEED_OF_LIGHT * 1e9;
+
+		// A full queue loses its oldest frame, the receiver could not have heard them all
+		if (d->ninq == EMU_AIR_QUEUE)
+		{
+			memmove(&d->inq[0], &d->inq[1], (EMU_AIR_QUEUE - 1) * sizeof(emu_air_t));
+			d->ninq--;
+			stats.rx_missed++;
+		}
+		for (j = d->ninq; j > 0 && d->inq[j - 1].start > start + (uint64_t) tof; j--)
+			d->inq[j] = d->inq[j - 1];
+		a = &d->inq[j];
+		d->ninq++;
+
+		a->start = start + (uint64_t) tof;
+		a->sfd = start + pre + (uint64_t) tof;
+		a->end = start + total + (uint64_t) tof;
+		a->rmarker = rmarker + tof;
+		a->ppm = DEV_PPM(self);
+		a->seq = ((uint64_t) self->index << 56) | self->tx_seq;
+		a->len = (uint16_t) len;
+		memset(a->data, 0, sizeof(a->data));
+		memcpy(a->data, &self->regfile[TX_BUFFER_ID][offset], len > 2 ? len - 2 : 0);
+	}
+	pthread_cond_signal(&wake);
+}
+
+/* End of the frame: store it in the IC side buffer or report an error or overrun */
+static void rx_end(void)
+{
+	int target = dw->dblbuf ? dw->ic : 0;
+
+	rx_off();
+	status_set(SYS_STATUS_RXPHD);
+
+	if (config.rx_error_rate > 0.0 && rng_uniform() < config.rx_error_rate)
+	{
+		status_set(SYS_STATUS_RXFCE);
+		evc_count(EVC_FCE_OFFSET);
+		stats.rx_errors++;
+		return;
+	}
+
+	if (dw->dblbuf && dw->buf[target].full)
+	{
+		status_set(SYS_STATUS_RXOVRR);
+		evc_count(EVC_OVR_OFFSET);
+		stats.rx_overruns++;
+		return;
+	}
+
+	dw->rx_pending.full = 1;
+	dw->buf[target] = dw->rx_pending;
+	evc_count(EVC_FCG_OFFSET);
+	stats.rx_frames++;
+	if (dw->dblbuf)
+		dw->ic ^= 1;
+	if (target == dw->hs)
+		rxbuf_map();
+}
+
+static void tx_start(uint32_t ctrl, uint64_t now)
+{
+	uint32_t fctrl = (uint32_t) get_le(dw->regfile[TX_FCTRL_ID], 4);
+	uint64_t antd = get_le(dw->regfile[TX_ANTD_ID], 2);
+	uint64_t pre, total, rmarker, start, ticks;
+
+	air_time(fctrl & (TX_FCTRL_TFLEN_MASK | TX_FCTRL_TFLE_MASK), &pre, &total);
+
+	if (ctrl & SYS_CTRL_TXDLYS)
+	{
+		// DX_TIME is the time of the RMARKER, the preamble goes out before it
+		rmarker = get_le(dw->regfile[DX_TIME_ID], 5) & ~EMU_TIME_RES;
+		start = device_time_ns(rmarker, now);
+		if (start == EMU_NO_EVENT || start < now + pre)
+		{
+			status_set(SYS_STATUS_HPDWARN);
+			evc_count(EVC_HPW_OFFSET);
+			stats.tx_late++;
+			return;
+		}
+		start -= pre;
+		ticks = dev_ticks(now);
+		air_send(start, pre, total, ticks + ((rmarker - ticks) & EMU_TIME_MASK) + antd);
+	}
+	else
+	{
+		start = now;
+		rmarker = dev_ticks(now + pre) & ~EMU_TIME_RES;
+		air_send(start, pre, total, rmarker + antd);
+		rmarker &= EMU_TIME_MASK;
+	}
+
+	put_le(&dw->tx_time[TX_TIME_TX_STAMP_OFFSET], (rmarker + antd) & EMU_TIME_MASK, 5);
+	put_le(&dw->tx_time[TX_TIME_TX_RAWST_OFFSET], rmarker, 5);
+	rx_off();
+	dw->tx_busy = 1;
+	dw->tx_end = start + total;
+	dw->wait4resp = (ctrl & SYS_CTRL_WAIT4RESP) != 0;
+}
+
+static void tx_end(void)
+{
+	dw->tx_busy = 0;
+	memcpy(dw->regfile[TX_TIME_ID], dw->tx_time, TX_TIME_LLEN);
+	status_set(SYS_STATUS_TXFRB | SYS_STATUS_TXPRS | SYS_STATUS_TXPHS | SYS_STATUS_TXFRS);
+	evc_count(EVC_TXFS_OFFSET);
+	stats.tx_frames++;
+	if (dw->wait4resp)
+	{
+		dw->rx_on = 1;
+		dw->rx_from = dw->tx_end;
+		dw->wait4resp = 0;
+		rx_start_timeout();
+	}
+}
+
+/* Deadline of the next event the timer thread must act on */
+static uint64_t next_event(void)
+{
+	uint64_t t = EMU_NO_EVENT;
+
+	if (dw->tx_busy)
+		t = dw->tx_end;
+	if (dw->air == 1 && dw->air_sfd < t)
+		t = dw->air_sfd;
+	if (dw->air == 2 && dw->air_end < t)
+		t = dw->air_end;
+	if (dw->ninq && dw->inq[0].start < t)
+		t = dw->inq[0].start;
+	if (dw->rx_on && dw->rx_timeout && dw->rx_timeout < t)
+		t = dw->rx_timeout;
+	// Frames sent while the receiver is off are only counted, lazily
+	if (dw->rx_on && dw->air == 0 && config.rx_rate_hz > 0.0)
+	{
+		uint64_t next = dw->rx_next > dw->rx_from ? dw->rx_next : dw->rx_from;
+		if (next < t)
+			t = next;
+	}
+	return t;
+}
+
+/* Process every event due by now, in time order */
+static void dw_update(uint64_t now)
+{
+	uint64_t period = (config.rx_rate_hz > 0.0) ? (uint64_t) (1e9 / config.rx_rate_hz) : 0;
+
+	while (1)
+	{
+		uint64_t t = EMU_NO_EVENT;
+		int ev = 0;
+
+		if (dw->tx_busy)
+		{
+			t = dw->tx_end;
+			ev = 1;
+		}
+		if (dw->air == 1 && dw->air_sfd < t)
+		{
+			t = dw->air_sfd;
+			ev = 2;
+		}
+		if (dw->air == 2 && dw->air_end < t)
+		{
+			t = dw->air_end;
+			ev = 3;
+		}
+		if (period && dw->rx_next < t)
+		{
+			t = dw->rx_next;
+			ev = 4;
+		}
+		if (dw->ninq && dw->inq[0].start < t)
+		{
+			t = dw->inq[0].start;
+			ev = 5;
+		}
+		if (dw->rx_on && dw->rx_timeout && dw->rx_timeout < t)
+		{
+			t = dw->rx_timeout;
+			ev = 6;
+		}
+		if (t > now)
+			break;
+
+		switch (ev)
+		{
+			case 1:
+				tx_end();
+				break;
+			case 2:
+				if (dw->air_remote)
+					rx_sfd_remote();
+				else
+					rx_sfd(dw->air_seq, dw->air_sfd);
+				dw->air = 2;
+				break;
+			case 3:
+				rx_end();
+				break;
+			case 4:
+				if (dw->rx_on && dw->air == 0 && !dw->tx_busy && dw->rx_next >= dw->rx_from)
+				{
+					uint64_t pre, total;
+
+					air_time(config.beacon ? EMU_BEACON_LEN : EMU_FRAME_LEN, &pre, &total);
+					dw->air = 1;
+					dw->air_remote = 0;
+					dw->air_seq = dw->rx_seq;
+					dw->air_sfd = dw->rx_next + pre;
+					dw->air_end = dw->rx_next + total;
+					status_set(SYS_STATUS_RXPRD);
+				}
+				else if (now - dw->rx_next > 1000000000ULL)
+				{
+					// Catch up in one step after a long time with the receiver off
+					uint64_t skip = (now - dw->rx_next) / period;
+
+					stats.rx_missed += skip;
+					dw->rx_seq += skip;
+					dw->rx_next += skip * period;
+					continue;
+				}
+				else
+					stats.rx_missed++;
+				dw->rx_seq++;
+				dw->rx_next += period;
+				break;
+			case 5:
+				if (dw->rx_on && dw->air == 0 && !dw->tx_busy && dw->inq[0].start >= dw->rx_from)
+				{
+					dw->air = 1;
+					dw->air_remote = 1;
+					dw->air_frame = dw->inq[0];
+					dw->air_sfd = dw->air_frame.sfd;
+					dw->air_end = dw->air_frame.end;
+					status_set(SYS_STATUS_RXPRD);
+				}
+				else
+					stats.rx_missed++;
+				memmove(&dw->inq[0], &dw->inq[1], (dw->ninq - 1) * sizeof(emu_air_t));
+				dw->ninq--;
+				break;
+			case 6:
+				// The timeout also aborts a frame being received
+				rx_off();
+				status_set(SYS_STATUS_RXRFTO);
+				evc_count(EVC_FWTO_OFFSET);
+				break;
+		}
+	}
+}
+
+/* Refresh the read-only SYS_STATUS bits and return the IRQ line level */
+static int dw_irq_line(void)
+{
+	uint8_t *s = dw->regfile[SYS_STATUS_ID];
+	uint32_t pending;
+	int level;
+
+	s[3] = (uint8_t) ((s[3] & 0x3F) | (dw->hs ? (SYS_STATUS_HSRBP >> 24) : 0) | (dw->ic ? (SYS_STATUS_ICRBP >> 24) : 0));
+	pending = (uint32_t) get_le(s, 4) & (uint32_t) get_le(dw->regfile[SYS_MASK_ID], 4) & ~SYS_STATUS_IRQS;
+	s[0] = (uint8_t) ((s[0] & ~SYS_STATUS_IRQS) | (pending ? SYS_STATUS_IRQS : 0));
+
+	level = pending != 0;
+	if (!(get_le(dw->regfile[SYS_CFG_ID], 4) & SYS_CFG_HIRQ_POL))
+		level = !level;
+	return level;
+}
+
+/* Returns the handler to call if the IRQ line rose. Called with the lock held. */
+static emu_isr_t dw_sync(void)
+{
+	int line = dw_irq_line();
+	emu_isr_t isr = (line && !dw->line && dw->irq_pin >= 0) ? pin_isr[dw->irq_pin] : NULL;
+
+	dw->line = line;
+	if (dw->resched && ndevs)
+		pthread_cond_signal(&wake);
+	dw->resched = 0;
+	return isr;
+}
+
+static void dw_reset(void)
+{
+	uint64_t now = now_ns();
+
+	// The handle, pins and OTP survive, the registers and the radio state do not
+	memset(&dw->t0, 0, sizeof(*dw) - offsetof(emu_dev_t, t0));
+
+	put_le(dw->regfile[DEV_ID_ID], EMU_DEV_ID, 4);
+	put_le(dw->regfile[SYS_CFG_ID], SYS_CFG_DIS_DRXB | SYS_CFG_HIRQ_POL, 4);
+	put_le(dw->regfile[TX_FCTRL_ID], 0x0015400CUL, 4);
+	put_le(dw->regfile[SYS_STATUS_ID], SYS_STATUS_CPLOCK, SYS_STATUS_LEN);
+	put_le(dw->regfile[PMSC_ID], 0xF0300200UL, 4);
+
+	dw->t0 = now;
+	dw->rx_next = now;
+	dw->resched = 1;
+	dw->line = dw_irq_line();
+}
+
+/* Side effects of a write to [start, end) of a register file, once chip select is released */
+static void dw_written(int file, uint32_t start, uint32_t end, uint64_t now)
+{
+	uint8_t *r = dw->regfile[file];
+
+#define COVERS(off)	(start <= (off) && (off) < end)
+	switch (file)
+	{
+		case SYS_CFG_ID:
+		{
+			int dblbuf = !(get_le(r, 4) & SYS_CFG_DIS_DRXB);
+
+			if (dblbuf != dw->dblbuf)
+			{
+				dw->dblbuf = dblbuf;
+				rx_reset_buffers();
+			}
+			break;
+		}
+		case SYS_CTRL_ID:
+		{
+			uint32_t ctrl = (uint32_t) get_le(r, SYS_CTRL_LEN);
+
+			if (ctrl & SYS_CTRL_TRXOFF)
+			{
+				// dwt_configure() requests TXSTRT together with TRXOFF, the transmission is aborted at once
+				rx_off();
+				dw->tx_busy = 0;
+				dw->wait4resp = 0;
+				ctrl &= ~(SYS_CTRL_TXSTRT | SYS_CTRL_RXENAB);
+			}
+			if (ctrl & SYS_CTRL_TXSTRT)
+				tx_start(ctrl, now);
+			if (ctrl & SYS_CTRL_RXENAB)
+			{
+				dw->rx_from = now;
+				if (ctrl & SYS_CTRL_RXDLYE)
+				{
+					dw->rx_from = device_time_ns(get_le(dw->regfile[DX_TIME_ID], 5) & ~EMU_TIME_RES, now);
+					if (dw->rx_from == EMU_NO_EVENT)
+					{
+						status_set(SYS_STATUS_HPDWARN);
+						evc_count(EVC_HPW_OFFSET);
+						dw->rx_from = now;
+					}
+				}
+				dw->rx_on = !dw->tx_busy;
+				if (dw->rx_on)
+					rx_start_timeout();
+				dw->resched = 1;
+			}
+			if ((ctrl & SYS_CTRL_HRBT) && dw->dblbuf)
+			{
+				dw->buf[dw->hs].full = 0;
+				dw->hs ^= 1;
+				rxbuf_map();
+			}
+			// Every command bit is self clearing
+			memset(r, 0, SYS_CTRL_LEN);
+			break;
+		}
+		case OTP_IF_ID:
+			if (COVERS(OTP_CTRL) && (r[OTP_CTRL] & OTP_CTRL_OTPREAD))
+			{
+				uint32_t addr = (uint32_t) get_le(&r[OTP_ADDR], 2);
+
+				put_le(&r[OTP_RDAT], (addr < EMU_OTP_WORDS) ? dw->otp[addr] : 0, 4);
+			}
+			put_le(&r[OTP_CTRL], get_le(&r[OTP_CTRL], 2) & ~(OTP_CTRL_OTPREAD | OTP_CTRL_LDELOAD), 2);
+			break;
+		case DIG_DIAG_ID:
+			if (r[EVC_CTRL_OFFSET] & EVC_CLR)
+			{
+				memset(&r[EVC_PHE_OFFSET], 0, EVC_TPW_OFFSET + 2 - EVC_PHE_OFFSET);
+				r[EVC_CTRL_OFFSET] &= ~EVC_CLR;
+			}
+			break;
+		case PMSC_ID:
+			if (COVERS(PMSC_CTRL0_SOFTRESET_OFFSET))
+			{
+				if (r[PMSC_CTRL0_SOFTRESET_OFFSET] == PMSC_CTRL0_RESET_ALL)
+				{
+					dw_reset();
+					r[PMSC_CTRL0_SOFTRESET_OFFSET] = PMSC_CTRL0_RESET_ALL;
+				}
+				else if (r[PMSC_CTRL0_SOFTRESET_OFFSET] == PMSC_CTRL0_RESET_RX)
+					rx_off();
+			}
+			break;
+		default:
+			break;
+	}
+#undef COVERS
+}
+
+static void *timer_thread(void *arg)
+{
+	(void) arg;
+
+	pthread_mutex_lock(&lock);
+	while (ndevs)
+	{
+		uint64_t t = EMU_NO_EVENT;
+		emu_isr_t isr;
+		int i;
+
+		for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+		{
+			uint64_t d;
+
+			dw = &devs[i];
+			if (dw->opened && (d = next_event()) < t)
+				t = d;
+		}
+
+		if (t == EMU_NO_EVENT)
+			pthread_cond_wait(&wake, &lock);
+		else if (t > now_ns())
+		{
+			struct timespec ts = { (time_t) (t / 1000000000ULL), (long) (t % 1000000000ULL) };
+
+			pthread_cond_timedwait(&wake, &lock, &ts);
+		}
+
+		for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+		{
+			if (!devs[i].opened)
+				continue;
+			dw = &devs[i];
+			dw_update(now_ns());
+			dw->resched = 0;
+			if ((isr = dw_sync()) != NULL)
+			{
+				pthread_mutex_unlock(&lock);
+				isr();
+				pthread_mutex_lock(&lock);
+			}
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// SPI decoding
+// ---------------------------------------------------------------------------
+
+static void frame_reset(spidev_emu_frame_t *f)
+{
+	f->hdrgot = 0;
+	f->hdrlen = 1;
+	f->pos = 0;
+	f->wstart = 0;
+	f->wend = 0;
+}
+
+/* Feed one header byte, returns non-zero once the header is complete. */
+static int frame_header(spidev_emu_frame_t *f, uint8_t b)
+{
+	f->hdr[f->hdrgot++] = b;
+
+	if (f->hdrgot == 1 && (b & 0x40))
+		f->hdrlen = 2;				// sub-index follows
+	else if (f->hdrgot == 2 && (b & 0x80))
+		f->hdrlen = 3;				// extended sub-index follows
+
+	return f->hdrgot == f->hdrlen;
+}
+
+static int read_only(int file)
+{
+	switch (file)
+	{
+		case DEV_ID_ID:
+		case SYS_TIME_ID:
+		case RX_FINFO_ID:
+		case RX_BUFFER_ID:
+		case RX_FQUAL_ID:
+		case RX_TTCKI_ID:
+		case RX_TTCKO_ID:
+		case RX_TIME_ID:
+		case TX_TIME_ID:
+		case ACC_MEM_ID:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+static void frame_data(spidev_emu_frame_t *f, const uint8_t *tx, uint8_t *rx, uint32_t len, uint64_t now)
+{
+	int write = f->hdr[0] & 0x80;
+	int id = f->hdr[0] & 0x3F;
+	uint8_t *file = dw->regfile[id];
+	uint32_t index = 0;
+	uint32_t start, n, i;
+
+	if (f->hdrlen > 1)
+		index = f->hdr[1] & 0x7F;
+	if (f->hdrlen > 2)
+		index |= (uint32_t) f->hdr[2] << 7;
+
+	if (!write && id == ACC_MEM_ID)
+	{
+		// The first octet read from the accumulator is a dummy
+		if (f->pos == 0)
+		{
+			if (rx)
+				*rx++ = 0;
+			len--;
+			f->pos = 1;
+		}
+		start = index + f->pos - 1;
+	}
+	else
+		start = index + f->pos;
+	if (!write && id == SYS_TIME_ID && f->pos == 0)
+		put_le(file, systime(now), 5);
+	f->pos += len;
+
+	// Accesses past the end of the modelled register file read as zero and drop writes
+	n = (start < SPIDEV_EMU_FILE_LEN) ? SPIDEV_EMU_FILE_LEN - start : 0;
+	if (n > len)
+		n = len;
+
+	if (write)
+	{
+		if (tx && id == SYS_STATUS_ID)
+		{
+			// Write one to clear, IRQS, HSRBP and ICRBP are read only
+			for (i = 0; i < n && start + i < SYS_STATUS_LEN; i++)
+				file[start + i] &= ~tx[i];
+		}
+		else if (tx && !read_only(id))
+			memcpy(&file[start], tx, n);
+		if (rx)
+			memset(rx, 0, len);
+		if (n)
+		{
+			if (f->wend == 0)
+				f->wstart = start;
+			f->wend = start + n;
+		}
+	}
+	else if (rx)
+	{
+		memcpy(rx, &file[start], n);
+		memset(rx + n, 0, len - n);
+	}
+}
+
+static int message(int fd, struct spi_ioc_transfer *xfer, unsigned int count)
+{
+	spidev_emu_frame_t f;
+	unsigned int t;
+	uint32_t total = 0;
+	uint64_t now;
+	emu_isr_t isr;
+
+	for (t = 0; t < count; t++)
+		total += xfer[t].len;
+	if (total > SPIDEV_EMU_BUFSIZ)
+	{
+		errno = EMSGSIZE;
+		return -1;
+	}
+
+	pthread_mutex_lock(&lock);
+	dw = &devs[fd];
+	now = now_ns();
+	dw_update(now);
+
+	frame_reset(&f);
+	stats.ioctls++;
+
+	for (t = 0; t < count; t++)
+	{
+		const uint8_t *tx = (const uint8_t *)(uintptr_t) xfer[t].tx_buf;
+		uint8_t *rx = (uint8_t *)(uintptr_t) xfer[t].rx_buf;
+		uint32_t len = xfer[t].len;
+		uint32_t i = 0;
+
+		// The header is always clocked out by the host, the device answers with zeros
+		while (i < len && f.hdrgot < f.hdrlen)
+		{
+			frame_header(&f, tx ? tx[i] : 0);
+			if (rx)
+				rx[i] = 0;
+			i++;
+		}
+
+		if (i < len)
+		{
+			uint32_t hz = xfer[t].speed_hz ? xfer[t].speed_hz : dw->max_speed_hz;
+
+			frame_data(&f, tx ? tx + i : NULL, rx ? rx + i : NULL, len - i, now);
+
+			// Clocked faster than the device can follow, every octet read back has a bit error
+			if (rx && config.spi_max_hz && hz > config.spi_max_hz)
+				for (; i < len; i++)
+					rx[i] ^= 0x01;
+		}
+
+		stats.transfers++;
+		stats.bytes += len;
+
+		// cs_change on a non-final segment releases chip select before the next one
+		if (xfer[t].cs_change || t == count - 1)
+		{
+			if (f.hdrgot)
+				stats.frames++;
+			if (f.hdrgot == f.hdrlen && (f.hdr[0] & 0x80) && f.wend > f.wstart)
+				dw_written(f.hdr[0] & 0x3F, f.wstart, f.wend, now);
+			frame_reset(&f);
+		}
+	}
+
+	isr = dw_sync();
+	pthread_mutex_unlock(&lock);
+	if (isr)
+		isr();
+
+	return total;
+}
+
+// ---------------------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------------------
+
+static double env_double(const char *name, double def)
+{
+	const char *v = getenv(name);
+
+	return (v && *v) ? strtod(v, NULL) : def;
+}
+
+int spidev_emu_open(const char *path)
+{
+	pthread_condattr_t attr;
+	int fd;
+
+	pthread_mutex_lock(&lock);
+	for (fd = 0; fd < SPIDEV_EMU_MAX_DEVS && devs[fd].opened; fd++)
+		;
+	if (fd == SPIDEV_EMU_MAX_DEVS)
+	{
+		pthread_mutex_unlock(&lock);
+		fprintf(stderr, "spidev_emu: no emulated device left for %s\n", path);
+		errno = EBUSY;
+		return -1;
+	}
+	dw = &devs[fd];
+	memset(dw, 0, sizeof(*dw));
+	dw->index = fd;
+	dw->max_speed_hz = 500000;
+	dw->rst_pin = -1;
+	dw->irq_pin = -1;
+
+	// Nominal OTP contents: no LDO tune, mid-range crystal trim
+	dw->otp[0x06] = 0x0100D10EUL;		// PARTID
+	dw->otp[0x07] = 0x00000E40UL + fd;	// LOTID
+	dw_reset();
+	dw->opened = 1;
+	pthread_mutex_unlock(&lock);
+
+	// The first device reads the traffic configuration and starts the timer thread shared by all of them
+	if (__atomic_fetch_add(&ndevs, 1, __ATOMIC_ACQ_REL) != 0)
+		return fd;
+
+	config.rx_rate_hz = env_double("DW1000_EMU_RX_RATE", EMU_DEFAULT_RATE);
+	config.rx_error_rate = env_double("DW1000_EMU_RX_ERRORS", 0.0);
+	config.first_path = (uint16_t) env_double("DW1000_EMU_FIRST_PATH", EMU_DEFAULT_FIRST_PATH);
+	config.fp_amplitude = (uint16_t) env_double("DW1000_EMU_AMPLITUDE", EMU_DEFAULT_AMPLITUDE);
+	config.noise = (uint16_t) env_double("DW1000_EMU_NOISE", EMU_DEFAULT_NOISE);
+	config.seed = (uint32_t) env_double("DW1000_EMU_SEED", 1);
+	config.spi_max_hz = (uint32_t) env_double("DW1000_EMU_SPI_MAX_HZ", EMU_DEFAULT_SPI_MAX_HZ);
+	config.distance_m = env_double("DW1000_EMU_DISTANCE", EMU_DEFAULT_DISTANCE);
+	config.clock_ppm = env_double("DW1000_EMU_CLOCK_PPM", 0.0);
+	config.beacon = (int) env_double("DW1000_EMU_BEACON", 0);
+	config.beacon_ppm = env_double("DW1000_EMU_BEACON_PPM", 0.0);
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&wake, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (pthread_create(&thread, NULL, timer_thread, NULL) != 0)
+	{
+		fprintf(stderr, "spidev_emu: could not start the timer thread\n");
+		devs[fd].opened = 0;
+		ndevs = 0;
+		errno = EAGAIN;
+		return -1;
+	}
+	pthread_detach(thread);
+	return fd;
+}
+
+int spidev_emu_close(int fd)
+{
+	if (fd < 0 || fd >= SPIDEV_EMU_MAX_DEVS || !devs[fd].opened)
+	{
+		errno = EBADF;
+		return -1;
+	}
+	pthread_mutex_lock(&lock);
+	devs[fd].opened = 0;
+	devs[fd].rst_pin = -1;
+	devs[fd].irq_pin = -1;
+	pthread_mutex_unlock(&lock);
+	return 0;
+}
+
+int spidev_emu_setpins(int fd, int rst_pin, int irq_pin)
+{
+	if (fd < 0 || fd >= SPIDEV_EMU_MAX_DEVS || !devs[fd].opened || rst_pin >= EMU_PINS || irq_pin >= EMU_PINS)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	pthread_mutex_lock(&lock);
+	devs[fd].rst_pin = rst_pin;
+	devs[fd].irq_pin = irq_pin;
+	pthread_mutex_unlock(&lock);
+	return 0;
+}
+
+int spidev_emu_ioctl(int fd, unsigned long request, void *arg)
+{
+	if (fd < 0 || fd >= SPIDEV_EMU_MAX_DEVS || !devs[fd].opened)
+	{
+		errno = EBADF;
+		return -1;
+	}
+
+	switch (request)
+	{
+		case SPI_IOC_WR_MODE:
+		case SPI_IOC_RD_MODE:
+		case SPI_IOC_WR_MODE32:
+		case SPI_IOC_RD_MODE32:
+		case SPI_IOC_WR_BITS_PER_WORD:
+		case SPI_IOC_RD_BITS_PER_WORD:
+			return 0;
+		case SPI_IOC_WR_MAX_SPEED_HZ:
+			devs[fd].max_speed_hz = *(uint32_t *) arg;
+			return 0;
+		case SPI_IOC_RD_MAX_SPEED_HZ:
+			*(uint32_t *) arg = devs[fd].max_speed_hz;
+			return 0;
+		default:
+			break;
+	}
+
+	if (_IOC_TYPE(request) == SPI_IOC_MAGIC && _IOC_NR(request) == 0 && _IOC_DIR(request) == _IOC_WRITE)
+		return message(fd, (struct spi_ioc_transfer *) arg, _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer));
+
+	errno = ENOTTY;
+	return -1;
+}
+
+void spidev_emu_getstats(spidev_emu_stats_t *out, int reset)
+{
+	pthread_mutex_lock(&lock);
+	*out = stats;
+	if (reset)
+		memset(&stats, 0, sizeof(stats));
+	pthread_mutex_unlock(&lock);
+}
+
+void spidev_emu_configure(const spidev_emu_config_t *cfg)
+{
+	int i;
+
+	pthread_mutex_lock(&lock);
+	config = *cfg;
+	for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+	{
+		if (!devs[i].opened)
+			continue;
+		dw = &devs[i];
+		dw->rx_next = now_ns();
+		dw->resched = 1;
+		dw_sync();
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+void spidev_emu_getconfig(spidev_emu_config_t *cfg)
+{
+	pthread_mutex_lock(&lock);
+	*cfg = config;
+	pthread_mutex_unlock(&lock);
+}
+
+int spidev_emu_inject(void)
+{
+	emu_isr_t isr[SPIDEV_EMU_MAX_DEVS];
+	uint64_t now;
+	int ret = -1;
+	int i;
+
+	pthread_mutex_lock(&lock);
+	now = now_ns();
+	for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+	{
+		isr[i] = NULL;
+		if (!devs[i].opened)
+			continue;
+		dw = &devs[i];
+		dw_update(now);
+		if (dw->rx_on && dw->air == 0 && !dw->tx_busy)
+		{
+			dw->air_remote = 0;
+			status_set(SYS_STATUS_RXPRD);
+			rx_sfd(dw->rx_seq++, now);
+			rx_end();
+			ret = 0;
+		}
+		isr[i] = dw_sync();
+	}
+	pthread_mutex_unlock(&lock);
+	for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+		if (isr[i])
+			isr[i]();
+	return ret;
+}
+
+/* Device whose reset (irq == 0) or IRQ (irq != 0) line is wired to pin, called with the lock held */
+static emu_dev_t *pin_device(int pin, int irq)
+{
+	int i;
+
+	for (i = 0; i < SPIDEV_EMU_MAX_DEVS; i++)
+		if (devs[i].opened && pin == (irq ? devs[i].irq_pin : devs[i].rst_pin))
+			return &devs[i];
+	return NULL;
+}
+
+int wiringPiSetup(void)
+{
+	return 0;
+}
+
+void pinMode(int pin, int mode)
+{
+	if (pin >= 0 && pin < EMU_PINS)
+	{
+		if (mode == OUTPUT)
+			output_pins |= 1ULL << pin;
+		else
+			output_pins &= ~(1ULL << pin);
+	}
+}
+
+void digitalWrite(int pin, int value)
+{
+	// RSTn is the only output, holding it low resets the device wired to it
+	if (pin >= 0 && pin < EMU_PINS && (output_pins & (1ULL << pin)) && value == LOW)
+	{
+		pthread_mutex_lock(&lock);
+		if ((dw = pin_device(pin, 0)) != NULL)
+			dw_reset();
+		pthread_mutex_unlock(&lock);
+	}
+}
+
+int digitalRead(int pin)
+{
+	emu_isr_t isr;
+	int level;
+
+	pthread_mutex_lock(&lock);
+	if ((dw = pin_device(pin, 1)) == NULL)
+	{
+		pthread_mutex_unlock(&lock);
+		return LOW;
+	}
+	dw_update(now_ns());
+	isr = dw_sync();
+	level = dw->line;
+	pthread_mutex_unlock(&lock);
+	if (isr)
+		isr();
+	return level ? HIGH : LOW;
+}
+
+int wiringPiISR(int pin, int edgeType, void (*function)(void))
+{
+	if (edgeType != INT_EDGE_RISING)
+	{
+		errno = EINVAL;
+		return -1;			// the DW1000 IRQ line is only watched for rising edges
+	}
+	if (pin < 0 || pin >= EMU_PINS)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	pthread_mutex_lock(&lock);
+	pin_isr[pin] = function;
+	pthread_mutex_unlock(&lock);
+	return 0;
+}
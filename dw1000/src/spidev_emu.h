@@ -0,0 +1,205 @@
+/*
+ * spidev_emu.h
+ *
+ * Emulated spidev backend for building, running and benchmarking the
+ * applications without a Raspberry Pi or a DW1000 attached. Behind the spidev
+ * calls sits a model of the DW1000 register file that transmits, receives
+ * synthetic frames and raises the IRQ line. Selected at build time with
+ * "make EMU=1", which defines DW1000_EMU.
+ *
+ * The synthetic traffic is configured with spidev_emu_configure() or, for
+ * unmodified applications, with these environment variables read when the
+ * device is opened:
+ *
+ *   DW1000_EMU_RX_RATE      frames per second on air, 0 for none (20)
+ *   DW1000_EMU_RX_ERRORS    fraction of frames received with a bad FCS (0)
+ *   DW1000_EMU_FIRST_PATH   accumulator tap of the direct path (745)
+ *   DW1000_EMU_AMPLITUDE    direct path amplitude (4000)
+ *   DW1000_EMU_NOISE        noise standard deviation per component (60)
+ *   DW1000_EMU_SEED         CIR generator seed (1)
+ *   DW1000_EMU_SPI_MAX_HZ   fastest SPI clock read back without bit errors,
+ *                           0 for no limit (20000000)
+ *   DW1000_EMU_DISTANCE     metres between devices n and n+1 (3)
+ *   DW1000_EMU_CLOCK_PPM    crystal offset step, device n runs n times this
+ *                           many ppm fast (0)
+ *   DW1000_EMU_BEACON       1 to send the synthetic frames as time sync
+ *                           beacons (dw1000_tx -b) of a virtual node whose
+ *                           clock started at boot (0)
+ *   DW1000_EMU_BEACON_PPM   crystal offset of that node, ppm fast (0)
+ *
+ * Devices opened in the same process share the air: a frame one of them
+ * sends is received by every other one listening, after the time of flight,
+ * with its RX timestamp taken on the receiver's clock and the carrier
+ * integrator showing the crystal offset between the two.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _SPIDEV_EMU_H_
+#define _SPIDEV_EMU_H_
+
+#include <stdint.h>
+
+#define SPIDEV_EMU_NUM_FILES	(64)			// 6-bit register file ID
+#define SPIDEV_EMU_FILE_LEN		(4096)			// large enough for ACC_MEM (4064 bytes)
+#define SPIDEV_EMU_BUFSIZ		(4096)			// default spidev bufsiz, longer messages fail with EMSGSIZE
+#define SPIDEV_EMU_MAX_DEVS		(4)				// emulated DW1000s, one per spidev_emu_open()
+
+typedef struct
+{
+	unsigned long		ioctls;				// SPI_IOC_MESSAGE ioctls issued
+	unsigned long		transfers;			// spi_ioc_transfer segments processed
+	unsigned long		frames;				// chip select assertions (one register access each)
+	unsigned long long	bytes;				// bytes clocked on the bus, header included
+	unsigned long		rx_frames;			// frames stored in a receive buffer
+	unsigned long		rx_missed;			// frames sent while the receiver was off or busy
+	unsigned long		rx_errors;			// frames received with a bad FCS
+	unsigned long		rx_overruns;		// frames lost because both receive buffers were full
+	unsigned long		tx_frames;			// frames sent
+	unsigned long		tx_late;			// delayed transmissions refused with HPDWARN
+} spidev_emu_stats_t;
+
+typedef struct
+{
+	double				rx_rate_hz;			// synthetic frames per second on air, 0 for none
+	double				rx_error_rate;		// fraction of frames received with a bad FCS
+	uint16_t			first_path;			// accumulator tap of the direct path
+	uint16_t			fp_amplitude;		// direct path amplitude
+	uint16_t			noise;				// noise standard deviation per component
+	uint32_t			seed;				// CIR generator seed, the CIR of a frame depends on it and the sequence number
+	uint32_t			spi_max_hz;			// reads clocked faster than this return bit errors, 0 for no limit
+	double				distance_m;			// between devices n and n+1, device n and n+k are k times as far
+	double				clock_ppm;			// device n runs n * clock_ppm ppm fast
+	int					beacon;				// synthetic frames are time sync beacons, see time_sync.h
+	double				beacon_ppm;			// crystal offset of the virtual node sending them
+} spidev_emu_config_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_open()
+ *
+ * @brief Stand-in for open() on a spidev node. Each call adds an emulated
+ * DW1000 and resets it. The first one reads the traffic configuration from the
+ * environment and starts the thread that times transmissions, receptions and
+ * IRQ edges for all devices. Every device hears the same synthetic traffic,
+ * with its own CIRs.
+ *
+ * @param path - spidev path, only used for diagnostics
+ *
+ * @return a non-negative handle, or -1 on error
+ */
+int spidev_emu_open(const char *path);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_close()
+ *
+ * @brief Stand-in for close() on a spidev handle. The device is removed and
+ * its slot can be opened again; the timer thread keeps running.
+ *
+ * @param fd - handle returned by spidev_emu_open()
+ *
+ * @return 0 on success, -1 on error
+ */
+int spidev_emu_close(int fd);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_setpins()
+ *
+ * @brief Wire the RSTn and IRQ lines of a device to wiringPi pins: driving the
+ * reset pin low resets it, digitalRead() and wiringPiISR() on the IRQ pin see
+ * its IRQ line.
+ *
+ * @param fd - handle returned by spidev_emu_open()
+ * @param rst_pin - reset pin, -1 for none
+ * @param irq_pin - IRQ pin, -1 for none
+ *
+ * @return 0 on success, -1 on error
+ */
+int spidev_emu_setpins(int fd, int rst_pin, int irq_pin);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_ioctl()
+ *
+ * @brief Stand-in for ioctl() on a spidev handle. Mode, bits per word and speed
+ * requests are accepted, SPI_IOC_MESSAGE(n) is decoded segment by segment.
+ *
+ * @param fd - handle returned by spidev_emu_open()
+ * @param request - spidev ioctl request
+ * @param arg - request argument
+ *
+ * @return the number of bytes transferred for messages, 0 for settings, -1 on error
+ */
+int spidev_emu_ioctl(int fd, unsigned long request, void *arg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_getstats()
+ *
+ * @brief Copy the bus counters accumulated since start-up or the last reset.
+ *
+ * @param stats - output counters
+ * @param reset - clear the counters after reading if non-zero
+ *
+ * @return none
+ */
+void spidev_emu_getstats(spidev_emu_stats_t *stats, int reset);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_configure()
+ *
+ * @brief Replace the synthetic traffic configuration. Frames are then sent on
+ * air every 1 / rx_rate_hz seconds from now.
+ *
+ * @param cfg - new configuration
+ *
+ * @return none
+ */
+void spidev_emu_configure(const spidev_emu_config_t *cfg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_getconfig()
+ *
+ * @brief Copy the current synthetic traffic configuration.
+ *
+ * @param cfg - output configuration
+ *
+ * @return none
+ */
+void spidev_emu_getconfig(spidev_emu_config_t *cfg);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn spidev_emu_inject()
+ *
+ * @brief Receive one synthetic frame at once, without waiting for its air time,
+ * on every device whose receiver is enabled and idle.
+ *
+ * @return 0 if a device received the frame, -1 if all receivers were off or busy
+ */
+int spidev_emu_inject(void);
+
+// ---------------------------------------------------------------------------
+// wiringPi stand-ins used by platform.c when DW1000_EMU is defined.
+// ---------------------------------------------------------------------------
+
+#define INPUT	(0)
+#define OUTPUT	(1)
+#define LOW		(0)
+#define HIGH	(1)
+
+#define INT_EDGE_SETUP		(0)
+#define INT_EDGE_FALLING	(1)
+#define INT_EDGE_RISING		(2)
+#define INT_EDGE_BOTH		(3)
+
+int wiringPiSetup(void);
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);				// reads the IRQ line of the device wired to the pin, see spidev_emu_setpins()
+int wiringPiISR(int pin, int edgeType, void (*function)(void));
+
+#endif /* _SPIDEV_EMU_H_ */
@@ -0,0 +1,136 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    time_sync.c
+ *  @brief   Over-the-air time synchronisation on the beacons of one node, see time_sync.h
+ *
+ *           The sender time M of a local timestamp L is predicted from the last beacon (L0, M0) as
+ *           M = M0 + (L - L0) * (1 + drift). The drift starts from the carrier integrator, which measures the frequency
+ *           offset of the sender on a single frame, and is then refined with the rate measured between consecutive
+ *           beacons, which also absorbs the error of the integrator. The time of flight from the sender is a constant
+ *           offset of each receiver and is not corrected.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "time_sync.h"
+
+#define SYNC_TIME_MASK      (0xFFFFFFFFFFULL)   /* 40-bit DW1000 time */
+#define SYNC_TIME_HALF      (0x8000000000ULL)
+#define SYNC_TICKS_PER_10US (638976LL)          /* 10 us of DW1000 ticks, 1/(128*499.2 MHz) each */
+
+/* Signed distance from a to b on the 40-bit clock, within half a period. */
+static int64_t timeDiff(uint64_t a, uint64_t b)
+{
+    uint64_t d = (b - a) & SYNC_TIME_MASK;
+
+    return d < SYNC_TIME_HALF ? (int64_t) d : (int64_t) d - (int64_t) (SYNC_TIME_MASK + 1);
+}
+
+/* DW1000 ticks to nanoseconds, in integers so that the sender time keeps ns resolution after days. */
+static int64_t ticksToNs(int64_t ticks)
+{
+    int64_t q = ticks / SYNC_TICKS_PER_10US;
+    int64_t r = ticks % SYNC_TICKS_PER_10US;
+
+    return q * 10000 + r * 10000 / SYNC_TICKS_PER_10US;
+}
+
+void time_sync_init(time_sync_t *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+uint64_t time_sync_extend(uint64_t *last, uint64_t t40)
+{
+    *last += (t40 - *last) & SYNC_TIME_MASK;
+    return *last;
+}
+
+void time_sync_beacon(time_sync_t *s, uint64_t master, uint64_t rx_stamp, double offset_ppm)
+{
+    uint64_t dl = (rx_stamp - s->local_ref) & SYNC_TIME_MASK;
+
+    if (s->valid && dl != 0 && dl < SYNC_TIME_HALF && master > s->master_ref)
+    {
+        /* How far the estimate had drifted since the last beacon, before it is corrected. */
+        int64_t predicted = (int64_t) (s->master_ref + dl) + llround((double) dl * s->drift);
+        double error = fabs((double) ticksToNs((int64_t) master - predicted));
+
+        s->residuals++;
+        s->residual_sum2 += error * error;
+        if (error > s->residual_max)
+        {
+            s->residual_max = error;
+        }
+        s->drift += SYNC_DRIFT_GAIN * ((double) (master - s->master_ref) / (double) dl - 1.0 - s->drift);
+    }
+    else
+    {
+        if (s->valid)
+        {
+            s->resyncs++;
+        }
+        s->drift = offset_ppm * 1e-6;
+    }
+    s->local_ref = rx_stamp & SYNC_TIME_MASK;
+    s->master_ref = master;
+    s->valid = 1;
+    s->beacons++;
+}
+
+int time_sync_frame(time_sync_t *s, const uint8 *frame, uint16 len, uint64_t rx_stamp, const dwt_config_t *config)
+{
+    uint64_t master;
+    double hz;
+    double ppm;
+
+    if (len < SYNC_BEACON_LEN || frame[1] != SYNC_BEACON)
+    {
+        return 0;
+    }
+    memcpy(&master, &frame[SYNC_TIME_IDX], sizeof(master));
+
+    /* Frequency offset of the sender, see dwt_readcarrierintegrator(). */
+    hz = dwt_readcarrierintegrator() * (config->dataRate == DWT_BR_110K ? FREQ_OFFSET_MULTIPLIER_110KB : FREQ_OFFSET_MULTIPLIER);
+    switch (config->chan)
+    {
+        case 1:
+            ppm = hz * HERTZ_TO_PPM_MULTIPLIER_CHAN_1;
+            break;
+        case 3:
+            ppm = hz * HERTZ_TO_PPM_MULTIPLIER_CHAN_3;
+            break;
+        case 5:
+        case 7:
+            ppm = hz * HERTZ_TO_PPM_MULTIPLIER_CHAN_5;
+            break;
+        default:
+            ppm = hz * HERTZ_TO_PPM_MULTIPLIER_CHAN_2;
+            break;
+    }
+
+    time_sync_beacon(s, master, rx_stamp, ppm);
+    return 1;
+}
+
+int time_sync_ns(const time_sync_t *s, uint64_t rx_stamp, int64_t *ns)
+{
+    int64_t dl;
+
+    if (!s->valid)
+    {
+        return -1;
+    }
+    dl = timeDiff(s->local_ref, rx_stamp);
+    *ns = ticksToNs((int64_t) s->master_ref + dl + llround((double) dl * s->drift));
+    return 0;
+}
+
+void time_sync_stamp(const time_sync_t *s, cir_record_t *rec)
+{
+    rec->sync_ns = 0;
+    if (time_sync_ns(s, rec->rx_stamp, &rec->sync_ns) == 0)
+    {
+        rec->flags |= CIR_RECORD_SYNC;
+    }
+}
@@ -0,0 +1,122 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    time_sync.h
+ *  @brief   Over-the-air time synchronisation on the beacons of one node
+ *
+ *           One node (dw1000_tx -b, or slot 0 of a dw1000d TDMA schedule) sends beacons carrying the time of their
+ *           RMARKER on its own DW1000 clock. Every receiver keeps the offset and the drift of its clock against the
+ *           beacon node from the RX timestamps of the beacons and the carrier integrator, and converts the RX timestamp
+ *           of any later frame to the beacon node's timebase in nanoseconds. CIR records captured on different nodes
+ *           then share one clock, see CIR_RECORD_SYNC.
+ */
+
+#ifndef _TIME_SYNC_H_
+#define _TIME_SYNC_H_
+
+#include <stdint.h>
+
+#include "deca_device_api.h"
+#include "cir_record.h"
+
+/* Beacon frame: flag, SYNC_BEACON, 64-bit sequence number, 64-bit sender time, FCS. The sender time is its 40-bit TX
+ * timestamp extended with the number of wraps of its system time, see time_sync_extend(). */
+#define SYNC_BEACON         (0x5b)      /* byte 1 of a beacon */
+#define SYNC_TIME_IDX       (10)        /* index of the sender time */
+#define SYNC_BEACON_LEN     (20)        /* FCS included */
+
+#define SYNC_DRIFT_GAIN     (0.25)      /* weight of the rate measured over the last beacon interval */
+
+typedef struct
+{
+    int             valid;          /* a beacon has been received */
+    uint64_t        local_ref;      /* RX timestamp of the last beacon, 40 bits */
+    uint64_t        master_ref;     /* sender time of the last beacon */
+    double          drift;          /* sender clock rate relative to the local one, minus one */
+    unsigned long   beacons;        /* beacons received */
+    unsigned long   resyncs;        /* beacons that restarted the estimate, the previous one was too old */
+    unsigned long   residuals;      /* beacons whose time was predicted from the previous estimate */
+    double          residual_sum2;  /* sum of the squared prediction errors, ns^2 */
+    double          residual_max;   /* largest prediction error, ns */
+} time_sync_t;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn time_sync_init()
+ *
+ * @brief Clear the estimate: no frame can be converted until the next beacon.
+ *
+ * @param  s - sync state
+ *
+ * @return  none
+ */
+void time_sync_init(time_sync_t *s);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn time_sync_extend()
+ *
+ * @brief Sender side: extend a 40-bit DW1000 time with the wraps of the system time counted so far. Calls must be
+ *        less than half a period (~8.6 s) apart.
+ *
+ * @param  last - previous extended time, 0 before the first call, updated
+ * @param  t40 - DW1000 time, 40 bits
+ *
+ * @return  the extended time
+ */
+uint64_t time_sync_extend(uint64_t *last, uint64_t t40);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn time_sync_beacon()
+ *
+ * @brief Update the estimate with a beacon. The first beacon, or one more than half a period after the previous one,
+ *        takes the drift from the carrier integrator; later ones blend in the rate measured over the interval.
+ *
+ * @param  s - sync state
+ * @param  master - sender time carried by the beacon
+ * @param  rx_stamp - RX timestamp of the beacon, 40 bits
+ * @param  offset_ppm - crystal offset of the sender measured by the carrier integrator, ppm
+ *
+ * @return  none
+ */
+void time_sync_beacon(time_sync_t *s, uint64_t master, uint64_t rx_stamp, double offset_ppm);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn time_sync_frame()
+ *
+ * @brief Update the estimate with the frame just received if it is a beacon. Reads the carrier integrator, so it must
+ *        run before the receiver is re-enabled for another frame.
+ *
+ * @param  s - sync state
+ * @param  frame - frame data
+ * @param  len - frame length, FCS included
+ * @param  rx_stamp - RX timestamp of the frame, 40 bits
+ * @param  config - configuration of the DW1000, for the carrier integrator scale
+ *
+ * @return  1 if the frame was a beacon, 0 otherwise
+ */
+int time_sync_frame(time_sync_t *s, const uint8 *frame, uint16 len, uint64_t rx_stamp, const dwt_config_t *config);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn time_sync_ns()
+ *
+ * @brief Convert a local RX timestamp, within half a period of the last beacon, to the sender timebase.
+ *
+ * @param  s - sync state
+ * @param  rx_stamp - RX timestamp, 40 bits
+ * @param  ns - receives the time on the beacon sender's clock, ns
+ *
+ * @return  0 on success, -1 if no beacon was received yet
+ */
+int time_sync_ns(const time_sync_t *s, uint64_t rx_stamp, int64_t *ns);
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn time_sync_stamp()
+ *
+ * @brief Once synchronised, set sync_ns from rx_stamp and CIR_RECORD_SYNC in a record. Call after copyCIRToRecord(),
+ *        which sets the flags and rx_stamp.
+ *
+ * @param  s - sync state
+ * @param  rec - the record
+ *
+ * @return  none
+ */
+void time_sync_stamp(const time_sync_t *s, cir_record_t *rec);
+
+#endif /* _TIME_SYNC_H_ */
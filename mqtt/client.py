@@ -5,34 +5,61 @@
 
 
 import paho.mqtt.client as client
-import time, subprocess, shlex, sys
+import time, socket, sys
 import numpy as np
 
 HOST = sys.argv[1] #235 in arena/199 in home
 PORT = int(sys.argv[2]) #1884 in arena/1883 in home
 TOPIC = "UWB"
 FLAG = int(sys.argv[3])
+DAEMON = sys.argv[4] if len(sys.argv) > 4 else "/tmp/dw1000d.sock" # socket of dw1000/src/dw1000d, started once beforehand
+
+# The radio stays initialised in dw1000d, each message only switches its role
+daemon = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+daemon.connect(DAEMON)
+daemon_io = daemon.makefile("rw")
+
+def dw1000d(cmd):
+    daemon_io.write(cmd + "\n")
+    daemon_io.flush()
+    reply = daemon_io.readline().strip()
+    print("%s: %s" % (cmd, reply))
+    return reply
+
+def UWB_TDMA(fields):
+    # Slot table: TDMA <file> <slot_ms> <rounds> <node of slot 0> <node of slot 1> ...
+    nodes = [int(n) for n in fields[4:]]
+    if FLAG not in nodes:
+        print("no slot")
+        return
+    slot = nodes.index(FLAG)
+    if slot == 0:
+        time.sleep(0.1) # The beacon starts the rounds, let the others get the table first
+    print("slot %i of %i" % (slot, len(nodes)))
+    dw1000d("RX %s.%i" % (fields[1], FLAG))
+    dw1000d("TDMA %i %i %s %s" % (slot, len(nodes), fields[2], fields[3]))
+    print("-"*30)
 
 def UWB_on_Message(client, userdata, msg):
-    if(len(msg.payload)):
-        speaker = int(msg.payload[0])
-        sequence_num = int(msg.payload[1:])
+    payload = msg.payload.decode()
+    if payload.startswith("TDMA"):
+        UWB_TDMA(payload.split())
+    elif(len(payload)):
+        speaker = int(payload[0])
+        sequence_num = int(payload[1:])
         print( "%s %i" % (msg.topic, sequence_num) )
         if(speaker== FLAG):
-            time.sleep(0.3)
+            time.sleep(0.01) # Listeners switch role in microseconds, only leave room for the MQTT delivery spread
             print("say")
-            cmd = shlex.split("/home/pi/UWB/dw1000/src/dw1000_tx")
-            p = subprocess.Popen(cmd, stdout=subprocess.PIPE)
-            print(p.communicate()[0].decode("utf-8")) # If communicate is called, it will wait until the process is terminated
+            dw1000d("TX %i" % sequence_num)
             print("-"*30)
         elif speaker<4 and speaker>-1:
             print("hear")
-            cmd = shlex.split("/home/pi/UWB/dw1000/src/dw1000_rx_cir %i" % sequence_num)
-            p = subprocess.Popen(cmd, stdout=subprocess.PIPE)
-            print(p.communicate()[0].decode("utf-8"))
+            dw1000d("RX %i.cir" % sequence_num)
             print("-"*30)
         else:
             print("End client")
+            dw1000d("CLOSE")
             sys.exit(0)
 
 def on_connect(client, userdata, flags, rc):
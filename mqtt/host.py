@@ -6,25 +6,25 @@
 
 import paho.mqtt.publish as publish
 import time
-import numpy as np
 import sys
 
 HOST = sys.argv[1] #235 in arena/199 in home
 PORT = int(sys.argv[2]) #1884 in arena/1883 in home
+FILE = sys.argv[3] if len(sys.argv) > 3 else "tdma" # capture of node n: data/<FILE>.<n>
+
+NODES = [0, 1, 2, 3] # node of each slot, slot 0 sends the beacon
+SLOT_MS = 6 # a frame is about 2.5 ms on air
+ROUNDS = 40
 
 def main():
-    epoch = 0
-    squence_num = 0
-    while(epoch<40):
-        for i in np.arange(4):
-            print("RPI %i speaks..." % i)
-            print("MSG %i" % squence_num)
-            print("-"*30)
-            publish.single("UWB", "%i%i"% (i, squence_num), hostname=HOST, port=PORT)
-            squence_num += 1
-            time.sleep(0.5)
-        epoch +=1
-        
-if __name__ == "__main__":  
-    main()
+    # The slot table goes out once: the nodes time their slots off the beacon on the DW1000 clock, a round takes
+    # len(NODES) * SLOT_MS ms and needs no message from here
+    table = "TDMA %s %i %i %s" % (FILE, SLOT_MS, ROUNDS, " ".join("%i" % n for n in NODES))
+    print(table)
+    publish.single("UWB", table, hostname=HOST, port=PORT)
+    time.sleep(ROUNDS * len(NODES) * SLOT_MS / 1000.0 + 1)
+    print("-"*30)
+    publish.single("UWB", "9%i" % ROUNDS, hostname=HOST, port=PORT) # clients close their capture and stop
 
+if __name__ == "__main__":
+    main()
@@ -6,7 +6,7 @@ Created on Mon Mar 25 17:49:15 2019
 @author: wangchenxi
 """
 
-import paramiko, shlex, subprocess
+import paramiko, shlex, subprocess, time
 
 def main():  
       
@@ -43,6 +43,9 @@ def main():
         rpi[idx].set_missing_host_key_policy(paramiko.AutoAddPolicy())
         try:
             rpi[idx].connect(hostname=hostname, username=username, password=password, timeout=2)
+            # Start the resident radio daemon once, the client then only sends it role switches
+            rpi[idx].exec_command("cd /home/pi/UWB/dw1000/src && sudo nohup ./dw1000d > /dev/null 2>&1 &")
+            time.sleep(1)
             stdin, stdout, stderr = rpi[idx].exec_command("python /home/pi/UWB/mqtt/client.py "+HOST+" "+PORT+" %i" % idx) # Set flag of each Rpi
             # This function just pass through the command. It doesn't wait for it to end.
 #            misbehave.append(idx) # This part is not finished yet